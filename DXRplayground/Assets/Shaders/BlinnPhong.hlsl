@@ -19,6 +19,15 @@ struct CbMaterial
     int NormalTexture;
     int OcclusionTexture;
     float4 BaseColorFactor;
+    // Compact vertices only, unused here
+    float4 PositionScale;
+    float4 PositionOffset;
+    float4 UvScaleOffset;
+    // Atlas page rects of the packed textures, see MaterialTextureRemap
+    float4 BaseColorRemap;
+    float4 MetallicRoughnessRemap;
+    float4 NormalRemap;
+    float4 OcclusionRemap;
 };
 struct Light
 {
@@ -72,13 +81,14 @@ vOut vs(vIn i)
 
 float4 ps(vOut i) : SV_Target
 {
-    float4 t = Textures[cbMaterial.BaseColorTexture].Sample(LinearWrapSampler, i.uv);
+    float4 t = SampleMaterialTexture(Textures[cbMaterial.BaseColorTexture], LinearWrapSampler, cbMaterial.BaseColorRemap, i.uv);
     float3 normal = normalize(i.norm);
     float3 tangent = normalize(i.tangent.xyz);
     float3 bitangent = cross(normal, tangent) * i.tangent.w;
     float3x3 tbn = float3x3(tangent, bitangent, normal);
 
-    float3 bumpNorm = Textures[cbMaterial.NormalTexture].Sample(LinearWrapSampler, i.uv).xyz * 2.0f - 1.0f;
+    float2 bumpXY = SampleMaterialTexture(Textures[cbMaterial.NormalTexture], LinearWrapSampler, cbMaterial.NormalRemap, i.uv).xy * 2.0f - 1.0f;
+    float3 bumpNorm = float3(bumpXY, sqrt(saturate(1.0f - dot(bumpXY, bumpXY)))); // BC5 normal maps only store xy
     bumpNorm = normalize(mul(bumpNorm, tbn));
 
     float3 bp = BlinnPhong(cbLight.Lights[0].Direction, cbLight.Lights[0].Color, cbCamera.Position, i.wpos, bumpNorm);
@@ -13,6 +13,14 @@ float4 RGBtosRGB(float4 c)
     return float4(pow(c.rgb, 1.0f / 2.2f), c.a);
 }
 
+// The padding around a packed texture holds its wrapped edges. Gradients of the unwrapped uv keep the mip selection across the frac seam.
+// Textures on their own have the identity remap.
+float4 SampleMaterialTexture(Texture2D<float4> tex, SamplerState wrapSampler, float4 remap, float2 uv)
+{
+    float2 pageUv = frac(uv) * remap.xy + remap.zw;
+    return tex.SampleGrad(wrapSampler, pageUv, ddx(uv) * remap.xy, ddy(uv) * remap.xy);
+}
+
 float3 BlinnPhong(float3 lightDir, float3 lightColor, float3 eyePos, float3 pos, float3 n)
 {
     float3 v = normalize(pos - eyePos);
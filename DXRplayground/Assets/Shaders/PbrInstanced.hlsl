@@ -20,6 +20,15 @@ struct CbMaterial
     int NormalTexture;
     int OcclusionTexture;
     float4 BaseColorFactor;
+    // Compact vertices only, unused here
+    float4 PositionScale;
+    float4 PositionOffset;
+    float4 UvScaleOffset;
+    // Atlas page rects of the packed textures, see MaterialTextureRemap
+    float4 BaseColorRemap;
+    float4 MetallicRoughnessRemap;
+    float4 NormalRemap;
+    float4 OcclusionRemap;
 };
 
 struct Light
@@ -75,18 +84,19 @@ vOut vs(vIn i, uint ind : SV_InstanceID)
 
 float4 ps(vOut pIn) : SV_Target
 {
-    float4 albedo = Textures[cbMaterial.BaseColorTexture].Sample(LinearWrapSampler, pIn.uv);
+    float4 albedo = SampleMaterialTexture(Textures[cbMaterial.BaseColorTexture], LinearWrapSampler, cbMaterial.BaseColorRemap, pIn.uv);
     albedo = sRGBtoRGB(albedo);
 
-    float2 metalnessRoughness = Textures[cbMaterial.MetallicRoughnessTexture].Sample(LinearWrapSampler, pIn.uv).xy;
-    float AO = Textures[cbMaterial.OcclusionTexture].Sample(LinearWrapSampler, pIn.uv).x;
+    float2 metalnessRoughness = SampleMaterialTexture(Textures[cbMaterial.MetallicRoughnessTexture], LinearWrapSampler, cbMaterial.MetallicRoughnessRemap, pIn.uv).xy;
+    float AO = SampleMaterialTexture(Textures[cbMaterial.OcclusionTexture], LinearWrapSampler, cbMaterial.OcclusionRemap, pIn.uv).x;
 
     float3 normal = normalize(pIn.norm);
     float3 tangent = normalize(pIn.tangent.xyz);
     float3 bitangent = cross(normal, tangent) * pIn.tangent.w;
     float3x3 tbn = float3x3(tangent, bitangent, normal);
 
-    float3 bumpNorm = Textures[cbMaterial.NormalTexture].Sample(LinearWrapSampler, pIn.uv).xyz * 2.0f - 1.0f;
+    float2 bumpXY = SampleMaterialTexture(Textures[cbMaterial.NormalTexture], LinearWrapSampler, cbMaterial.NormalRemap, pIn.uv).xy * 2.0f - 1.0f;
+    float3 bumpNorm = float3(bumpXY, sqrt(saturate(1.0f - dot(bumpXY, bumpXY)))); // BC5 normal maps only store xy
     float3 N = normalize(mul(bumpNorm, tbn));
 
     float3 wpos = pIn.wpos;
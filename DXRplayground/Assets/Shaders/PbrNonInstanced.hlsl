@@ -20,6 +20,15 @@ struct CbMaterial
     int NormalTexture;
     int OcclusionTexture;
     float4 BaseColorFactor;
+    // Compact vertices only, see VertexDequantization
+    float4 PositionScale;
+    float4 PositionOffset;
+    float4 UvScaleOffset;
+    // Atlas page rects of the packed textures, see MaterialTextureRemap
+    float4 BaseColorRemap;
+    float4 MetallicRoughnessRemap;
+    float4 NormalRemap;
+    float4 OcclusionRemap;
 };
 
 struct Light
@@ -44,6 +53,23 @@ Texture2D<float4> Textures[10000] : register(t0);
 SamplerState LinearClampSampler : register(s0);
 SamplerState LinearWrapSampler : register(s1);
 
+#ifdef COMPACT_VERTICES
+// CompactVertex: snorm16 position with the tangent sign in w, unorm16 uv, octahedral normal and tangent
+struct vIn
+{
+    float4 pos : POSITION;
+    float2 uv : TEXCOORD0;
+    float4 normTangent : NORMAL;
+};
+
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.xy -= (step(0.0f, n.xy) * 2.0f - 1.0f) * t;
+    return normalize(n);
+}
+#else
 struct vIn
 {
     float3 pos : POSITION;
@@ -51,6 +77,7 @@ struct vIn
     float2 uv : TEXCOORD0;
     float4 tangent : TANGENT0;
 };
+#endif
 
 struct vOut
 {
@@ -64,29 +91,38 @@ struct vOut
 vOut vs(vIn i, uint ind : SV_InstanceID)
 {
     vOut o;
-    float4 wPos = mul(float4(i.pos.xyz, 1.0f), cbObject.ToWorld);
-    o.wpos = wPos.xyz;
-    o.pos = mul(wPos, cbCamera.ViewProjection);
+#ifdef COMPACT_VERTICES
+    float3 pos = i.pos.xyz * cbMaterial.PositionScale.xyz + cbMaterial.PositionOffset.xyz;
+    o.norm = DecodeOctahedral(i.normTangent.xy);
+    o.tangent = float4(DecodeOctahedral(i.normTangent.zw), i.pos.w < 0.0f ? -1.0f : 1.0f);
+    o.uv = i.uv * cbMaterial.UvScaleOffset.xy + cbMaterial.UvScaleOffset.zw;
+#else
+    float3 pos = i.pos.xyz;
     o.norm = i.norm;
     o.tangent = i.tangent;
     o.uv = i.uv;
+#endif
+    float4 wPos = mul(float4(pos, 1.0f), cbObject.ToWorld);
+    o.wpos = wPos.xyz;
+    o.pos = mul(wPos, cbCamera.ViewProjection);
     return o;
 }
 
 float4 ps(vOut pIn) : SV_Target
 {
-    float4 albedo = Textures[cbMaterial.BaseColorTexture].Sample(LinearWrapSampler, pIn.uv);
+    float4 albedo = SampleMaterialTexture(Textures[cbMaterial.BaseColorTexture], LinearWrapSampler, cbMaterial.BaseColorRemap, pIn.uv);
     albedo = sRGBtoRGB(albedo);
 
-    float2 metalnessRoughness = Textures[cbMaterial.MetallicRoughnessTexture].Sample(LinearWrapSampler, pIn.uv).xy;
-    float AO = Textures[cbMaterial.OcclusionTexture].Sample(LinearWrapSampler, pIn.uv).x;
+    float2 metalnessRoughness = SampleMaterialTexture(Textures[cbMaterial.MetallicRoughnessTexture], LinearWrapSampler, cbMaterial.MetallicRoughnessRemap, pIn.uv).xy;
+    float AO = SampleMaterialTexture(Textures[cbMaterial.OcclusionTexture], LinearWrapSampler, cbMaterial.OcclusionRemap, pIn.uv).x;
 
     float3 normal = normalize(pIn.norm);
     float3 tangent = normalize(pIn.tangent.xyz);
     float3 bitangent = cross(normal, tangent) * pIn.tangent.w;
     float3x3 tbn = float3x3(tangent, bitangent, normal);
 
-    float3 bumpNorm = Textures[cbMaterial.NormalTexture].Sample(LinearWrapSampler, pIn.uv).xyz * 2.0f - 1.0f;
+    float2 bumpXY = SampleMaterialTexture(Textures[cbMaterial.NormalTexture], LinearWrapSampler, cbMaterial.NormalRemap, pIn.uv).xy * 2.0f - 1.0f;
+    float3 bumpNorm = float3(bumpXY, sqrt(saturate(1.0f - dot(bumpXY, bumpXY)))); // BC5 normal maps only store xy
     float3 N = normalize(mul(bumpNorm, tbn));
 
     float3 wpos = pIn.wpos;
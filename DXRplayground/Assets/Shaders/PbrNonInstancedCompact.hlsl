@@ -0,0 +1,2 @@
+#define COMPACT_VERTICES
+#include "PbrNonInstanced.hlsl"
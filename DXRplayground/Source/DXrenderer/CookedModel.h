@@ -0,0 +1,61 @@
+#pragma once
+
+#include "DXrenderer/Model.h"
+
+namespace DirectxPlayground
+{
+// Layout of the cooked model file, written next to the source glTF:
+// header | meshes | instances | images | dependencies | strings | vertex and index data.
+// Vertices and indices are stored exactly as they are uploaded, so loading is a file mapping plus offsets.
+constexpr UINT CookedModelMagic = 0x4d505844; // "DXPM"
+constexpr UINT CookedModelVersion = 9;
+constexpr UINT CookedDataAlignment = 16;
+
+struct CookedModelHeader
+{
+    UINT Magic = CookedModelMagic;
+    UINT Version = CookedModelVersion;
+    UINT64 SourceHash = 0; // .gltf/.glb and every external buffer it references
+    UINT64 OptionsHash = 0; // ModelLoadOptions the model was cooked with
+    UINT MeshCount = 0;
+    UINT InstanceCount = 0; // MeshInstance records
+    UINT ImageCount = 0;
+    UINT DependencyCount = 0;
+    UINT StringsSize = 0;
+    UINT64 DataOffset = 0;
+};
+
+struct CookedString
+{
+    UINT Offset = 0;
+    UINT Length = 0;
+};
+
+struct CookedMesh
+{
+    UINT64 VertexOffset = 0; // Relative to CookedModelHeader::DataOffset
+    UINT64 IndexOffset = 0;
+    UINT64 MeshletOffset = 0;
+    UINT64 MeshletVertexOffset = 0;
+    UINT64 MeshletTriangleOffset = 0;
+    UINT64 LodOffset = 0;
+    UINT VertexCount = 0;
+    UINT IndexCount = 0;
+    UINT MeshletCount = 0;
+    UINT MeshletVertexCount = 0;
+    UINT MeshletTriangleCount = 0;
+    UINT LodCount = 0;
+    VertexLayout Layout = VertexLayout::Float; // Format of the vertex block
+    DXGI_FORMAT IndexFormat = DXGI_FORMAT_R32_UINT; // Format of the index block
+    VertexDequantization Dequantization;
+    DirectX::XMFLOAT3 BoundsCenter = {};
+    float BoundsRadius = 0.0f;
+    float UvDensity = 0.0f;
+    Material MeshMaterial{ -1, -1, -1, -1 }; // Texture slots index the image table, -1 if not set
+};
+
+inline std::string GetCookedModelPath(const std::string& path)
+{
+    return path + ".cooked";
+}
+}
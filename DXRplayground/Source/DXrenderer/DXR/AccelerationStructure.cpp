@@ -2,6 +2,8 @@
 
 #include "DXrenderer/Model.h"
 
+#include <algorithm>
+
 namespace DirectxPlayground::DXR
 {
 
@@ -38,7 +40,8 @@ UINT64 AccelerationStructure::GetMaxScratchSize(std::vector<AccelerationStructur
 
 BottomLevelAccelerationStructure::BottomLevelAccelerationStructure(RenderContext& context, std::vector<Model*> models, std::vector<D3D12_RAYTRACING_AABB> aabbs)
 {
-    std::swap(models, m_models);
+    for (const auto model : models)
+        m_meshes.insert(m_meshes.end(), model->GetMeshes().begin(), model->GetMeshes().end());
     m_desc.reserve(16);
 
     m_aabbsCount = UINT(aabbs.size());
@@ -76,6 +79,12 @@ BottomLevelAccelerationStructure::BottomLevelAccelerationStructure(RenderContext
 {
 }
 
+BottomLevelAccelerationStructure::BottomLevelAccelerationStructure(RenderContext& context, const Model::Mesh* mesh)
+    : BottomLevelAccelerationStructure(context, std::vector<Model*>{}, {})
+{
+    m_meshes.push_back(mesh);
+}
+
 BottomLevelAccelerationStructure::BottomLevelAccelerationStructure(RenderContext& context, std::vector<D3D12_RAYTRACING_AABB> aabbs)
     : BottomLevelAccelerationStructure(context, {}, std::move(aabbs))
 {
@@ -104,28 +113,33 @@ void BottomLevelAccelerationStructure::Prebuild(RenderContext& context, const D3
     else
     {
         desc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-        desc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
         desc.Triangles.Transform3x4 = 0;
-        desc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-        desc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
         desc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
     }
-    for (const auto model : m_models)
+    // Meshes of a merged model share their buffers, each one is transitioned once.
+    std::vector<ID3D12Resource*> transitionedBuffers;
+    for (const auto mesh : m_meshes)
     {
-        for (const auto mesh : model->GetMeshes())
+        for (ID3D12Resource* buffer : { mesh->GetIndexBufferResource(), mesh->GetVertexBufferResource() })
         {
-            m_toNonPixelTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(mesh->GetIndexBufferResource(), D3D12_RESOURCE_STATE_INDEX_BUFFER, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
-            m_toNonPixelTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(mesh->GetVertexBufferResource(), D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
-
-            m_toIndexVertexTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(mesh->GetIndexBufferResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_INDEX_BUFFER));
-            m_toIndexVertexTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(mesh->GetVertexBufferResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-
-            desc.Triangles.IndexBuffer = mesh->GetIndexBufferGpuAddress();
-            desc.Triangles.IndexCount = mesh->GetIndexCount();
-            desc.Triangles.VertexCount = mesh->GetVertexCount();
-            desc.Triangles.VertexBuffer.StartAddress = mesh->GetVertexBufferGpuAddress();
-            m_desc.push_back(desc);
+            if (std::find(transitionedBuffers.begin(), transitionedBuffers.end(), buffer) != transitionedBuffers.end())
+                continue;
+            transitionedBuffers.push_back(buffer);
+            D3D12_RESOURCE_STATES state = buffer == mesh->GetIndexBufferResource() ? D3D12_RESOURCE_STATE_INDEX_BUFFER : D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+            m_toNonPixelTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(buffer, state, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+            m_toIndexVertexTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, state));
         }
+
+        // Compact positions would need their dequantization as Transform3x4, the models traced so far are float.
+        assert(mesh->GetVertexLayout() == VertexLayout::Float && "Compact vertices aren't supported in BLAS yet");
+        desc.Triangles.VertexFormat = GetVertexPositionFormat(mesh->GetVertexLayout());
+        desc.Triangles.VertexBuffer.StrideInBytes = mesh->GetVertexStride();
+        desc.Triangles.IndexFormat = mesh->GetIndexFormat();
+        desc.Triangles.IndexBuffer = mesh->GetIndexBufferGpuAddress();
+        desc.Triangles.IndexCount = mesh->GetIndexCount();
+        desc.Triangles.VertexCount = mesh->GetVertexCount();
+        desc.Triangles.VertexBuffer.StartAddress = mesh->GetVertexBufferGpuAddress();
+        m_desc.push_back(desc);
     }
 
     if (m_aabbsCount > 0)
@@ -204,6 +218,19 @@ void TopLevelAccelerationStructure::AddDescriptor(D3D12_RAYTRACING_INSTANCE_DESC
     m_instanceDescs.push_back(std::move(desc));
 }
 
+void TopLevelAccelerationStructure::AddInstances(const Model& model, const std::vector<BottomLevelAccelerationStructure*>& meshBlases, const DirectX::XMFLOAT4X4& toWorld /* = Identity */, UINT instanceMask /* = 0 */, UINT instanceId /* = 0 */, UINT flags /* = 0 */, UINT contribToHitGroupIndex /* = 0 */)
+{
+    assert(meshBlases.size() == model.GetMeshes().size());
+    DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&toWorld);
+    for (const auto& instance : model.GetInstances())
+    {
+        // Instance descs take the 3x4 part of a column vector matrix
+        DirectX::XMFLOAT4X4 transform;
+        DirectX::XMStoreFloat4x4(&transform, DirectX::XMMatrixTranspose(DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&instance.Transform), world)));
+        AddDescriptor(*meshBlases[instance.MeshIndex], transform, instanceMask, instanceId, flags, contribToHitGroupIndex);
+    }
+}
+
 void TopLevelAccelerationStructure::Prebuild(RenderContext& context, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags /* = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE*/)
 {
     D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& buildDescInputs = mBuildDesc.Inputs;
@@ -5,6 +5,7 @@
 #include <DirectXMath.h>
 
 #include "DXrenderer/DXhelpers.h"
+#include "DXrenderer/Model.h"
 #include "DXrenderer/ResourceDX.h"
 #include "DXrenderer/Buffers/UploadBuffer.h"
 #include "External/Dx12Helpers/d3dx12.h"
@@ -12,7 +13,6 @@
 namespace DirectxPlayground
 {
 
-class Model;
 class UnorderedAccessBuffer;
 class UploadBuffer;
 struct RenderContext;
@@ -92,6 +92,7 @@ public:
     BottomLevelAccelerationStructure(RenderContext& context, std::vector<Model*> models, std::vector<D3D12_RAYTRACING_AABB> aabbs);
     BottomLevelAccelerationStructure(RenderContext& context, std::vector<Model*> models);
     BottomLevelAccelerationStructure(RenderContext& context, Model* model);
+    BottomLevelAccelerationStructure(RenderContext& context, const Model::Mesh* mesh);
     BottomLevelAccelerationStructure(RenderContext& context, std::vector<D3D12_RAYTRACING_AABB> aabbs);
     BottomLevelAccelerationStructure(RenderContext& context, D3D12_RAYTRACING_AABB aabb);
 
@@ -101,7 +102,7 @@ public:
 
 private:
    std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> m_desc;
-   std::vector<Model*> m_models;
+   std::vector<const Model::Mesh*> m_meshes;
    UINT m_aabbsCount = 0;
 
    ResourceDX m_aabbResource{ D3D12_RESOURCE_STATE_COPY_DEST };
@@ -123,6 +124,8 @@ public:
 
     void AddDescriptor(const BottomLevelAccelerationStructure& blas, const DirectX::XMFLOAT4X4& transform = IdentityMatrix, UINT instanceMask = 0, UINT instanceId = 0, UINT flags = 0, UINT contribToHitGroupIndex = 0);
     void AddDescriptor(D3D12_RAYTRACING_INSTANCE_DESC desc);
+    // One descriptor per model instance, meshBlases are indexed by MeshInstance::MeshIndex. toWorld uses row vectors.
+    void AddInstances(const Model& model, const std::vector<BottomLevelAccelerationStructure*>& meshBlases, const DirectX::XMFLOAT4X4& toWorld = IdentityMatrix, UINT instanceMask = 0, UINT instanceId = 0, UINT flags = 0, UINT contribToHitGroupIndex = 0);
 
     void Prebuild(RenderContext& context, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE);
     void Build(RenderContext& context, UnorderedAccessBuffer* scratchBuffer, bool setUavBarrier) override;
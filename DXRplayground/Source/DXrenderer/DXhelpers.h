@@ -8,6 +8,8 @@
 #include <DirectXMath.h>
 #include "External/Dx12Helpers/d3dx12.h"
 #include "DXrenderer/RenderContext.h"
+#include "DXrenderer/Geometry/VertexLayout.h"
+#include "DXrenderer/Textures/TextureFormat.h"
 #include "Utils/Logger.h"
 
 namespace DirectxPlayground
@@ -81,16 +83,9 @@ inline DirectX::XMFLOAT4X4 TransposeMatrix(const DirectX::XMFLOAT4X4& m)
     return res;
 }
 
-inline std::array<D3D12_INPUT_ELEMENT_DESC, 4>& GetInputLayoutUV_N_T()
+inline const std::vector<D3D12_INPUT_ELEMENT_DESC>& GetInputLayoutUV_N_T()
 {
-    static std::array<D3D12_INPUT_ELEMENT_DESC, 4> layout = 
-    { {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 20, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-    } };
-    return layout;
+    return GetVertexInputLayout(VertexLayout::Float);
 }
 
 
@@ -234,11 +229,45 @@ inline D3D12_COMPUTE_PIPELINE_STATE_DESC GetDefaultComputePsoDescriptor(ID3D12Ro
     return desc;
 }
 
+// Bytes per pixel, 0 for block compressed formats and the ones TextureFormat doesn't list
+inline UINT FindPixelSize(DXGI_FORMAT format)
+{
+    return GetFormatPixelBytes(static_cast<TextureFormat>(format));
+}
+
 inline UINT GetPixelSize(DXGI_FORMAT format)
 {
-    static const std::map<DXGI_FORMAT, UINT> formats{ { DXGI_FORMAT_R8G8B8A8_UNORM, 4 }, { DXGI_FORMAT_R32G32B32A32_FLOAT, 16 }, { DXGI_FORMAT_R32G32B32_FLOAT, 12 } };
-    assert(formats.count(format) == 1 && "Pixel size for the format isn't defined");
-    return formats.at(format);
+    UINT size = FindPixelSize(format);
+    assert(size != 0 && "Pixel size for the format isn't defined");
+    return size;
+}
+
+// Bytes per 4x4 block, 0 for formats that aren't block compressed
+inline UINT GetBlockBytes(DXGI_FORMAT format)
+{
+    return GetFormatBlockBytes(static_cast<TextureFormat>(format));
+}
+
+inline UINT64 GetRowPitch(DXGI_FORMAT format, UINT width)
+{
+    UINT blockBytes = GetBlockBytes(format);
+    return blockBytes != 0 ? UINT64((width + 3) / 4) * blockBytes : UINT64(width) * GetPixelSize(format);
+}
+
+// Rows of pixels or rows of blocks
+inline UINT GetRowsCount(DXGI_FORMAT format, UINT height)
+{
+    return GetBlockBytes(format) != 0 ? (height + 3) / 4 : height;
+}
+
+// A resource can start with this mip of the texture, block compressed ones need whole blocks on top
+inline bool IsBlockAlignedMip(DXGI_FORMAT format, UINT width, UINT height, UINT mip)
+{
+    if (GetBlockBytes(format) == 0)
+        return true;
+    width >>= mip;
+    height >>= mip;
+    return width != 0 && height != 0 && (width & 3) == 0 && (height & 3) == 0;
 }
 
 inline constexpr DirectX::XMFLOAT4X4 IdentityMatrix{
@@ -0,0 +1,352 @@
+#include "DXrenderer/Geometry/AccessorDecoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#define ACCESSOR_DECODER_AVX2
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ACCESSOR_DECODER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DirectxPlayground
+{
+namespace
+{
+struct KernelParams
+{
+    float Scale[4];
+    float Offset[4];
+    float Min; // Signed normalized values clamp -128 and -32768 to -1
+};
+
+using DecodeKernel = void (*)(const byte* src, UINT srcStride, size_t count, byte* dst, UINT dstStride, const KernelParams& params);
+
+template <typename T>
+float ReadScalar(const byte* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return static_cast<float>(value);
+}
+
+template <typename T, bool Clamp, UINT N>
+struct ScalarKernel
+{
+    static void Run(const byte* src, UINT srcStride, size_t count, byte* dst, UINT dstStride, const KernelParams& params)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const byte* element = src + size_t(srcStride) * i;
+            float out[N];
+            for (UINT c = 0; c < N; ++c)
+            {
+                float value = ReadScalar<T>(element + c * sizeof(T));
+                if constexpr (Clamp)
+                    value = std::max(value, params.Min);
+                out[c] = value * params.Scale[c] + params.Offset[c];
+            }
+            memcpy(dst + size_t(dstStride) * i, out, sizeof(out));
+        }
+    }
+};
+
+#if defined(ACCESSOR_DECODER_AVX2) || defined(ACCESSOR_DECODER_SSE2)
+// Bytes read by one vector load of 4 components
+template <typename T>
+constexpr size_t LoadSize = sizeof(T) == 1 ? 4 : (sizeof(T) == 2 ? 8 : 16);
+
+template <typename T>
+__m128i LoadInts(const byte* data)
+{
+    if constexpr (sizeof(T) == 1)
+    {
+        int bits;
+        memcpy(&bits, data, sizeof(bits));
+        __m128i v = _mm_cvtsi32_si128(bits);
+#if defined(ACCESSOR_DECODER_AVX2)
+        return std::is_signed_v<T> ? _mm_cvtepi8_epi32(v) : _mm_cvtepu8_epi32(v);
+#else
+        if constexpr (std::is_signed_v<T>)
+        {
+            v = _mm_unpacklo_epi8(v, v);
+            return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+        }
+        else
+        {
+            __m128i zero = _mm_setzero_si128();
+            return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+        }
+#endif
+    }
+    else if constexpr (sizeof(T) == 2)
+    {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+#if defined(ACCESSOR_DECODER_AVX2)
+        return std::is_signed_v<T> ? _mm_cvtepi16_epi32(v) : _mm_cvtepu16_epi32(v);
+#else
+        if constexpr (std::is_signed_v<T>)
+            return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        else
+            return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+#endif
+    }
+    else
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    }
+}
+
+// No unsigned 32 bit conversion before AVX-512, both halves convert exactly and the sum is rounded once.
+inline __m128 UIntsToFloats(__m128i v)
+{
+    __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+    __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)));
+    return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+}
+
+template <typename T>
+__m128 Load(const byte* data)
+{
+    if constexpr (std::is_same_v<T, float>)
+        return _mm_loadu_ps(reinterpret_cast<const float*>(data));
+    else if constexpr (std::is_same_v<T, UINT>)
+        return UIntsToFloats(LoadInts<T>(data));
+    else
+        return _mm_cvtepi32_ps(LoadInts<T>(data));
+}
+
+#if defined(ACCESSOR_DECODER_AVX2)
+inline __m256 UIntsToFloats(__m256i v)
+{
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xFFFF)));
+    return _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+}
+
+// Two elements in one register, the first one in the low half
+template <typename T>
+__m256 Load2(const byte* first, const byte* second)
+{
+    if constexpr (std::is_same_v<T, float>)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(Load<T>(first)), Load<T>(second), 1);
+    }
+    else
+    {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(LoadInts<T>(first)), LoadInts<T>(second), 1);
+        if constexpr (std::is_same_v<T, UINT>)
+            return UIntsToFloats(v);
+        else
+            return _mm256_cvtepi32_ps(v);
+    }
+}
+#endif
+
+template <UINT N>
+void Store(byte* dst, __m128 v)
+{
+    float* out = reinterpret_cast<float*>(dst);
+    if constexpr (N == 1)
+    {
+        _mm_store_ss(out, v);
+    }
+    else if constexpr (N == 2)
+    {
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), v);
+    }
+    else if constexpr (N == 3)
+    {
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), v);
+        _mm_store_ss(out + 2, _mm_movehl_ps(v, v));
+    }
+    else
+    {
+        _mm_storeu_ps(out, v);
+    }
+}
+
+template <typename T, bool Clamp, UINT N>
+struct SimdKernel
+{
+    static void Run(const byte* src, UINT srcStride, size_t count, byte* dst, UINT dstStride, const KernelParams& params)
+    {
+        // Vector loads can read past the element, the last few go through a zero padded copy so the source range is never overrun.
+        constexpr size_t elementSize = N * sizeof(T);
+        size_t lastEnd = (count - 1) * srcStride + elementSize;
+        size_t safeCount = lastEnd >= LoadSize<T> ? std::min(count, (lastEnd - LoadSize<T>) / srcStride + 1) : 0;
+
+        __m128 scale = _mm_loadu_ps(params.Scale);
+        __m128 offset = _mm_loadu_ps(params.Offset);
+        __m128 minValue = _mm_set1_ps(params.Min);
+
+        size_t i = 0;
+#if defined(ACCESSOR_DECODER_AVX2)
+        __m256 scale2 = _mm256_insertf128_ps(_mm256_castps128_ps256(scale), scale, 1);
+        __m256 offset2 = _mm256_insertf128_ps(_mm256_castps128_ps256(offset), offset, 1);
+        __m256 minValue2 = _mm256_set1_ps(params.Min);
+        for (; i + 1 < safeCount; i += 2)
+        {
+            const byte* element = src + size_t(srcStride) * i;
+            __m256 v = Load2<T>(element, element + srcStride);
+            if constexpr (Clamp)
+                v = _mm256_max_ps(v, minValue2);
+            v = _mm256_add_ps(_mm256_mul_ps(v, scale2), offset2);
+            byte* out = dst + size_t(dstStride) * i;
+            Store<N>(out, _mm256_castps256_ps128(v));
+            Store<N>(out + dstStride, _mm256_extractf128_ps(v, 1));
+        }
+#endif
+        auto decode = [&](const byte* element, size_t index)
+        {
+            __m128 v = Load<T>(element);
+            if constexpr (Clamp)
+                v = _mm_max_ps(v, minValue);
+            Store<N>(dst + size_t(dstStride) * index, _mm_add_ps(_mm_mul_ps(v, scale), offset));
+        };
+        for (; i < safeCount; ++i)
+            decode(src + size_t(srcStride) * i, i);
+        for (; i < count; ++i)
+        {
+            alignas(16) byte padded[16] = {};
+            memcpy(padded, src + size_t(srcStride) * i, elementSize);
+            decode(padded, i);
+        }
+    }
+};
+#else
+template <typename T, bool Clamp, UINT N>
+using SimdKernel = ScalarKernel<T, Clamp, N>;
+#endif
+
+struct KernelRow
+{
+    DecodeKernel Kernels[2][4]; // [clamp][components - 1]
+};
+
+template <template <typename, bool, UINT> class Kernel, typename T>
+constexpr KernelRow MakeKernelRow()
+{
+    return { {
+        { &Kernel<T, false, 1>::Run, &Kernel<T, false, 2>::Run, &Kernel<T, false, 3>::Run, &Kernel<T, false, 4>::Run },
+        { &Kernel<T, true, 1>::Run, &Kernel<T, true, 2>::Run, &Kernel<T, true, 3>::Run, &Kernel<T, true, 4>::Run } } };
+}
+
+template <template <typename, bool, UINT> class Kernel>
+DecodeKernel GetKernel(AccessorComponent component, bool clamp, UINT componentsCount)
+{
+    static constexpr KernelRow table[] =
+    {
+        MakeKernelRow<Kernel, INT8>(),
+        MakeKernelRow<Kernel, UINT8>(),
+        MakeKernelRow<Kernel, INT16>(),
+        MakeKernelRow<Kernel, UINT16>(),
+        MakeKernelRow<Kernel, UINT>(),
+        MakeKernelRow<Kernel, float>(),
+    };
+    static_assert(std::size(table) == static_cast<size_t>(AccessorComponent::Count));
+    return table[static_cast<UINT>(component)].Kernels[clamp ? 1 : 0][componentsCount - 1];
+}
+
+// 0 for components that can't be normalized
+float GetNormalizedMax(AccessorComponent component)
+{
+    switch (component)
+    {
+    case AccessorComponent::Int8:
+        return 127.0f;
+    case AccessorComponent::UInt8:
+        return 255.0f;
+    case AccessorComponent::Int16:
+        return 32767.0f;
+    case AccessorComponent::UInt16:
+        return 65535.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+template <template <typename, bool, UINT> class Kernel>
+void Decode(const AccessorView& source, const DecodeTarget& target)
+{
+    if (source.Count == 0)
+        return;
+    assert(source.Data != nullptr && target.Data != nullptr && source.Stride > 0);
+    assert(source.ComponentsCount >= 1 && source.ComponentsCount <= 4 && source.ColumnsCount >= 1 && source.ColumnsCount <= 4);
+
+    float normalizedMax = GetNormalizedMax(source.Component);
+    assert((!source.Normalized || normalizedMax > 0.0f) && "Only 8 and 16 bit integers can be normalized");
+    bool normalized = source.Normalized && normalizedMax > 0.0f;
+    bool clamp = normalized && (source.Component == AccessorComponent::Int8 || source.Component == AccessorComponent::Int16);
+
+    KernelParams params;
+    for (UINT i = 0; i < 4; ++i)
+    {
+        params.Scale[i] = normalized ? target.Scale[i] / normalizedMax : target.Scale[i];
+        params.Offset[i] = target.Offset[i];
+    }
+    params.Min = clamp ? -normalizedMax : -FLT_MAX;
+
+    DecodeKernel kernel = GetKernel<Kernel>(source.Component, clamp, source.ComponentsCount);
+    UINT columnStride = GetColumnStride(source.Component, source.ComponentsCount, source.ColumnsCount);
+    for (UINT column = 0; column < source.ColumnsCount; ++column)
+    {
+        kernel(source.Data + column * columnStride, source.Stride, source.Count,
+            target.Data + column * source.ComponentsCount * sizeof(float), target.Stride, params);
+    }
+}
+}
+
+UINT GetComponentSize(AccessorComponent component)
+{
+    switch (component)
+    {
+    case AccessorComponent::Int8:
+    case AccessorComponent::UInt8:
+        return 1;
+    case AccessorComponent::Int16:
+    case AccessorComponent::UInt16:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+UINT GetColumnStride(AccessorComponent component, UINT componentsCount, UINT columnsCount)
+{
+    UINT size = GetComponentSize(component) * componentsCount;
+    return columnsCount > 1 ? (size + 3) & ~3u : size;
+}
+
+UINT GetElementSize(AccessorComponent component, UINT componentsCount, UINT columnsCount)
+{
+    return GetColumnStride(component, componentsCount, columnsCount) * columnsCount;
+}
+
+void DecodeAccessor(const AccessorView& source, const DecodeTarget& target)
+{
+    Decode<SimdKernel>(source, target);
+}
+
+void DecodeAccessorScalar(const AccessorView& source, const DecodeTarget& target)
+{
+    Decode<ScalarKernel>(source, target);
+}
+
+const char* GetAccessorDecoderIsaName()
+{
+#if defined(ACCESSOR_DECODER_AVX2)
+    return "AVX2";
+#elif defined(ACCESSOR_DECODER_SSE2)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+enum class AccessorComponent : UINT
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    UInt32,
+    Float,
+    Count
+};
+
+// Strided source data of any glTF accessor type. Matrices are read column by column,
+// every column of a 1 or 2 byte component matrix starts at a 4 byte boundary as the spec requires.
+struct AccessorView
+{
+    const byte* Data = nullptr;
+    size_t Count = 0;
+    UINT Stride = 0;
+    AccessorComponent Component = AccessorComponent::Float;
+    UINT ComponentsCount = 1; // Rows for matrices
+    UINT ColumnsCount = 1;
+    bool Normalized = false;
+};
+
+// Decoded elements are written as floats, value * Scale + Offset per component. Only ComponentsCount * ColumnsCount floats
+// of every element are touched, so attributes can be decoded straight into the fields of an interleaved vertex.
+struct DecodeTarget
+{
+    byte* Data = nullptr;
+    UINT Stride = 0;
+    float Scale[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float Offset[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+UINT GetComponentSize(AccessorComponent component);
+UINT GetColumnStride(AccessorComponent component, UINT componentsCount, UINT columnsCount);
+UINT GetElementSize(AccessorComponent component, UINT componentsCount, UINT columnsCount);
+
+void DecodeAccessor(const AccessorView& source, const DecodeTarget& target);
+// Same conversion one component at a time, the reference for the SIMD kernels.
+void DecodeAccessorScalar(const AccessorView& source, const DecodeTarget& target);
+
+// Instruction set the kernels were compiled for.
+const char* GetAccessorDecoderIsaName();
+}
@@ -0,0 +1,45 @@
+#include "DXrenderer/Geometry/GeometryArena.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace DirectxPlayground
+{
+namespace
+{
+UINT64 AlignToStride(UINT64 offset, UINT stride)
+{
+    return (offset + stride - 1) / stride * stride;
+}
+}
+
+UINT GeometryArena::Add(UINT vertexStride, UINT vertexCount, UINT indexStride, UINT indexCount)
+{
+    assert(vertexStride > 0 && (indexStride == 2 || indexStride == 4));
+
+    UINT64 vertexOffset = AlignToStride(mVertexDataSize, vertexStride);
+    UINT64 indexOffset = AlignToStride(mIndexDataSize, indexStride);
+    assert(vertexOffset / vertexStride <= 0xFFFFFFFF && indexOffset / indexStride <= 0xFFFFFFFF);
+
+    GeometryRange range;
+    range.BaseVertex = static_cast<UINT>(vertexOffset / vertexStride);
+    range.FirstIndex = static_cast<UINT>(indexOffset / indexStride);
+    range.VertexStride = vertexStride;
+    range.IndexStride = indexStride;
+    range.VertexCount = vertexCount;
+    range.IndexCount = indexCount;
+    mRanges.push_back(range);
+
+    mVertexDataSize = vertexOffset + UINT64(vertexStride) * vertexCount;
+    mIndexDataSize = indexOffset + UINT64(indexStride) * indexCount;
+    return static_cast<UINT>(mRanges.size() - 1);
+}
+
+void GeometryArena::Write(UINT index, const byte* vertices, const byte* indices, byte* vertexData, byte* indexData) const
+{
+    const GeometryRange& range = mRanges[index];
+    memcpy(vertexData + UINT64(range.BaseVertex) * range.VertexStride, vertices, UINT64(range.VertexStride) * range.VertexCount);
+    memcpy(indexData + UINT64(range.FirstIndex) * range.IndexStride, indices, UINT64(range.IndexStride) * range.IndexCount);
+}
+
+}
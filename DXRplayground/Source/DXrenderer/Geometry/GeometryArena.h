@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+// Placement of one mesh inside the shared buffers. Offsets are in elements of the mesh's own stride,
+// so they go straight to BaseVertexLocation and StartIndexLocation of a draw.
+struct GeometryRange
+{
+    UINT BaseVertex = 0;
+    UINT FirstIndex = 0;
+    UINT VertexStride = 0;
+    UINT IndexStride = 0;
+    UINT VertexCount = 0;
+    UINT IndexCount = 0;
+};
+
+// CPU side bookkeeping for packing many meshes into one vertex and one index buffer. Meshes can have different
+// vertex strides and index formats, every range starts at a multiple of its own stride, so the buffer can be viewed with any of them.
+class GeometryArena
+{
+public:
+    GeometryArena() = default;
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena(GeometryArena&&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+    GeometryArena& operator=(GeometryArena&&) = delete;
+    ~GeometryArena() = default;
+
+    // Returns the range index
+    UINT Add(UINT vertexStride, UINT vertexCount, UINT indexStride, UINT indexCount);
+
+    const GeometryRange& GetRange(UINT index) const;
+    UINT GetRangesCount() const;
+    UINT64 GetVertexDataSize() const;
+    UINT64 GetIndexDataSize() const;
+
+    // Copies the mesh data to its place, the destinations are GetVertexDataSize() and GetIndexDataSize() bytes long.
+    void Write(UINT index, const byte* vertices, const byte* indices, byte* vertexData, byte* indexData) const;
+
+private:
+    std::vector<GeometryRange> mRanges;
+    UINT64 mVertexDataSize = 0;
+    UINT64 mIndexDataSize = 0;
+};
+
+inline const GeometryRange& GeometryArena::GetRange(UINT index) const
+{
+    return mRanges[index];
+}
+
+inline UINT GeometryArena::GetRangesCount() const
+{
+    return static_cast<UINT>(mRanges.size());
+}
+
+inline UINT64 GeometryArena::GetVertexDataSize() const
+{
+    return mVertexDataSize;
+}
+
+inline UINT64 GeometryArena::GetIndexDataSize() const
+{
+    return mIndexDataSize;
+}
+}
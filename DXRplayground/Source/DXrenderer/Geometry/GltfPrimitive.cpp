@@ -0,0 +1,272 @@
+#include "DXrenderer/Geometry/GltfPrimitive.h"
+
+#include <cassert>
+
+#include "DXrenderer/Geometry/AccessorDecoder.h"
+#include "Utils/Logger.h"
+
+#define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NOEXCEPTION
+#define JSON_NOEXCEPTION
+// Images are decoded by TextureManager, tinygltf only needs their uris
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE
+#include "External/TinyGLTF/tiny_gltf.h"
+
+namespace DirectxPlayground
+{
+namespace
+{
+template <typename T>
+T GetElementFromBuffer(const byte* bufferStart, UINT byteStride, size_t elemIndex, UINT offsetInElem = 0)
+{
+    return *(reinterpret_cast<const T*>(bufferStart + size_t(byteStride) * size_t(elemIndex) + offsetInElem));
+}
+
+bool SkipImage(tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*)
+{
+    return true;
+}
+
+// Distance between two neighbouring values the component can store, 0 for floats.
+float GetComponentStep(int componentType, bool normalized)
+{
+    if (componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
+        return 0.0f;
+    if (!normalized)
+        return 1.0f;
+    switch (componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        return 1.0f / 127.0f;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return 1.0f / 255.0f;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+        return 1.0f / 32767.0f;
+    default:
+        return 1.0f / 65535.0f;
+    }
+}
+
+AccessorComponent GetAccessorComponent(int componentType)
+{
+    switch (componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        return AccessorComponent::Int8;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return AccessorComponent::UInt8;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+        return AccessorComponent::Int16;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        return AccessorComponent::UInt16;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        return AccessorComponent::UInt32;
+    default:
+        assert(componentType == TINYGLTF_COMPONENT_TYPE_FLOAT && "Unsupported accessor component type");
+        return AccessorComponent::Float;
+    }
+}
+
+// Attributes can be stored as floats or, with KHR_mesh_quantization, as normalized or plain integers.
+AccessorView GetAccessorView(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+{
+    AccessorView view;
+    view.Component = GetAccessorComponent(accessor.componentType);
+    view.Normalized = accessor.normalized;
+    view.Count = accessor.count;
+    switch (accessor.type)
+    {
+    case TINYGLTF_TYPE_MAT2:
+        view.ComponentsCount = view.ColumnsCount = 2;
+        break;
+    case TINYGLTF_TYPE_MAT3:
+        view.ComponentsCount = view.ColumnsCount = 3;
+        break;
+    case TINYGLTF_TYPE_MAT4:
+        view.ComponentsCount = view.ColumnsCount = 4;
+        break;
+    default:
+        view.ComponentsCount = tinygltf::GetNumComponentsInType(accessor.type);
+        break;
+    }
+
+    const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+    view.Data = &model.buffers[bufferView.buffer].data.at(0) + bufferView.byteOffset + accessor.byteOffset;
+    // Tightly packed matrices still have padded columns, tinygltf's ByteStride doesn't know about it
+    view.Stride = bufferView.byteStride != 0 ? static_cast<UINT>(bufferView.byteStride) : GetElementSize(view.Component, view.ComponentsCount, view.ColumnsCount);
+    return view;
+}
+
+struct TextureTransform
+{
+    DirectX::XMFLOAT2 Scale = { 1.0f, 1.0f };
+    DirectX::XMFLOAT2 Offset = { 0.0f, 0.0f };
+
+    bool operator==(const TextureTransform& other) const
+    {
+        return Scale.x == other.Scale.x && Scale.y == other.Scale.y && Offset.x == other.Offset.x && Offset.y == other.Offset.y;
+    }
+};
+
+// KHR_texture_transform of a single textureInfo
+TextureTransform GetTextureTransform(const tinygltf::ExtensionMap& extensions)
+{
+    TextureTransform result;
+    auto transform = extensions.find("KHR_texture_transform");
+    if (transform == extensions.end())
+        return result;
+    const tinygltf::Value& value = transform->second;
+    if (value.Has("scale"))
+        result.Scale = { static_cast<float>(value.Get("scale").Get(0).GetNumberAsDouble()), static_cast<float>(value.Get("scale").Get(1).GetNumberAsDouble()) };
+    if (value.Has("offset"))
+        result.Offset = { static_cast<float>(value.Get("offset").Get(0).GetNumberAsDouble()), static_cast<float>(value.Get("offset").Get(1).GetNumberAsDouble()) };
+    if (value.Has("rotation"))
+        LOG("GLTF Warning: KHR_texture_transform rotation is ignored\n");
+    return result;
+}
+
+// There is a single uv set and the transform is baked into it, so every texture of the material has to agree.
+// The base color one wins, or the first texture that has one, the others are reported.
+TextureTransform GetTextureTransform(const tinygltf::Model& model, const tinygltf::Primitive& primitive)
+{
+    TextureTransform baked;
+    if (primitive.material == -1)
+        return baked;
+    const tinygltf::Material& material = model.materials[primitive.material];
+    const std::pair<int, const tinygltf::ExtensionMap*> textures[] = {
+        { material.pbrMetallicRoughness.baseColorTexture.index, &material.pbrMetallicRoughness.baseColorTexture.extensions },
+        { material.pbrMetallicRoughness.metallicRoughnessTexture.index, &material.pbrMetallicRoughness.metallicRoughnessTexture.extensions },
+        { material.normalTexture.index, &material.normalTexture.extensions },
+        { material.occlusionTexture.index, &material.occlusionTexture.extensions } };
+
+    bool found = false;
+    for (const auto& [index, extensions] : textures)
+    {
+        if (index == -1)
+            continue;
+        TextureTransform transform = GetTextureTransform(*extensions);
+        if (!found)
+        {
+            baked = transform;
+            found = true;
+        }
+        else if (!(transform == baked))
+        {
+            LOG("GLTF Warning: material ", material.name, " textures have different KHR_texture_transforms, only the first one is applied");
+            break;
+        }
+    }
+    return baked;
+}
+
+void DecodeVertices(const tinygltf::Model& model, const tinygltf::Primitive& primitive, GltfPrimitiveGeometry& geometry)
+{
+    TextureTransform uvTransform = GetTextureTransform(model, primitive);
+    SourceQuantization& quantization = geometry.Quantization;
+
+    for (auto& attrib : primitive.attributes)
+    {
+        const tinygltf::Accessor& accessor = model.accessors[attrib.second];
+        AccessorView view = GetAccessorView(model, accessor);
+
+        size_t elemCount = accessor.count;
+        if (geometry.Vertices.empty())
+            geometry.Vertices.resize(elemCount);
+        assert(geometry.Vertices.size() == elemCount);
+
+        float step = GetComponentStep(accessor.componentType, accessor.normalized);
+        DecodeTarget target;
+        target.Stride = sizeof(Vertex);
+
+        if (attrib.first.compare("POSITION") == 0 && accessor.type == TINYGLTF_TYPE_VEC3)
+        {
+            quantization.PositionStep[0] = step;
+            quantization.PositionStep[1] = step;
+            quantization.PositionStep[2] = step;
+            target.Data = reinterpret_cast<byte*>(&geometry.Vertices[0].Pos);
+        }
+        else if (attrib.first.compare("NORMAL") == 0 && accessor.type == TINYGLTF_TYPE_VEC3)
+        {
+            target.Data = reinterpret_cast<byte*>(&geometry.Vertices[0].Norm);
+        }
+        else if (attrib.first.compare("TEXCOORD_0") == 0 && accessor.type == TINYGLTF_TYPE_VEC2)
+        {
+            quantization.UvStep[0] = step * uvTransform.Scale.x;
+            quantization.UvStep[1] = step * uvTransform.Scale.y;
+            target.Data = reinterpret_cast<byte*>(&geometry.Vertices[0].Uv);
+            target.Scale[0] = uvTransform.Scale.x;
+            target.Scale[1] = uvTransform.Scale.y;
+            target.Offset[0] = uvTransform.Offset.x;
+            target.Offset[1] = uvTransform.Offset.y;
+        }
+        else if (attrib.first.compare("TANGENT") == 0 && accessor.type == TINYGLTF_TYPE_VEC4)
+        {
+            target.Data = reinterpret_cast<byte*>(&geometry.Vertices[0].Tangent);
+        }
+        else
+        {
+            LOG("GLTF Warning: attrib ", attrib.first, " isn't parsed properly\n");
+            continue;
+        }
+        DecodeAccessor(view, target);
+    }
+}
+
+void DecodeIndices(const tinygltf::Model& model, const tinygltf::Primitive& primitive, std::vector<UINT>& indices)
+{
+    const tinygltf::Accessor& indexAccessor = model.accessors[primitive.indices];
+    indices.resize(indexAccessor.count);
+
+    const tinygltf::BufferView& indexView = model.bufferViews[indexAccessor.bufferView];
+    const byte* bufferData = &model.buffers[indexView.buffer].data.at(0);
+    size_t byteOffset = indexView.byteOffset + indexAccessor.byteOffset;
+
+    UINT byteStride = indexAccessor.ByteStride(indexView);
+    const byte* bufferStart = bufferData + byteOffset;
+    assert((indexAccessor.count % 3 == 0) && "GLTF index accessor doesn't represent triangles");
+    switch (indexAccessor.componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        for (size_t i = 0; i < indexAccessor.count; ++i)
+            indices[i] = GetElementFromBuffer<byte>(bufferStart, byteStride, i);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        for (size_t i = 0; i < indexAccessor.count; ++i)
+            indices[i] = GetElementFromBuffer<UINT16>(bufferStart, byteStride, i);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        for (size_t i = 0; i < indexAccessor.count; ++i)
+            indices[i] = GetElementFromBuffer<UINT>(bufferStart, byteStride, i);
+        break;
+    default:
+        assert(false);
+    }
+}
+}
+
+bool LoadGltf(const std::string& path, tinygltf::Model& model, std::string& error)
+{
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(SkipImage, nullptr);
+    std::string warn;
+
+    size_t lastPeriod = path.find_last_of('.');
+    std::string ext = lastPeriod != std::string::npos ? path.substr(lastPeriod) : std::string();
+    if (ext == ".glb")
+        return loader.LoadBinaryFromFile(&model, &error, &warn, path.c_str());
+    if (ext == ".gltf")
+        return loader.LoadASCIIFromFile(&model, &error, &warn, path.c_str());
+    error = "Unknown glTF extension " + ext;
+    return false;
+}
+
+void DecodeGltfPrimitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, GltfPrimitiveGeometry& geometry)
+{
+    geometry.Vertices.clear();
+    geometry.Quantization = {};
+    DecodeVertices(model, primitive, geometry);
+    DecodeIndices(model, primitive, geometry.Indices);
+}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <windows.h>
+
+#include "DXrenderer/Geometry/Vertex.h"
+#include "DXrenderer/Geometry/VertexLayout.h"
+
+namespace tinygltf
+{
+class Model;
+struct Primitive;
+}
+
+namespace DirectxPlayground
+{
+// Float vertices and indices of one primitive, in the mesh space. Node transforms go to the instances.
+struct GltfPrimitiveGeometry
+{
+    std::vector<Vertex> Vertices;
+    std::vector<UINT> Indices;
+    SourceQuantization Quantization;
+};
+
+// Parses the file and its buffers. Images are decoded by TextureManager, only their uris are read.
+bool LoadGltf(const std::string& path, tinygltf::Model& model, std::string& error);
+// The KHR_texture_transform of the material is baked into the uvs. Can be called from any thread.
+void DecodeGltfPrimitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, GltfPrimitiveGeometry& geometry);
+}
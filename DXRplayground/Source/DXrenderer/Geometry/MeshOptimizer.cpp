@@ -0,0 +1,293 @@
+#include "DXrenderer/Geometry/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace DirectxPlayground
+{
+namespace
+{
+// FIFO cache emulation. A vertex is in the cache if it was inserted less than cacheSize insertions ago.
+class CacheSimulator
+{
+public:
+    CacheSimulator(size_t vertexCount, UINT cacheSize)
+        : mCacheTime(vertexCount, 0)
+        , mCacheSize(cacheSize)
+        , mTime(cacheSize + 1)
+    {}
+
+    bool IsCached(UINT vertex) const
+    {
+        return mTime - mCacheTime[vertex] <= mCacheSize;
+    }
+    UINT GetAge(UINT vertex) const
+    {
+        return mTime - mCacheTime[vertex];
+    }
+    // Returns true on a cache miss
+    bool Access(UINT vertex)
+    {
+        if (IsCached(vertex))
+            return false;
+        mCacheTime[vertex] = mTime++;
+        return true;
+    }
+    UINT AccessTriangle(const UINT* triangle)
+    {
+        return UINT(Access(triangle[0])) + UINT(Access(triangle[1])) + UINT(Access(triangle[2]));
+    }
+    void Flush()
+    {
+        mTime += mCacheSize + 1;
+    }
+
+private:
+    std::vector<UINT> mCacheTime;
+    UINT mCacheSize;
+    UINT mTime;
+};
+
+struct ClusterSortData
+{
+    size_t FirstTriangle = 0;
+    size_t TrianglesCount = 0;
+    float SortKey = 0.0f;
+};
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<UINT>& indices, size_t vertexCount, UINT cacheSize /*= DefaultVertexCacheSize*/)
+{
+    VertexCacheStats stats;
+    stats.TrianglesCount = indices.size() / 3;
+
+    CacheSimulator cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    for (UINT index : indices)
+    {
+        if (cache.Access(index))
+            ++stats.TransformedCount;
+        if (!used[index])
+        {
+            used[index] = true;
+            ++stats.VerticesCount;
+        }
+    }
+    return stats;
+}
+
+void OptimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount, UINT cacheSize /*= DefaultVertexCacheSize*/)
+{
+    size_t trianglesCount = indices.size() / 3;
+    if (trianglesCount == 0)
+        return;
+
+    // Vertex -> triangles adjacency, packed into a single array.
+    std::vector<UINT> liveTriangles(vertexCount, 0);
+    for (UINT index : indices)
+        ++liveTriangles[index];
+    std::vector<UINT> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    std::vector<UINT> adjacency(indices.size());
+    std::vector<UINT> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+        adjacency[fillOffsets[indices[i]]++] = UINT(i / 3);
+
+    CacheSimulator cache(vertexCount, cacheSize);
+    std::vector<bool> emitted(trianglesCount, false);
+    std::vector<UINT> deadEnd;
+    deadEnd.reserve(indices.size());
+    std::vector<UINT> candidates;
+    std::vector<UINT> result;
+    result.reserve(indices.size());
+    size_t cursor = 0;
+
+    auto skipDeadEnd = [&]() -> int
+    {
+        while (!deadEnd.empty())
+        {
+            UINT vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[vertex] > 0)
+                return int(vertex);
+        }
+        for (; cursor < vertexCount; ++cursor)
+        {
+            if (liveTriangles[cursor] > 0)
+                return int(cursor);
+        }
+        return -1;
+    };
+
+    auto nextFanningVertex = [&]() -> int
+    {
+        int best = -1;
+        int bestPriority = -1;
+        for (UINT vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+            // Prefer the oldest vertex that stays in the cache after fanning all of its triangles.
+            int priority = 0;
+            if (cache.GetAge(vertex) + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = int(cache.GetAge(vertex));
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = int(vertex);
+            }
+        }
+        return best != -1 ? best : skipDeadEnd();
+    };
+
+    int fanning = int(indices[0]);
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (UINT i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; ++i)
+        {
+            UINT triangle = adjacency[i];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (UINT k = 0; k < 3; ++k)
+            {
+                UINT vertex = indices[triangle * 3 + k];
+                result.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangles[vertex];
+                cache.Access(vertex);
+            }
+        }
+        fanning = nextFanningVertex();
+    }
+    indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<UINT>& indices, const std::vector<Vertex>& vertices, UINT cacheSize /*= DefaultVertexCacheSize*/, float threshold /*= 1.05f*/)
+{
+    size_t trianglesCount = indices.size() / 3;
+    if (trianglesCount == 0)
+        return;
+
+    // Hard boundaries: a triangle that misses the cache completely starts a new patch.
+    std::vector<size_t> hardClusters;
+    CacheSimulator cache(vertices.size(), cacheSize);
+    for (size_t t = 0; t < trianglesCount; ++t)
+    {
+        if (cache.AccessTriangle(&indices[t * 3]) == 3 || t == 0)
+            hardClusters.push_back(t);
+    }
+    hardClusters.push_back(trianglesCount);
+
+    // Soft boundaries: split a patch further while the pieces keep the cache efficiency close to the patch one.
+    std::vector<ClusterSortData> clusters;
+    for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+    {
+        size_t begin = hardClusters[c];
+        size_t end = hardClusters[c + 1];
+
+        cache.Flush();
+        UINT clusterMisses = 0;
+        for (size_t t = begin; t < end; ++t)
+            clusterMisses += cache.AccessTriangle(&indices[t * 3]);
+        float clusterAcmr = float(clusterMisses) / float(end - begin);
+
+        cache.Flush();
+        size_t start = begin;
+        UINT misses = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            misses += cache.AccessTriangle(&indices[t * 3]);
+            if (t + 1 < end && float(misses) / float(t - start + 1) <= clusterAcmr * threshold)
+            {
+                clusters.push_back({ start, t + 1 - start });
+                start = t + 1;
+                misses = 0;
+                cache.Flush();
+            }
+        }
+        clusters.push_back({ start, end - start });
+    }
+
+    float meshCenter[3] = {};
+    for (const auto& v : vertices)
+    {
+        meshCenter[0] += v.Pos.x;
+        meshCenter[1] += v.Pos.y;
+        meshCenter[2] += v.Pos.z;
+    }
+    for (float& c : meshCenter)
+        c /= float(vertices.size());
+
+    // Clusters facing away from the mesh center are likely to occlude the rest, so they go first.
+    for (auto& cluster : clusters)
+    {
+        float center[3] = {};
+        float normal[3] = {};
+        float area = 0.0f;
+        for (size_t t = cluster.FirstTriangle; t < cluster.FirstTriangle + cluster.TrianglesCount; ++t)
+        {
+            const auto& p0 = vertices[indices[t * 3 + 0]].Pos;
+            const auto& p1 = vertices[indices[t * 3 + 1]].Pos;
+            const auto& p2 = vertices[indices[t * 3 + 2]].Pos;
+            float e0[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+            float e1[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+            float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+            float triArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            center[0] += (p0.x + p1.x + p2.x) / 3.0f * triArea;
+            center[1] += (p0.y + p1.y + p2.y) / 3.0f * triArea;
+            center[2] += (p0.z + p1.z + p2.z) / 3.0f * triArea;
+            normal[0] += n[0];
+            normal[1] += n[1];
+            normal[2] += n[2];
+            area += triArea;
+        }
+        float invArea = area == 0.0f ? 0.0f : 1.0f / area;
+        float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float invNormalLength = normalLength == 0.0f ? 0.0f : 1.0f / normalLength;
+
+        cluster.SortKey = 0.0f;
+        for (int k = 0; k < 3; ++k)
+            cluster.SortKey += (center[k] * invArea - meshCenter[k]) * normal[k] * invNormalLength;
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const ClusterSortData& a, const ClusterSortData& b) { return a.SortKey > b.SortKey; });
+
+    std::vector<UINT> result;
+    result.reserve(indices.size());
+    for (const auto& cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.FirstTriangle * 3, indices.begin() + (cluster.FirstTriangle + cluster.TrianglesCount) * 3);
+    indices.swap(result);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    constexpr UINT Unused = ~0u;
+    std::vector<UINT> remap(vertices.size(), Unused);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (UINT& index : indices)
+    {
+        if (remap[index] == Unused)
+        {
+            remap[index] = UINT(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+#include "DXrenderer/Geometry/Vertex.h"
+
+namespace DirectxPlayground
+{
+// Post-transform cache statistics for a triangle list, simulated with a FIFO cache.
+struct VertexCacheStats
+{
+    size_t TrianglesCount = 0;
+    size_t VerticesCount = 0; // Unique vertices referenced by the indices
+    size_t TransformedCount = 0;
+
+    float GetAcmr() const; // Average cache miss ratio, transformed vertices per triangle
+    float GetAtvr() const; // Average transform to vertex ratio, 1.0 is the ideal
+};
+
+constexpr UINT DefaultVertexCacheSize = 16;
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<UINT>& indices, size_t vertexCount, UINT cacheSize = DefaultVertexCacheSize);
+
+// Tipsify (Sander et al. 2007), Algorithm 1 of the paper: FIFO timestamps, the candidate priority is its cache position if it
+// stays cached after fanning all of its live triangles (s - C[v] + 2 * L[v] <= k), dead-ends pop the dead-end stack and then
+// scan the vertices in input order. Deviations: fanning starts at the first index instead of vertex 0, and candidates
+// are kept in emission order with duplicates, which picks the same vertex since ties keep the first one.
+void OptimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount, UINT cacheSize = DefaultVertexCacheSize);
+
+// Splits cache optimized indices into clusters and sorts them so outward facing clusters are drawn first (section 4 of the paper).
+// Unlike the paper, hard boundaries aren't recorded by Tipsify: a triangle missing all three vertices starts a new one,
+// which approximates the places Tipsify jumped to a non-local vertex. Soft boundaries split a hard cluster while the piece
+// ACMR stays within threshold of the cluster ACMR.
+void OptimizeOverdraw(std::vector<UINT>& indices, const std::vector<Vertex>& vertices, UINT cacheSize = DefaultVertexCacheSize, float threshold = 1.05f);
+
+// Reorders vertices in the order of the first use by the indices and drops unreferenced ones.
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<UINT>& indices);
+
+// All of the above in the order they are meant to be applied.
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<UINT>& indices);
+
+inline float VertexCacheStats::GetAcmr() const
+{
+    return TrianglesCount == 0 ? 0.0f : float(TransformedCount) / float(TrianglesCount);
+}
+
+inline float VertexCacheStats::GetAtvr() const
+{
+    return VerticesCount == 0 ? 0.0f : float(TransformedCount) / float(VerticesCount);
+}
+}
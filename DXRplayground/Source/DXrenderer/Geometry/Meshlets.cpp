@@ -0,0 +1,270 @@
+#include "DXrenderer/Geometry/Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace DirectxPlayground
+{
+namespace
+{
+using DirectX::XMFLOAT3;
+
+XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+XMFLOAT3 Scale(const XMFLOAT3& a, float s)
+{
+    return { a.x * s, a.y * s, a.z * s };
+}
+
+float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+float Length(const XMFLOAT3& a)
+{
+    return std::sqrt(Dot(a, a));
+}
+
+XMFLOAT3 Normalize(const XMFLOAT3& a)
+{
+    float length = Length(a);
+    return length == 0.0f ? a : Scale(a, 1.0f / length);
+}
+
+// Ritter's bounding sphere, not minimal but within a few percent of it.
+void ComputeBoundingSphere(const Meshlet& meshlet, const MeshletData& data, const std::vector<Vertex>& vertices, Meshlet& result)
+{
+    auto position = [&](UINT i) -> const XMFLOAT3& { return vertices[data.Vertices[meshlet.VertexOffset + i]].Pos; };
+
+    auto farthestFrom = [&](const XMFLOAT3& p)
+    {
+        UINT farthest = 0;
+        float maxDistance = -1.0f;
+        for (UINT i = 0; i < meshlet.VertexCount; ++i)
+        {
+            XMFLOAT3 d = Sub(position(i), p);
+            float distance = Dot(d, d);
+            if (distance > maxDistance)
+            {
+                maxDistance = distance;
+                farthest = i;
+            }
+        }
+        return farthest;
+    };
+
+    const XMFLOAT3& a = position(farthestFrom(position(0)));
+    const XMFLOAT3& b = position(farthestFrom(a));
+    XMFLOAT3 center = Scale(Add(a, b), 0.5f);
+    float radius = Length(Sub(b, a)) * 0.5f;
+
+    for (UINT i = 0; i < meshlet.VertexCount; ++i)
+    {
+        XMFLOAT3 d = Sub(position(i), center);
+        float distance = Length(d);
+        if (distance > radius)
+        {
+            float newRadius = (radius + distance) * 0.5f;
+            center = Add(center, Scale(d, (newRadius - radius) / distance));
+            radius = newRadius;
+        }
+    }
+    result.Center = center;
+    result.Radius = radius;
+}
+
+void ComputeNormalCone(const Meshlet& meshlet, const MeshletData& data, const std::vector<Vertex>& vertices, Meshlet& result)
+{
+    // Never culled, either there are no valid triangles or they face too many directions.
+    result.ConeApex = result.Center;
+    result.ConeAxis = { 0.0f, 0.0f, 1.0f };
+    result.ConeCutoff = 2.0f;
+
+    std::vector<XMFLOAT3> normals(meshlet.TriangleCount);
+    std::vector<bool> valid(meshlet.TriangleCount, false);
+    XMFLOAT3 axis = {};
+    for (UINT t = 0; t < meshlet.TriangleCount; ++t)
+    {
+        const byte* triangle = &data.Triangles[(meshlet.TriangleOffset + t) * 3];
+        const Vertex& v0 = vertices[data.Vertices[meshlet.VertexOffset + triangle[0]]];
+        const Vertex& v1 = vertices[data.Vertices[meshlet.VertexOffset + triangle[1]]];
+        const Vertex& v2 = vertices[data.Vertices[meshlet.VertexOffset + triangle[2]]];
+
+        // The rasterizer culls by winding, so the face normal decides, whatever the shading normals say.
+        // glTF fronts are counter-clockwise, the cross product points out of them.
+        XMFLOAT3 normal = Cross(Sub(v1.Pos, v0.Pos), Sub(v2.Pos, v0.Pos));
+        float area = Length(normal);
+        if (area == 0.0f)
+            continue;
+        normal = Scale(normal, 1.0f / area);
+
+        normals[t] = normal;
+        valid[t] = true;
+        axis = Add(axis, normal);
+    }
+    if (Length(axis) == 0.0f)
+        return;
+    axis = Normalize(axis);
+
+    float minDot = 1.0f;
+    for (UINT t = 0; t < meshlet.TriangleCount; ++t)
+    {
+        if (valid[t])
+            minDot = std::min(minDot, Dot(normals[t], axis));
+    }
+    if (minDot <= 0.1f)
+        return;
+
+    // Move the apex back along the axis until it's behind every triangle plane.
+    float maxT = 0.0f;
+    for (UINT t = 0; t < meshlet.TriangleCount; ++t)
+    {
+        if (!valid[t])
+            continue;
+        const byte* triangle = &data.Triangles[(meshlet.TriangleOffset + t) * 3];
+        const XMFLOAT3& p0 = vertices[data.Vertices[meshlet.VertexOffset + triangle[0]]].Pos;
+        float distance = Dot(Sub(result.Center, p0), normals[t]) / Dot(axis, normals[t]);
+        maxT = std::max(maxT, distance);
+    }
+
+    result.ConeApex = Sub(result.Center, Scale(axis, maxT));
+    result.ConeAxis = axis;
+    result.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+}
+
+void BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices, MeshletData& data)
+{
+    constexpr byte Unassigned = 0xff;
+    std::vector<byte> localIndices(vertices.size(), Unassigned);
+
+    data.Meshlets.clear();
+    data.Vertices.clear();
+    data.Triangles.clear();
+    data.Triangles.reserve(indices.size());
+
+    Meshlet meshlet;
+    auto finishMeshlet = [&]()
+    {
+        if (meshlet.TriangleCount == 0)
+            return;
+        for (UINT i = 0; i < meshlet.VertexCount; ++i)
+            localIndices[data.Vertices[meshlet.VertexOffset + i]] = Unassigned;
+        ComputeBoundingSphere(meshlet, data, vertices, meshlet);
+        ComputeNormalCone(meshlet, data, vertices, meshlet);
+        data.Meshlets.push_back(meshlet);
+        meshlet = {};
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const UINT* triangle = &indices[i];
+        UINT newVertices = 0;
+        for (UINT k = 0; k < 3; ++k)
+        {
+            bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if (localIndices[triangle[k]] == Unassigned && !repeated)
+                ++newVertices;
+        }
+        if (meshlet.VertexCount + newVertices > MaxMeshletVertices || meshlet.TriangleCount == MaxMeshletTriangles)
+            finishMeshlet();
+
+        if (meshlet.TriangleCount == 0)
+        {
+            meshlet.FirstIndex = UINT(i);
+            meshlet.VertexOffset = UINT(data.Vertices.size());
+            meshlet.TriangleOffset = UINT(data.Triangles.size() / 3);
+        }
+        for (UINT k = 0; k < 3; ++k)
+        {
+            byte& local = localIndices[triangle[k]];
+            if (local == Unassigned)
+            {
+                local = byte(meshlet.VertexCount++);
+                data.Vertices.push_back(triangle[k]);
+            }
+            data.Triangles.push_back(local);
+        }
+        ++meshlet.TriangleCount;
+    }
+    finishMeshlet();
+}
+
+MeshletCullingView::MeshletCullingView(const DirectX::XMFLOAT4X4& meshToClip, const DirectX::XMFLOAT3& viewerPosition)
+    : ViewerPosition(viewerPosition)
+{
+    // Row vector matrices, clip space z is in [0, 1].
+    auto column = [&meshToClip](int c) { return DirectX::XMFLOAT4{ meshToClip(0, c), meshToClip(1, c), meshToClip(2, c), meshToClip(3, c) }; };
+    DirectX::XMFLOAT4 x = column(0);
+    DirectX::XMFLOAT4 y = column(1);
+    DirectX::XMFLOAT4 z = column(2);
+    DirectX::XMFLOAT4 w = column(3);
+
+    Planes[0] = { w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w };
+    Planes[1] = { w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w };
+    Planes[2] = { w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w };
+    Planes[3] = { w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w };
+    Planes[4] = z;
+    Planes[5] = { w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w };
+    for (auto& plane : Planes)
+    {
+        float length = Length({ plane.x, plane.y, plane.z });
+        plane = { plane.x / length, plane.y / length, plane.z / length, plane.w / length };
+    }
+}
+
+MeshletVisibility TestMeshlet(const Meshlet& meshlet, const MeshletCullingView& view)
+{
+    for (const auto& plane : view.Planes)
+    {
+        if (Dot({ plane.x, plane.y, plane.z }, meshlet.Center) + plane.w < -meshlet.Radius)
+            return MeshletVisibility::OutsideFrustum;
+    }
+    if (Dot(Normalize(Sub(meshlet.ConeApex, view.ViewerPosition)), meshlet.ConeAxis) >= meshlet.ConeCutoff)
+        return MeshletVisibility::Backfacing;
+    return MeshletVisibility::Visible;
+}
+
+void CullMeshlets(const std::vector<Meshlet>& meshlets, const MeshletCullingView& view, std::vector<IndexRange>& visibleRanges, MeshletCullingStats& stats)
+{
+    bool merge = false;
+    for (const auto& meshlet : meshlets)
+    {
+        ++stats.MeshletsCount;
+        stats.TrianglesCount += meshlet.TriangleCount;
+
+        MeshletVisibility visibility = TestMeshlet(meshlet, view);
+        if (visibility != MeshletVisibility::Visible)
+        {
+            ++stats.CulledMeshletsCount;
+            if (visibility == MeshletVisibility::OutsideFrustum)
+                stats.FrustumCulledTrianglesCount += meshlet.TriangleCount;
+            else
+                stats.BackfaceCulledTrianglesCount += meshlet.TriangleCount;
+            merge = false;
+            continue;
+        }
+
+        if (merge && visibleRanges.back().FirstIndex + visibleRanges.back().IndexCount == meshlet.FirstIndex)
+            visibleRanges.back().IndexCount += meshlet.TriangleCount * 3;
+        else
+            visibleRanges.push_back({ meshlet.FirstIndex, meshlet.TriangleCount * 3 });
+        merge = true;
+    }
+}
+
+}
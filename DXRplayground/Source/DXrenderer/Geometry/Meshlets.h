@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+#include "DXrenderer/Geometry/Vertex.h"
+
+namespace DirectxPlayground
+{
+constexpr UINT MaxMeshletVertices = 64;
+constexpr UINT MaxMeshletTriangles = 124;
+
+struct Meshlet
+{
+    UINT FirstIndex = 0; // Meshlet triangles are contiguous in the source index buffer
+    UINT VertexOffset = 0; // Into MeshletData::Vertices
+    UINT TriangleOffset = 0; // Into MeshletData::Triangles, in triangles
+    UINT VertexCount = 0;
+    UINT TriangleCount = 0;
+
+    DirectX::XMFLOAT3 Center = {};
+    float Radius = 0.0f;
+
+    // Every triangle faces away from a viewer placed inside the cone: dot(normalize(ConeApex - viewer), ConeAxis) >= ConeCutoff
+    DirectX::XMFLOAT3 ConeApex = {};
+    DirectX::XMFLOAT3 ConeAxis = {};
+    float ConeCutoff = 0.0f;
+};
+
+// Layout matches what a mesh shader wants: per meshlet unique vertices and triangles made of 8 bit local indices.
+struct MeshletData
+{
+    std::vector<Meshlet> Meshlets;
+    std::vector<UINT> Vertices;
+    std::vector<byte> Triangles;
+};
+
+// Greedy split in the index buffer order, so run it after the vertex cache optimization.
+void BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices, MeshletData& data);
+
+// Frustum planes and viewer position in the mesh space.
+struct MeshletCullingView
+{
+    MeshletCullingView(const DirectX::XMFLOAT4X4& meshToClip, const DirectX::XMFLOAT3& viewerPosition);
+
+    DirectX::XMFLOAT4 Planes[6];
+    DirectX::XMFLOAT3 ViewerPosition;
+};
+
+struct MeshletCullingStats
+{
+    size_t MeshletsCount = 0;
+    size_t CulledMeshletsCount = 0;
+    size_t TrianglesCount = 0;
+    size_t FrustumCulledTrianglesCount = 0;
+    size_t BackfaceCulledTrianglesCount = 0;
+};
+
+struct IndexRange
+{
+    UINT FirstIndex = 0;
+    UINT IndexCount = 0;
+};
+
+enum class MeshletVisibility
+{
+    Visible,
+    OutsideFrustum,
+    Backfacing
+};
+
+MeshletVisibility TestMeshlet(const Meshlet& meshlet, const MeshletCullingView& view);
+
+// Appends index ranges of the visible meshlets, neighbouring ranges are merged to save draw calls.
+void CullMeshlets(const std::vector<Meshlet>& meshlets, const MeshletCullingView& view, std::vector<IndexRange>& visibleRanges, MeshletCullingStats& stats);
+}
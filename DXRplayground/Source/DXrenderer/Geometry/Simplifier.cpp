@@ -0,0 +1,306 @@
+#include "DXrenderer/Geometry/Simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace DirectxPlayground
+{
+namespace
+{
+// Sum of squared distances to a set of planes: p^T A p + 2 b^T p + c, A is symmetric.
+struct Quadric
+{
+    double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+    double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+    double C = 0.0;
+
+    void AddPlane(double nx, double ny, double nz, double d)
+    {
+        A00 += nx * nx; A01 += nx * ny; A02 += nx * nz;
+        A11 += ny * ny; A12 += ny * nz; A22 += nz * nz;
+        B0 += nx * d; B1 += ny * d; B2 += nz * d;
+        C += d * d;
+    }
+
+    void Add(const Quadric& q)
+    {
+        A00 += q.A00; A01 += q.A01; A02 += q.A02;
+        A11 += q.A11; A12 += q.A12; A22 += q.A22;
+        B0 += q.B0; B1 += q.B1; B2 += q.B2;
+        C += q.C;
+    }
+
+    double Evaluate(const DirectX::XMFLOAT3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double result = A00 * x * x + A11 * y * y + A22 * z * z + 2.0 * (A01 * x * y + A02 * x * z + A12 * y * z) + 2.0 * (B0 * x + B1 * y + B2 * z) + C;
+        return std::max(result, 0.0);
+    }
+};
+
+struct Collapse
+{
+    UINT From = 0;
+    UINT To = 0;
+    double Cost = 0.0;
+};
+
+struct PositionHash
+{
+    size_t operator()(const DirectX::XMFLOAT3& p) const
+    {
+        UINT bits[3];
+        memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+struct PositionEqual
+{
+    bool operator()(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) const
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+};
+
+void GetNormal(const DirectX::XMFLOAT3& p0, const DirectX::XMFLOAT3& p1, const DirectX::XMFLOAT3& p2, double n[3])
+{
+    double e0[3] = { double(p1.x) - p0.x, double(p1.y) - p0.y, double(p1.z) - p0.z };
+    double e1[3] = { double(p2.x) - p0.x, double(p2.y) - p0.y, double(p2.z) - p0.z };
+    n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+    n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+    n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+UINT64 EdgeKey(UINT a, UINT b)
+{
+    return a < b ? (UINT64(a) << 32) | b : (UINT64(b) << 32) | a;
+}
+}
+
+float SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices, size_t targetIndexCount, float maxError, std::vector<UINT>& result)
+{
+    result = indices;
+    size_t vertexCount = vertices.size();
+
+    // Vertices sharing a position with another one are on a seam, moving them would tear the mesh apart.
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_map<DirectX::XMFLOAT3, UINT, PositionHash, PositionEqual> firstWithPosition;
+        std::vector<bool> referenced(vertexCount, false);
+        for (UINT index : indices)
+            referenced[index] = true;
+        for (UINT v = 0; v < vertexCount; ++v)
+        {
+            if (!referenced[v])
+                continue;
+            auto it = firstWithPosition.emplace(vertices[v].Pos, v);
+            if (!it.second)
+            {
+                locked[v] = true;
+                locked[it.first->second] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const auto& p0 = vertices[indices[i + 0]].Pos;
+        double n[3];
+        GetNormal(p0, vertices[indices[i + 1]].Pos, vertices[indices[i + 2]].Pos, n);
+        double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0)
+            continue;
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        double d = -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z);
+        for (UINT k = 0; k < 3; ++k)
+            quadrics[indices[i + k]].AddPlane(n[0], n[1], n[2], d);
+    }
+
+    double maxCost = double(maxError) * double(maxError);
+    double resultCost = 0.0;
+    std::vector<UINT> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<bool> border(vertexCount);
+    std::vector<UINT> adjacencyOffsets(vertexCount + 1);
+    std::vector<UINT> adjacency;
+    std::vector<Collapse> bestCollapse(vertexCount);
+    std::vector<Collapse> collapses;
+    std::unordered_map<UINT64, UINT> edgeUsage;
+
+    while (result.size() > targetIndexCount)
+    {
+        // Edges used by anything but two triangles are borders or non manifold, their vertices stay.
+        edgeUsage.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (UINT k = 0; k < 3; ++k)
+                ++edgeUsage[EdgeKey(result[i + k], result[i + (k + 1) % 3])];
+        }
+        std::fill(border.begin(), border.end(), false);
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (UINT k = 0; k < 3; ++k)
+            {
+                UINT a = result[i + k];
+                UINT b = result[i + (k + 1) % 3];
+                if (edgeUsage[EdgeKey(a, b)] != 2)
+                {
+                    border[a] = true;
+                    border[b] = true;
+                }
+            }
+        }
+
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (UINT index : result)
+            ++adjacencyOffsets[index + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<UINT> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+            adjacency[fillOffsets[result[i]]++] = UINT(i / 3);
+
+        // The cheapest edge for every movable vertex, the vertex moves onto the other end of it.
+        std::fill(bestCollapse.begin(), bestCollapse.end(), Collapse{ 0, 0, -1.0 });
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (UINT k = 0; k < 3; ++k)
+            {
+                for (UINT dir = 1; dir < 3; ++dir)
+                {
+                    UINT from = result[i + k];
+                    UINT to = result[i + (k + dir) % 3];
+                    if (locked[from] || border[from] || from == to)
+                        continue;
+                    Quadric q = quadrics[from];
+                    q.Add(quadrics[to]);
+                    double cost = q.Evaluate(vertices[to].Pos);
+                    Collapse& best = bestCollapse[from];
+                    if (best.Cost < 0.0 || cost < best.Cost || (cost == best.Cost && to < best.To))
+                        best = { from, to, cost };
+                }
+            }
+        }
+        collapses.clear();
+        for (const auto& collapse : bestCollapse)
+        {
+            if (collapse.Cost >= 0.0 && collapse.Cost <= maxCost)
+                collapses.push_back(collapse);
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.Cost != b.Cost ? a.Cost < b.Cost : a.From < b.From;
+        });
+
+        for (UINT v = 0; v < vertexCount; ++v)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        auto flips = [&](UINT from, UINT to)
+        {
+            for (UINT i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i)
+            {
+                const UINT* triangle = &result[adjacency[i] * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    continue;
+                DirectX::XMFLOAT3 p[3];
+                for (UINT k = 0; k < 3; ++k)
+                    p[k] = vertices[triangle[k] == from ? to : triangle[k]].Pos;
+                double before[3];
+                double after[3];
+                GetNormal(vertices[triangle[0]].Pos, vertices[triangle[1]].Pos, vertices[triangle[2]].Pos, before);
+                GetNormal(p[0], p[1], p[2], after);
+                if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+                    return true;
+            }
+            return false;
+        };
+
+        // An interior collapse removes two triangles. Only one collapse per neighbourhood in a pass, so the checks stay valid.
+        size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        for (const auto& collapse : collapses)
+        {
+            if (removed >= trianglesToRemove)
+                break;
+            if (touched[collapse.From] || touched[collapse.To])
+                continue;
+
+            // The cheapest edge can fold the ring over, the vertex then tries its other edges before giving up for this pass
+            Collapse chosen = collapse;
+            if (flips(chosen.From, chosen.To))
+            {
+                chosen.Cost = -1.0;
+                for (UINT i = adjacencyOffsets[collapse.From]; i < adjacencyOffsets[collapse.From + 1]; ++i)
+                {
+                    const UINT* triangle = &result[adjacency[i] * 3];
+                    for (UINT k = 0; k < 3; ++k)
+                    {
+                        UINT to = triangle[k];
+                        if (to == collapse.From || to == collapse.To || touched[to])
+                            continue;
+                        Quadric q = quadrics[collapse.From];
+                        q.Add(quadrics[to]);
+                        double cost = q.Evaluate(vertices[to].Pos);
+                        if (cost > maxCost || (chosen.Cost >= 0.0 && (cost > chosen.Cost || (cost == chosen.Cost && to >= chosen.To))))
+                            continue;
+                        if (!flips(collapse.From, to))
+                            chosen = { collapse.From, to, cost };
+                    }
+                }
+                if (chosen.Cost < 0.0)
+                    continue;
+            }
+
+            for (UINT i = adjacencyOffsets[chosen.From]; i < adjacencyOffsets[chosen.From + 1]; ++i)
+            {
+                const UINT* triangle = &result[adjacency[i] * 3];
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+            }
+            remap[chosen.From] = chosen.To;
+            quadrics[chosen.To].Add(quadrics[chosen.From]);
+            resultCost = std::max(resultCost, chosen.Cost);
+            removed += 2;
+        }
+        if (removed == 0)
+            break;
+
+        size_t writeIndex = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            UINT a = remap[result[i + 0]];
+            UINT b = remap[result[i + 1]];
+            UINT c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[writeIndex++] = a;
+            result[writeIndex++] = b;
+            result[writeIndex++] = c;
+        }
+        result.resize(writeIndex);
+    }
+    return float(std::sqrt(resultCost));
+}
+
+UINT SelectLod(const std::vector<MeshLod>& lods, float distance, float projectionScale, float maxPixelError /*= 1.0f*/)
+{
+    UINT selected = 0;
+    for (UINT i = 1; i < lods.size(); ++i)
+    {
+        if (lods[i].Error * projectionScale > maxPixelError * distance)
+            break;
+        selected = i;
+    }
+    return selected;
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+#include "DXrenderer/Geometry/Vertex.h"
+
+namespace DirectxPlayground
+{
+// LODs share the vertex buffer, each one is a range in the mesh index buffer.
+struct MeshLod
+{
+    UINT FirstIndex = 0;
+    UINT IndexCount = 0;
+    float Error = 0.0f; // Geometric deviation from the full resolution mesh, in mesh units
+};
+
+// Quadric error metric edge collapse (Garland-Heckbert) onto existing vertices, so the vertex buffer stays untouched.
+// Vertices on open borders and UV/normal seams are never moved. Deterministic: the same input gives the same output.
+// Returns the error of the result, the collapses stop at targetIndexCount or at maxError, whichever comes first.
+float SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices, size_t targetIndexCount, float maxError, std::vector<UINT>& result);
+
+// projectionScale converts the error at a unit distance into pixels, i.e. proj(1, 1) * viewportHeight / 2.
+// Returns the coarsest LOD whose projected error stays below maxPixelError.
+UINT SelectLod(const std::vector<MeshLod>& lods, float distance, float projectionScale, float maxPixelError = 1.0f);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+namespace DirectxPlayground
+{
+struct Vertex
+{
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT2 Uv;
+    DirectX::XMFLOAT3 Norm;
+    DirectX::XMFLOAT4 Tangent;
+};
+}
@@ -0,0 +1,251 @@
+#include "DXrenderer/Geometry/VertexLayout.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace DirectxPlayground
+{
+namespace
+{
+struct VertexElement
+{
+    const char* Semantic;
+    DXGI_FORMAT Format;
+    UINT Size;
+};
+
+constexpr VertexElement FloatElements[] =
+{
+    { "POSITION", DXGI_FORMAT_R32G32B32_FLOAT, 12 },
+    { "TEXCOORD", DXGI_FORMAT_R32G32_FLOAT, 8 },
+    { "NORMAL", DXGI_FORMAT_R32G32B32_FLOAT, 12 },
+    { "TANGENT", DXGI_FORMAT_R32G32B32A32_FLOAT, 16 },
+};
+
+constexpr VertexElement CompactElements[] =
+{
+    { "POSITION", DXGI_FORMAT_R16G16B16A16_SNORM, 8 },
+    { "TEXCOORD", DXGI_FORMAT_R16G16_UNORM, 4 },
+    { "NORMAL", DXGI_FORMAT_R8G8B8A8_SNORM, 4 },
+};
+
+template <size_t N>
+constexpr UINT GetElementsSize(const VertexElement (&elements)[N])
+{
+    UINT size = 0;
+    for (const auto& element : elements)
+        size += element.Size;
+    return size;
+}
+
+static_assert(GetElementsSize(FloatElements) == sizeof(Vertex), "Float vertex layout doesn't match Vertex");
+static_assert(GetElementsSize(CompactElements) == sizeof(CompactVertex), "Compact vertex layout doesn't match CompactVertex");
+
+template <size_t N>
+std::vector<D3D12_INPUT_ELEMENT_DESC> CreateInputLayout(const VertexElement (&elements)[N])
+{
+    std::vector<D3D12_INPUT_ELEMENT_DESC> layout;
+    UINT offset = 0;
+    for (const auto& element : elements)
+    {
+        layout.push_back({ element.Semantic, 0, element.Format, 0, offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+        offset += element.Size;
+    }
+    return layout;
+}
+
+// value = code * Step + Base, codes in [MinCode, MaxCode]
+struct Quantization
+{
+    float Step = 1.0f;
+    float Base = 0.0f;
+    int MinCode = 0;
+    int MaxCode = 0;
+
+    int Encode(float value) const
+    {
+        int code = static_cast<int>(std::lround((value - Base) / Step));
+        return std::clamp(code, MinCode, MaxCode);
+    }
+};
+
+Quantization ChooseQuantization(float minValue, float maxValue, float sourceStep, int minCode, int maxCode)
+{
+    Quantization q;
+    q.MinCode = minCode;
+    q.MaxCode = maxCode;
+    float codesCount = static_cast<float>(maxCode - minCode);
+    float range = maxValue - minValue;
+    if (sourceStep > 0.0f && range / sourceStep <= codesCount)
+        q.Step = sourceStep; // Source grid fits, keep it
+    else if (range > 0.0f)
+        q.Step = range / codesCount;
+    q.Base = minValue - minCode * q.Step;
+    return q;
+}
+
+INT8 EncodeSnorm8(float v)
+{
+    return static_cast<INT8>(std::lround(std::clamp(v, -1.0f, 1.0f) * 127.0f));
+}
+
+float DecodeSnorm8(INT8 v)
+{
+    return std::max(v / 127.0f, -1.0f);
+}
+
+void EncodeOctahedral(float x, float y, float z, INT8* encoded)
+{
+    float sum = std::abs(x) + std::abs(y) + std::abs(z);
+    if (sum == 0.0f)
+    {
+        encoded[0] = 0;
+        encoded[1] = 0;
+        return;
+    }
+    x /= sum;
+    y /= sum;
+    if (z < 0.0f)
+    {
+        float ox = x;
+        x = (1.0f - std::abs(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::abs(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    encoded[0] = EncodeSnorm8(x);
+    encoded[1] = EncodeSnorm8(y);
+}
+
+// Same as DecodeOctahedral in the shaders
+DirectX::XMFLOAT3 DecodeOctahedral(const INT8* encoded)
+{
+    float x = DecodeSnorm8(encoded[0]);
+    float y = DecodeSnorm8(encoded[1]);
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    return { x / length, y / length, z / length };
+}
+
+float Angle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+    float lengths = std::sqrt((a.x * a.x + a.y * a.y + a.z * a.z) * (b.x * b.x + b.y * b.y + b.z * b.z));
+    if (lengths == 0.0f)
+        return 0.0f;
+    return std::acos(std::clamp((a.x * b.x + a.y * b.y + a.z * b.z) / lengths, -1.0f, 1.0f));
+}
+}
+
+UINT GetVertexStride(VertexLayout layout)
+{
+    return layout == VertexLayout::Compact ? GetElementsSize(CompactElements) : GetElementsSize(FloatElements);
+}
+
+const std::vector<D3D12_INPUT_ELEMENT_DESC>& GetVertexInputLayout(VertexLayout layout)
+{
+    static const std::vector<D3D12_INPUT_ELEMENT_DESC> floatLayout = CreateInputLayout(FloatElements);
+    static const std::vector<D3D12_INPUT_ELEMENT_DESC> compactLayout = CreateInputLayout(CompactElements);
+    return layout == VertexLayout::Compact ? compactLayout : floatLayout;
+}
+
+DXGI_FORMAT GetVertexPositionFormat(VertexLayout layout)
+{
+    return layout == VertexLayout::Compact ? CompactElements[0].Format : FloatElements[0].Format;
+}
+
+const char* GetVertexLayoutName(VertexLayout layout)
+{
+    return layout == VertexLayout::Compact ? "Compact" : "Float";
+}
+
+void EncodeCompactVertices(const std::vector<Vertex>& vertices, const SourceQuantization& source, std::vector<CompactVertex>& encoded, VertexDequantization& dequantization)
+{
+    encoded.resize(vertices.size());
+    if (vertices.empty())
+        return;
+
+    float minPos[3] = { vertices[0].Pos.x, vertices[0].Pos.y, vertices[0].Pos.z };
+    float maxPos[3] = { minPos[0], minPos[1], minPos[2] };
+    float minUv[2] = { vertices[0].Uv.x, vertices[0].Uv.y };
+    float maxUv[2] = { minUv[0], minUv[1] };
+    for (const auto& v : vertices)
+    {
+        const float pos[3] = { v.Pos.x, v.Pos.y, v.Pos.z };
+        const float uv[2] = { v.Uv.x, v.Uv.y };
+        for (int c = 0; c < 3; ++c)
+        {
+            minPos[c] = std::min(minPos[c], pos[c]);
+            maxPos[c] = std::max(maxPos[c], pos[c]);
+        }
+        for (int c = 0; c < 2; ++c)
+        {
+            minUv[c] = std::min(minUv[c], uv[c]);
+            maxUv[c] = std::max(maxUv[c], uv[c]);
+        }
+    }
+
+    Quantization posQuantization[3];
+    for (int c = 0; c < 3; ++c)
+        posQuantization[c] = ChooseQuantization(minPos[c], maxPos[c], source.PositionStep[c], -32767, 32767);
+    Quantization uvQuantization[2];
+    for (int c = 0; c < 2; ++c)
+        uvQuantization[c] = ChooseQuantization(minUv[c], maxUv[c], source.UvStep[c], 0, 65535);
+
+    // The input assembler returns code / 32767 for snorm16 and code / 65535 for unorm16.
+    dequantization.PositionScale = { posQuantization[0].Step * 32767.0f, posQuantization[1].Step * 32767.0f, posQuantization[2].Step * 32767.0f, 0.0f };
+    dequantization.PositionOffset = { posQuantization[0].Base, posQuantization[1].Base, posQuantization[2].Base, 0.0f };
+    dequantization.UvScaleOffset = { uvQuantization[0].Step * 65535.0f, uvQuantization[1].Step * 65535.0f, uvQuantization[0].Base, uvQuantization[1].Base };
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex& v = vertices[i];
+        CompactVertex& e = encoded[i];
+        e.Pos[0] = static_cast<INT16>(posQuantization[0].Encode(v.Pos.x));
+        e.Pos[1] = static_cast<INT16>(posQuantization[1].Encode(v.Pos.y));
+        e.Pos[2] = static_cast<INT16>(posQuantization[2].Encode(v.Pos.z));
+        e.Pos[3] = v.Tangent.w < 0.0f ? -32767 : 32767;
+        e.Uv[0] = static_cast<UINT16>(uvQuantization[0].Encode(v.Uv.x));
+        e.Uv[1] = static_cast<UINT16>(uvQuantization[1].Encode(v.Uv.y));
+        EncodeOctahedral(v.Norm.x, v.Norm.y, v.Norm.z, &e.NormalTangent[0]);
+        EncodeOctahedral(v.Tangent.x, v.Tangent.y, v.Tangent.z, &e.NormalTangent[2]);
+    }
+}
+
+void DecodeCompactVertices(const std::vector<CompactVertex>& encoded, const VertexDequantization& dequantization, std::vector<Vertex>& vertices)
+{
+    const auto& scale = dequantization.PositionScale;
+    const auto& offset = dequantization.PositionOffset;
+    const auto& uv = dequantization.UvScaleOffset;
+
+    vertices.resize(encoded.size());
+    for (size_t i = 0; i < encoded.size(); ++i)
+    {
+        const CompactVertex& e = encoded[i];
+        Vertex& v = vertices[i];
+        v.Pos = { std::max(e.Pos[0] / 32767.0f, -1.0f) * scale.x + offset.x, std::max(e.Pos[1] / 32767.0f, -1.0f) * scale.y + offset.y, std::max(e.Pos[2] / 32767.0f, -1.0f) * scale.z + offset.z };
+        v.Uv = { e.Uv[0] / 65535.0f * uv.x + uv.z, e.Uv[1] / 65535.0f * uv.y + uv.w };
+        v.Norm = DecodeOctahedral(&e.NormalTangent[0]);
+        DirectX::XMFLOAT3 tangent = DecodeOctahedral(&e.NormalTangent[2]);
+        v.Tangent = { tangent.x, tangent.y, tangent.z, e.Pos[3] < 0 ? -1.0f : 1.0f };
+    }
+}
+
+VertexEncodingError MeasureEncodingError(const std::vector<Vertex>& original, const std::vector<Vertex>& decoded)
+{
+    assert(original.size() == decoded.size());
+    VertexEncodingError error;
+    for (size_t i = 0; i < original.size(); ++i)
+    {
+        const Vertex& a = original[i];
+        const Vertex& b = decoded[i];
+        error.Position = std::max({ error.Position, std::abs(a.Pos.x - b.Pos.x), std::abs(a.Pos.y - b.Pos.y), std::abs(a.Pos.z - b.Pos.z) });
+        error.Uv = std::max({ error.Uv, std::abs(a.Uv.x - b.Uv.x), std::abs(a.Uv.y - b.Uv.y) });
+        error.NormalAngle = std::max(error.NormalAngle, Angle(a.Norm, b.Norm));
+        error.TangentAngle = std::max(error.TangentAngle, Angle({ a.Tangent.x, a.Tangent.y, a.Tangent.z }, { b.Tangent.x, b.Tangent.y, b.Tangent.z }));
+    }
+    return error;
+}
+
+}
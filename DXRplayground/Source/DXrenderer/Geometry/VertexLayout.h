@@ -0,0 +1,59 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+#include "DXrenderer/Geometry/Vertex.h"
+
+namespace DirectxPlayground
+{
+enum class VertexLayout : UINT
+{
+    Float, // Vertex, 48 bytes
+    Compact // CompactVertex, 16 bytes
+};
+
+// Position xyz is snorm16 in the mesh bounds, w keeps the tangent handedness.
+// Uv is unorm16 in the mesh uv bounds. Normal and tangent are octahedral, two snorm8 each.
+struct CompactVertex
+{
+    INT16 Pos[4];
+    UINT16 Uv[2];
+    INT8 NormalTangent[4];
+};
+
+// Per mesh constants that bring compact vertices back to the mesh space, identity for float vertices.
+struct VertexDequantization
+{
+    DirectX::XMFLOAT4 PositionScale = { 1.0f, 1.0f, 1.0f, 0.0f };
+    DirectX::XMFLOAT4 PositionOffset = { 0.0f, 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT4 UvScaleOffset = { 1.0f, 1.0f, 0.0f, 0.0f };
+};
+
+// Step of the integer grid the source data was stored on (KHR_mesh_quantization), 0 for float data.
+// The compact encoding snaps to that grid, so already quantized positions and uvs are kept exactly.
+struct SourceQuantization
+{
+    float PositionStep[3] = {};
+    float UvStep[2] = {};
+};
+
+// Both the input layout and the stride come from the same element list, so they can't drift apart.
+UINT GetVertexStride(VertexLayout layout);
+const std::vector<D3D12_INPUT_ELEMENT_DESC>& GetVertexInputLayout(VertexLayout layout);
+DXGI_FORMAT GetVertexPositionFormat(VertexLayout layout);
+const char* GetVertexLayoutName(VertexLayout layout);
+
+void EncodeCompactVertices(const std::vector<Vertex>& vertices, const SourceQuantization& source, std::vector<CompactVertex>& encoded, VertexDequantization& dequantization);
+void DecodeCompactVertices(const std::vector<CompactVertex>& encoded, const VertexDequantization& dequantization, std::vector<Vertex>& vertices);
+
+struct VertexEncodingError
+{
+    float Position = 0.0f; // Mesh units
+    float Uv = 0.0f;
+    float NormalAngle = 0.0f; // Radians
+    float TangentAngle = 0.0f;
+};
+
+VertexEncodingError MeasureEncodingError(const std::vector<Vertex>& original, const std::vector<Vertex>& decoded);
+}
@@ -1,31 +1,292 @@
 #include "DXrenderer/Model.h"
 
+#include "DXrenderer/CookedModel.h"
+#include "DXrenderer/Geometry/AccessorDecoder.h"
+#include "DXrenderer/Geometry/GeometryArena.h"
+#include "DXrenderer/Geometry/GltfPrimitive.h"
+#include "DXrenderer/Geometry/MeshOptimizer.h"
+#include "DXrenderer/Geometry/Meshlets.h"
+#include "DXrenderer/Geometry/Simplifier.h"
 #include "DXrenderer/RenderContext.h"
 #include "DXrenderer/Textures/TextureManager.h"
+#include "DXrenderer/Textures/TextureStreamer.h"
+#include "DXrenderer/Textures/VirtualTextureDX.h"
 #include "DXrenderer/Buffers/UploadBuffer.h"
+#include "Utils/Hash.h"
 #include "Utils/Logger.h"
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
 
+#include <cfloat>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
+#include <numeric>
 
-#define TINYGLTF_IMPLEMENTATION
 #define TINYGLTF_NOEXCEPTION
 #define JSON_NOEXCEPTION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE
 #include "External/TinyGLTF/tiny_gltf.h"
 
 namespace DirectxPlayground
 {
 namespace
 {
-template <typename T>
-T GetElementFromBuffer(const byte* bufferStart, UINT byteStride, size_t elemIndex, UINT offsetInElem = 0)
+std::string GetModelDirectory(const std::string& path)
 {
-    return *(reinterpret_cast<const T*>(bufferStart + size_t(byteStride) * size_t(elemIndex) + offsetInElem));
+    std::filesystem::path pathToModel{ path };
+    return pathToModel.parent_path().string() + '\\';
+}
+
+XMMATRIX GetNodeMatrix(const tinygltf::Node& node)
+{
+    if (node.matrix.size() == 16)
+    {
+        // Column-major for column vectors is the same memory as row-major for row vectors
+        XMFLOAT4X4 m;
+        for (int i = 0; i < 16; ++i)
+            m.m[i / 4][i % 4] = static_cast<float>(node.matrix[i]);
+        return XMLoadFloat4x4(&m);
+    }
+    XMVECTOR scale = XMVectorSplatOne();
+    if (node.scale.size() == 3)
+        scale = XMVectorSet(static_cast<float>(node.scale[0]), static_cast<float>(node.scale[1]), static_cast<float>(node.scale[2]), 0.0f);
+    XMVECTOR rotation = XMQuaternionIdentity();
+    if (node.rotation.size() == 4)
+        rotation = XMVectorSet(static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2]), static_cast<float>(node.rotation[3]));
+    XMVECTOR translation = XMVectorZero();
+    if (node.translation.size() == 3)
+        translation = XMVectorSet(static_cast<float>(node.translation[0]), static_cast<float>(node.translation[1]), static_cast<float>(node.translation[2]), 0.0f);
+    return XMMatrixAffineTransformation(scale, XMVectorZero(), rotation, translation);
+}
+
+int GetImageIndex(const tinygltf::Model& model, int textureIndex)
+{
+    return textureIndex == -1 ? -1 : model.textures[textureIndex].source;
 }
+
+// Images used only as normal maps or only as occlusion get their own block formats. Metallic-roughness, occlusion packed
+// with it and any other mix without base color are linear data, base color keeps everything it's shared with in sRGB.
+std::vector<TextureUsage> GetImageUsages(const std::vector<Material>& materials, size_t imagesCount)
+{
+    constexpr UINT ColorSlot = 1;
+    constexpr UINT NormalSlot = 2;
+    constexpr UINT MaskSlot = 4;
+    constexpr UINT DataSlot = 8;
+    std::vector<UINT> slots(imagesCount, 0);
+    auto addSlot = [&slots](int image, UINT slot)
+    {
+        if (image >= 0 && size_t(image) < slots.size())
+            slots[image] |= slot;
+    };
+    for (const auto& material : materials)
+    {
+        addSlot(material.BaseColorTexture, ColorSlot);
+        addSlot(material.MetallicRoughnessTexture, DataSlot);
+        addSlot(material.NormalTexture, NormalSlot);
+        addSlot(material.OcclusionTexture, MaskSlot);
+    }
+
+    std::vector<TextureUsage> usages(imagesCount, TextureUsage::Color);
+    for (size_t i = 0; i < imagesCount; ++i)
+    {
+        if (slots[i] == 0 || (slots[i] & ColorSlot) != 0)
+            continue;
+        if (slots[i] == NormalSlot)
+            usages[i] = TextureUsage::Normal;
+        else if (slots[i] == MaskSlot)
+            usages[i] = TextureUsage::Mask;
+        else
+            usages[i] = TextureUsage::Data;
+    }
+    return usages;
+}
+
+// Hashes the model file and every file it depends on. Returns 0 if any of them can't be read.
+UINT64 HashModelSources(const std::string& path, const std::vector<std::string>& dependencies)
+{
+    MappedFile source(path);
+    if (!source.IsValid())
+        return 0;
+    UINT64 hash = HashBytes(source.GetData(), source.GetSize());
+
+    std::string dir = GetModelDirectory(path);
+    for (const auto& dependency : dependencies)
+    {
+        MappedFile file(dir + dependency);
+        if (!file.IsValid())
+            return 0;
+        hash = HashString(dependency, hash);
+        hash = HashBytes(file.GetData(), file.GetSize(), hash);
+    }
+    return hash;
+}
+
+UINT64 HashLoadOptions(const ModelLoadOptions& options)
+{
+    UINT64 hash = HashValue(UINT(options.OptimizeMeshes));
+    hash = HashValue(UINT(options.BuildMeshlets), hash);
+    hash = HashValue(options.LodCount, hash);
+    return HashValue(options.Layout, hash);
 }
 
-Model::Model(RenderContext& ctx, const std::string& path)
+void ComputeBounds(const std::vector<Vertex>& vertices, XMFLOAT3& center, float& radius)
 {
+    if (vertices.empty())
+        return;
+    XMVECTOR minPos = XMLoadFloat3(&vertices[0].Pos);
+    XMVECTOR maxPos = minPos;
+    for (const auto& v : vertices)
+    {
+        minPos = XMVectorMin(minPos, XMLoadFloat3(&v.Pos));
+        maxPos = XMVectorMax(maxPos, XMLoadFloat3(&v.Pos));
+    }
+    XMVECTOR c = XMVectorScale(XMVectorAdd(minPos, maxPos), 0.5f);
+    XMVECTOR maxDistance = XMVectorZero();
+    for (const auto& v : vertices)
+        maxDistance = XMVectorMax(maxDistance, XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&v.Pos), c)));
+    XMStoreFloat3(&center, c);
+    radius = std::sqrt(XMVectorGetX(maxDistance));
+}
+
+// Square root of the UV area over the surface area, how much the textures are stretched across the mesh. 0 without either.
+float ComputeUvDensity(const std::vector<Vertex>& vertices, const std::vector<UINT>& indices)
+{
+    float uvArea = 0.0f;
+    float area = 0.0f;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const Vertex& a = vertices[indices[i]];
+        const Vertex& b = vertices[indices[i + 1]];
+        const Vertex& c = vertices[indices[i + 2]];
+        XMVECTOR edge0 = XMVectorSubtract(XMLoadFloat3(&b.Pos), XMLoadFloat3(&a.Pos));
+        XMVECTOR edge1 = XMVectorSubtract(XMLoadFloat3(&c.Pos), XMLoadFloat3(&a.Pos));
+        area += XMVectorGetX(XMVector3Length(XMVector3Cross(edge0, edge1)));
+        float du0 = b.Uv.x - a.Uv.x;
+        float dv0 = b.Uv.y - a.Uv.y;
+        float du1 = c.Uv.x - a.Uv.x;
+        float dv1 = c.Uv.y - a.Uv.y;
+        uvArea += std::abs(du0 * dv1 - du1 * dv0);
+    }
+    return area > 0.0f ? std::sqrt(uvArea / area) : 0.0f;
+}
+
+void LogMemoryStats(const std::string& path, const ModelMemoryStats& stats)
+{
+    size_t total = stats.VertexBytes + stats.IndexBytes;
+    size_t wideTotal = stats.FloatVertexBytes + stats.WideIndexBytes;
+    LOG("Model ", path, " geometry: vertices ", stats.VertexBytes / 1024, " KB (", stats.FloatVertexBytes / 1024, " KB as floats), indices ",
+        stats.IndexBytes / 1024, " KB (", stats.WideIndexBytes / 1024, " KB as 32-bit), saved ", (wideTotal - total) / 1024, " KB");
+    LOG("Model ", path, " geometry buffers: ", stats.GeometryBuffersCount, " (", stats.UnmergedGeometryBuffersCount, " with a buffer per mesh)");
+}
+
+size_t AlignOffset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// A block of count elements at offset, all of it inside size
+bool IsBlockInside(UINT64 offset, UINT64 count, UINT64 elementSize, UINT64 size)
+{
+    return offset <= size && count <= (size - offset) / elementSize;
+}
+
+bool IsTextureIndexValid(int index, UINT imageCount)
+{
+    return index == -1 || (index >= 0 && UINT(index) < imageCount);
+}
+
+// Every table and block of a cooked model within the file and every index within its table, so nothing reads past the mapping.
+// The header magic and version are checked by the caller.
+bool IsCookedModelValid(const byte* data, UINT64 size)
+{
+    const CookedModelHeader& header = *reinterpret_cast<const CookedModelHeader*>(data);
+    const std::pair<UINT64, UINT64> tables[] = { { header.MeshCount, sizeof(CookedMesh) }, { header.InstanceCount, sizeof(MeshInstance) },
+        { UINT64(header.ImageCount) + header.DependencyCount, sizeof(CookedString) }, { header.StringsSize, 1 } };
+    UINT64 tablesSize = sizeof(CookedModelHeader);
+    for (const auto& [count, elementSize] : tables)
+    {
+        if (!IsBlockInside(tablesSize, count, elementSize, size))
+            return false;
+        tablesSize += count * elementSize;
+    }
+    if (header.DataOffset < tablesSize || header.DataOffset > size)
+        return false;
+
+    const CookedMesh* meshes = reinterpret_cast<const CookedMesh*>(data + sizeof(CookedModelHeader));
+    const MeshInstance* instances = reinterpret_cast<const MeshInstance*>(meshes + header.MeshCount);
+    const CookedString* strings = reinterpret_cast<const CookedString*>(instances + header.InstanceCount);
+    for (UINT i = 0; i < header.ImageCount + header.DependencyCount; ++i)
+    {
+        if (!IsBlockInside(strings[i].Offset, strings[i].Length, 1, header.StringsSize))
+            return false;
+    }
+    for (UINT i = 0; i < header.InstanceCount; ++i)
+    {
+        if (instances[i].MeshIndex >= header.MeshCount)
+            return false;
+    }
+
+    const byte* payload = data + header.DataOffset;
+    UINT64 payloadSize = size - header.DataOffset;
+    for (UINT i = 0; i < header.MeshCount; ++i)
+    {
+        const CookedMesh& mesh = meshes[i];
+        if (mesh.Layout != VertexLayout::Float && mesh.Layout != VertexLayout::Compact)
+            return false;
+        if (mesh.IndexFormat != DXGI_FORMAT_R16_UINT && mesh.IndexFormat != DXGI_FORMAT_R32_UINT)
+            return false;
+        const Material& material = mesh.MeshMaterial;
+        for (int texture : { material.BaseColorTexture, material.MetallicRoughnessTexture, material.NormalTexture, material.OcclusionTexture })
+        {
+            if (!IsTextureIndexValid(texture, header.ImageCount))
+                return false;
+        }
+
+        // LODs first, the index block holds all of them
+        if (mesh.LodCount == 0 || !IsBlockInside(mesh.LodOffset, mesh.LodCount, sizeof(MeshLod), payloadSize))
+            return false;
+        const MeshLod* lods = reinterpret_cast<const MeshLod*>(payload + mesh.LodOffset);
+        UINT64 indexBufferCount = 0;
+        for (UINT lod = 0; lod < mesh.LodCount; ++lod)
+            indexBufferCount = std::max(indexBufferCount, UINT64(lods[lod].FirstIndex) + lods[lod].IndexCount);
+        if (mesh.IndexCount > indexBufferCount || UINT64(lods[mesh.LodCount - 1].FirstIndex) + lods[mesh.LodCount - 1].IndexCount != indexBufferCount)
+            return false;
+
+        UINT64 vertexStride = mesh.Layout == VertexLayout::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+        UINT64 indexStride = mesh.IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(UINT16) : sizeof(UINT);
+        if (!IsBlockInside(mesh.VertexOffset, mesh.VertexCount, vertexStride, payloadSize) ||
+            !IsBlockInside(mesh.IndexOffset, indexBufferCount, indexStride, payloadSize) ||
+            !IsBlockInside(mesh.MeshletOffset, mesh.MeshletCount, sizeof(Meshlet), payloadSize) ||
+            !IsBlockInside(mesh.MeshletVertexOffset, mesh.MeshletVertexCount, sizeof(UINT), payloadSize) ||
+            !IsBlockInside(mesh.MeshletTriangleOffset, UINT64(mesh.MeshletTriangleCount) * 3, 1, payloadSize))
+            return false;
+        const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(payload + mesh.MeshletOffset);
+        for (UINT m = 0; m < mesh.MeshletCount; ++m)
+        {
+            if (UINT64(meshlets[m].VertexOffset) + meshlets[m].VertexCount > mesh.MeshletVertexCount ||
+                UINT64(meshlets[m].TriangleOffset) + meshlets[m].TriangleCount > mesh.MeshletTriangleCount)
+                return false;
+        }
+    }
+    return true;
+}
+}
+
+Model::Model(RenderContext& ctx, const std::string& path, const ModelLoadOptions& options /*= {}*/)
+    : mOptions(options)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    if (LoadCooked(ctx, path))
+    {
+        auto loadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        LOG("Loaded cooked model ", path, " in ", loadTime, " ms");
+        LogMemoryStats(path, GetMemoryStats());
+        return;
+    }
+
     tinygltf::Model model;
     LoadModel(path, model);
 
@@ -38,30 +299,40 @@ Model::Model(RenderContext& ctx, const std::string& path)
         }
     }
 
-    std::filesystem::path pathToModel{ path };
-    std::string dir = pathToModel.parent_path().string() + '\\';
-    for (const auto& image : model.images)
-    {
-        UINT index = ctx.TexManager->CreateTexture(ctx, dir + image.uri).SRVOffset;
-        mImages.push_back({ index, image.uri });
-    }
-    for (const auto& texture : model.textures)
-    {
-        mTextures.push_back(texture.source);
-    }
     for (const auto& mat : model.materials)
     {
         Material m;
-        m.BaseColorTexture = mat.pbrMetallicRoughness.baseColorTexture.index;
-        m.MetallicRoughnessTexture = mat.pbrMetallicRoughness.metallicRoughnessTexture.index;
-        m.NormalTexture = mat.normalTexture.index;
-        m.OcclusionTexture = mat.occlusionTexture.index;
+        m.BaseColorTexture = GetImageIndex(model, mat.pbrMetallicRoughness.baseColorTexture.index);
+        m.MetallicRoughnessTexture = GetImageIndex(model, mat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+        m.NormalTexture = GetImageIndex(model, mat.normalTexture.index);
+        m.OcclusionTexture = GetImageIndex(model, mat.occlusionTexture.index);
         mMaterials.push_back(m);
     }
 
+    std::vector<std::string> uris;
+    for (const auto& image : model.images)
+        uris.push_back(image.uri);
+    CreateTextures(ctx, path, uris, GetImageUsages(mMaterials, uris.size()));
+
+    std::vector<SceneNode> nodes;
     const tinygltf::Scene& scene = model.scenes[model.defaultScene];
     for (int node : scene.nodes)
-        ParseModelNodes(ctx, model, model.nodes[node]);
+        ParseModelNodes(model, node, -1, nodes);
+    std::vector<PrimitiveJob> jobs;
+    CreateInstances(model, nodes, jobs);
+    ParseGLTFMeshes(ctx, model, jobs);
+
+    auto loadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    LOG("Loaded glTF model ", path, " in ", loadTime, " ms");
+    LogMemoryStats(path, GetMemoryStats());
+
+    std::vector<std::string> dependencies;
+    for (const auto& buffer : model.buffers)
+    {
+        if (!buffer.uri.empty() && buffer.uri.compare(0, 5, "data:") != 0)
+            dependencies.push_back(buffer.uri);
+    }
+    WriteCooked(path, dependencies);
 }
 
 Model::Model(RenderContext& ctx, std::vector<Vertex> vertices, std::vector<UINT> indices)
@@ -72,199 +343,624 @@ Model::Model(RenderContext& ctx, std::vector<Vertex> vertices, std::vector<UINT>
     sMesh->mVertices.swap(vertices);
     sMesh->mIndices.swap(indices);
     sMesh->mIndexCount = static_cast<UINT>(sMesh->mIndices.size());
-
-    sMesh->mVertexBuffer = new VertexBuffer(reinterpret_cast<byte*>(sMesh->mVertices.data()), static_cast<UINT>(sizeof(Vertex) * sMesh->mVertices.size()), sizeof(Vertex), ctx.CommandList, ctx.Device);
-    sMesh->mIndexBuffer = new IndexBuffer(reinterpret_cast<byte*>(sMesh->mIndices.data()), static_cast<UINT>(sizeof(UINT) * sMesh->mIndices.size()), ctx.CommandList, ctx.Device, DXGI_FORMAT_R32_UINT);
+    sMesh->mVertexCount = static_cast<UINT>(sMesh->mVertices.size());
+    sMesh->mLods.push_back({ 0, sMesh->mIndexCount, 0.0f });
+    ComputeBounds(sMesh->mVertices, sMesh->mBoundsCenter, sMesh->mBoundsRadius);
+    sMesh->mUvDensity = ComputeUvDensity(sMesh->mVertices, sMesh->mIndices);
+    PackIndices(sMesh);
+    mInstances.push_back({ 0, IdentityMatrix });
+
+    const byte* indexData = sMesh->mIndexFormat == DXGI_FORMAT_R16_UINT ? reinterpret_cast<byte*>(sMesh->mShortIndices.data()) : reinterpret_cast<byte*>(sMesh->mIndices.data());
+    CreateMeshBuffers(ctx, { reinterpret_cast<byte*>(sMesh->mVertices.data()) }, { indexData });
 }
 
 Model::~Model()
 {
+    assert(mTextures.empty() && "ReleaseTextures wasn't called, the textures stay registered");
     for (auto submesh : mMeshes)
     {
         delete submesh;
     }
     mMeshes.clear();
+    for (auto buffer : mVertexBuffers)
+        delete buffer;
+    for (auto buffer : mIndexBuffers)
+        delete buffer;
+}
+
+ModelMemoryStats Model::GetMemoryStats() const
+{
+    ModelMemoryStats stats;
+    for (const auto mesh : mMeshes)
+    {
+        stats.VertexBytes += size_t(mesh->GetVertexStride()) * mesh->mVertexCount;
+        stats.FloatVertexBytes += sizeof(Vertex) * mesh->mVertexCount;
+        stats.IndexBytes += size_t(mesh->GetIndexStride()) * mesh->GetIndexBufferCount();
+        stats.WideIndexBytes += sizeof(UINT) * mesh->GetIndexBufferCount();
+    }
+    stats.GeometryBuffersCount = static_cast<UINT>(mVertexBuffers.size() + mIndexBuffers.size());
+    stats.UnmergedGeometryBuffersCount = static_cast<UINT>(mMeshes.size() * 2);
+    return stats;
 }
 
 void Model::UpdateMeshes(UINT frame)
 {
+    if (mTextureManager != nullptr)
+    {
+        for (size_t i = 0; i < mImages.size(); ++i)
+            mImages[i].IndexInHeap = mTextureManager->GetSrvOffset(mTextures[i]);
+        for (auto mesh : mMeshes)
+            ResolveMaterial(mesh, mesh->mImageMaterial);
+    }
     for (auto mesh : mMeshes)
         mesh->UpdateMaterialBuffer(frame);
 }
 
-void Model::LoadModel(const std::string& path, tinygltf::Model& model)
+void Model::RequestTextureMips(TextureManager& textureManager, const Mesh* mesh, const XMFLOAT3& viewerPosition, float projectionScale) const
 {
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
+    TextureStreamer* streamer = textureManager.GetStreamer();
+    if (!mOptions.StreamTextures || streamer == nullptr || mesh->mUvDensity <= 0.0f)
+        return;
+
+    XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&mesh->mBoundsCenter), XMLoadFloat3(&viewerPosition));
+    float centerDistance = XMVectorGetX(XMVector3Length(toCenter));
+    float distance = std::max(centerDistance - mesh->mBoundsRadius, 0.001f);
+    // Projected bounding sphere, about the whole screen from inside it
+    float projectedRadius = projectionScale * mesh->mBoundsRadius / std::max(centerDistance, mesh->mBoundsRadius);
+    float screenArea = XM_PI * projectedRadius * projectedRadius;
+
+    const Material& material = mesh->mImageMaterial;
+    for (int image : { material.BaseColorTexture, material.MetallicRoughnessTexture, material.NormalTexture, material.OcclusionTexture })
+    {
+        if (image < 0)
+            continue;
+        UINT texture = mTextures[image].StreamIdx;
+        const StreamedTextureDesc& desc = streamer->GetDesc(texture);
+        streamer->Request(texture, ComputeWantedMip(desc.Width, desc.Height, mesh->mUvDensity, distance, projectionScale), screenArea);
+    }
+}
 
-    bool res = false;
+void Model::RequestVirtualTiles(VirtualTextureDX& virtualTexture, const Mesh* mesh, const XMFLOAT3& viewerPosition, float projectionScale) const
+{
+    int image = mesh->mImageMaterial.BaseColorTexture;
+    if (image < 0 || mVirtualTextures.empty() || mVirtualTextures[image] == InvalidOffset || mesh->mUvDensity <= 0.0f)
+        return;
+
+    XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&mesh->mBoundsCenter), XMLoadFloat3(&viewerPosition));
+    float distance = std::max(XMVectorGetX(XMVector3Length(toCenter)) - mesh->mBoundsRadius, 0.001f);
+    UINT texture = mVirtualTextures[image];
+    const VirtualTextureCache& cache = virtualTexture.GetCache();
+    float mip = ComputeWantedMip(cache.GetWidth(texture), cache.GetHeight(texture), mesh->mUvDensity, distance, projectionScale);
+    virtualTexture.AddMipFeedback(texture, static_cast<UINT>(std::max(mip, 0.0f)));
+}
 
-    size_t lastPeriod = path.find_last_of('.');
-    if (lastPeriod == std::string::npos)
-        assert(false);
-    std::string ext = path.substr(lastPeriod);
+void Model::MarkTexturesUsed(TextureManager& textureManager, const Mesh* mesh) const
+{
+    if (!mOptions.EvictableTextures)
+        return;
+    const Material& material = mesh->mImageMaterial;
+    for (int image : { material.BaseColorTexture, material.MetallicRoughnessTexture, material.NormalTexture, material.OcclusionTexture })
+    {
+        if (image >= 0)
+            textureManager.MarkTextureUsed(mTextures[image]);
+    }
+}
 
-    if (ext == ".glb")
-        res = loader.LoadBinaryFromFile(&model, &err, &warn, path.c_str());
-    else if (ext == ".gltf")
-        res = loader.LoadASCIIFromFile(&model, &err, &warn, path.c_str());
-    else
-        assert(false);
-    if (!res)
+void Model::LoadModel(const std::string& path, tinygltf::Model& model)
+{
+    std::string err;
+    if (!LoadGltf(path, model, err))
     {
         std::stringstream ss;
-        ss << "Failed to load model " << path << std::endl;
+        ss << "Failed to load model " << path << ": " << err << std::endl;
         OutputDebugStringA(ss.str().c_str());
         assert(ss.str().c_str() && false);
     }
 }
 
-void Model::ParseModelNodes(RenderContext& ctx, const tinygltf::Model& model, const tinygltf::Node& node)
+bool Model::LoadCooked(RenderContext& ctx, const std::string& path)
 {
-    if (node.mesh != -1) // Camera usually
-        ParseGLTFMesh(ctx, model, node, model.meshes[node.mesh]);
-    for (int i : node.children)
+    MappedFile file(GetCookedModelPath(path));
+    if (!file.IsValid() || file.GetSize() < sizeof(CookedModelHeader))
+        return false;
+
+    const byte* data = file.GetData();
+    const CookedModelHeader& header = *reinterpret_cast<const CookedModelHeader*>(data);
+    if (header.Magic != CookedModelMagic || header.Version != CookedModelVersion)
     {
-        ParseModelNodes(ctx, model, model.nodes[i]);
+        LOG("Cooked model ", GetCookedModelPath(path), " is outdated, recooking");
+        return false;
     }
+    if (!IsCookedModelValid(data, file.GetSize()))
+    {
+        LOG("Cooked model ", GetCookedModelPath(path), " is truncated or corrupted, recooking");
+        return false;
+    }
+
+    const CookedMesh* meshes = reinterpret_cast<const CookedMesh*>(data + sizeof(CookedModelHeader));
+    const MeshInstance* instances = reinterpret_cast<const MeshInstance*>(meshes + header.MeshCount);
+    const CookedString* images = reinterpret_cast<const CookedString*>(instances + header.InstanceCount);
+    const CookedString* dependencies = images + header.ImageCount;
+    const char* strings = reinterpret_cast<const char*>(dependencies + header.DependencyCount);
+    auto getString = [strings](const CookedString& str) { return std::string(strings + str.Offset, str.Length); };
+
+    std::vector<std::string> dependencyNames;
+    for (UINT i = 0; i < header.DependencyCount; ++i)
+        dependencyNames.push_back(getString(dependencies[i]));
+    if (HashModelSources(path, dependencyNames) != header.SourceHash || HashLoadOptions(mOptions) != header.OptionsHash)
+    {
+        LOG("Cooked model ", GetCookedModelPath(path), " doesn't match the source, recooking");
+        return false;
+    }
+
+    std::vector<std::string> uris;
+    for (UINT i = 0; i < header.ImageCount; ++i)
+        uris.push_back(getString(images[i]));
+    std::vector<Material> cookedMaterials;
+    for (UINT i = 0; i < header.MeshCount; ++i)
+        cookedMaterials.push_back(meshes[i].MeshMaterial);
+    CreateTextures(ctx, path, uris, GetImageUsages(cookedMaterials, uris.size()));
+    mInstances.assign(instances, instances + header.InstanceCount);
+
+    const byte* payload = data + header.DataOffset;
+    std::vector<const byte*> vertexData;
+    std::vector<const byte*> indexData;
+    for (UINT i = 0; i < header.MeshCount; ++i)
+    {
+        const CookedMesh& cookedMesh = meshes[i];
+        Mesh* mesh = new Mesh{};
+        mMeshes.push_back(mesh);
+        mesh->mVertexCount = cookedMesh.VertexCount;
+        mesh->mIndexCount = cookedMesh.IndexCount;
+        mesh->mVertexLayout = cookedMesh.Layout;
+        mesh->mIndexFormat = cookedMesh.IndexFormat;
+        mesh->mDequantization = cookedMesh.Dequantization;
+
+        // Meshlets are culled on the CPU, so they have to outlive the mapping.
+        const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(payload + cookedMesh.MeshletOffset);
+        const UINT* meshletVertices = reinterpret_cast<const UINT*>(payload + cookedMesh.MeshletVertexOffset);
+        const byte* meshletTriangles = payload + cookedMesh.MeshletTriangleOffset;
+        mesh->mMeshlets.Meshlets.assign(meshlets, meshlets + cookedMesh.MeshletCount);
+        mesh->mMeshlets.Vertices.assign(meshletVertices, meshletVertices + cookedMesh.MeshletVertexCount);
+        mesh->mMeshlets.Triangles.assign(meshletTriangles, meshletTriangles + cookedMesh.MeshletTriangleCount * 3);
+        const MeshLod* lods = reinterpret_cast<const MeshLod*>(payload + cookedMesh.LodOffset);
+        mesh->mLods.assign(lods, lods + cookedMesh.LodCount);
+        mesh->mBoundsCenter = cookedMesh.BoundsCenter;
+        mesh->mBoundsRadius = cookedMesh.BoundsRadius;
+        mesh->mUvDensity = cookedMesh.UvDensity;
+
+        ResolveMaterial(mesh, cookedMesh.MeshMaterial);
+        vertexData.push_back(payload + cookedMesh.VertexOffset);
+        indexData.push_back(payload + cookedMesh.IndexOffset);
+    }
+    CreateMeshBuffers(ctx, vertexData, indexData);
+    return true;
 }
 
-void Model::ParseGLTFMesh(RenderContext& ctx, const tinygltf::Model& model, const tinygltf::Node& node, const tinygltf::Mesh& gltfMesh)
+void Model::WriteCooked(const std::string& path, const std::vector<std::string>& dependencies) const
 {
-    for (size_t i = 0; i < gltfMesh.primitives.size(); ++i)
+    CookedModelHeader header;
+    header.SourceHash = HashModelSources(path, dependencies);
+    header.OptionsHash = HashLoadOptions(mOptions);
+    header.MeshCount = static_cast<UINT>(mMeshes.size());
+    header.InstanceCount = static_cast<UINT>(mInstances.size());
+    header.ImageCount = static_cast<UINT>(mImages.size());
+    header.DependencyCount = static_cast<UINT>(dependencies.size());
+
+    std::string strings;
+    std::vector<CookedString> stringTable;
+    for (const auto& image : mImages)
     {
-        mMeshes.push_back(new Mesh{});
-        Mesh* mesh = mMeshes.back();
+        stringTable.push_back({ static_cast<UINT>(strings.size()), static_cast<UINT>(image.Name.size()) });
+        strings += image.Name;
+    }
+    for (const auto& dependency : dependencies)
+    {
+        stringTable.push_back({ static_cast<UINT>(strings.size()), static_cast<UINT>(dependency.size()) });
+        strings += dependency;
+    }
+    header.StringsSize = static_cast<UINT>(strings.size());
 
-        tinygltf::Primitive primitive = gltfMesh.primitives[i];
+    // Every array starts aligned, so the file offsets follow from the sizes alone.
+    struct DataBlock
+    {
+        const void* Data = nullptr;
+        size_t Size = 0;
+    };
+    std::vector<DataBlock> blocks;
+    size_t dataSize = 0;
+    auto addBlock = [&blocks, &dataSize](const void* data, size_t size)
+    {
+        UINT64 offset = dataSize;
+        blocks.push_back({ data, size });
+        dataSize = AlignOffset(dataSize + size, CookedDataAlignment);
+        return offset;
+    };
+
+    std::vector<CookedMesh> meshes(mMeshes.size());
+    for (size_t i = 0; i < mMeshes.size(); ++i)
+    {
+        const Mesh* mesh = mMeshes[i];
+        const MeshletData& meshlets = mesh->mMeshlets;
+        CookedMesh& cookedMesh = meshes[i];
+        cookedMesh.VertexCount = mesh->mVertexCount;
+        cookedMesh.IndexCount = mesh->mIndexCount;
+        cookedMesh.MeshletCount = static_cast<UINT>(meshlets.Meshlets.size());
+        cookedMesh.MeshletVertexCount = static_cast<UINT>(meshlets.Vertices.size());
+        cookedMesh.MeshletTriangleCount = static_cast<UINT>(meshlets.Triangles.size() / 3);
+        cookedMesh.LodCount = static_cast<UINT>(mesh->mLods.size());
+        cookedMesh.Layout = mesh->mVertexLayout;
+        cookedMesh.IndexFormat = mesh->mIndexFormat;
+        cookedMesh.Dequantization = mesh->mDequantization;
+        cookedMesh.BoundsCenter = mesh->mBoundsCenter;
+        cookedMesh.BoundsRadius = mesh->mBoundsRadius;
+        cookedMesh.UvDensity = mesh->mUvDensity;
+        if (mesh->mMaterialIndex != -1)
+            cookedMesh.MeshMaterial = mMaterials[mesh->mMaterialIndex];
+        if (mesh->mVertexLayout == VertexLayout::Compact)
+            cookedMesh.VertexOffset = addBlock(mesh->mCompactVertices.data(), sizeof(CompactVertex) * mesh->mCompactVertices.size());
+        else
+            cookedMesh.VertexOffset = addBlock(mesh->mVertices.data(), sizeof(Vertex) * mesh->mVertices.size());
+        if (mesh->mIndexFormat == DXGI_FORMAT_R16_UINT)
+            cookedMesh.IndexOffset = addBlock(mesh->mShortIndices.data(), sizeof(UINT16) * mesh->mShortIndices.size());
+        else
+            cookedMesh.IndexOffset = addBlock(mesh->mIndices.data(), sizeof(UINT) * mesh->mIndices.size());
+        cookedMesh.MeshletOffset = addBlock(meshlets.Meshlets.data(), sizeof(Meshlet) * meshlets.Meshlets.size());
+        cookedMesh.MeshletVertexOffset = addBlock(meshlets.Vertices.data(), sizeof(UINT) * meshlets.Vertices.size());
+        cookedMesh.MeshletTriangleOffset = addBlock(meshlets.Triangles.data(), meshlets.Triangles.size());
+        cookedMesh.LodOffset = addBlock(mesh->mLods.data(), sizeof(MeshLod) * mesh->mLods.size());
+    }
 
-        ParseVertices(mesh, model, node, primitive);
-        ParseIndices(mesh, model, primitive);
+    size_t tablesSize = sizeof(CookedModelHeader) + sizeof(CookedMesh) * meshes.size() + sizeof(MeshInstance) * mInstances.size() + sizeof(CookedString) * stringTable.size() + strings.size();
+    header.DataOffset = AlignOffset(tablesSize, CookedDataAlignment);
 
-        mesh->mIndexCount = static_cast<UINT>(mesh->mIndices.size());
+    // Written aside and renamed over the old one, so a crash or a full disk never leaves a truncated file behind
+    std::string cookedPath = GetCookedModelPath(path);
+    std::string tempPath = cookedPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG("Can't write cooked model ", cookedPath);
+            return;
+        }
+
+        const char padding[CookedDataAlignment] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(meshes.data()), sizeof(CookedMesh) * meshes.size());
+        file.write(reinterpret_cast<const char*>(mInstances.data()), sizeof(MeshInstance) * mInstances.size());
+        file.write(reinterpret_cast<const char*>(stringTable.data()), sizeof(CookedString) * stringTable.size());
+        file.write(strings.data(), strings.size());
+        file.write(padding, header.DataOffset - tablesSize);
+        for (const auto& block : blocks)
+        {
+            file.write(reinterpret_cast<const char*>(block.Data), block.Size);
+            file.write(padding, AlignOffset(block.Size, CookedDataAlignment) - block.Size);
+        }
+        if (!file)
+        {
+            LOG("Can't write cooked model ", cookedPath);
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cookedPath, error);
+    if (error)
+    {
+        LOG("Can't replace cooked model ", cookedPath, ": ", error.message());
+        std::filesystem::remove(tempPath, error);
+    }
+}
+
+void Model::CreateTextures(RenderContext& ctx, const std::string& path, const std::vector<std::string>& uris, const std::vector<TextureUsage>& usages)
+{
+    assert(!(mOptions.StreamTextures && mOptions.EvictableTextures) && "Streamed textures have their own budget");
+    std::string dir = GetModelDirectory(path);
+    mTextureDirectory = dir;
+    std::vector<std::string> filenames;
+    for (const auto& uri : uris)
+        filenames.push_back(dir + uri);
+    std::vector<TexResourceData> textures;
+    std::vector<TexturePlacement> placements(filenames.size());
+    if (mOptions.StreamTextures)
+    {
+        textures = ctx.TexManager->CreateStreamedTextures(ctx, filenames, usages, mOptions.Compression);
+        mTextureManager = ctx.TexManager;
+    }
+    else if (mOptions.PackTextures)
+    {
+        textures = ctx.TexManager->CreatePackedTextures(ctx, filenames, placements, usages, mOptions.Compression, mOptions.GenerateMips, mOptions.Packing);
+    }
+    else
+    {
+        textures = ctx.TexManager->CreateTextures(ctx, filenames, usages, mOptions.Compression, mOptions.GenerateMips, mOptions.EvictableTextures);
+        if (mOptions.EvictableTextures)
+            mTextureManager = ctx.TexManager;
+    }
+    for (size_t i = 0; i < uris.size(); ++i)
+    {
+        const float* remap = placements[i].UvScaleOffset;
+        mImages.push_back({ textures[i].SRVOffset, uris[i], XMFLOAT4(remap[0], remap[1], remap[2], remap[3]) });
+    }
+    mTextures.insert(mTextures.end(), textures.begin(), textures.end());
+}
 
-        Material& modelMat = mMaterials[primitive.material];
-        if (modelMat.BaseColorTexture != -1)
-            mesh->mMaterial.BaseColorTexture = mImages[mTextures[modelMat.BaseColorTexture]].IndexInHeap;
-        if (modelMat.MetallicRoughnessTexture != -1)
-            mesh->mMaterial.MetallicRoughnessTexture = mImages[mTextures[modelMat.MetallicRoughnessTexture]].IndexInHeap;
-        if (modelMat.NormalTexture != -1)
-            mesh->mMaterial.NormalTexture = mImages[mTextures[modelMat.NormalTexture]].IndexInHeap;
-        if (modelMat.OcclusionTexture != -1)
-            mesh->mMaterial.OcclusionTexture = mImages[mTextures[modelMat.OcclusionTexture]].IndexInHeap;
-        memcpy(mesh->mMaterial.BaseColorFactor, modelMat.BaseColorFactor, sizeof(float) * 4);
+void Model::ReleaseTextures(TextureManager& textureManager)
+{
+    for (const auto& texture : mTextures)
+        textureManager.ReleaseTexture(texture);
+    mTextures.clear();
+}
 
-        mesh->mVertexBuffer = new VertexBuffer(reinterpret_cast<byte*>(mesh->mVertices.data()), static_cast<UINT>(sizeof(Vertex) * mesh->mVertices.size()), sizeof(Vertex), ctx.CommandList, ctx.Device);
-        mesh->mIndexBuffer = new IndexBuffer(reinterpret_cast<byte*>(mesh->mIndices.data()), static_cast<UINT>(sizeof(UINT) * mesh->mIndices.size()), ctx.CommandList, ctx.Device, DXGI_FORMAT_R32_UINT);
-        mesh->mMaterialBuffer = new UploadBuffer(*ctx.Device, sizeof(Material), true, RenderContext::FramesCount);
+void Model::AddVirtualTextures(RenderContext& ctx, VirtualTextureDX& virtualTexture)
+{
+    mVirtualTextures.assign(mImages.size(), InvalidOffset);
+    for (const auto mesh : mMeshes)
+    {
+        int image = mesh->mImageMaterial.BaseColorTexture;
+        if (image < 0 || mVirtualTextures[image] != InvalidOffset)
+            continue;
+        DecodedImage decoded;
+        std::string filename = mTextureDirectory + mImages[image].Name;
+        if (!ctx.TexManager->ReadImage(filename, decoded, TextureUsage::Color, TextureCompression::None, true, ctx.Workers))
+            continue;
+        if (decoded.Format != virtualTexture.GetFormat())
+        {
+            LOG("Virtual texture skips ", filename, ", it isn't in the format of the physical cache");
+            continue;
+        }
+        mVirtualTextures[image] = virtualTexture.AddTexture(std::move(decoded));
     }
 }
 
-void Model::ParseVertices(Mesh* mesh, const tinygltf::Model& model, const tinygltf::Node& node, const tinygltf::Primitive& primitive)
+void Model::CreateMeshBuffers(RenderContext& ctx, const std::vector<const byte*>& vertices, const std::vector<const byte*>& indices)
 {
-    for (auto& attrib : primitive.attributes)
+    assert(vertices.size() == mMeshes.size() && indices.size() == mMeshes.size());
+    for (auto mesh : mMeshes)
+        mesh->mMaterialBuffer = new UploadBuffer(*ctx.Device, sizeof(MeshConstants), true, RenderContext::FramesCount);
+
+    if (!mOptions.MergeBuffers)
     {
-        tinygltf::Accessor accessor = model.accessors[attrib.second];
-        const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
+        for (size_t i = 0; i < mMeshes.size(); ++i)
+        {
+            Mesh* mesh = mMeshes[i];
+            UINT stride = mesh->GetVertexStride();
+            mesh->mVertexBuffer = new VertexBuffer(vertices[i], stride * mesh->mVertexCount, stride, ctx.CommandList, ctx.Device);
+            mesh->mIndexBuffer = new IndexBuffer(indices[i], mesh->GetIndexStride() * mesh->GetIndexBufferCount(), ctx.CommandList, ctx.Device, mesh->mIndexFormat);
+            mesh->mVertexBufferView = mesh->mVertexBuffer->GetVertexBufferView();
+            mesh->mIndexBufferView = mesh->mIndexBuffer->GetIndexBufferView();
+            mVertexBuffers.push_back(mesh->mVertexBuffer);
+            mIndexBuffers.push_back(mesh->mIndexBuffer);
+        }
+        return;
+    }
 
-        const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-        const byte* bufferData = &model.buffers[bufferView.buffer].data.at(0);
-        const byte* bufferStart = bufferData + bufferView.byteOffset + accessor.byteOffset;
+    GeometryArena arena;
+    for (const auto mesh : mMeshes)
+        arena.Add(mesh->GetVertexStride(), mesh->mVertexCount, mesh->GetIndexStride(), mesh->GetIndexBufferCount());
+    std::vector<byte> vertexData(arena.GetVertexDataSize());
+    std::vector<byte> indexData(arena.GetIndexDataSize());
+    for (UINT i = 0; i < arena.GetRangesCount(); ++i)
+        arena.Write(i, vertices[i], indices[i], vertexData.data(), indexData.data());
+
+    // The views get the stride and the format of the mesh, the buffers themselves don't care.
+    VertexBuffer* vertexBuffer = new VertexBuffer(vertexData.data(), static_cast<UINT>(vertexData.size()), sizeof(Vertex), ctx.CommandList, ctx.Device);
+    IndexBuffer* indexBuffer = new IndexBuffer(indexData.data(), static_cast<UINT>(indexData.size()), ctx.CommandList, ctx.Device, DXGI_FORMAT_R32_UINT);
+    mVertexBuffers.push_back(vertexBuffer);
+    mIndexBuffers.push_back(indexBuffer);
+    for (UINT i = 0; i < arena.GetRangesCount(); ++i)
+    {
+        Mesh* mesh = mMeshes[i];
+        const GeometryRange& range = arena.GetRange(i);
+        mesh->mVertexBuffer = vertexBuffer;
+        mesh->mIndexBuffer = indexBuffer;
+        mesh->mVertexBufferView = vertexBuffer->GetVertexBufferView();
+        mesh->mVertexBufferView.StrideInBytes = range.VertexStride;
+        mesh->mIndexBufferView = indexBuffer->GetIndexBufferView();
+        mesh->mIndexBufferView.Format = mesh->mIndexFormat;
+        mesh->mBaseVertex = range.BaseVertex;
+        mesh->mFirstIndex = range.FirstIndex;
+    }
+}
 
-        size_t elemCount = accessor.count;
-        if (mesh->mVertices.empty())
-            mesh->mVertices.resize(elemCount);
-        assert(mesh->mVertices.size() == elemCount);
+void Model::ResolveMaterial(Mesh* mesh, const Material& material)
+{
+    if (material.BaseColorTexture != -1)
+    {
+        mesh->mMaterial.BaseColorTexture = mImages[material.BaseColorTexture].IndexInHeap;
+        mesh->mTextureRemap.BaseColor = mImages[material.BaseColorTexture].UvScaleOffset;
+    }
+    if (material.MetallicRoughnessTexture != -1)
+    {
+        mesh->mMaterial.MetallicRoughnessTexture = mImages[material.MetallicRoughnessTexture].IndexInHeap;
+        mesh->mTextureRemap.MetallicRoughness = mImages[material.MetallicRoughnessTexture].UvScaleOffset;
+    }
+    if (material.NormalTexture != -1)
+    {
+        mesh->mMaterial.NormalTexture = mImages[material.NormalTexture].IndexInHeap;
+        mesh->mTextureRemap.Normal = mImages[material.NormalTexture].UvScaleOffset;
+    }
+    if (material.OcclusionTexture != -1)
+    {
+        mesh->mMaterial.OcclusionTexture = mImages[material.OcclusionTexture].IndexInHeap;
+        mesh->mTextureRemap.Occlusion = mImages[material.OcclusionTexture].UvScaleOffset;
+    }
+    memcpy(mesh->mMaterial.BaseColorFactor, material.BaseColorFactor, sizeof(float) * 4);
+    mesh->mImageMaterial = material;
+}
 
-        // TODO: don't assume the elem length in the buffer. i.e. UV can be more than 2 floats.
-        //uint32 size = 1;
-        //if (accessor.type != TINYGLTF_TYPE_SCALAR)
-        //    size = accessor.type;
+void Model::ParseModelNodes(const tinygltf::Model& model, int nodeIndex, int parent, std::vector<SceneNode>& nodes)
+{
+    const tinygltf::Node& node = model.nodes[nodeIndex];
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back({ &node, parent });
+    for (int i : node.children)
+    {
+        ParseModelNodes(model, i, index, nodes);
+    }
+}
 
-        UINT byteStride = accessor.ByteStride(bufferView);
-        XMFLOAT3 scale = { 1.0f, 1.0f, 1.0f };
-        if (node.scale.size() == 3)
-            scale = { static_cast<float>(node.scale[0]), static_cast<float>(node.scale[1]), static_cast<float>(node.scale[2]) };
+void Model::CreateInstances(const tinygltf::Model& model, const std::vector<SceneNode>& nodes, std::vector<PrimitiveJob>& jobs)
+{
+    // Parents go first, so one pass over the flat array resolves the whole hierarchy.
+    std::vector<XMMATRIX> transforms(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+        transforms[i] = GetNodeMatrix(*nodes[i].Node);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes[i].Parent != -1)
+            transforms[i] = XMMatrixMultiply(transforms[i], transforms[nodes[i].Parent]);
+    }
 
-        if (attrib.first.compare("POSITION") == 0)
+    // Every glTF mesh is parsed once, however many nodes reference it.
+    constexpr UINT NotParsed = 0xFFFFFFFF;
+    std::vector<UINT> firstJob(model.meshes.size(), NotParsed);
+    UINT firstMesh = static_cast<UINT>(mMeshes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        int meshIndex = nodes[i].Node->mesh;
+        if (meshIndex == -1) // Camera usually
+            continue;
+        const auto& primitives = model.meshes[meshIndex].primitives;
+        if (firstJob[meshIndex] == NotParsed)
         {
-            for (size_t i = 0; i < elemCount; ++i)
-            {
-                float x = GetElementFromBuffer<float>(bufferStart, byteStride, i, 0);
-                float y = GetElementFromBuffer<float>(bufferStart, byteStride, i, 4);
-                float z = GetElementFromBuffer<float>(bufferStart, byteStride, i, 8);
-                mesh->mVertices[i].Pos = { x * scale.x, y * scale.y, z * scale.z }; // For now bake the scale directly in the position
-            }
+            firstJob[meshIndex] = static_cast<UINT>(jobs.size());
+            for (const auto& primitive : primitives)
+                jobs.push_back({ &primitive });
         }
-        else if (attrib.first.compare("NORMAL") == 0)
+        for (UINT p = 0; p < primitives.size(); ++p)
         {
-            for (size_t i = 0; i < elemCount; ++i)
-            {
-                float x = GetElementFromBuffer<float>(bufferStart, byteStride, i, 0);
-                float y = GetElementFromBuffer<float>(bufferStart, byteStride, i, 4);
-                float z = GetElementFromBuffer<float>(bufferStart, byteStride, i, 8);
-                mesh->mVertices[i].Norm = { x, y, z };
-            }
+            MeshInstance instance;
+            instance.MeshIndex = firstMesh + firstJob[meshIndex] + p;
+            XMStoreFloat4x4(&instance.Transform, transforms[i]);
+            mInstances.push_back(instance);
         }
-        else if (attrib.first.compare("TEXCOORD_0") == 0)
+    }
+    LOG("Model has ", jobs.size(), " unique primitives and ", mInstances.size(), " instances");
+}
+
+void Model::ParseGLTFMeshes(RenderContext& ctx, const tinygltf::Model& model, const std::vector<PrimitiveJob>& jobs)
+{
+    size_t firstMesh = mMeshes.size();
+    for (size_t i = 0; i < jobs.size(); ++i)
+        mMeshes.push_back(new Mesh{});
+
+    // CPU side conversion only. Every job writes into its own mesh, so the order of mMeshes stays the node traversal order.
+    std::vector<VertexCacheStats> statsBefore(jobs.size());
+    std::vector<VertexCacheStats> statsAfter(jobs.size());
+    std::vector<float> lodTimes(jobs.size(), 0.0f);
+    auto start = std::chrono::high_resolution_clock::now();
+    ctx.Workers->ParallelFor(jobs.size(), [&](size_t i)
+    {
+        Mesh* mesh = mMeshes[firstMesh + i];
+        GltfPrimitiveGeometry geometry;
+        DecodeGltfPrimitive(model, *jobs[i].Primitive, geometry);
+        mesh->mVertices = std::move(geometry.Vertices);
+        mesh->mIndices = std::move(geometry.Indices);
+        const SourceQuantization& quantization = geometry.Quantization;
+        if (mOptions.OptimizeMeshes)
         {
-            for (size_t i = 0; i < elemCount; ++i)
-            {
-                float u = GetElementFromBuffer<float>(bufferStart, byteStride, i, 0);
-                float v = GetElementFromBuffer<float>(bufferStart, byteStride, i, 4);
-                mesh->mVertices[i].Uv = { u, v };
-            }
+            statsBefore[i] = AnalyzeVertexCache(mesh->mIndices, mesh->mVertices.size());
+            OptimizeMesh(mesh->mVertices, mesh->mIndices);
+            statsAfter[i] = AnalyzeVertexCache(mesh->mIndices, mesh->mVertices.size());
         }
-        else if (attrib.first.compare("TANGENT") == 0)
+        if (mOptions.BuildMeshlets)
+            BuildMeshlets(mesh->mVertices, mesh->mIndices, mesh->mMeshlets);
+        mesh->mIndexCount = static_cast<UINT>(mesh->mIndices.size());
+        mesh->mVertexCount = static_cast<UINT>(mesh->mVertices.size());
+        ComputeBounds(mesh->mVertices, mesh->mBoundsCenter, mesh->mBoundsRadius);
+        mesh->mUvDensity = ComputeUvDensity(mesh->mVertices, mesh->mIndices);
+
+        auto lodStart = std::chrono::high_resolution_clock::now();
+        BuildLods(mesh);
+        lodTimes[i] = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - lodStart).count();
+
+        // Quantized sources are never widened on the GPU side, the compact encoding keeps their grid.
+        bool quantizedSource = quantization.PositionStep[0] > 0.0f;
+        mesh->mVertexLayout = quantizedSource ? VertexLayout::Compact : mOptions.Layout;
+        if (mesh->mVertexLayout == VertexLayout::Compact)
         {
-            for (size_t i = 0; i < elemCount; ++i)
-            {
-                float x = GetElementFromBuffer<float>(bufferStart, byteStride, i, 0);
-                float y = GetElementFromBuffer<float>(bufferStart, byteStride, i, 4);
-                float z = GetElementFromBuffer<float>(bufferStart, byteStride, i, 8);
-                float w = GetElementFromBuffer<float>(bufferStart, byteStride, i, 12);
-                mesh->mVertices[i].Tangent = { x, y, z, w };
-            }
+            EncodeCompactVertices(mesh->mVertices, quantization, mesh->mCompactVertices, mesh->mDequantization);
+            std::vector<Vertex>().swap(mesh->mVertices);
         }
-        else
+        PackIndices(mesh);
+    });
+    auto parseTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    LOG("Parsed ", jobs.size(), " primitives in ", parseTime, " ms on ", ctx.Workers->GetThreadsCount(), " threads, ", GetAccessorDecoderIsaName(), " accessor decoding");
+    if (mOptions.OptimizeMeshes)
+    {
+        VertexCacheStats before;
+        VertexCacheStats after;
+        for (size_t i = 0; i < jobs.size(); ++i)
         {
-            LOG("GLTF Warning: attrib ", attrib.first, " isn't parsed properly\n");
+            before.TrianglesCount += statsBefore[i].TrianglesCount;
+            before.VerticesCount += statsBefore[i].VerticesCount;
+            before.TransformedCount += statsBefore[i].TransformedCount;
+            after.TrianglesCount += statsAfter[i].TrianglesCount;
+            after.VerticesCount += statsAfter[i].VerticesCount;
+            after.TransformedCount += statsAfter[i].TransformedCount;
         }
+        LOG("Mesh optimization ACMR ", before.GetAcmr(), " -> ", after.GetAcmr(), ", ATVR ", before.GetAtvr(), " -> ", after.GetAtvr());
+    }
+    if (mOptions.LodCount > 0)
+    {
+        size_t lodsCount = 0;
+        for (size_t i = 0; i < jobs.size(); ++i)
+            lodsCount += mMeshes[firstMesh + i]->mLods.size() - 1;
+        LOG("Simplified ", lodsCount, " LODs in ", std::accumulate(lodTimes.begin(), lodTimes.end(), 0.0f), " ms of CPU time");
+    }
+
+    std::vector<const byte*> vertices;
+    std::vector<const byte*> indices;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        Mesh* mesh = mMeshes[firstMesh + i];
+        mesh->mMaterialIndex = jobs[i].Primitive->material;
+        if (mesh->mMaterialIndex != -1)
+            ResolveMaterial(mesh, mMaterials[mesh->mMaterialIndex]);
+        vertices.push_back(mesh->mVertexLayout == VertexLayout::Compact ? reinterpret_cast<byte*>(mesh->mCompactVertices.data()) : reinterpret_cast<byte*>(mesh->mVertices.data()));
+        indices.push_back(mesh->mIndexFormat == DXGI_FORMAT_R16_UINT ? reinterpret_cast<byte*>(mesh->mShortIndices.data()) : reinterpret_cast<byte*>(mesh->mIndices.data()));
     }
+    CreateMeshBuffers(ctx, vertices, indices);
 }
 
-void Model::ParseIndices(Mesh* mesh, const tinygltf::Model& model, const tinygltf::Primitive& primitive)
+void Model::BuildLods(Mesh* mesh) const
 {
-    tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
-    mesh->mIndices.reserve(indexAccessor.count);
+    mesh->mLods.push_back({ 0, static_cast<UINT>(mesh->mIndices.size()), 0.0f });
 
-    const tinygltf::BufferView& indexView = model.bufferViews[indexAccessor.bufferView];
-    const byte* bufferData = &model.buffers[indexView.buffer].data.at(0);
-    size_t byteOffset = indexView.byteOffset + indexAccessor.byteOffset;
-    size_t byteLength = indexView.byteLength;
-
-    UINT byteStride = indexAccessor.ByteStride(indexView);
-    const byte* bufferStart = bufferData + byteOffset;
-    assert((indexAccessor.count % 3 == 0) && "GLTF index accessor doesn't represent triangles");
-    if (byteStride == 2)
+    std::vector<UINT> source = mesh->mIndices;
+    std::vector<UINT> lod;
+    for (UINT i = 0; i < mOptions.LodCount; ++i)
     {
-        for (size_t i = 0; i < indexAccessor.count; i ++)
-        {
-            short i0 = GetElementFromBuffer<short>(bufferStart, byteStride, i + 0);
-            mesh->mIndices.push_back(i0);
-        }
+        float error = SimplifyMesh(mesh->mVertices, source, source.size() / 6 * 3, FLT_MAX, lod);
+        // Seams and borders are locked, so the simplifier can get stuck. A LOD that barely differs isn't worth a range.
+        if (lod.empty() || lod.size() > source.size() * 9 / 10)
+            break;
+        if (mOptions.OptimizeMeshes)
+            OptimizeVertexCache(lod, mesh->mVertices.size());
+
+        // Every LOD is simplified from the previous one, errors add up.
+        mesh->mLods.push_back({ static_cast<UINT>(mesh->mIndices.size()), static_cast<UINT>(lod.size()), mesh->mLods.back().Error + error });
+        mesh->mIndices.insert(mesh->mIndices.end(), lod.begin(), lod.end());
+        source.swap(lod);
     }
-    else if (byteStride == 4)
+}
+
+void Model::PackIndices(Mesh* mesh) const
+{
+    // 16-bit indices address up to 65536 vertices, which covers most glTF meshes. The strip cut value isn't used, 0xFFFF is a valid index.
+    if (mesh->mVertexCount > 0x10000)
     {
-        for (size_t i = 0; i < indexAccessor.count; i++)
-        {
-            UINT i0 = GetElementFromBuffer<UINT>(bufferStart, byteStride, i + 0);
-            mesh->mIndices.push_back(i0);
-        }
+        mesh->mIndexFormat = DXGI_FORMAT_R32_UINT;
+        return;
     }
-    else
-        assert(false);
+    mesh->mIndexFormat = DXGI_FORMAT_R16_UINT;
+    mesh->mShortIndices.assign(mesh->mIndices.begin(), mesh->mIndices.end());
+    std::vector<UINT>().swap(mesh->mIndices);
 }
 
 
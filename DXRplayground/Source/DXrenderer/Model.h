@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <d3d12.h>
 #include <DirectXMath.h>
 #include <string>
@@ -7,6 +8,12 @@
 
 #include "Buffers/HeapBuffer.h"
 #include "Buffers/UploadBuffer.h"
+#include "DXrenderer/Geometry/Meshlets.h"
+#include "DXrenderer/Geometry/Simplifier.h"
+#include "DXrenderer/Geometry/Vertex.h"
+#include "DXrenderer/Geometry/VertexLayout.h"
+#include "DXrenderer/Textures/BlockCompression.h"
+#include "DXrenderer/Textures/TexturePacker.h"
 #include "Utils/Helpers.h"
 
 namespace tinygltf
@@ -22,20 +29,15 @@ namespace DirectxPlayground
 using namespace DirectX;
 
 struct RenderContext;
+struct TexResourceData;
 class TextureManager;
-
-struct Vertex
-{
-    XMFLOAT3 Pos;
-    XMFLOAT2 Uv;
-    XMFLOAT3 Norm;
-    XMFLOAT4 Tangent;
-};
+class VirtualTextureDX;
 
 struct Image
 {
     UINT IndexInHeap = 0;
     std::string Name;
+    XMFLOAT4 UvScaleOffset = { 1.0f, 1.0f, 0.0f, 0.0f }; // Rect in its atlas page when packed
 };
 
 struct Material
@@ -47,6 +49,58 @@ struct Material
     float BaseColorFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 };
 
+// Atlas page rects of the material textures, page uv = frac(uv) * xy + zw. Identity for the ones on their own, see TexturePacker.h
+struct MaterialTextureRemap
+{
+    XMFLOAT4 BaseColor = { 1.0f, 1.0f, 0.0f, 0.0f };
+    XMFLOAT4 MetallicRoughness = { 1.0f, 1.0f, 0.0f, 0.0f };
+    XMFLOAT4 Normal = { 1.0f, 1.0f, 0.0f, 0.0f };
+    XMFLOAT4 Occlusion = { 1.0f, 1.0f, 0.0f, 0.0f };
+};
+
+// Per mesh constant buffer, CbMaterial in the shaders
+struct MeshConstants
+{
+    Material MeshMaterial;
+    VertexDequantization Dequantization;
+    MaterialTextureRemap TextureRemap;
+};
+
+struct ModelLoadOptions
+{
+    bool OptimizeMeshes = false; // Vertex cache, overdraw and vertex fetch order, see MeshOptimizer.h
+    bool BuildMeshlets = false; // Clusters for CPU culling, see Meshlets.h
+    UINT LodCount = 0; // Simplified LODs on top of the full mesh, each one halves the triangles. See Simplifier.h
+    VertexLayout Layout = VertexLayout::Float; // Meshes with quantized positions (KHR_mesh_quantization) are always Compact
+    bool MergeBuffers = false; // One vertex and one index buffer for every mesh, see GeometryArena.h
+    TextureCompression Compression = TextureCompression::None; // Block formats picked by the material slot, see BlockCompression.h
+    bool GenerateMips = false; // Full chains built on the CPU, see MipBuilder.h
+    bool StreamTextures = false; // Mip tails first, the rest as RequestTextureMips asks for it. Mips are always built then, see TextureStreamer.h
+    // Demoted or evicted over the budget, the draws call MarkTexturesUsed. Not with StreamTextures, those have their own budget. See TextureResidency.h
+    bool EvictableTextures = false;
+    // Small images share atlas pages, the Pbr shaders remap the uvs. Not with StreamTextures, packed textures stay pinned. See TexturePacker.h
+    bool PackTextures = false;
+    TexturePackingOptions Packing;
+};
+
+// One node referencing a mesh. Nodes that share a glTF mesh share its Model::Mesh and buffers.
+struct MeshInstance
+{
+    UINT MeshIndex = 0;
+    XMFLOAT4X4 Transform = IdentityMatrix; // Node to model space, the whole node hierarchy applied
+};
+
+// GPU memory taken by the geometry of a model, next to what float vertices and 32-bit indices would take.
+struct ModelMemoryStats
+{
+    size_t VertexBytes = 0;
+    size_t IndexBytes = 0;
+    size_t FloatVertexBytes = 0;
+    size_t WideIndexBytes = 0;
+    UINT GeometryBuffersCount = 0; // Each one is a committed resource plus its upload buffer
+    UINT UnmergedGeometryBuffersCount = 0; // With a vertex and an index buffer per mesh
+};
+
 class Model
 {
 public:
@@ -56,38 +110,74 @@ public:
         Mesh() = default;
         ~Mesh()
         {
-            SafeDelete(mIndexBuffer);
-            SafeDelete(mVertexBuffer);
             SafeDelete(mMaterialBuffer);
         }
 
         UINT GetIndexCount() const
         {
-            return UINT(mIndices.size());
+            return mIndexCount;
         }
         UINT GetVertexCount() const
         {
-            return UINT(mVertices.size());
+            return mVertexCount;
+        }
+
+        VertexLayout GetVertexLayout() const
+        {
+            return mVertexLayout;
+        }
+
+        UINT GetVertexStride() const
+        {
+            return DirectxPlayground::GetVertexStride(mVertexLayout);
         }
 
+        DXGI_FORMAT GetIndexFormat() const
+        {
+            return mIndexFormat;
+        }
+
+        UINT GetIndexStride() const
+        {
+            return static_cast<UINT>(mIndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(UINT16) : sizeof(UINT));
+        }
+
+        // Every LOD included
+        UINT GetIndexBufferCount() const
+        {
+            return mLods.back().FirstIndex + mLods.back().IndexCount;
+        }
+
+        // Views cover the whole buffer, which can be shared with other meshes. Draws add GetBaseVertex and GetFirstIndex.
         const D3D12_VERTEX_BUFFER_VIEW& GetVertexBufferView() const
         {
-            return mVertexBuffer->GetVertexBufferView();
+            return mVertexBufferView;
         }
 
         const D3D12_INDEX_BUFFER_VIEW& GetIndexBufferView() const
         {
-            return mIndexBuffer->GetIndexBufferView();
+            return mIndexBufferView;
+        }
+
+        UINT GetBaseVertex() const
+        {
+            return mBaseVertex;
         }
 
+        UINT GetFirstIndex() const
+        {
+            return mFirstIndex;
+        }
+
+        // Start of the mesh data, for consumers without base offsets like BLAS geometry
         D3D12_GPU_VIRTUAL_ADDRESS GetVertexBufferGpuAddress() const
         {
-            return mVertexBuffer->GetVertexBuffer()->GetGPUVirtualAddress();
+            return mVertexBufferView.BufferLocation + UINT64(mBaseVertex) * GetVertexStride();
         }
 
         D3D12_GPU_VIRTUAL_ADDRESS GetIndexBufferGpuAddress() const
         {
-            return mIndexBuffer->GetIndexBuffer()->GetGPUVirtualAddress();
+            return mIndexBufferView.BufferLocation + UINT64(mFirstIndex) * GetIndexStride();
         }
 
         D3D12_GPU_VIRTUAL_ADDRESS GetMaterialBufferGpuAddress(UINT frame) const
@@ -105,27 +195,71 @@ public:
             return mVertexBuffer->GetVertexBuffer();
         }
 
+        const MeshletData& GetMeshlets() const
+        {
+            return mMeshlets;
+        }
+
+        const std::vector<MeshLod>& GetLods() const
+        {
+            return mLods;
+        }
+
+        UINT SelectLod(const XMFLOAT3& viewerPosition, float projectionScale, float maxPixelError = 1.0f) const
+        {
+            XMVECTOR toCenter = XMVectorSubtract(XMLoadFloat3(&mBoundsCenter), XMLoadFloat3(&viewerPosition));
+            float distance = std::max(XMVectorGetX(XMVector3Length(toCenter)) - mBoundsRadius, 0.001f);
+            return DirectxPlayground::SelectLod(mLods, distance, projectionScale, maxPixelError);
+        }
+
+        // UV units per mesh space unit
+        float GetUvDensity() const
+        {
+            return mUvDensity;
+        }
+
         void UpdateMaterialBuffer(UINT frame)
         {
-            mMaterialBuffer->UploadData(frame, mMaterial);
+            mMaterialBuffer->UploadData(frame, MeshConstants{ mMaterial, mDequantization, mTextureRemap });
         }
 
     private:
         friend class Model;
 
         UINT mIndexCount = 0;
+        UINT mVertexCount = 0;
+        int mMaterialIndex = -1;
         Material mMaterial{};
-
-        std::vector<Vertex> mVertices;
-        std::vector<UINT> mIndices;
-
+        Material mImageMaterial{ -1, -1, -1, -1 }; // Texture slots index the model images
+        MaterialTextureRemap mTextureRemap;
+        VertexLayout mVertexLayout = VertexLayout::Float;
+        DXGI_FORMAT mIndexFormat = DXGI_FORMAT_R32_UINT;
+        VertexDequantization mDequantization;
+
+        // Empty when the mesh comes from a cooked file, the buffers are filled straight from the mapped data.
+        std::vector<Vertex> mVertices; // Released once encoded for compact meshes
+        std::vector<CompactVertex> mCompactVertices;
+        std::vector<UINT> mIndices; // Every LOD, the full mesh goes first. Released once packed to 16 bits
+        std::vector<UINT16> mShortIndices;
+
+        MeshletData mMeshlets;
+        std::vector<MeshLod> mLods;
+        XMFLOAT3 mBoundsCenter = {};
+        float mBoundsRadius = 0.0f;
+        float mUvDensity = 0.0f;
+
+        // Owned by the model
         VertexBuffer* mVertexBuffer = nullptr;
         IndexBuffer* mIndexBuffer = nullptr;
+        D3D12_VERTEX_BUFFER_VIEW mVertexBufferView{};
+        D3D12_INDEX_BUFFER_VIEW mIndexBufferView{};
+        UINT mBaseVertex = 0;
+        UINT mFirstIndex = 0;
 
         UploadBuffer* mMaterialBuffer = nullptr;
     };
 
-    Model(RenderContext& ctx, const std::string& path);
+    Model(RenderContext& ctx, const std::string& path, const ModelLoadOptions& options = {});
     Model(RenderContext& ctx, std::vector<Vertex> vertices, std::vector<UINT> indices);
     ~Model();
 
@@ -136,18 +270,57 @@ public:
     const Mesh* GetMesh() const;
 
     const std::vector<Mesh*>& GetMeshes() const;
+    const std::vector<MeshInstance>& GetInstances() const;
+    ModelMemoryStats GetMemoryStats() const;
+    // Streamed and evictable textures get their current views first
     void UpdateMeshes(UINT frame);
+    // Asks for the mips the streamed textures of the mesh need at this distance, weighted by its projected area.
+    // The viewer position is in the mesh space and projectionScale is the one of SelectLod.
+    void RequestTextureMips(TextureManager& textureManager, const Mesh* mesh, const XMFLOAT3& viewerPosition, float projectionScale) const;
+    // Keeps the evictable textures of the mesh resident, for every draw of it
+    void MarkTexturesUsed(TextureManager& textureManager, const Mesh* mesh) const;
+    // Textures are shared with the other models that use the same images, call it before the model is unloaded
+    void ReleaseTextures(TextureManager& textureManager);
+    // Base color images are added to the virtual texture too, uncompressed with their mips. The ones in another format are skipped.
+    void AddVirtualTextures(RenderContext& ctx, VirtualTextureDX& virtualTexture);
+    // Feedback of the mesh for the virtual texture, the mip RequestTextureMips would ask for. Same spaces as RequestTextureMips.
+    void RequestVirtualTiles(VirtualTextureDX& virtualTexture, const Mesh* mesh, const XMFLOAT3& viewerPosition, float projectionScale) const;
 
 private:
-    void LoadModel(const std::string& path, tinygltf::Model& model);
-    void ParseModelNodes(RenderContext& ctx, const tinygltf::Model& model, const tinygltf::Node& node);
-    void ParseGLTFMesh(RenderContext& ctx, const tinygltf::Model& model, const tinygltf::Node& node, const tinygltf::Mesh& mesh);
-    void ParseVertices(Mesh* mesh, const tinygltf::Model& model, const tinygltf::Node& node, const tinygltf::Primitive& primitive);
-    void ParseIndices(Mesh* mesh, const tinygltf::Model& model, const tinygltf::Primitive& primitive);
+    struct PrimitiveJob
+    {
+        const tinygltf::Primitive* Primitive = nullptr;
+    };
 
+    // Flattened hierarchy, a parent always goes before its children
+    struct SceneNode
+    {
+        const tinygltf::Node* Node = nullptr;
+        int Parent = -1;
+    };
+
+    void LoadModel(const std::string& path, tinygltf::Model& model);
+    bool LoadCooked(RenderContext& ctx, const std::string& path);
+    void WriteCooked(const std::string& path, const std::vector<std::string>& dependencies) const;
+    void CreateTextures(RenderContext& ctx, const std::string& path, const std::vector<std::string>& uris, const std::vector<TextureUsage>& usages);
+    void CreateMeshBuffers(RenderContext& ctx, const std::vector<const byte*>& vertices, const std::vector<const byte*>& indices);
+    void ResolveMaterial(Mesh* mesh, const Material& material);
+    void BuildLods(Mesh* mesh) const;
+    void PackIndices(Mesh* mesh) const;
+    void ParseModelNodes(const tinygltf::Model& model, int nodeIndex, int parent, std::vector<SceneNode>& nodes);
+    void CreateInstances(const tinygltf::Model& model, const std::vector<SceneNode>& nodes, std::vector<PrimitiveJob>& jobs);
+    void ParseGLTFMeshes(RenderContext& ctx, const tinygltf::Model& model, const std::vector<PrimitiveJob>& jobs);
+
+    ModelLoadOptions mOptions;
     std::vector<Mesh*> mMeshes;
+    std::vector<MeshInstance> mInstances;
+    std::vector<VertexBuffer*> mVertexBuffers;
+    std::vector<IndexBuffer*> mIndexBuffers;
     std::vector<Image> mImages;
-    std::vector<int> mTextures;
+    std::vector<TexResourceData> mTextures;
+    std::string mTextureDirectory;
+    std::vector<UINT> mVirtualTextures; // By image, InvalidOffset when it isn't in the virtual texture
+    TextureManager* mTextureManager = nullptr; // Set when the views of the textures change, streamed or evictable ones
     std::vector<Material> mMaterials;
 };
 
@@ -175,4 +348,9 @@ inline const std::vector<Model::Mesh*>& Model::GetMeshes() const
 {
     return mMeshes;
 }
+
+inline const std::vector<MeshInstance>& Model::GetInstances() const
+{
+    return mInstances;
+}
 }
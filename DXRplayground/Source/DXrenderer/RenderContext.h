@@ -9,6 +9,7 @@ class TextureManager;
 class PsoManager;
 class IRenderPipeline;
 class ImguiTextureManager;
+class ThreadPool;
 
 struct RenderContext
 {
@@ -33,6 +34,7 @@ struct RenderContext
     TextureManager* TexManager = nullptr;
     ImguiTextureManager* ImguiTexManager = nullptr;
     PsoManager* PsoManager = nullptr;
+    ThreadPool* Workers = nullptr;
 
     IRenderPipeline* Pipeline = nullptr;
 };
@@ -16,6 +16,7 @@
 
 #include "Utils/PixProfiler.h"
 #include "Utils/Logger.h"
+#include "Utils/ThreadPool.h"
 
 namespace DirectxPlayground
 {
@@ -25,6 +26,7 @@ RenderPipeline::~RenderPipeline()
 {
     SafeDelete(mTextureManager);
     SafeDelete(mImguiTextureManager);
+    SafeDelete(mThreadPool);
 }
 
 void RenderPipeline::Init(HWND hwnd, int width, int height, Scene* scene)
@@ -93,6 +95,9 @@ void RenderPipeline::Init(HWND hwnd, int width, int height, Scene* scene)
     mPsoManager = new PsoManager();
     mContext.PsoManager = mPsoManager;
 
+    mThreadPool = new ThreadPool();
+    mContext.Workers = mThreadPool;
+
     mTextureManager = new TextureManager(mContext);
     mContext.TexManager = mTextureManager;
 
@@ -106,7 +111,8 @@ void RenderPipeline::Init(HWND hwnd, int width, int height, Scene* scene)
     mCommandList->Reset(mCommandAllocators[mCurrentAllocatorIdx].Get(), nullptr);
 
     mContext.CommandList = mCommandList.Get();
-    scene->InitResources(mContext);
+    mScene = scene;
+    mScene->InitResources(mContext);
 
     mCommandList->Close();
     ID3D12CommandList* cmdLists[] = { mCommandList.Get() };
@@ -184,6 +190,12 @@ void RenderPipeline::Render(Scene* scene)
 
     ImGui::Begin("Stats", NULL, ImGuiWindowFlags_NoFocusOnAppearing);
     ImGui::Text("Avg %.3f ms/F (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+    TextureResidencyStats residency = mTextureManager->GetResidencyStats();
+    ImGui::Text("Textures: %llu / %llu MB (%llu MB pinned)", residency.ResidentBytes >> 20, residency.Budget >> 20, residency.PinnedBytes >> 20);
+    ImGui::Text("Textures: %u, %u evictable, %u demoted, %u evicted (%llu MB saved)", residency.TexturesCount, residency.EvictableCount,
+        residency.DemotedCount, residency.EvictedCount, residency.SavedBytes >> 20);
+    ImGui::Text("Upload buffers: %llu KB", residency.UploadBytes / 1024);
+    ImGui::Text("Demotions: %llu, evictions: %llu, restores: %llu", residency.Demotions, residency.Evictions, residency.Restores);
     ImGui::End();
 
     IncrementAllocatorIndex();
@@ -194,6 +206,7 @@ void RenderPipeline::Render(Scene* scene)
     mContext.CommandList = mCommandList.Get();
 
     mContext.PsoManager->BeginFrame(mContext);
+    mTextureManager->UpdateResidency();
 
     scene->Render(mContext);
 
@@ -234,6 +247,10 @@ void RenderPipeline::Render(Scene* scene)
 
 void RenderPipeline::Shutdown()
 {
+    if (mContext.Device != nullptr)
+        Flush();
+    if (mScene != nullptr)
+        mScene->ReleaseResources(mContext);
     mPsoManager->Shutdown();
     SafeDelete(mTextureManager); // To dtor to safely delete stuff
     SafeDelete(mPsoManager);
@@ -59,6 +59,8 @@ private:
     Swapchain mSwapChain;
     TextureManager* mTextureManager = nullptr;
     PsoManager* mPsoManager = nullptr;
+    ThreadPool* mThreadPool = nullptr;
+    Scene* mScene = nullptr;
 
     ImguiTextureManager* mImguiTextureManager = nullptr;
 
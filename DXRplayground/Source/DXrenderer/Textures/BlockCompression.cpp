@@ -0,0 +1,1044 @@
+#include "DXrenderer/Textures/BlockCompression.h"
+
+#include "Utils/ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DirectxPlayground
+{
+namespace
+{
+// 16 pixels as INT16 RGBA, channels the format doesn't store are zeroed so they don't count in the distances.
+using BlockColors = INT16[16][4];
+
+constexpr UINT BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Nearest palette entry for every pixel by squared RGBA distance, returns the summed error.
+UINT FindNearest(const BlockColors& pixels, const INT16 (*palette)[4], UINT paletteSize, byte* indices)
+{
+#if defined(BLOCK_COMPRESSION_SSE2)
+    __m128i px[8];
+    for (UINT i = 0; i < 8; ++i)
+        px[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels[i * 2]));
+
+    __m128i best[4];
+    __m128i bestIndex[4];
+    for (UINT g = 0; g < 4; ++g)
+    {
+        best[g] = _mm_set1_epi32(INT_MAX);
+        bestIndex[g] = _mm_setzero_si128();
+    }
+    for (UINT p = 0; p < paletteSize; ++p)
+    {
+        __m128i entry = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette[p]));
+        entry = _mm_unpacklo_epi64(entry, entry);
+        __m128i index = _mm_set1_epi32(p);
+        for (UINT g = 0; g < 4; ++g)
+        {
+            // Two pixels per register, madd leaves RG and BA partial sums that are added pairwise
+            __m128i d0 = _mm_sub_epi16(px[g * 2], entry);
+            __m128i d1 = _mm_sub_epi16(px[g * 2 + 1], entry);
+            __m128 s0 = _mm_castsi128_ps(_mm_madd_epi16(d0, d0));
+            __m128 s1 = _mm_castsi128_ps(_mm_madd_epi16(d1, d1));
+            __m128i distance = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1))));
+            __m128i closer = _mm_cmplt_epi32(distance, best[g]);
+            best[g] = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best[g]));
+            bestIndex[g] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex[g]));
+        }
+    }
+
+    alignas(16) int errors[16];
+    alignas(16) int nearest[16];
+    for (UINT g = 0; g < 4; ++g)
+    {
+        _mm_store_si128(reinterpret_cast<__m128i*>(errors + g * 4), best[g]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(nearest + g * 4), bestIndex[g]);
+    }
+    UINT error = 0;
+    for (UINT i = 0; i < 16; ++i)
+    {
+        error += errors[i];
+        indices[i] = static_cast<byte>(nearest[i]);
+    }
+    return error;
+#else
+    UINT error = 0;
+    for (UINT i = 0; i < 16; ++i)
+    {
+        int best = INT_MAX;
+        for (UINT p = 0; p < paletteSize; ++p)
+        {
+            int distance = 0;
+            for (UINT c = 0; c < 4; ++c)
+            {
+                int d = pixels[i][c] - palette[p][c];
+                distance += d * d;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = static_cast<byte>(p);
+            }
+        }
+        error += best;
+    }
+    return error;
+#endif
+}
+
+// Endpoints along the principal axis of the block colors, extended to the farthest projections.
+void FitPrincipalAxis(const BlockColors& pixels, UINT channels, float* start, float* end, float maxValue = 255.0f)
+{
+    float mean[4] = {};
+    for (UINT i = 0; i < 16; ++i)
+        for (UINT c = 0; c < channels; ++c)
+            mean[c] += pixels[i][c] / 16.0f;
+
+    float covariance[4][4] = {};
+    float axis[4] = {};
+    for (UINT i = 0; i < 16; ++i)
+    {
+        for (UINT a = 0; a < channels; ++a)
+        {
+            float da = pixels[i][a] - mean[a];
+            for (UINT b = 0; b < channels; ++b)
+                covariance[a][b] += da * (pixels[i][b] - mean[b]);
+            axis[a] = std::max(axis[a], std::fabs(da));
+        }
+    }
+    for (UINT iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (UINT a = 0; a < channels; ++a)
+        {
+            for (UINT b = 0; b < channels; ++b)
+                next[a] += covariance[a][b] * axis[b];
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length < 1e-6f)
+            break;
+        for (UINT a = 0; a < channels; ++a)
+            axis[a] = next[a] / length;
+    }
+    float length = 0.0f;
+    for (UINT c = 0; c < channels; ++c)
+        length += axis[c] * axis[c];
+    length = std::sqrt(length);
+
+    float minT = 0.0f;
+    float maxT = 0.0f;
+    if (length > 1e-6f)
+    {
+        for (UINT c = 0; c < channels; ++c)
+            axis[c] /= length;
+        minT = FLT_MAX;
+        maxT = -FLT_MAX;
+        for (UINT i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for (UINT c = 0; c < channels; ++c)
+                t += (pixels[i][c] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+    }
+    for (UINT c = 0; c < channels; ++c)
+    {
+        start[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, maxValue);
+        end[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, maxValue);
+    }
+}
+
+// Least squares endpoints for fixed interpolation weights (0 is start, 1 is end). Returns false for degenerate weights.
+bool RefineEndpoints(const BlockColors& pixels, UINT channels, const float* weights, float* start, float* end, float maxValue = 255.0f)
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = {};
+    float bx[4] = {};
+    for (UINT i = 0; i < 16; ++i)
+    {
+        float b = weights[i];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (UINT c = 0; c < channels; ++c)
+        {
+            ax[c] += a * pixels[i][c];
+            bx[c] += b * pixels[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return false;
+    for (UINT c = 0; c < channels; ++c)
+    {
+        start[c] = std::clamp((bb * ax[c] - ab * bx[c]) / det, 0.0f, maxValue);
+        end[c] = std::clamp((aa * bx[c] - ab * ax[c]) / det, 0.0f, maxValue);
+    }
+    return true;
+}
+
+class BitWriter
+{
+public:
+    BitWriter(byte* data) : mData(data) {}
+
+    void Write(UINT value, UINT bits)
+    {
+        for (UINT i = 0; i < bits; ++i, ++mPosition)
+            mData[mPosition >> 3] |= ((value >> i) & 1) << (mPosition & 7);
+    }
+
+private:
+    byte* mData = nullptr;
+    UINT mPosition = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const byte* data) : mData(data) {}
+
+    UINT Read(UINT bits)
+    {
+        UINT value = 0;
+        for (UINT i = 0; i < bits; ++i, ++mPosition)
+            value |= ((mData[mPosition >> 3] >> (mPosition & 7)) & 1) << i;
+        return value;
+    }
+
+private:
+    const byte* mData = nullptr;
+    UINT mPosition = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// BC1
+//////////////////////////////////////////////////////////////////////////
+
+UINT16 Quantize565(const float* rgb)
+{
+    UINT r = static_cast<UINT>(std::clamp(rgb[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+    UINT g = static_cast<UINT>(std::clamp(rgb[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f));
+    UINT b = static_cast<UINT>(std::clamp(rgb[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+    return static_cast<UINT16>((r << 11) | (g << 5) | b);
+}
+
+void Expand565(UINT16 color, int* rgb)
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four color mode palette, the one BC3 always uses
+void GetBC1Palette(UINT16 c0, UINT16 c1, int (*palette)[3])
+{
+    Expand565(c0, palette[0]);
+    Expand565(c1, palette[1]);
+    for (UINT c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+UINT EvaluateBC1(const BlockColors& pixels, UINT16& c0, UINT16& c1, byte* indices)
+{
+    if (c0 < c1)
+        std::swap(c0, c1);
+    int colors[4][3];
+    GetBC1Palette(c0, c1, colors);
+    INT16 palette[4][4] = {};
+    for (UINT p = 0; p < 4; ++p)
+        for (UINT c = 0; c < 3; ++c)
+            palette[p][c] = static_cast<INT16>(colors[p][c]);
+    // Equal endpoints switch to the three color mode, where only index 0 is still the same color
+    return FindNearest(pixels, palette, c0 == c1 ? 1 : 4, indices);
+}
+
+void EncodeBC1(const BlockColors& pixels, byte* out)
+{
+    float start[3];
+    float end[3];
+    FitPrincipalAxis(pixels, 3, start, end);
+    UINT16 c0 = Quantize565(start);
+    UINT16 c1 = Quantize565(end);
+    // Index 0 is c0 once the four color mode puts the larger endpoint first, start has to follow it for the weights below
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        std::swap(start, end);
+    }
+    byte indices[16];
+    UINT error = EvaluateBC1(pixels, c0, c1, indices);
+
+    constexpr float IndexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float weights[16];
+    for (UINT i = 0; i < 16; ++i)
+        weights[i] = IndexWeights[indices[i]];
+    if (RefineEndpoints(pixels, 3, weights, start, end))
+    {
+        UINT16 r0 = Quantize565(start);
+        UINT16 r1 = Quantize565(end);
+        byte refined[16];
+        UINT refinedError = EvaluateBC1(pixels, r0, r1, refined);
+        if (refinedError < error)
+        {
+            c0 = r0;
+            c1 = r1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    UINT bits = 0;
+    for (UINT i = 0; i < 16; ++i)
+        bits |= UINT(indices[i]) << (i * 2);
+    memcpy(out, &c0, 2);
+    memcpy(out + 2, &c1, 2);
+    memcpy(out + 4, &bits, 4);
+}
+
+void DecodeBC1(const byte* in, bool fourColors, byte (*out)[4])
+{
+    UINT16 c0;
+    UINT16 c1;
+    UINT bits;
+    memcpy(&c0, in, 2);
+    memcpy(&c1, in + 2, 2);
+    memcpy(&bits, in + 4, 4);
+
+    int palette[4][3];
+    GetBC1Palette(c0, c1, palette);
+    bool threeColors = !fourColors && c0 <= c1;
+    if (threeColors)
+    {
+        for (UINT c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    for (UINT i = 0; i < 16; ++i)
+    {
+        UINT index = (bits >> (i * 2)) & 3;
+        for (UINT c = 0; c < 3; ++c)
+            out[i][c] = static_cast<byte>(palette[index][c]);
+        out[i][3] = threeColors && index == 3 ? 0 : 255;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// BC4
+//////////////////////////////////////////////////////////////////////////
+
+void GetBC4Palette(int a0, int a1, int* palette)
+{
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+        for (int k = 2; k < 8; ++k)
+            palette[k] = ((8 - k) * a0 + (k - 1) * a1 + 3) / 7;
+    }
+    else
+    {
+        for (int k = 2; k < 6; ++k)
+            palette[k] = ((6 - k) * a0 + (k - 1) * a1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+void EncodeBC4(const byte* values, byte* out)
+{
+    byte maxValue = *std::max_element(values, values + 16);
+    byte minValue = *std::min_element(values, values + 16);
+    memset(out, 0, 8);
+    out[0] = maxValue;
+    out[1] = minValue;
+    if (maxValue == minValue)
+        return;
+
+    BlockColors pixels = {};
+    for (UINT i = 0; i < 16; ++i)
+        pixels[i][0] = values[i];
+    int levels[8];
+    GetBC4Palette(maxValue, minValue, levels);
+    INT16 palette[8][4] = {};
+    for (UINT p = 0; p < 8; ++p)
+        palette[p][0] = static_cast<INT16>(levels[p]);
+    byte indices[16];
+    FindNearest(pixels, palette, 8, indices);
+
+    UINT64 bits = 0;
+    for (UINT i = 0; i < 16; ++i)
+        bits |= UINT64(indices[i]) << (i * 3);
+    memcpy(out + 2, &bits, 6);
+}
+
+void DecodeBC4(const byte* in, byte (*out)[4], UINT channel)
+{
+    int palette[8];
+    GetBC4Palette(in[0], in[1], palette);
+    UINT64 bits = 0;
+    memcpy(&bits, in + 2, 6);
+    for (UINT i = 0; i < 16; ++i)
+        out[i][channel] = static_cast<byte>(palette[(bits >> (i * 3)) & 7]);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// BC7
+//////////////////////////////////////////////////////////////////////////
+
+struct BC7Mode6
+{
+    UINT Endpoints[2][4] = {}; // 7 bits
+    UINT PBits[2] = {};
+    byte Indices[16] = {};
+    UINT Error = UINT_MAX;
+};
+
+void GetBC7Palette(const BC7Mode6& block, INT16 (*palette)[4])
+{
+    for (UINT c = 0; c < 4; ++c)
+    {
+        int e0 = (block.Endpoints[0][c] << 1) | block.PBits[0];
+        int e1 = (block.Endpoints[1][c] << 1) | block.PBits[1];
+        for (UINT k = 0; k < 16; ++k)
+            palette[k][c] = static_cast<INT16>(((64 - BC7Weights[k]) * e0 + BC7Weights[k] * e1 + 32) >> 6);
+    }
+}
+
+// Tries every p-bit pair for the endpoints and keeps the best one in result
+void EvaluateBC7(const BlockColors& pixels, const float* start, const float* end, BC7Mode6& result)
+{
+    for (UINT p = 0; p < 4; ++p)
+    {
+        BC7Mode6 candidate;
+        candidate.PBits[0] = p & 1;
+        candidate.PBits[1] = p >> 1;
+        for (UINT c = 0; c < 4; ++c)
+        {
+            candidate.Endpoints[0][c] = static_cast<UINT>(std::clamp((start[c] - candidate.PBits[0]) * 0.5f + 0.5f, 0.0f, 127.0f));
+            candidate.Endpoints[1][c] = static_cast<UINT>(std::clamp((end[c] - candidate.PBits[1]) * 0.5f + 0.5f, 0.0f, 127.0f));
+        }
+        INT16 palette[16][4];
+        GetBC7Palette(candidate, palette);
+        candidate.Error = FindNearest(pixels, palette, 16, candidate.Indices);
+        if (candidate.Error < result.Error)
+            result = candidate;
+    }
+}
+
+void EncodeBC7(const BlockColors& pixels, byte* out)
+{
+    float start[4];
+    float end[4];
+    FitPrincipalAxis(pixels, 4, start, end);
+    BC7Mode6 block;
+    EvaluateBC7(pixels, start, end, block);
+
+    float weights[16];
+    for (UINT i = 0; i < 16; ++i)
+        weights[i] = BC7Weights[block.Indices[i]] / 64.0f;
+    if (RefineEndpoints(pixels, 4, weights, start, end))
+        EvaluateBC7(pixels, start, end, block);
+
+    // The anchor index is stored without its top bit
+    if (block.Indices[0] & 8)
+    {
+        std::swap(block.Endpoints[0], block.Endpoints[1]);
+        std::swap(block.PBits[0], block.PBits[1]);
+        for (UINT i = 0; i < 16; ++i)
+            block.Indices[i] = 15 - block.Indices[i];
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer(out);
+    writer.Write(1 << 6, 7);
+    for (UINT c = 0; c < 4; ++c)
+    {
+        writer.Write(block.Endpoints[0][c], 7);
+        writer.Write(block.Endpoints[1][c], 7);
+    }
+    writer.Write(block.PBits[0], 1);
+    writer.Write(block.PBits[1], 1);
+    writer.Write(block.Indices[0], 3);
+    for (UINT i = 1; i < 16; ++i)
+        writer.Write(block.Indices[i], 4);
+}
+
+void DecodeBC7(const byte* in, byte (*out)[4])
+{
+    BitReader reader(in);
+    if (reader.Read(7) != (1 << 6))
+    {
+        assert("Only BC7 mode 6 blocks can be decoded" && false);
+        memset(out, 0, 64);
+        return;
+    }
+    BC7Mode6 block;
+    for (UINT c = 0; c < 4; ++c)
+    {
+        block.Endpoints[0][c] = reader.Read(7);
+        block.Endpoints[1][c] = reader.Read(7);
+    }
+    block.PBits[0] = reader.Read(1);
+    block.PBits[1] = reader.Read(1);
+    block.Indices[0] = static_cast<byte>(reader.Read(3));
+    for (UINT i = 1; i < 16; ++i)
+        block.Indices[i] = static_cast<byte>(reader.Read(4));
+
+    INT16 palette[16][4];
+    GetBC7Palette(block, palette);
+    for (UINT i = 0; i < 16; ++i)
+        for (UINT c = 0; c < 4; ++c)
+            out[i][c] = static_cast<byte>(palette[block.Indices[i]][c]);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// BC6H
+//////////////////////////////////////////////////////////////////////////
+
+// Unsigned single region modes. Blocks are fitted on the half float bit patterns, which are close to logarithmic,
+// the first endpoint keeps EndpointBits and the second one is a signed delta of DeltaBits when the mode is transformed.
+struct BC6HMode
+{
+    UINT Code;
+    UINT EndpointBits;
+    UINT DeltaBits;
+    bool Transformed;
+};
+
+constexpr BC6HMode BC6HModes[] = { { 0x03, 10, 10, false }, { 0x07, 11, 9, true }, { 0x0b, 12, 8, true }, { 0x0f, 16, 4, true } };
+constexpr UINT BC6HMaxHalf = 0x7bff;
+
+struct BC6HBlock
+{
+    UINT Mode = 0;
+    int Endpoints[2][3] = {};
+    byte Indices[16] = {};
+    float Error = FLT_MAX;
+};
+
+// Negative and NaN values are clamped to 0 and infinities to the largest half, the unsigned format has no room for them
+UINT16 FloatToUnsignedHalf(float value)
+{
+    if (!(value > 0.0f))
+        return 0;
+    if (value >= 65504.0f)
+        return BC6HMaxHalf;
+    UINT bits;
+    memcpy(&bits, &value, 4);
+    int exponent = int(bits >> 23) - 127 + 15;
+    UINT mantissa = bits & 0x7fffff;
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return 0;
+        UINT shift = 14 - exponent;
+        return static_cast<UINT16>(((mantissa | 0x800000) + (1 << (shift - 1))) >> shift);
+    }
+    return static_cast<UINT16>(std::min<UINT>((exponent << 10) + ((mantissa + 0x1000) >> 13), BC6HMaxHalf));
+}
+
+float UnsignedHalfToFloat(UINT half)
+{
+    UINT exponent = (half >> 10) & 0x1f;
+    UINT mantissa = half & 0x3ff;
+    return exponent == 0 ? std::ldexp(float(mantissa), -24) : std::ldexp(float(mantissa | 0x400), int(exponent) - 25);
+}
+
+int QuantizeBC6H(float half, UINT bits)
+{
+    // Inverse of the unquantization and the 31/64 scale the decoder applies after the interpolation
+    float unquantized = half * 64.0f / 31.0f;
+    float value = bits >= 15 ? unquantized + 0.5f : unquantized * float(1 << bits) / 65536.0f;
+    return std::clamp(static_cast<int>(value), 0, (1 << bits) - 1);
+}
+
+int UnquantizeBC6H(int value, UINT bits)
+{
+    if (bits >= 15 || value == 0)
+        return value;
+    if (value == (1 << bits) - 1)
+        return 0xffff;
+    return ((value << 16) + 0x8000) >> bits;
+}
+
+void GetBC6HPalette(const BC6HBlock& block, int (*palette)[3])
+{
+    UINT bits = BC6HModes[block.Mode].EndpointBits;
+    for (UINT c = 0; c < 3; ++c)
+    {
+        int e0 = UnquantizeBC6H(block.Endpoints[0][c], bits);
+        int e1 = UnquantizeBC6H(block.Endpoints[1][c], bits);
+        for (UINT k = 0; k < 16; ++k)
+            palette[k][c] = ((((64 - BC7Weights[k]) * e0 + BC7Weights[k] * e1 + 32) >> 6) * 31) >> 6;
+    }
+}
+
+// The squared distances of half bit patterns don't fit the INT16 kernel, so this one is scalar
+float FindNearestBC6H(const BlockColors& pixels, const int (*palette)[3], byte* indices)
+{
+    float error = 0.0f;
+    for (UINT i = 0; i < 16; ++i)
+    {
+        float best = FLT_MAX;
+        for (UINT p = 0; p < 16; ++p)
+        {
+            float distance = 0.0f;
+            for (UINT c = 0; c < 3; ++c)
+            {
+                float d = float(pixels[i][c] - palette[p][c]);
+                distance += d * d;
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = static_cast<byte>(p);
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+void EvaluateBC6H(const BlockColors& pixels, const float* start, const float* end, UINT mode, BC6HBlock& result)
+{
+    const BC6HMode& info = BC6HModes[mode];
+    // Symmetric delta range, so swapping the endpoints for the anchor index never leaves it
+    int maxDelta = (1 << (info.DeltaBits - 1)) - 1;
+    BC6HBlock candidate;
+    candidate.Mode = mode;
+    for (UINT c = 0; c < 3; ++c)
+    {
+        candidate.Endpoints[0][c] = QuantizeBC6H(start[c], info.EndpointBits);
+        candidate.Endpoints[1][c] = QuantizeBC6H(end[c], info.EndpointBits);
+        if (info.Transformed)
+            candidate.Endpoints[1][c] = candidate.Endpoints[0][c] + std::clamp(candidate.Endpoints[1][c] - candidate.Endpoints[0][c], -maxDelta, maxDelta);
+    }
+    int palette[16][3];
+    GetBC6HPalette(candidate, palette);
+    candidate.Error = FindNearestBC6H(pixels, palette, candidate.Indices);
+    if (candidate.Error < result.Error)
+        result = candidate;
+}
+
+// Moves single quantized endpoint channels by one step while that lowers the error
+void PerturbBC6H(const BlockColors& pixels, BC6HBlock& block)
+{
+    const BC6HMode& info = BC6HModes[block.Mode];
+    int maxValue = (1 << info.EndpointBits) - 1;
+    int maxDelta = (1 << (info.DeltaBits - 1)) - 1;
+    bool improved = true;
+    for (UINT pass = 0; pass < 4 && improved; ++pass)
+    {
+        improved = false;
+        for (UINT e = 0; e < 2; ++e)
+        {
+            for (UINT c = 0; c < 3; ++c)
+            {
+                for (int step : { -1, 1 })
+                {
+                    BC6HBlock candidate = block;
+                    int& value = candidate.Endpoints[e][c];
+                    value += step;
+                    int delta = candidate.Endpoints[1][c] - candidate.Endpoints[0][c];
+                    if (value < 0 || value > maxValue || (info.Transformed && std::abs(delta) > maxDelta))
+                        continue;
+                    int palette[16][3];
+                    GetBC6HPalette(candidate, palette);
+                    candidate.Error = FindNearestBC6H(pixels, palette, candidate.Indices);
+                    if (candidate.Error < block.Error)
+                    {
+                        block = candidate;
+                        improved = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void EncodeBC6H(const BlockColors& pixels, bool highQuality, byte* out)
+{
+    float start[3];
+    float end[3];
+    FitPrincipalAxis(pixels, 3, start, end, float(BC6HMaxHalf));
+    // Fast only uses the 10 bit mode, high quality also tries the delta modes, which are more precise on smooth blocks
+    UINT modesCount = highQuality ? UINT(std::size(BC6HModes)) : 1;
+    BC6HBlock block;
+    for (UINT mode = 0; mode < modesCount; ++mode)
+        EvaluateBC6H(pixels, start, end, mode, block);
+
+    for (UINT iteration = 0; iteration < (highQuality ? 3U : 1U); ++iteration)
+    {
+        float weights[16];
+        for (UINT i = 0; i < 16; ++i)
+            weights[i] = BC7Weights[block.Indices[i]] / 64.0f;
+        if (!RefineEndpoints(pixels, 3, weights, start, end, float(BC6HMaxHalf)))
+            break;
+        for (UINT mode = 0; mode < modesCount; ++mode)
+            EvaluateBC6H(pixels, start, end, mode, block);
+    }
+    if (highQuality)
+        PerturbBC6H(pixels, block);
+
+    if (block.Indices[0] & 8)
+    {
+        std::swap(block.Endpoints[0], block.Endpoints[1]);
+        for (UINT i = 0; i < 16; ++i)
+            block.Indices[i] = 15 - block.Indices[i];
+    }
+
+    const BC6HMode& info = BC6HModes[block.Mode];
+    memset(out, 0, 16);
+    BitWriter writer(out);
+    writer.Write(info.Code, 5);
+    for (UINT c = 0; c < 3; ++c)
+        writer.Write(block.Endpoints[0][c] & 0x3ff, 10);
+    for (UINT c = 0; c < 3; ++c)
+    {
+        int second = info.Transformed ? block.Endpoints[1][c] - block.Endpoints[0][c] : block.Endpoints[1][c];
+        writer.Write(UINT(second) & ((1 << info.DeltaBits) - 1), info.DeltaBits);
+        // Endpoint bits above the first 10 follow the delta, most significant first
+        for (UINT bit = info.EndpointBits; bit-- > 10;)
+            writer.Write(UINT(block.Endpoints[0][c] >> bit) & 1, 1);
+    }
+    writer.Write(block.Indices[0], 3);
+    for (UINT i = 1; i < 16; ++i)
+        writer.Write(block.Indices[i], 4);
+}
+
+void DecodeBC6H(const byte* in, float (*out)[4])
+{
+    BitReader reader(in);
+    UINT code = reader.Read(5);
+    BC6HBlock block;
+    block.Mode = UINT(std::find_if(std::begin(BC6HModes), std::end(BC6HModes), [code](const BC6HMode& mode) { return mode.Code == code; }) - std::begin(BC6HModes));
+    if (block.Mode == std::size(BC6HModes))
+    {
+        assert("Only single region BC6H blocks can be decoded" && false);
+        memset(out, 0, 64 * sizeof(float));
+        return;
+    }
+    const BC6HMode& info = BC6HModes[block.Mode];
+    for (UINT c = 0; c < 3; ++c)
+        block.Endpoints[0][c] = reader.Read(10);
+    for (UINT c = 0; c < 3; ++c)
+    {
+        int second = reader.Read(info.DeltaBits);
+        for (UINT bit = info.EndpointBits; bit-- > 10;)
+            block.Endpoints[0][c] |= reader.Read(1) << bit;
+        if (info.Transformed)
+        {
+            int sign = 1 << (info.DeltaBits - 1);
+            second = (second ^ sign) - sign;
+            second = (block.Endpoints[0][c] + second) & ((1 << info.EndpointBits) - 1);
+        }
+        block.Endpoints[1][c] = second;
+    }
+    block.Indices[0] = static_cast<byte>(reader.Read(3));
+    for (UINT i = 1; i < 16; ++i)
+        block.Indices[i] = static_cast<byte>(reader.Read(4));
+
+    int palette[16][3];
+    GetBC6HPalette(block, palette);
+    for (UINT i = 0; i < 16; ++i)
+    {
+        for (UINT c = 0; c < 3; ++c)
+            out[i][c] = UnsignedHalfToFloat(palette[block.Indices[i]][c]);
+        out[i][3] = 1.0f;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void CompressBlock(BlockFormat format, const byte (*rgba)[4], byte* out)
+{
+    BlockColors pixels = {};
+    byte channel[16];
+    switch (format)
+    {
+    case BlockFormat::BC1:
+    case BlockFormat::BC3:
+        for (UINT i = 0; i < 16; ++i)
+            for (UINT c = 0; c < 3; ++c)
+                pixels[i][c] = rgba[i][c];
+        if (format == BlockFormat::BC3)
+        {
+            for (UINT i = 0; i < 16; ++i)
+                channel[i] = rgba[i][3];
+            EncodeBC4(channel, out);
+            out += 8;
+        }
+        EncodeBC1(pixels, out);
+        break;
+    case BlockFormat::BC4:
+    case BlockFormat::BC5:
+        for (UINT i = 0; i < 16; ++i)
+            channel[i] = rgba[i][0];
+        EncodeBC4(channel, out);
+        if (format == BlockFormat::BC5)
+        {
+            for (UINT i = 0; i < 16; ++i)
+                channel[i] = rgba[i][1];
+            EncodeBC4(channel, out + 8);
+        }
+        break;
+    case BlockFormat::BC7:
+        for (UINT i = 0; i < 16; ++i)
+            for (UINT c = 0; c < 4; ++c)
+                pixels[i][c] = rgba[i][c];
+        EncodeBC7(pixels, out);
+        break;
+    case BlockFormat::BC6H:
+        break;
+    }
+}
+
+void DecompressBlock(BlockFormat format, const byte* in, byte (*rgba)[4])
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        DecodeBC1(in, false, rgba);
+        break;
+    case BlockFormat::BC3:
+        DecodeBC1(in + 8, true, rgba);
+        DecodeBC4(in, rgba, 3);
+        break;
+    case BlockFormat::BC4:
+    case BlockFormat::BC5:
+        for (UINT i = 0; i < 16; ++i)
+        {
+            rgba[i][1] = rgba[i][2] = 0;
+            rgba[i][3] = 255;
+        }
+        DecodeBC4(in, rgba, 0);
+        if (format == BlockFormat::BC5)
+            DecodeBC4(in + 8, rgba, 1);
+        break;
+    case BlockFormat::BC7:
+        DecodeBC7(in, rgba);
+        break;
+    case BlockFormat::BC6H:
+        break;
+    }
+}
+
+UINT GetStoredChannels(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return 3;
+    case BlockFormat::BC4:
+        return 1;
+    case BlockFormat::BC5:
+        return 2;
+    default:
+        return 4;
+    }
+}
+}
+
+DXGI_FORMAT GetBlockFormatDxgi(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return DXGI_FORMAT_BC1_UNORM;
+    case BlockFormat::BC3:
+        return DXGI_FORMAT_BC3_UNORM;
+    case BlockFormat::BC4:
+        return DXGI_FORMAT_BC4_UNORM;
+    case BlockFormat::BC5:
+        return DXGI_FORMAT_BC5_UNORM;
+    case BlockFormat::BC6H:
+        return DXGI_FORMAT_BC6H_UF16;
+    default:
+        return DXGI_FORMAT_BC7_UNORM;
+    }
+}
+
+const char* GetBlockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return "BC1";
+    case BlockFormat::BC3:
+        return "BC3";
+    case BlockFormat::BC4:
+        return "BC4";
+    case BlockFormat::BC5:
+        return "BC5";
+    case BlockFormat::BC6H:
+        return "BC6H";
+    default:
+        return "BC7";
+    }
+}
+
+UINT GetBlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t GetCompressedSize(BlockFormat format, UINT width, UINT height)
+{
+    return size_t((width + 3) / 4) * size_t((height + 3) / 4) * GetBlockBytes(format);
+}
+
+void CompressBlocks(BlockFormat format, const byte* rgba, UINT width, UINT height, byte* blocks, ThreadPool* workers)
+{
+    assert(width % 4 == 0 && height % 4 == 0 && "Block compression needs dimensions that are multiples of 4");
+    assert(format != BlockFormat::BC6H && "BC6H is compressed from float pixels");
+    UINT blocksWide = width / 4;
+    UINT blockBytes = GetBlockBytes(format);
+    auto compressRow = [&](size_t row)
+    {
+        byte pixels[16][4];
+        for (UINT bx = 0; bx < blocksWide; ++bx)
+        {
+            for (UINT y = 0; y < 4; ++y)
+                memcpy(pixels[y * 4], rgba + ((row * 4 + y) * width + bx * 4) * 4, 16);
+            CompressBlock(format, pixels, blocks + (row * blocksWide + bx) * blockBytes);
+        }
+    };
+    if (workers != nullptr)
+    {
+        workers->ParallelFor(height / 4, compressRow);
+    }
+    else
+    {
+        for (UINT row = 0; row < height / 4; ++row)
+            compressRow(row);
+    }
+}
+
+void DecompressBlocks(BlockFormat format, const byte* blocks, UINT width, UINT height, byte* rgba)
+{
+    assert(format != BlockFormat::BC6H && "BC6H is decompressed to float pixels");
+    UINT blocksWide = width / 4;
+    UINT blockBytes = GetBlockBytes(format);
+    byte pixels[16][4];
+    for (UINT by = 0; by < height / 4; ++by)
+    {
+        for (UINT bx = 0; bx < blocksWide; ++bx)
+        {
+            DecompressBlock(format, blocks + (size_t(by) * blocksWide + bx) * blockBytes, pixels);
+            for (UINT y = 0; y < 4; ++y)
+                memcpy(rgba + ((size_t(by) * 4 + y) * width + bx * 4) * 4, pixels[y * 4], 16);
+        }
+    }
+}
+
+BlockFormat GetBlockFormat(TextureUsage usage, TextureCompression compression, bool transparent)
+{
+    if (usage == TextureUsage::Normal)
+        return BlockFormat::BC5;
+    if (usage == TextureUsage::Mask)
+        return BlockFormat::BC4;
+    if (compression == TextureCompression::HighQuality)
+        return BlockFormat::BC7;
+    return transparent && usage == TextureUsage::Color ? BlockFormat::BC3 : BlockFormat::BC1;
+}
+
+float ComputeBlockPsnr(BlockFormat format, const byte* reference, const byte* decoded, UINT width, UINT height)
+{
+    UINT channels = GetStoredChannels(format);
+    double error = 0.0;
+    for (size_t i = 0; i < size_t(width) * height; ++i)
+    {
+        for (UINT c = 0; c < channels; ++c)
+        {
+            double d = double(reference[i * 4 + c]) - double(decoded[i * 4 + c]);
+            error += d * d;
+        }
+    }
+    double mse = error / (double(width) * height * channels);
+    return mse > 0.0 ? static_cast<float>(10.0 * std::log10(255.0 * 255.0 / mse)) : 100.0f;
+}
+
+void CompressBlocksBC6H(const float* rgba, UINT width, UINT height, TextureCompression quality, byte* blocks, ThreadPool* workers)
+{
+    assert(width % 4 == 0 && height % 4 == 0 && "Block compression needs dimensions that are multiples of 4");
+    UINT blocksWide = width / 4;
+    bool highQuality = quality == TextureCompression::HighQuality;
+    auto compressRow = [&](size_t row)
+    {
+        BlockColors pixels = {};
+        for (UINT bx = 0; bx < blocksWide; ++bx)
+        {
+            for (UINT i = 0; i < 16; ++i)
+            {
+                const float* pixel = rgba + ((row * 4 + i / 4) * width + bx * 4 + i % 4) * 4;
+                for (UINT c = 0; c < 3; ++c)
+                    pixels[i][c] = static_cast<INT16>(FloatToUnsignedHalf(pixel[c]));
+            }
+            EncodeBC6H(pixels, highQuality, blocks + (row * blocksWide + bx) * 16);
+        }
+    };
+    if (workers != nullptr)
+    {
+        workers->ParallelFor(height / 4, compressRow);
+    }
+    else
+    {
+        for (UINT row = 0; row < height / 4; ++row)
+            compressRow(row);
+    }
+}
+
+void DecompressBlocksBC6H(const byte* blocks, UINT width, UINT height, float* rgba)
+{
+    UINT blocksWide = width / 4;
+    float pixels[16][4];
+    for (UINT by = 0; by < height / 4; ++by)
+    {
+        for (UINT bx = 0; bx < blocksWide; ++bx)
+        {
+            DecodeBC6H(blocks + (size_t(by) * blocksWide + bx) * 16, pixels);
+            for (UINT y = 0; y < 4; ++y)
+                memcpy(rgba + ((size_t(by) * 4 + y) * width + bx * 4) * 4, pixels[y * 4], sizeof(float) * 16);
+        }
+    }
+}
+
+float ComputeLogRmse(const float* reference, const float* decoded, UINT width, UINT height)
+{
+    double error = 0.0;
+    for (size_t i = 0; i < size_t(width) * height; ++i)
+    {
+        for (UINT c = 0; c < 3; ++c)
+        {
+            float value = UnsignedHalfToFloat(FloatToUnsignedHalf(reference[i * 4 + c]));
+            double d = std::log2(1.0 + value) - std::log2(1.0 + std::max(decoded[i * 4 + c], 0.0f));
+            error += d * d;
+        }
+    }
+    return static_cast<float>(std::sqrt(error / (double(width) * height * 3)));
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <d3d12.h>
+
+namespace DirectxPlayground
+{
+class ThreadPool;
+
+enum class BlockFormat : UINT
+{
+    BC1, // RGB
+    BC3, // RGBA, BC1 color and BC4 alpha
+    BC4, // R
+    BC5, // RG
+    BC6H, // Unsigned half float RGB, single region modes only
+    BC7, // RGBA, single subset mode 6 only
+};
+
+DXGI_FORMAT GetBlockFormatDxgi(BlockFormat format);
+const char* GetBlockFormatName(BlockFormat format);
+UINT GetBlockBytes(BlockFormat format);
+size_t GetCompressedSize(BlockFormat format, UINT width, UINT height);
+
+// How a texture is sampled, picks the block format it's compressed to
+enum class TextureUsage : UINT
+{
+    Color, // BC1 or BC3 when fast, BC7 otherwise
+    Normal, // BC5, the shaders rebuild z
+    Mask, // Single channel read from .r, BC4
+    Data, // Linear channels like metallic-roughness with occlusion, alpha unused. BC1 when fast, BC7 otherwise
+};
+
+enum class TextureCompression : UINT
+{
+    None,
+    Fast,
+    HighQuality,
+};
+
+// Transparent color keeps its alpha in BC3 when fast
+BlockFormat GetBlockFormat(TextureUsage usage, TextureCompression compression, bool transparent);
+
+// Source is tightly packed R8G8B8A8, width and height have to be multiples of 4. Block rows are spread over the pool threads.
+void CompressBlocks(BlockFormat format, const byte* rgba, UINT width, UINT height, byte* blocks, ThreadPool* workers);
+void DecompressBlocks(BlockFormat format, const byte* blocks, UINT width, UINT height, byte* rgba);
+
+// Over the channels the format stores, in dB
+float ComputeBlockPsnr(BlockFormat format, const byte* reference, const byte* decoded, UINT width, UINT height);
+
+// Source is tightly packed R32G32B32A32_FLOAT, alpha is dropped and negative values are clamped to 0. Cubemap faces can be
+// passed stacked one under another, blocks never cross them. Fast tries the 10 bit mode only, HighQuality all the single region modes.
+void CompressBlocksBC6H(const float* rgba, UINT width, UINT height, TextureCompression quality, byte* blocks, ThreadPool* workers);
+void DecompressBlocksBC6H(const byte* blocks, UINT width, UINT height, float* rgba);
+
+// RGB error of log2(1 + x), the reference is first rounded to the values BC6H can store
+float ComputeLogRmse(const float* reference, const float* decoded, UINT width, UINT height);
+}
@@ -0,0 +1,454 @@
+#include "DXrenderer/Textures/ContainerParser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+namespace DirectxPlayground
+{
+namespace
+{
+bool Fail(std::string& error, std::string message)
+{
+    error = std::move(message);
+    return false;
+}
+
+// D3D12 resource limits
+constexpr uint32_t MaxDimension = 16384;
+constexpr uint32_t MaxVolumeDimension = 2048;
+constexpr uint32_t MaxArraySize = 2048;
+
+//////////////////////////////////////////////////////////////////////////
+/// DDS
+//////////////////////////////////////////////////////////////////////////
+
+constexpr uint32_t DdsFourCCFlag = 0x4;
+constexpr uint32_t DdsRgbFlag = 0x40;
+constexpr uint32_t DdsAlphaFlag = 0x2;
+constexpr uint32_t DdsLuminanceFlag = 0x20000;
+constexpr uint32_t DdsCubemapFlag = 0x200;
+constexpr uint32_t DdsCubemapAllFaces = 0xfc00;
+constexpr uint32_t DdsVolumeFlag = 0x200000;
+constexpr uint32_t DdsDx10CubeFlag = 0x4;
+
+constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+    return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+struct DdsPixelFormat
+{
+    uint32_t Size;
+    uint32_t Flags;
+    uint32_t FourCC;
+    uint32_t RgbBitCount;
+    uint32_t RMask;
+    uint32_t GMask;
+    uint32_t BMask;
+    uint32_t AMask;
+};
+
+struct DdsHeader
+{
+    uint32_t Size;
+    uint32_t Flags;
+    uint32_t Height;
+    uint32_t Width;
+    uint32_t PitchOrLinearSize;
+    uint32_t Depth;
+    uint32_t MipMapCount;
+    uint32_t Reserved1[11];
+    DdsPixelFormat PixelFormat;
+    uint32_t Caps;
+    uint32_t Caps2;
+    uint32_t Caps3;
+    uint32_t Caps4;
+    uint32_t Reserved2;
+};
+static_assert(sizeof(DdsHeader) == 124, "DDS header layout");
+
+struct DdsHeaderDx10
+{
+    uint32_t DxgiFormat;
+    uint32_t ResourceDimension; // Same values as D3D12_RESOURCE_DIMENSION
+    uint32_t MiscFlag;
+    uint32_t ArraySize;
+    uint32_t MiscFlags2;
+};
+
+// Files written before the DX10 header, only the layouts that have an exact DXGI match
+TextureFormat GetLegacyDdsFormat(const DdsPixelFormat& format)
+{
+    if (format.Flags & DdsFourCCFlag)
+    {
+        switch (format.FourCC)
+        {
+        case MakeFourCC('D', 'X', 'T', '1'):
+            return TextureFormat::BC1_UNORM;
+        case MakeFourCC('D', 'X', 'T', '2'):
+        case MakeFourCC('D', 'X', 'T', '3'):
+            return TextureFormat::BC2_UNORM;
+        case MakeFourCC('D', 'X', 'T', '4'):
+        case MakeFourCC('D', 'X', 'T', '5'):
+            return TextureFormat::BC3_UNORM;
+        case MakeFourCC('A', 'T', 'I', '1'):
+        case MakeFourCC('B', 'C', '4', 'U'):
+            return TextureFormat::BC4_UNORM;
+        case MakeFourCC('B', 'C', '4', 'S'):
+            return TextureFormat::BC4_SNORM;
+        case MakeFourCC('A', 'T', 'I', '2'):
+        case MakeFourCC('B', 'C', '5', 'U'):
+            return TextureFormat::BC5_UNORM;
+        case MakeFourCC('B', 'C', '5', 'S'):
+            return TextureFormat::BC5_SNORM;
+        // D3DFORMAT values stored as the FourCC
+        case 36:
+            return TextureFormat::R16G16B16A16_UNORM;
+        case 110:
+            return TextureFormat::R16G16B16A16_SNORM;
+        case 111:
+            return TextureFormat::R16_FLOAT;
+        case 112:
+            return TextureFormat::R16G16_FLOAT;
+        case 113:
+            return TextureFormat::R16G16B16A16_FLOAT;
+        case 114:
+            return TextureFormat::R32_FLOAT;
+        case 115:
+            return TextureFormat::R32G32_FLOAT;
+        case 116:
+            return TextureFormat::R32G32B32A32_FLOAT;
+        default:
+            return TextureFormat::Unknown;
+        }
+    }
+
+    auto hasMasks = [&format](uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+    {
+        return format.RMask == r && format.GMask == g && format.BMask == b && format.AMask == a;
+    };
+    if ((format.Flags & DdsRgbFlag) && format.RgbBitCount == 32)
+    {
+        if (hasMasks(0xff, 0xff00, 0xff0000, 0xff000000))
+            return TextureFormat::R8G8B8A8_UNORM;
+        if (hasMasks(0xff0000, 0xff00, 0xff, 0xff000000))
+            return TextureFormat::B8G8R8A8_UNORM;
+        if (hasMasks(0xff0000, 0xff00, 0xff, 0))
+            return TextureFormat::B8G8R8X8_UNORM;
+        if (hasMasks(0xffff, 0xffff0000, 0, 0))
+            return TextureFormat::R16G16_UNORM;
+        if (hasMasks(0xffffffff, 0, 0, 0))
+            return TextureFormat::R32_FLOAT;
+        if (hasMasks(0x3ff, 0xffc00, 0x3ff00000, 0xc0000000))
+            return TextureFormat::R10G10B10A2_UNORM;
+    }
+    if ((format.Flags & DdsRgbFlag) && format.RgbBitCount == 16)
+    {
+        if (hasMasks(0xf800, 0x7e0, 0x1f, 0))
+            return TextureFormat::B5G6R5_UNORM;
+        if (hasMasks(0x7c00, 0x3e0, 0x1f, 0x8000))
+            return TextureFormat::B5G5R5A1_UNORM;
+        if (hasMasks(0xf00, 0xf0, 0xf, 0xf000))
+            return TextureFormat::B4G4R4A4_UNORM;
+    }
+    if ((format.Flags & DdsAlphaFlag) && !(format.Flags & DdsRgbFlag) && format.RgbBitCount == 8 && hasMasks(0, 0, 0, 0xff))
+        return TextureFormat::A8_UNORM;
+    if (format.Flags & DdsLuminanceFlag)
+    {
+        if (format.RgbBitCount == 8 && hasMasks(0xff, 0, 0, 0))
+            return TextureFormat::R8_UNORM;
+        if (format.RgbBitCount == 16 && hasMasks(0xffff, 0, 0, 0))
+            return TextureFormat::R16_UNORM;
+        if (format.RgbBitCount == 16 && hasMasks(0xff, 0, 0, 0xff00))
+            return TextureFormat::R8G8_UNORM;
+    }
+    return TextureFormat::Unknown;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// KTX2
+//////////////////////////////////////////////////////////////////////////
+
+constexpr uint8_t Ktx2Identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+struct Ktx2Header
+{
+    uint8_t Identifier[12];
+    uint32_t VkFormat;
+    uint32_t TypeSize;
+    uint32_t PixelWidth;
+    uint32_t PixelHeight; // 0 for 1D textures
+    uint32_t PixelDepth; // 0 for everything but 3D textures
+    uint32_t LayerCount; // 0 if it's not an array
+    uint32_t FaceCount;
+    uint32_t LevelCount; // 0 asks the loader to generate the mips
+    uint32_t SupercompressionScheme;
+    uint32_t DfdByteOffset;
+    uint32_t DfdByteLength;
+    uint32_t KvdByteOffset;
+    uint32_t KvdByteLength;
+    uint64_t SgdByteOffset;
+    uint64_t SgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+struct Ktx2Level
+{
+    uint64_t ByteOffset;
+    uint64_t ByteLength;
+    uint64_t UncompressedByteLength;
+};
+
+struct VkFormatMapping
+{
+    uint32_t VkFormat;
+    TextureFormat Format;
+};
+
+// Vulkan formats that have the same memory layout as a DXGI one
+constexpr VkFormatMapping VkFormats[] = {
+    { 4, TextureFormat::B5G6R5_UNORM }, // R5G6B5_UNORM_PACK16
+    { 8, TextureFormat::B5G5R5A1_UNORM }, // A1R5G5B5_UNORM_PACK16
+    { 9, TextureFormat::R8_UNORM },
+    { 10, TextureFormat::R8_SNORM },
+    { 13, TextureFormat::R8_UINT },
+    { 14, TextureFormat::R8_SINT },
+    { 16, TextureFormat::R8G8_UNORM },
+    { 17, TextureFormat::R8G8_SNORM },
+    { 20, TextureFormat::R8G8_UINT },
+    { 21, TextureFormat::R8G8_SINT },
+    { 37, TextureFormat::R8G8B8A8_UNORM },
+    { 38, TextureFormat::R8G8B8A8_SNORM },
+    { 41, TextureFormat::R8G8B8A8_UINT },
+    { 42, TextureFormat::R8G8B8A8_SINT },
+    { 43, TextureFormat::R8G8B8A8_UNORM_SRGB },
+    { 44, TextureFormat::B8G8R8A8_UNORM },
+    { 50, TextureFormat::B8G8R8A8_UNORM_SRGB },
+    { 64, TextureFormat::R10G10B10A2_UNORM }, // A2B10G10R10_UNORM_PACK32
+    { 68, TextureFormat::R10G10B10A2_UINT }, // A2B10G10R10_UINT_PACK32
+    { 70, TextureFormat::R16_UNORM },
+    { 71, TextureFormat::R16_SNORM },
+    { 74, TextureFormat::R16_UINT },
+    { 75, TextureFormat::R16_SINT },
+    { 76, TextureFormat::R16_FLOAT },
+    { 77, TextureFormat::R16G16_UNORM },
+    { 78, TextureFormat::R16G16_SNORM },
+    { 81, TextureFormat::R16G16_UINT },
+    { 82, TextureFormat::R16G16_SINT },
+    { 83, TextureFormat::R16G16_FLOAT },
+    { 91, TextureFormat::R16G16B16A16_UNORM },
+    { 92, TextureFormat::R16G16B16A16_SNORM },
+    { 95, TextureFormat::R16G16B16A16_UINT },
+    { 96, TextureFormat::R16G16B16A16_SINT },
+    { 97, TextureFormat::R16G16B16A16_FLOAT },
+    { 98, TextureFormat::R32_UINT },
+    { 99, TextureFormat::R32_SINT },
+    { 100, TextureFormat::R32_FLOAT },
+    { 101, TextureFormat::R32G32_UINT },
+    { 102, TextureFormat::R32G32_SINT },
+    { 103, TextureFormat::R32G32_FLOAT },
+    { 104, TextureFormat::R32G32B32_UINT },
+    { 105, TextureFormat::R32G32B32_SINT },
+    { 106, TextureFormat::R32G32B32_FLOAT },
+    { 107, TextureFormat::R32G32B32A32_UINT },
+    { 108, TextureFormat::R32G32B32A32_SINT },
+    { 109, TextureFormat::R32G32B32A32_FLOAT },
+    { 122, TextureFormat::R11G11B10_FLOAT }, // B10G11R11_UFLOAT_PACK32
+    { 123, TextureFormat::R9G9B9E5_SHAREDEXP }, // E5B9G9R9_UFLOAT_PACK32
+    { 124, TextureFormat::D16_UNORM },
+    { 126, TextureFormat::D32_FLOAT },
+    { 131, TextureFormat::BC1_UNORM }, // BC1_RGB, DXGI has no separate opaque variant
+    { 132, TextureFormat::BC1_UNORM_SRGB },
+    { 133, TextureFormat::BC1_UNORM },
+    { 134, TextureFormat::BC1_UNORM_SRGB },
+    { 135, TextureFormat::BC2_UNORM },
+    { 136, TextureFormat::BC2_UNORM_SRGB },
+    { 137, TextureFormat::BC3_UNORM },
+    { 138, TextureFormat::BC3_UNORM_SRGB },
+    { 139, TextureFormat::BC4_UNORM },
+    { 140, TextureFormat::BC4_SNORM },
+    { 141, TextureFormat::BC5_UNORM },
+    { 142, TextureFormat::BC5_SNORM },
+    { 143, TextureFormat::BC6H_UF16 },
+    { 144, TextureFormat::BC6H_SF16 },
+    { 145, TextureFormat::BC7_UNORM },
+    { 146, TextureFormat::BC7_UNORM_SRGB },
+};
+
+TextureFormat GetKtx2Format(uint32_t vkFormat)
+{
+    auto it = std::find_if(std::begin(VkFormats), std::end(VkFormats), [vkFormat](const VkFormatMapping& mapping) { return mapping.VkFormat == vkFormat; });
+    return it != std::end(VkFormats) ? it->Format : TextureFormat::Unknown;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+uint32_t GetFullMipLevelsCount(uint32_t width, uint32_t height, uint32_t depth)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max({ width, height, depth }); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+bool CheckDescription(const ContainerLayout& layout, std::string& error)
+{
+    if (GetFormatRowPitch(layout.Format, 1) == 0)
+        return Fail(error, "format " + std::to_string(uint32_t(layout.Format)) + " isn't supported");
+    bool volume = layout.Dimension == ContainerDimension::Texture3D;
+    uint32_t maxDimension = volume ? MaxVolumeDimension : MaxDimension;
+    bool valid = layout.Width != 0 && layout.Width <= maxDimension && layout.Height <= maxDimension && layout.Depth <= maxDimension
+        && layout.ArraySize != 0 && layout.ArraySize <= MaxArraySize && (!volume || layout.ArraySize == 1)
+        && layout.MipLevels <= GetFullMipLevelsCount(layout.Width, layout.Height, volume ? layout.Depth : 1)
+        && (!layout.Cubemap || (layout.Width == layout.Height && layout.ArraySize % 6 == 0));
+    return valid || Fail(error, "the description is past the D3D12 limits or inconsistent");
+}
+
+// Tightly packed pitches of one subresource, returns its size with every depth slice
+uint64_t GetSubresourceFootprint(const ContainerLayout& layout, uint32_t mip, ContainerSubresource& subresource)
+{
+    uint32_t width = std::max(layout.Width >> mip, 1U);
+    uint32_t height = std::max(layout.Height >> mip, 1U);
+    uint32_t depth = layout.Dimension == ContainerDimension::Texture3D ? std::max(layout.Depth >> mip, 1U) : 1;
+    subresource.RowPitch = GetFormatRowPitch(layout.Format, width);
+    subresource.SlicePitch = subresource.RowPitch * GetFormatRowsCount(layout.Format, height);
+    return subresource.SlicePitch * depth;
+}
+}
+
+bool ParseDdsLayout(const uint8_t* data, size_t size, ContainerLayout& layout, std::string& error)
+{
+    size_t offset = 4 + sizeof(DdsHeader);
+    if (size < offset || memcmp(data, "DDS ", 4) != 0)
+        return Fail(error, "not a DDS file");
+    DdsHeader header;
+    memcpy(&header, data + 4, sizeof(header));
+    if (header.Size != sizeof(DdsHeader) || header.PixelFormat.Size != sizeof(DdsPixelFormat))
+        return Fail(error, "the DDS header sizes are wrong");
+
+    layout.Dimension = ContainerDimension::Texture2D;
+    layout.Width = header.Width;
+    layout.Height = std::max(header.Height, 1U);
+    layout.Depth = 1;
+    layout.ArraySize = 1;
+    layout.MipLevels = std::max(header.MipMapCount, 1U);
+    layout.Cubemap = false;
+    if ((header.PixelFormat.Flags & DdsFourCCFlag) && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+    {
+        if (size < offset + sizeof(DdsHeaderDx10))
+            return Fail(error, "the DX10 header is truncated");
+        DdsHeaderDx10 extension;
+        memcpy(&extension, data + offset, sizeof(extension));
+        offset += sizeof(extension);
+        layout.Format = static_cast<TextureFormat>(extension.DxgiFormat);
+        layout.ArraySize = extension.ArraySize;
+        switch (extension.ResourceDimension)
+        {
+        case uint32_t(ContainerDimension::Texture1D):
+            layout.Dimension = ContainerDimension::Texture1D;
+            layout.Height = 1;
+            break;
+        case uint32_t(ContainerDimension::Texture2D):
+            if (extension.MiscFlag & DdsDx10CubeFlag)
+            {
+                if (layout.ArraySize > MaxArraySize / 6)
+                    return Fail(error, "too many cubes");
+                layout.Cubemap = true;
+                layout.ArraySize *= 6;
+            }
+            break;
+        case uint32_t(ContainerDimension::Texture3D):
+            layout.Dimension = ContainerDimension::Texture3D;
+            layout.Depth = std::max(header.Depth, 1U);
+            break;
+        default:
+            return Fail(error, "unknown resource dimension " + std::to_string(extension.ResourceDimension));
+        }
+    }
+    else
+    {
+        layout.Format = GetLegacyDdsFormat(header.PixelFormat);
+        if (header.Caps2 & DdsCubemapFlag)
+        {
+            // Cubes with missing faces can't be a D3D12 cubemap
+            if ((header.Caps2 & DdsCubemapAllFaces) != DdsCubemapAllFaces)
+                return Fail(error, "the cubemap misses faces");
+            layout.Cubemap = true;
+            layout.ArraySize = 6;
+        }
+        else if (header.Caps2 & DdsVolumeFlag)
+        {
+            layout.Dimension = ContainerDimension::Texture3D;
+            layout.Depth = std::max(header.Depth, 1U);
+        }
+    }
+    if (!CheckDescription(layout, error))
+        return false;
+
+    // Every array slice holds its whole mip chain
+    layout.Subresources.resize(size_t(layout.MipLevels) * layout.ArraySize);
+    for (uint32_t slice = 0; slice < layout.ArraySize; ++slice)
+    {
+        for (uint32_t mip = 0; mip < layout.MipLevels; ++mip)
+        {
+            ContainerSubresource& subresource = layout.Subresources[mip + slice * layout.MipLevels];
+            uint64_t subresourceSize = GetSubresourceFootprint(layout, mip, subresource);
+            if (subresourceSize > size - offset)
+                return Fail(error, "the data is shorter than the footprint");
+            subresource.Offset = offset;
+            offset += static_cast<size_t>(subresourceSize);
+        }
+    }
+    return true;
+}
+
+bool ParseKtx2Layout(const uint8_t* data, size_t size, ContainerLayout& layout, std::string& error)
+{
+    if (size < sizeof(Ktx2Header) || memcmp(data, Ktx2Identifier, sizeof(Ktx2Identifier)) != 0)
+        return Fail(error, "not a KTX2 file");
+    Ktx2Header header;
+    memcpy(&header, data, sizeof(header));
+    if (header.SupercompressionScheme != 0)
+        return Fail(error, "supercompressed KTX2 textures aren't supported");
+    if ((header.FaceCount != 1 && header.FaceCount != 6) || header.LayerCount > MaxArraySize)
+        return Fail(error, "wrong face or layer count");
+
+    layout.Format = GetKtx2Format(header.VkFormat);
+    layout.Dimension = header.PixelHeight == 0 ? ContainerDimension::Texture1D
+        : header.PixelDepth == 0 ? ContainerDimension::Texture2D : ContainerDimension::Texture3D;
+    layout.Width = header.PixelWidth;
+    layout.Height = std::max(header.PixelHeight, 1U);
+    layout.Depth = std::max(header.PixelDepth, 1U);
+    layout.Cubemap = header.FaceCount == 6;
+    layout.ArraySize = std::max(header.LayerCount, 1U) * header.FaceCount;
+    layout.MipLevels = std::max(header.LevelCount, 1U);
+    if (!CheckDescription(layout, error))
+        return false;
+    if (size < sizeof(Ktx2Header) + sizeof(Ktx2Level) * layout.MipLevels)
+        return Fail(error, "the level index is truncated");
+
+    // Every level holds all of its layers and faces, in the same order D3D12 counts the array slices
+    layout.Subresources.resize(size_t(layout.MipLevels) * layout.ArraySize);
+    for (uint32_t mip = 0; mip < layout.MipLevels; ++mip)
+    {
+        Ktx2Level level;
+        memcpy(&level, data + sizeof(Ktx2Header) + sizeof(Ktx2Level) * mip, sizeof(level));
+        if (level.ByteOffset > size || level.ByteLength > size - level.ByteOffset)
+            return Fail(error, "level " + std::to_string(mip) + " is past the end of the file");
+        uint64_t offset = level.ByteOffset;
+        uint64_t end = level.ByteOffset + level.ByteLength;
+        for (uint32_t slice = 0; slice < layout.ArraySize; ++slice)
+        {
+            ContainerSubresource& subresource = layout.Subresources[mip + slice * layout.MipLevels];
+            uint64_t subresourceSize = GetSubresourceFootprint(layout, mip, subresource);
+            if (subresourceSize > end - offset)
+                return Fail(error, "level " + std::to_string(mip) + " is shorter than its footprint");
+            subresource.Offset = offset;
+            offset += subresourceSize;
+        }
+    }
+    return true;
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DXrenderer/Textures/TextureFormat.h"
+
+namespace DirectxPlayground
+{
+// Same values as D3D12_RESOURCE_DIMENSION
+enum class ContainerDimension : uint32_t
+{
+    Texture1D = 2,
+    Texture2D = 3,
+    Texture3D = 4,
+};
+
+// One mip of one array slice, tightly packed
+struct ContainerSubresource
+{
+    uint64_t Offset = 0; // From the start of the data
+    uint64_t RowPitch = 0;
+    uint64_t SlicePitch = 0; // One depth slice
+};
+
+// What a DDS or KTX2 header describes. Subresources are in the D3D12 order (mip + slice * MipLevels).
+struct ContainerLayout
+{
+    ContainerDimension Dimension = ContainerDimension::Texture2D;
+    TextureFormat Format = TextureFormat::Unknown;
+    uint32_t Width = 0;
+    uint32_t Height = 1;
+    uint32_t Depth = 1;
+    uint32_t ArraySize = 1; // Faces included, a multiple of 6 for cubemaps
+    uint32_t MipLevels = 1;
+    bool Cubemap = false;
+    std::vector<ContainerSubresource> Subresources;
+};
+
+// Fail on formats whose footprint isn't known, on descriptions past the D3D12 limits and on data shorter than the footprint.
+// The error says why, the caller logs it. Only the standard library is used, so the parsing is tested on any platform.
+bool ParseDdsLayout(const uint8_t* data, size_t size, ContainerLayout& layout, std::string& error);
+bool ParseKtx2Layout(const uint8_t* data, size_t size, ContainerLayout& layout, std::string& error);
+}
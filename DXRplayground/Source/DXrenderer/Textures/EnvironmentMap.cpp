@@ -1,19 +1,22 @@
 #include "DXrenderer/Textures/EnvironmentMap.h"
 
+#include <chrono>
+
 #include "DXrenderer/Buffers/UploadBuffer.h"
 #include "DXrenderer/Shader.h"
 #include "DXrenderer/PsoManager.h"
 #include "DXrenderer/RenderPipeline.h"
+#include "DXrenderer/Textures/BlockCompression.h"
 #include "Utils/Helpers.h"
 #include "Utils/PixProfiler.h"
 
 namespace DirectxPlayground
 {
 
-EnvironmentMap::EnvironmentMap(RenderContext& ctx, const std::string& path, UINT cubemapSize, UINT irradianceMapSize)
+EnvironmentMap::EnvironmentMap(RenderContext& ctx, const std::string& path, UINT cubemapSize, UINT irradianceMapSize, TextureCompression compression /*= TextureCompression::None*/)
     : mDataBuffer(new UploadBuffer(*ctx.Device, sizeof(mGraphicsData), true, 1))
     , mConvolutionDataBuffer(new UploadBuffer(*ctx.Device, sizeof(mConvolutionData), true, 1)), mCubemapSize(cubemapSize)
-    , mIrradianceMapSize(irradianceMapSize)
+    , mIrradianceMapSize(irradianceMapSize), mCompression(compression)
 {
     CreateRootSig(ctx);
     CreateDescriptorHeap(ctx);
@@ -25,7 +28,10 @@ EnvironmentMap::EnvironmentMap(RenderContext& ctx, const std::string& path, UINT
     shaderPath = ASSETS_DIR_W + std::wstring(L"Shaders//IrradianceMapConvertion.hlsl");
     ctx.PsoManager->CreatePso(ctx, mConvolutionPsoName, shaderPath, desc);
 
-    mEnvMapData = ctx.TexManager->CreateTexture(ctx, path, true);
+    if (compression == TextureCompression::None)
+        mEnvMapData = ctx.TexManager->CreateTexture(ctx, path, true);
+    else
+        mEnvMapData = ctx.TexManager->CreateTextures(ctx, { path }, {}, compression).front();
     mEnvMapData.Resource->SetName(L"EnvEquirectMap");
     mCubemapData = ctx.TexManager->CreateCubemap(ctx, mCubemapSize, DXGI_FORMAT_R32G32B32A32_FLOAT, true);
     mCubemapData.Resource->SetName(L"EnvCubemap");
@@ -47,12 +53,25 @@ EnvironmentMap::EnvironmentMap(RenderContext& ctx, const std::string& path, UINT
 
 EnvironmentMap::~EnvironmentMap()
 {
+    assert(mEnvMapData.Resource == nullptr && "ReleaseTextures wasn't called, the equirect map stays registered");
     SafeDelete(mDataBuffer);
     SafeDelete(mConvolutionDataBuffer);
 }
 
+void EnvironmentMap::ReleaseTextures(TextureManager& textureManager)
+{
+    if (mEnvMapData.Resource != nullptr)
+        textureManager.ReleaseTexture(mEnvMapData);
+    mEnvMapData = {};
+}
+
 void EnvironmentMap::ConvertToCubemap(RenderContext& ctx)
 {
+    if (!mReadbacks.empty())
+        CompressCubemaps(ctx);
+    if (mConverted)
+        return;
+
     GPU_SCOPED_EVENT(ctx, "ConverToCubemap");
     ctx.Pipeline->Flush();
 
@@ -87,7 +106,13 @@ void EnvironmentMap::ConvertToCubemap(RenderContext& ctx)
     barriers[0] = mCubemapData.Resource->GetBarrier(cubeState);
     barriers[1] = mIrradianceMapData.Resource->GetBarrier(irrMapState);
     ctx.CommandList->ResourceBarrier(2U, barriers.data());
+    if (mCompression != TextureCompression::None)
+    {
+        ReadBackCubemap(ctx, mCubemapData, "EnvCubemap");
+        ReadBackCubemap(ctx, mIrradianceMapData, "IrradianceMap");
+    }
     ctx.Pipeline->Flush();
+    mConverted = true;
 }
 
 bool EnvironmentMap::IsConvertedToCubemap() const
@@ -240,4 +265,97 @@ void EnvironmentMap::Convolute(RenderContext& ctx) const
     ctx.CommandList->Dispatch(static_cast<UINT>(mIrradianceMapData.Resource->Get()->GetDesc().Width / 32), static_cast<UINT>(mIrradianceMapData.Resource->Get()->GetDesc().Height / 32), 6);
 }
 
+void EnvironmentMap::ReadBackCubemap(RenderContext& ctx, TexResourceData& cubemap, const std::string& name)
+{
+    CubemapReadback readback;
+    readback.Cubemap = &cubemap;
+    readback.Name = name;
+    D3D12_RESOURCE_DESC desc = cubemap.Resource->Get()->GetDesc();
+    UINT64 size = 0;
+    ctx.Device->GetCopyableFootprints(&desc, 0, 6, 0, readback.Layouts.data(), nullptr, nullptr, &size);
+
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    ThrowIfFailed(ctx.Device->CreateCommittedResource(&heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(readback.Buffer.GetAddressOf())));
+
+    D3D12_RESOURCE_STATES state = cubemap.Resource->GetCurrentState();
+    cubemap.Resource->Transition(ctx.CommandList, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    for (UINT face = 0; face < 6; ++face)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION dst(readback.Buffer.Get(), readback.Layouts[face]);
+        CD3DX12_TEXTURE_COPY_LOCATION src(cubemap.Resource->Get(), face);
+        ctx.CommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+    cubemap.Resource->Transition(ctx.CommandList, state);
+    mReadbacks.push_back(std::move(readback));
+}
+
+// The faces are encoded stacked one under another, the way the encoder takes them
+void EnvironmentMap::CompressCubemaps(RenderContext& ctx)
+{
+    ctx.Pipeline->Flush();
+    for (CubemapReadback& readback : mReadbacks)
+    {
+        const UINT size = readback.Layouts[0].Footprint.Width;
+        const size_t faceBytes = size_t(size) * size * sizeof(float) * 4;
+        assert(size % 4 == 0 && "BC6H cubemap faces have to be made of whole blocks");
+
+        byte* mapped = nullptr;
+        CD3DX12_RANGE readRange(0, static_cast<SIZE_T>(readback.Buffer->GetDesc().Width));
+        ThrowIfFailed(readback.Buffer->Map(0, &readRange, reinterpret_cast<void**>(&mapped)));
+        // Rows and faces are usually tightly packed already, the copy is for the footprints that aren't
+        bool packed = true;
+        for (UINT face = 0; face < 6; ++face)
+            packed &= readback.Layouts[face].Offset == face * faceBytes && readback.Layouts[face].Footprint.RowPitch == size * sizeof(float) * 4;
+        std::vector<byte> gathered;
+        if (!packed)
+        {
+            gathered.resize(faceBytes * 6);
+            for (UINT face = 0; face < 6; ++face)
+            {
+                for (UINT row = 0; row < size; ++row)
+                    memcpy(gathered.data() + face * faceBytes + size_t(row) * size * sizeof(float) * 4,
+                        mapped + readback.Layouts[face].Offset + size_t(row) * readback.Layouts[face].Footprint.RowPitch, size * sizeof(float) * 4);
+            }
+        }
+        const float* pixels = reinterpret_cast<const float*>(packed ? mapped : gathered.data());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<byte> blocks(GetCompressedSize(BlockFormat::BC6H, size, size * 6));
+        CompressBlocksBC6H(pixels, size, size * 6, mCompression, blocks.data(), ctx.Workers);
+#if defined(_DEBUG)
+        auto compressTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::vector<float> decoded(size_t(size) * size * 6 * 4);
+        DecompressBlocksBC6H(blocks.data(), size, size * 6, decoded.data());
+        LOG("Compressed ", readback.Name, " faces to BC6H in ", compressTime, " ms, log2 RMSE ", ComputeLogRmse(pixels, decoded.data(), size, size * 6));
+#endif
+        CD3DX12_RANGE writtenRange(0, 0);
+        readback.Buffer->Unmap(0, &writtenRange);
+
+        TextureContainer container;
+        container.Format = GetBlockFormatDxgi(BlockFormat::BC6H);
+        container.Width = size;
+        container.Height = size;
+        container.ArraySize = 6;
+        container.Cubemap = true;
+        const size_t blockFaceBytes = blocks.size() / 6;
+        for (UINT face = 0; face < 6; ++face)
+        {
+            D3D12_SUBRESOURCE_DATA subresource{};
+            subresource.pData = blocks.data() + face * blockFaceBytes;
+            subresource.RowPitch = static_cast<LONG_PTR>(GetRowPitch(container.Format, size));
+            subresource.SlicePitch = static_cast<LONG_PTR>(blockFaceBytes);
+            container.Subresources.push_back(subresource);
+        }
+        // The upload copies the blocks right away, the float cubemap isn't used after the flush above
+        ctx.TexManager->ReplaceCubemap(ctx, *readback.Cubemap, container, readback.Name + "BC6H");
+    }
+    mReadbacks.clear();
+}
+
 }
\ No newline at end of file
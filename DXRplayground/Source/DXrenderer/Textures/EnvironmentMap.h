@@ -13,11 +13,17 @@ class UploadBuffer;
 class EnvironmentMap
 {
 public:
-    EnvironmentMap(RenderContext& ctx, const std::string& path, UINT cubemapSize, UINT irradianceMapSize);
+    // A compressed source is BC6H without mips, the conversion only reads the top level. An uncompressed one is packed
+    // to RGBA16F, R11G11B10F or RGB9E5 and sampled in whatever format it got. With compression the converted cubemap and
+    // irradiance map are read back and their faces are encoded to BC6H the frame after the conversion.
+    EnvironmentMap(RenderContext& ctx, const std::string& path, UINT cubemapSize, UINT irradianceMapSize, TextureCompression compression = TextureCompression::None);
     ~EnvironmentMap();
 
+    // Converts once, the next call compresses the cubemaps when that was asked for
     void ConvertToCubemap(RenderContext& ctx);
     bool IsConvertedToCubemap() const;
+    // Drops the reference of the equirect source, the GPU has to be done with it
+    void ReleaseTextures(TextureManager& textureManager);
 
 private:
     struct
@@ -33,7 +39,18 @@ private:
     void CreateDescriptorHeap(RenderContext& ctx);
     void CreateViews(RenderContext& ctx) const;
     void Convolute(RenderContext& ctx) const;
-    
+    void ReadBackCubemap(RenderContext& ctx, TexResourceData& cubemap, const std::string& name);
+    void CompressCubemaps(RenderContext& ctx);
+
+    struct CubemapReadback
+    {
+        TexResourceData* Cubemap = nullptr;
+        std::string Name;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+        std::array<D3D12_PLACED_SUBRESOURCE_FOOTPRINT, 6> Layouts{};
+    };
+    std::vector<CubemapReadback> mReadbacks;
+
     TexResourceData mCubemapData;
     TexResourceData mEnvMapData;
     TexResourceData mIrradianceMapData;
@@ -46,6 +63,7 @@ private:
     bool mConverted = false;
     UINT mCubemapSize = 0;
     UINT mIrradianceMapSize = 0;
+    TextureCompression mCompression = TextureCompression::None;
 };
 
 }
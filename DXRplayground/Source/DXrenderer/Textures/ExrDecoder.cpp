@@ -0,0 +1,166 @@
+#include "DXrenderer/Textures/ExrDecoder.h"
+
+#include "Utils/Logger.h"
+#include "Utils/ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#define TINYEXR_USE_THREAD (1)
+#define TINYEXR_IMPLEMENTATION
+#include "External/TinyEXR/tinyexr.h"
+
+namespace DirectxPlayground
+{
+namespace
+{
+// tinyexr structures, freed on scope exit
+struct ExrData
+{
+    EXRHeader Header;
+    EXRImage Image;
+
+    ExrData()
+    {
+        InitEXRHeader(&Header);
+        InitEXRImage(&Image);
+    }
+
+    ~ExrData()
+    {
+        FreeEXRImage(&Image);
+        FreeEXRHeader(&Header);
+    }
+};
+
+// Index of the channel in the default layer, -1 if there's none
+int FindExrChannel(const EXRHeader& header, const char* name)
+{
+    for (int i = 0; i < header.num_channels; ++i)
+    {
+        if (strcmp(header.channels[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Planar float channels to RGBA rows, a missing alpha is 1
+void InterleaveExrRows(const float* const (&channels)[4], size_t srcPitch, UINT width, UINT height, float* dst, size_t dstPitch)
+{
+    for (UINT y = 0; y < height; ++y)
+    {
+        size_t src = y * srcPitch;
+        float* out = dst + y * dstPitch * 4;
+        for (UINT x = 0; x < width; ++x)
+        {
+            out[x * 4 + 0] = channels[0][src + x];
+            out[x * 4 + 1] = channels[1][src + x];
+            out[x * 4 + 2] = channels[2][src + x];
+            out[x * 4 + 3] = channels[3] != nullptr ? channels[3][src + x] : 1.0f;
+        }
+    }
+}
+}
+
+bool DecodeExr(const byte* data, size_t size, std::vector<byte>& pixels, UINT& width, UINT& height, ThreadPool* workers)
+{
+    EXRVersion version;
+    ExrData exr;
+    const char* err = nullptr;
+    int ret = ParseEXRVersionFromMemory(&version, data, size);
+    if (ret == TINYEXR_SUCCESS && (version.multipart || version.non_image))
+    {
+        LOG("EXR decoding error, multipart and deep images aren't supported");
+        return false;
+    }
+    if (ret == TINYEXR_SUCCESS)
+        ret = ParseEXRHeaderFromMemory(&exr.Header, &version, data, size, &err);
+    if (ret == TINYEXR_SUCCESS)
+    {
+        for (int i = 0; i < exr.Header.num_channels; ++i)
+        {
+            if (exr.Header.pixel_types[i] == TINYEXR_PIXELTYPE_HALF)
+                exr.Header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+        }
+        ret = LoadEXRImageFromMemory(&exr.Image, &exr.Header, data, size, &err);
+    }
+    if (ret != TINYEXR_SUCCESS)
+    {
+        LOG("EXR decoding error ", ret, " : ", err != nullptr ? err : "");
+        if (err != nullptr)
+            FreeEXRErrorMessage(err);
+        return false;
+    }
+
+    // A single channel is gray
+    int indices[4] = { FindExrChannel(exr.Header, "R"), FindExrChannel(exr.Header, "G"), FindExrChannel(exr.Header, "B"), FindExrChannel(exr.Header, "A") };
+    if (exr.Header.num_channels == 1)
+        indices[0] = indices[1] = indices[2] = 0;
+    for (UINT c = 0; c < 4; ++c)
+    {
+        if ((indices[c] < 0 && c < 3) || (indices[c] >= 0 && exr.Header.pixel_types[indices[c]] != TINYEXR_PIXELTYPE_FLOAT))
+        {
+            LOG("EXR decoding error, no float R, G and B channels");
+            return false;
+        }
+    }
+    auto getChannels = [&](unsigned char** images, const float* (&channels)[4])
+    {
+        for (UINT c = 0; c < 4; ++c)
+            channels[c] = indices[c] >= 0 ? reinterpret_cast<const float*>(images[indices[c]]) : nullptr;
+    };
+    auto parallelFor = [workers](size_t count, const std::function<void(size_t)>& func)
+    {
+        if (workers != nullptr)
+        {
+            workers->ParallelFor(count, func);
+        }
+        else
+        {
+            for (size_t i = 0; i < count; ++i)
+                func(i);
+        }
+    };
+
+    UINT w = static_cast<UINT>(exr.Image.width);
+    UINT h = static_cast<UINT>(exr.Image.height);
+    pixels.resize(size_t(w) * h * sizeof(float) * 4);
+    float* dst = reinterpret_cast<float*>(pixels.data());
+    if (exr.Header.tiled)
+    {
+        // Only the top level of mipmapped files
+        UINT tileWidth = static_cast<UINT>(exr.Header.tile_size_x);
+        UINT tileHeight = static_cast<UINT>(exr.Header.tile_size_y);
+        parallelFor(static_cast<size_t>(exr.Image.num_tiles), [&](size_t i)
+        {
+            const EXRTile& tile = exr.Image.tiles[i];
+            UINT x = tile.offset_x * tileWidth;
+            UINT y = tile.offset_y * tileHeight;
+            if (x >= w || y >= h)
+                return;
+            const float* channels[4];
+            getChannels(tile.images, channels);
+            InterleaveExrRows(channels, tileWidth, std::min<UINT>(tile.width, w - x), std::min<UINT>(tile.height, h - y), dst + (size_t(y) * w + x) * 4, w);
+        });
+    }
+    else
+    {
+        constexpr UINT BlockRows = 64;
+        const float* channels[4];
+        getChannels(exr.Image.images, channels);
+        parallelFor((h + BlockRows - 1) / BlockRows, [&](size_t block)
+        {
+            size_t y = block * BlockRows;
+            const float* rows[4];
+            for (UINT c = 0; c < 4; ++c)
+                rows[c] = channels[c] != nullptr ? channels[c] + y * w : nullptr;
+            InterleaveExrRows(rows, w, w, std::min<UINT>(BlockRows, h - static_cast<UINT>(y)), dst + y * w * 4, w);
+        });
+    }
+    width = w;
+    height = h;
+    return true;
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+class ThreadPool;
+
+// Decodes the R, G, B and A channels of a single part scanline or tiled EXR to tightly packed R32G32B32A32_FLOAT, only
+// the top level of mipmapped files. A missing alpha is 1, a single channel is gray. tinyexr decompresses the chunks on its
+// own threads and the planar channels it produces are interleaved straight into pixels, spread over the pool threads.
+bool DecodeExr(const byte* data, size_t size, std::vector<byte>& pixels, UINT& width, UINT& height, ThreadPool* workers);
+}
@@ -0,0 +1,480 @@
+#include "DXrenderer/Textures/HdrPacking.h"
+
+#include "Utils/ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#define HDR_PACKING_F16C
+#include <immintrin.h>
+#endif
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HDR_PACKING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DirectxPlayground
+{
+namespace
+{
+constexpr size_t ChunkTexels = 16384; // Multiple of 4, the vector kernels take 4 texels at once
+constexpr size_t ErrorSampleTexels = 65536;
+
+constexpr float MaxHalf = 65504.0f;
+constexpr float MaxFloat11 = 65024.0f;
+constexpr float MaxFloat10 = 64512.0f;
+constexpr float MaxRgb9e5 = 65408.0f;
+constexpr float MinNormalHalf = 6.103515625e-05f; // 2^-14, the smallest normal for all the 5 bit exponent formats
+
+UINT AsUint(float value)
+{
+    UINT bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float AsFloat(UINT bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+float Sanitize(float value, float minValue, float maxValue)
+{
+    return std::isnan(value) ? 0.0f : std::min(std::max(value, minValue), maxValue);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Scalar
+//////////////////////////////////////////////////////////////////////////
+
+// Value is non-negative and inside the format range. 5 bit exponent with a bias of 15, rounds to nearest even, denormals included.
+template<UINT MantissaBits>
+UINT FloatToSmallFloat(float value)
+{
+    if (value < MinNormalHalf)
+    {
+        // Adding the magic number shifts the mantissa right where the denormal one is and rounds it on the way
+        const float magic = AsFloat(((127 - 15) + (23 - MantissaBits) + 1) << 23);
+        return AsUint(value + magic) - AsUint(magic);
+    }
+    UINT bits = AsUint(value);
+    UINT mantissaOdd = (bits >> (23 - MantissaBits)) & 1;
+    bits += UINT(15 - 127) * (1U << 23) + (1U << (22 - MantissaBits)) - 1 + mantissaOdd;
+    return bits >> (23 - MantissaBits);
+}
+
+template<UINT MantissaBits>
+float SmallFloatToFloat(UINT bits)
+{
+    UINT exponent = bits >> MantissaBits;
+    UINT mantissa = bits & ((1U << MantissaBits) - 1);
+    if (exponent == 0)
+        return std::ldexp(float(mantissa), -14 - int(MantissaBits));
+    if (exponent == 31)
+        return mantissa == 0 ? INFINITY : NAN;
+    return AsFloat(((exponent - 15 + 127) << 23) | (mantissa << (23 - MantissaBits)));
+}
+
+USHORT FloatToHalf(float value)
+{
+    value = Sanitize(value, -MaxHalf, MaxHalf);
+    UINT sign = (AsUint(value) >> 16) & 0x8000;
+    return static_cast<USHORT>(sign | FloatToSmallFloat<10>(std::abs(value)));
+}
+
+float HalfToFloat(USHORT bits)
+{
+    float value = SmallFloatToFloat<10>(bits & 0x7fff);
+    return (bits & 0x8000) != 0 ? -value : value;
+}
+
+UINT PackR11G11B10(const float* rgba)
+{
+    UINT r = FloatToSmallFloat<6>(Sanitize(rgba[0], 0.0f, MaxFloat11));
+    UINT g = FloatToSmallFloat<6>(Sanitize(rgba[1], 0.0f, MaxFloat11));
+    UINT b = FloatToSmallFloat<5>(Sanitize(rgba[2], 0.0f, MaxFloat10));
+    return r | (g << 11) | (b << 22);
+}
+
+// Shared exponent as the D3D spec defines it: picked by the largest channel, bumped when its mantissa rounds up to 512
+UINT PackRGB9E5(const float* rgba)
+{
+    float r = Sanitize(rgba[0], 0.0f, MaxRgb9e5);
+    float g = Sanitize(rgba[1], 0.0f, MaxRgb9e5);
+    float b = Sanitize(rgba[2], 0.0f, MaxRgb9e5);
+    float maxChannel = std::max(r, std::max(g, b));
+    int exponent = std::max(int(AsUint(maxChannel) >> 23) - 127, -16) + 16;
+    float scale = AsFloat(UINT(127 + 24 - exponent) << 23); // 2^(15 + 9 - exponent)
+    if (UINT(maxChannel * scale + 0.5f) == 512)
+    {
+        scale *= 0.5f;
+        ++exponent;
+    }
+    return UINT(r * scale + 0.5f) | (UINT(g * scale + 0.5f) << 9) | (UINT(b * scale + 0.5f) << 18) | (UINT(exponent) << 27);
+}
+
+void PackTexelsScalar(HdrFormat format, const float* rgba, size_t count, byte* packed)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* texel = rgba + i * 4;
+        switch (format)
+        {
+        case HdrFormat::Float32:
+            memcpy(packed + i * 16, texel, 16);
+            break;
+        case HdrFormat::Float16:
+        {
+            USHORT halves[4] = { FloatToHalf(texel[0]), FloatToHalf(texel[1]), FloatToHalf(texel[2]), FloatToHalf(texel[3]) };
+            memcpy(packed + i * 8, halves, sizeof(halves));
+            break;
+        }
+        case HdrFormat::R11G11B10:
+        {
+            UINT bits = PackR11G11B10(texel);
+            memcpy(packed + i * 4, &bits, sizeof(bits));
+            break;
+        }
+        case HdrFormat::RGB9E5:
+        {
+            UINT bits = PackRGB9E5(texel);
+            memcpy(packed + i * 4, &bits, sizeof(bits));
+            break;
+        }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Vector
+//////////////////////////////////////////////////////////////////////////
+
+#if defined(HDR_PACKING_SSE2)
+__m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// NaNs go to 0 as max returns its second operand for them
+__m128 Clamp(__m128 value, float maxValue)
+{
+    return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(maxValue));
+}
+
+// Same as the scalar FloatToSmallFloat, both paths computed and selected
+template<int MantissaBits>
+__m128i FloatToSmallFloat(__m128 value)
+{
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(((127 - 15) + (23 - MantissaBits) + 1) << 23));
+    __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, magic)), _mm_castps_si128(magic));
+
+    __m128i bits = _mm_castps_si128(value);
+    __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 23 - MantissaBits), _mm_set1_epi32(1));
+    bits = _mm_add_epi32(bits, _mm_set1_epi32((15 - 127) * (1 << 23) + (1 << (22 - MantissaBits)) - 1));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(bits, mantissaOdd), 23 - MantissaBits);
+
+    __m128i isDenormal = _mm_castps_si128(_mm_cmplt_ps(value, _mm_set1_ps(MinNormalHalf)));
+    return Select(isDenormal, denormal, normal);
+}
+
+#if defined(HDR_PACKING_F16C)
+__m128i FloatToHalf(__m128 value)
+{
+    value = _mm_and_ps(value, _mm_cmpord_ps(value, value));
+    value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-MaxHalf)), _mm_set1_ps(MaxHalf));
+    return _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT);
+}
+#else
+// Halves in the low 16 bits of every lane, sign extended so they can be packed with signed saturation
+__m128i FloatToHalf(__m128 value)
+{
+    value = _mm_and_ps(value, _mm_cmpord_ps(value, value));
+    __m128i sign = _mm_and_si128(_mm_castps_si128(value), _mm_set1_epi32(int(0x80000000)));
+    __m128 absValue = _mm_min_ps(_mm_castsi128_ps(_mm_xor_si128(_mm_castps_si128(value), sign)), _mm_set1_ps(MaxHalf));
+    __m128i half = _mm_or_si128(FloatToSmallFloat<10>(absValue), _mm_srli_epi32(sign, 16));
+    return _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+}
+#endif
+
+void PackFloat16Texels(const float* rgba, size_t count, byte* packed)
+{
+    size_t i = 0;
+#if defined(HDR_PACKING_F16C)
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i halves = _mm_unpacklo_epi64(FloatToHalf(_mm_loadu_ps(rgba + i * 4)), FloatToHalf(_mm_loadu_ps(rgba + i * 4 + 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i * 8), halves);
+    }
+#else
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i halves = _mm_packs_epi32(FloatToHalf(_mm_loadu_ps(rgba + i * 4)), FloatToHalf(_mm_loadu_ps(rgba + i * 4 + 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i * 8), halves);
+    }
+#endif
+    PackTexelsScalar(HdrFormat::Float16, rgba + i * 4, count - i, packed + i * 8);
+}
+
+// Four texels at a time, transposed so every channel gets its own vector
+void PackR11G11B10Texels(const float* rgba, size_t count, byte* packed)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(rgba + i * 4);
+        __m128 g = _mm_loadu_ps(rgba + i * 4 + 4);
+        __m128 b = _mm_loadu_ps(rgba + i * 4 + 8);
+        __m128 a = _mm_loadu_ps(rgba + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        __m128i bits = FloatToSmallFloat<6>(Clamp(r, MaxFloat11));
+        bits = _mm_or_si128(bits, _mm_slli_epi32(FloatToSmallFloat<6>(Clamp(g, MaxFloat11)), 11));
+        bits = _mm_or_si128(bits, _mm_slli_epi32(FloatToSmallFloat<5>(Clamp(b, MaxFloat10)), 22));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i * 4), bits);
+    }
+    PackTexelsScalar(HdrFormat::R11G11B10, rgba + i * 4, count - i, packed + i * 4);
+}
+
+void PackRGB9E5Texels(const float* rgba, size_t count, byte* packed)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 r = _mm_loadu_ps(rgba + i * 4);
+        __m128 g = _mm_loadu_ps(rgba + i * 4 + 4);
+        __m128 b = _mm_loadu_ps(rgba + i * 4 + 8);
+        __m128 a = _mm_loadu_ps(rgba + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        r = Clamp(r, MaxRgb9e5);
+        g = Clamp(g, MaxRgb9e5);
+        b = Clamp(b, MaxRgb9e5);
+        __m128 maxChannel = _mm_max_ps(r, _mm_max_ps(g, b));
+
+        __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxChannel), 23), _mm_set1_epi32(127));
+        exponent = Select(_mm_cmpgt_epi32(exponent, _mm_set1_epi32(-16)), exponent, _mm_set1_epi32(-16));
+        exponent = _mm_add_epi32(exponent, _mm_set1_epi32(16));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 24), exponent), 23));
+
+        __m128i maxMantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxChannel, scale), half));
+        __m128i roundedUp = _mm_cmpeq_epi32(maxMantissa, _mm_set1_epi32(512));
+        scale = _mm_castsi128_ps(Select(roundedUp, _mm_castps_si128(_mm_mul_ps(scale, half)), _mm_castps_si128(scale)));
+        exponent = _mm_sub_epi32(exponent, roundedUp);
+
+        __m128i bits = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+        bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half)), 9));
+        bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half)), 18));
+        bits = _mm_or_si128(bits, _mm_slli_epi32(exponent, 27));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i * 4), bits);
+    }
+    PackTexelsScalar(HdrFormat::RGB9E5, rgba + i * 4, count - i, packed + i * 4);
+}
+#endif
+
+void PackTexels(HdrFormat format, const float* rgba, size_t count, byte* packed)
+{
+#if defined(HDR_PACKING_SSE2)
+    switch (format)
+    {
+    case HdrFormat::Float16:
+        PackFloat16Texels(rgba, count, packed);
+        return;
+    case HdrFormat::R11G11B10:
+        PackR11G11B10Texels(rgba, count, packed);
+        return;
+    case HdrFormat::RGB9E5:
+        PackRGB9E5Texels(rgba, count, packed);
+        return;
+    case HdrFormat::Float32:
+        break;
+    }
+#endif
+    PackTexelsScalar(format, rgba, count, packed);
+}
+}
+
+DXGI_FORMAT GetHdrFormatDxgi(HdrFormat format)
+{
+    switch (format)
+    {
+    case HdrFormat::Float16:
+        return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case HdrFormat::R11G11B10:
+        return DXGI_FORMAT_R11G11B10_FLOAT;
+    case HdrFormat::RGB9E5:
+        return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+    default:
+        return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    }
+}
+
+const char* GetHdrFormatName(HdrFormat format)
+{
+    switch (format)
+    {
+    case HdrFormat::Float16:
+        return "RGBA16F";
+    case HdrFormat::R11G11B10:
+        return "R11G11B10F";
+    case HdrFormat::RGB9E5:
+        return "RGB9E5";
+    default:
+        return "RGBA32F";
+    }
+}
+
+void PackHdr(HdrFormat format, const float* rgba, size_t count, byte* packed, ThreadPool* workers)
+{
+    size_t texelSize = format == HdrFormat::Float32 ? 16 : (format == HdrFormat::Float16 ? 8 : 4);
+    size_t chunksCount = (count + ChunkTexels - 1) / ChunkTexels;
+    auto packChunk = [&](size_t chunk)
+    {
+        size_t first = chunk * ChunkTexels;
+        PackTexels(format, rgba + first * 4, std::min(ChunkTexels, count - first), packed + first * texelSize);
+    };
+    if (workers != nullptr)
+    {
+        workers->ParallelFor(chunksCount, packChunk);
+    }
+    else
+    {
+        for (size_t i = 0; i < chunksCount; ++i)
+            packChunk(i);
+    }
+}
+
+void PackHdrScalar(HdrFormat format, const float* rgba, size_t count, byte* packed)
+{
+    PackTexelsScalar(format, rgba, count, packed);
+}
+
+void UnpackHdr(HdrFormat format, const byte* packed, size_t count, float* rgba)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        float* texel = rgba + i * 4;
+        switch (format)
+        {
+        case HdrFormat::Float32:
+            memcpy(texel, packed + i * 16, 16);
+            break;
+        case HdrFormat::Float16:
+        {
+            USHORT halves[4];
+            memcpy(halves, packed + i * 8, sizeof(halves));
+            for (UINT c = 0; c < 4; ++c)
+                texel[c] = HalfToFloat(halves[c]);
+            break;
+        }
+        case HdrFormat::R11G11B10:
+        {
+            UINT bits;
+            memcpy(&bits, packed + i * 4, sizeof(bits));
+            texel[0] = SmallFloatToFloat<6>(bits & 0x7ff);
+            texel[1] = SmallFloatToFloat<6>((bits >> 11) & 0x7ff);
+            texel[2] = SmallFloatToFloat<5>(bits >> 22);
+            texel[3] = 1.0f;
+            break;
+        }
+        case HdrFormat::RGB9E5:
+        {
+            UINT bits;
+            memcpy(&bits, packed + i * 4, sizeof(bits));
+            int exponent = int(bits >> 27) - 15 - 9;
+            texel[0] = std::ldexp(float(bits & 0x1ff), exponent);
+            texel[1] = std::ldexp(float((bits >> 9) & 0x1ff), exponent);
+            texel[2] = std::ldexp(float((bits >> 18) & 0x1ff), exponent);
+            texel[3] = 1.0f;
+            break;
+        }
+        }
+    }
+}
+
+float ComputeHdrLogRmse(const float* reference, const float* decoded, size_t count)
+{
+    if (count == 0)
+        return 0.0f;
+    double error = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (UINT c = 0; c < 3; ++c)
+        {
+            double d = std::log2(1.0 + std::max(reference[i * 4 + c], 0.0f)) - std::log2(1.0 + std::max(decoded[i * 4 + c], 0.0f));
+            error += d * d;
+        }
+    }
+    return static_cast<float>(std::sqrt(error / (double(count) * 3)));
+}
+
+HdrFormat ChooseHdrFormat(const float* rgba, size_t count, float maxError, float* error /*= nullptr*/)
+{
+    float maxValue = 0.0f;
+    bool negative = false;
+    bool alpha = false;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* texel = rgba + i * 4;
+        for (UINT c = 0; c < 3; ++c)
+        {
+            maxValue = std::max(maxValue, std::abs(texel[c]));
+            negative |= texel[c] < 0.0f;
+        }
+        alpha |= texel[3] != 1.0f;
+    }
+    if (error != nullptr)
+        *error = 0.0f;
+    if (maxValue > MaxHalf)
+        return HdrFormat::Float32;
+
+    // Every texel of small images, evenly spread ones of the rest
+    size_t step = std::max<size_t>(count / ErrorSampleTexels, 1);
+    std::vector<float> sample;
+    sample.reserve((count / step + 1) * 4);
+    for (size_t i = 0; i < count; i += step)
+        sample.insert(sample.end(), rgba + i * 4, rgba + i * 4 + 4);
+    size_t sampleCount = sample.size() / 4;
+
+    std::vector<byte> packed(sampleCount * 8);
+    std::vector<float> decoded(sample.size());
+    auto measure = [&](HdrFormat format)
+    {
+        PackTexels(format, sample.data(), sampleCount, packed.data());
+        UnpackHdr(format, packed.data(), sampleCount, decoded.data());
+        return ComputeHdrLogRmse(sample.data(), decoded.data(), sampleCount);
+    };
+
+    HdrFormat format = HdrFormat::Float16;
+    float formatError = measure(HdrFormat::Float16);
+    if (!negative && !alpha)
+    {
+        float r11g11b10Error = measure(HdrFormat::R11G11B10);
+        float rgb9e5Error = measure(HdrFormat::RGB9E5);
+        float packedError = std::min(r11g11b10Error, rgb9e5Error);
+        if (packedError <= maxError)
+        {
+            format = r11g11b10Error <= rgb9e5Error ? HdrFormat::R11G11B10 : HdrFormat::RGB9E5;
+            formatError = packedError;
+        }
+    }
+    if (error != nullptr)
+        *error = formatError;
+    return format;
+}
+
+const char* GetHdrPackingIsaName()
+{
+#if defined(HDR_PACKING_F16C)
+    return "F16C";
+#elif defined(HDR_PACKING_SSE2)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+}
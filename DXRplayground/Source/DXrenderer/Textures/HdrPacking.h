@@ -0,0 +1,35 @@
+#pragma once
+
+#include <d3d12.h>
+
+namespace DirectxPlayground
+{
+class ThreadPool;
+
+enum class HdrFormat : UINT
+{
+    Float32, // R32G32B32A32_FLOAT, as decoded
+    Float16, // R16G16B16A16_FLOAT, keeps alpha and negative values
+    R11G11B10, // R11G11B10_FLOAT, 6/6/5 bit mantissas, unsigned, no alpha
+    RGB9E5, // R9G9B9E5_SHAREDEXP, 9 bit mantissas sharing one exponent, unsigned, no alpha
+};
+
+DXGI_FORMAT GetHdrFormatDxgi(HdrFormat format);
+const char* GetHdrFormatName(HdrFormat format);
+
+// Source is tightly packed R32G32B32A32_FLOAT, count is in texels. Values are clamped to the range the format stores and
+// rounded to nearest even, NaNs become 0. Chunks of texels are spread over the pool threads.
+void PackHdr(HdrFormat format, const float* rgba, size_t count, byte* packed, ThreadPool* workers);
+// Reference for the vector kernels, same results bit for bit
+void PackHdrScalar(HdrFormat format, const float* rgba, size_t count, byte* packed);
+void UnpackHdr(HdrFormat format, const byte* packed, size_t count, float* rgba);
+
+// RGB error of log2(1 + x), alpha isn't counted
+float ComputeHdrLogRmse(const float* reference, const float* decoded, size_t count);
+
+// Smallest format that keeps the alpha, the sign and the range of the texels and whose error on a sample of them stays
+// under maxError. Falls back to Float16, or to Float32 for values past the half float range.
+HdrFormat ChooseHdrFormat(const float* rgba, size_t count, float maxError, float* error = nullptr);
+
+const char* GetHdrPackingIsaName();
+}
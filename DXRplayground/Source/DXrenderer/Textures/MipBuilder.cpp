@@ -0,0 +1,358 @@
+#include "DXrenderer/Textures/MipBuilder.h"
+
+#include "DXrenderer/Textures/TextureCache.h"
+#include "Utils/ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_BUILDER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DirectxPlayground
+{
+namespace
+{
+// Source texels and their weights for every destination texel along one axis, indices are already clamped to the edges
+struct AxisFilter
+{
+    struct Taps
+    {
+        UINT Offset = 0;
+        UINT Count = 0;
+    };
+    std::vector<Taps> Texels;
+    std::vector<UINT> Indices;
+    std::vector<float> Weights;
+
+    void Normalize(UINT offset, float sum);
+};
+
+void AxisFilter::Normalize(UINT offset, float sum)
+{
+    for (size_t i = offset; i < Weights.size(); ++i)
+        Weights[i] /= sum;
+}
+
+AxisFilter CreateBoxFilter(UINT srcSize, UINT dstSize)
+{
+    // Every destination texel averages the source area it covers, so an odd size splits the middle texels between neighbours
+    AxisFilter filter;
+    float scale = float(srcSize) / float(dstSize);
+    for (UINT i = 0; i < dstSize; ++i)
+    {
+        float begin = i * scale;
+        float end = (i + 1) * scale;
+        AxisFilter::Taps taps;
+        taps.Offset = static_cast<UINT>(filter.Weights.size());
+        for (UINT j = static_cast<UINT>(begin); j < srcSize && float(j) < end; ++j)
+        {
+            float weight = std::min(end, float(j + 1)) - std::max(begin, float(j));
+            if (weight <= 0.0f)
+                continue;
+            filter.Indices.push_back(j);
+            filter.Weights.push_back(weight);
+        }
+        taps.Count = static_cast<UINT>(filter.Weights.size()) - taps.Offset;
+        filter.Normalize(taps.Offset, scale);
+        filter.Texels.push_back(taps);
+    }
+    return filter;
+}
+
+float BesselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (UINT k = 1; k < 16; ++k)
+    {
+        term *= (x * 0.5f / k) * (x * 0.5f / k);
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr float KaiserRadius = 3.0f;
+
+AxisFilter CreateKaiserFilter(UINT srcSize, UINT dstSize)
+{
+    constexpr float Radius = KaiserRadius;
+    constexpr float Alpha = 4.0f;
+    constexpr float Pi = 3.14159265358979f;
+    AxisFilter filter;
+    float scale = float(srcSize) / float(dstSize);
+    float windowScale = 1.0f / BesselI0(Alpha);
+    for (UINT i = 0; i < dstSize; ++i)
+    {
+        float center = (i + 0.5f) * scale;
+        int first = static_cast<int>(std::floor(center - Radius * scale));
+        int last = static_cast<int>(std::ceil(center + Radius * scale));
+        AxisFilter::Taps taps;
+        taps.Offset = static_cast<UINT>(filter.Weights.size());
+        float sum = 0.0f;
+        for (int j = first; j <= last; ++j)
+        {
+            float x = (j + 0.5f - center) / scale;
+            if (std::fabs(x) >= Radius)
+                continue;
+            float sinc = x == 0.0f ? 1.0f : std::sin(Pi * x) / (Pi * x);
+            float t = x / Radius;
+            float weight = sinc * BesselI0(Alpha * std::sqrt(1.0f - t * t)) * windowScale;
+            if (weight == 0.0f)
+                continue;
+            filter.Indices.push_back(static_cast<UINT>(std::clamp(j, 0, int(srcSize) - 1)));
+            filter.Weights.push_back(weight);
+            sum += weight;
+        }
+        taps.Count = static_cast<UINT>(filter.Weights.size()) - taps.Offset;
+        filter.Normalize(taps.Offset, sum);
+        filter.Texels.push_back(taps);
+    }
+    return filter;
+}
+
+AxisFilter CreateAxisFilter(MipFilter filter, UINT srcSize, UINT dstSize)
+{
+    // Once the kernel covers the whole axis the clamped edges outweigh the texels, the box filter takes over there
+    if (filter == MipFilter::Kaiser && dstSize > 2 * KaiserRadius)
+        return CreateKaiserFilter(srcSize, dstSize);
+    return CreateBoxFilter(srcSize, dstSize);
+}
+
+// One RGBA row resampled horizontally
+void FilterRow(const float* src, const AxisFilter& filter, float* dst)
+{
+    for (size_t x = 0; x < filter.Texels.size(); ++x)
+    {
+        const AxisFilter::Taps& taps = filter.Texels[x];
+        const UINT* indices = filter.Indices.data() + taps.Offset;
+        const float* weights = filter.Weights.data() + taps.Offset;
+#if defined(MIP_BUILDER_SSE2)
+        __m128 sum = _mm_setzero_ps();
+        for (UINT k = 0; k < taps.Count; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(src + size_t(indices[k]) * 4)));
+        _mm_storeu_ps(dst + x * 4, sum);
+#else
+        float sum[4] = {};
+        for (UINT k = 0; k < taps.Count; ++k)
+            for (UINT c = 0; c < 4; ++c)
+                sum[c] += weights[k] * src[size_t(indices[k]) * 4 + c];
+        memcpy(dst + x * 4, sum, sizeof(sum));
+#endif
+    }
+}
+
+// dst += weight * src over a whole row, the vertical pass
+void AccumulateRow(const float* src, float weight, size_t count, float* dst)
+{
+    size_t i = 0;
+#if defined(MIP_BUILDER_SSE2)
+    __m128 w = _mm_set1_ps(weight);
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(w, _mm_loadu_ps(src + i + 4))));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] += weight * src[i];
+}
+
+void ParallelRows(ThreadPool* workers, size_t count, const std::function<void(size_t)>& func)
+{
+    if (workers != nullptr)
+    {
+        workers->ParallelFor(count, func);
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+    }
+}
+
+float SrgbToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+std::vector<float> ReadPixels(const DecodedImage& image, bool srgb)
+{
+    size_t count = size_t(image.Width) * image.Height * 4;
+    std::vector<float> pixels(count);
+    if (image.Format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+    {
+        memcpy(pixels.data(), image.Data.data(), count * sizeof(float));
+        return pixels;
+    }
+    float table[256];
+    for (UINT i = 0; i < 256; ++i)
+        table[i] = srgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+    for (size_t i = 0; i < count; ++i)
+        pixels[i] = (i & 3) == 3 ? image.Data[i] / 255.0f : table[image.Data[i]];
+    return pixels;
+}
+
+void WritePixels(const std::vector<float>& pixels, DXGI_FORMAT format, bool srgb, std::vector<byte>& data)
+{
+    size_t offset = data.size();
+    if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+    {
+        data.resize(offset + pixels.size() * sizeof(float));
+        memcpy(data.data() + offset, pixels.data(), pixels.size() * sizeof(float));
+        return;
+    }
+    data.resize(offset + pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        float value = std::clamp(pixels[i], 0.0f, 1.0f);
+        if (srgb && (i & 3) != 3)
+            value = LinearToSrgb(value);
+        data[offset + i] = static_cast<byte>(value * 255.0f + 0.5f);
+    }
+}
+
+float GetAlphaCoverage(const std::vector<float>& pixels, float cutoff, float scale)
+{
+    size_t passed = 0;
+    for (size_t i = 3; i < pixels.size(); i += 4)
+        passed += pixels[i] * scale >= cutoff ? 1 : 0;
+    return float(passed) / float(pixels.size() / 4);
+}
+
+// Filtering smooths alpha towards the mean, so alpha tested foliage thins out or grows with distance without this
+void ScaleAlphaToCoverage(std::vector<float>& pixels, float cutoff, float coverage)
+{
+    float low = 0.0f;
+    float high = 4.0f;
+    for (UINT i = 0; i < 16; ++i)
+    {
+        float middle = (low + high) * 0.5f;
+        if (GetAlphaCoverage(pixels, cutoff, middle) < coverage)
+            low = middle;
+        else
+            high = middle;
+    }
+    // Coverage is a step function of the scale, take whichever bound lands closer
+    float lowError = std::fabs(GetAlphaCoverage(pixels, cutoff, low) - coverage);
+    float highError = std::fabs(GetAlphaCoverage(pixels, cutoff, high) - coverage);
+    float scale = lowError < highError ? low : high;
+    for (size_t i = 3; i < pixels.size(); i += 4)
+        pixels[i] = std::min(pixels[i] * scale, 1.0f);
+}
+
+void FinishLevel(std::vector<float>& pixels, const MipBuildOptions& options)
+{
+    // The Kaiser filter rings below zero next to sharp edges
+    for (float& value : pixels)
+        value = std::max(value, 0.0f);
+    if (!options.NormalMap)
+        return;
+    for (size_t i = 0; i < pixels.size(); i += 4)
+    {
+        float v[3];
+        float length = 0.0f;
+        for (UINT c = 0; c < 3; ++c)
+        {
+            v[c] = pixels[i + c] * 2.0f - 1.0f;
+            length += v[c] * v[c];
+        }
+        if (length < 1e-12f)
+            continue;
+        length = 1.0f / std::sqrt(length);
+        for (UINT c = 0; c < 3; ++c)
+            pixels[i + c] = v[c] * length * 0.5f + 0.5f;
+    }
+}
+}
+
+MipBuildOptions GetMipBuildOptions(TextureUsage usage, TextureCompression compression, bool transparent)
+{
+    MipBuildOptions options;
+    options.Filter = compression == TextureCompression::HighQuality ? MipFilter::Kaiser : MipFilter::Box;
+    options.Srgb = usage == TextureUsage::Color;
+    options.NormalMap = usage == TextureUsage::Normal;
+    if (usage == TextureUsage::Color && transparent)
+        options.AlphaTestCutoff = 0.5f;
+    return options;
+}
+
+UINT GetMipLevelsCount(UINT width, UINT height)
+{
+    UINT levels = 1;
+    for (UINT size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+bool BuildMips(DecodedImage& image, const MipBuildOptions& options, ThreadPool* workers)
+{
+    bool floatPixels = image.Format == DXGI_FORMAT_R32G32B32A32_FLOAT;
+    if ((!floatPixels && image.Format != DXGI_FORMAT_R8G8B8A8_UNORM) || image.CachedFile != nullptr || image.MipLevels != 1)
+    {
+        assert("Mips are built for decoded R8G8B8A8_UNORM and R32G32B32A32_FLOAT images only" && false);
+        return false;
+    }
+    bool srgb = options.Srgb && !floatPixels && !options.NormalMap;
+    UINT width = image.Width;
+    UINT height = image.Height;
+    UINT levels = GetMipLevelsCount(width, height);
+
+    std::vector<float> current = ReadPixels(image, srgb);
+    bool keepCoverage = options.AlphaTestCutoff > 0.0f;
+    float coverage = keepCoverage ? GetAlphaCoverage(current, options.AlphaTestCutoff, 1.0f) : 0.0f;
+    image.Data.reserve(image.Data.size() / 3 * 4 + (floatPixels ? 16 : 4) * levels);
+
+    std::vector<float> rows;
+    std::vector<float> scaled;
+    for (UINT level = 1; level < levels; ++level)
+    {
+        UINT dstWidth = std::max(width >> 1, 1U);
+        UINT dstHeight = std::max(height >> 1, 1U);
+        AxisFilter filterX = CreateAxisFilter(options.Filter, width, dstWidth);
+        AxisFilter filterY = CreateAxisFilter(options.Filter, height, dstHeight);
+
+        rows.resize(size_t(dstWidth) * height * 4);
+        ParallelRows(workers, height, [&](size_t y)
+        {
+            FilterRow(current.data() + y * width * 4, filterX, rows.data() + y * dstWidth * 4);
+        });
+        std::vector<float> next(size_t(dstWidth) * dstHeight * 4, 0.0f);
+        ParallelRows(workers, dstHeight, [&](size_t y)
+        {
+            const AxisFilter::Taps& taps = filterY.Texels[y];
+            for (UINT k = 0; k < taps.Count; ++k)
+            {
+                const float* src = rows.data() + size_t(filterY.Indices[taps.Offset + k]) * dstWidth * 4;
+                AccumulateRow(src, filterY.Weights[taps.Offset + k], size_t(dstWidth) * 4, next.data() + y * dstWidth * 4);
+            }
+        });
+        FinishLevel(next, options);
+
+        // The next level is filtered from the unscaled alpha, so the corrections don't pile up
+        if (keepCoverage)
+        {
+            scaled = next;
+            ScaleAlphaToCoverage(scaled, options.AlphaTestCutoff, coverage);
+        }
+        WritePixels(keepCoverage ? scaled : next, image.Format, srgb, image.Data);
+
+        current.swap(next);
+        width = dstWidth;
+        height = dstHeight;
+    }
+    image.MipLevels = levels;
+    return true;
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <d3d12.h>
+
+#include "DXrenderer/Textures/BlockCompression.h"
+
+namespace DirectxPlayground
+{
+class ThreadPool;
+struct DecodedImage;
+
+enum class MipFilter : UINT
+{
+    Box, // Area average, exact for odd sizes too
+    Kaiser, // Kaiser windowed sinc, 3 texels of the smaller level on both sides. Sharper, slower
+};
+
+struct MipBuildOptions
+{
+    MipFilter Filter = MipFilter::Box;
+    bool Srgb = false; // RGB is filtered in linear space and encoded back, alpha is always linear
+    bool NormalMap = false; // RG(B) hold a [0, 1] encoded vector that is renormalized on every level
+    float AlphaTestCutoff = 0.0f; // Alpha is rescaled so every level passes the test as often as the top one, 0 disables it
+};
+
+// Kaiser when cooking for quality, box otherwise. Only color is sRGB, data and masks are filtered as they are stored.
+// Materials don't carry their alpha mode yet, so transparent color keeps the coverage of the default glTF alpha cutoff.
+MipBuildOptions GetMipBuildOptions(TextureUsage usage, TextureCompression compression, bool transparent);
+
+// Full chain, down to 1x1
+UINT GetMipLevelsCount(UINT width, UINT height);
+
+// Appends the chain below the top level of an R8G8B8A8_UNORM or R32G32B32A32_FLOAT image. Every level is filtered from
+// the one above it with clamped edges, its rows are spread over the pool threads.
+bool BuildMips(DecodedImage& image, const MipBuildOptions& options, ThreadPool* workers);
+}
@@ -0,0 +1,436 @@
+#include "DXrenderer/Textures/PngDecoder.h"
+
+#include "Utils/Inflate.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_DECODER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace DirectxPlayground
+{
+namespace
+{
+constexpr byte PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+enum PngFilter : byte
+{
+    FilterNone,
+    FilterSub,
+    FilterUp,
+    FilterAverage,
+    FilterPaeth,
+};
+
+UINT ReadBigEndian(const byte* data)
+{
+    return (UINT(data[0]) << 24) | (UINT(data[1]) << 16) | (UINT(data[2]) << 8) | UINT(data[3]);
+}
+
+bool IsChunk(const byte* chunk, const char* type)
+{
+    return memcmp(chunk + 4, type, 4) == 0;
+}
+
+UINT GetChannelsCount(UINT colorType)
+{
+    switch (colorType)
+    {
+    case 2:
+        return 3;
+    case 4:
+        return 2;
+    case 6:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+struct PngChunks
+{
+    const byte* Palette = nullptr;
+    UINT PaletteSize = 0; // Entries
+    const byte* Transparency = nullptr;
+    UINT TransparencySize = 0;
+    std::vector<std::pair<const byte*, size_t>> Data; // IDAT chunks, one zlib stream split over them
+};
+
+bool ReadChunks(const byte* data, size_t size, PngChunks& chunks)
+{
+    size_t offset = sizeof(PngSignature);
+    while (offset + 12 <= size)
+    {
+        const byte* chunk = data + offset;
+        size_t length = ReadBigEndian(chunk);
+        if (length > size - offset - 12)
+            return false;
+        const byte* chunkData = chunk + 8;
+        if (IsChunk(chunk, "IDAT"))
+        {
+            chunks.Data.emplace_back(chunkData, length);
+        }
+        else if (IsChunk(chunk, "PLTE"))
+        {
+            chunks.Palette = chunkData;
+            chunks.PaletteSize = static_cast<UINT>(std::min<size_t>(length / 3, 256));
+        }
+        else if (IsChunk(chunk, "tRNS"))
+        {
+            chunks.Transparency = chunkData;
+            chunks.TransparencySize = static_cast<UINT>(length);
+        }
+        else if (IsChunk(chunk, "IEND"))
+        {
+            break;
+        }
+        offset += length + 12;
+    }
+    return !chunks.Data.empty();
+}
+
+// Palette entries or the transparent key color, packed as they're written to the destination
+struct ColorTables
+{
+    UINT Palette[256];
+    int Key[3] = { -1, -1, -1 };
+};
+
+void BuildColorTables(const PngInfo& info, const PngChunks& chunks, ColorTables& tables)
+{
+    if (info.ColorType == 3)
+    {
+        for (UINT i = 0; i < 256; ++i)
+        {
+            // Indices past the palette are an error lodepng reports, they're just opaque black here
+            const byte* color = chunks.Palette + i * 3;
+            UINT alpha = i < chunks.TransparencySize ? chunks.Transparency[i] : 255;
+            tables.Palette[i] = i < chunks.PaletteSize ? (UINT(color[0]) | (UINT(color[1]) << 8) | (UINT(color[2]) << 16) | (alpha << 24)) : 0xff000000;
+        }
+    }
+    else if ((info.ColorType == 0 && chunks.TransparencySize >= 2) || (info.ColorType == 2 && chunks.TransparencySize >= 6))
+    {
+        // 16 bit values, only the low byte can match at 8 bits
+        for (UINT c = 0; c < (info.ColorType == 0 ? 1U : 3U); ++c)
+            tables.Key[c] = chunks.Transparency[c * 2] == 0 ? chunks.Transparency[c * 2 + 1] : 256;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Unfiltering
+//////////////////////////////////////////////////////////////////////////
+
+byte Paeth(int a, int b, int c)
+{
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<byte>(a);
+    return static_cast<byte>(pb <= pc ? b : c);
+}
+
+// Out can be the source row itself, previous is the row above already unfiltered
+void UnfilterScalar(byte filter, const byte* src, const byte* previous, byte* out, size_t rowBytes, UINT bpp)
+{
+    switch (filter)
+    {
+    case FilterSub:
+        for (size_t i = 0; i < rowBytes; ++i)
+            out[i] = static_cast<byte>(src[i] + (i >= bpp ? out[i - bpp] : 0));
+        break;
+    case FilterUp:
+        for (size_t i = 0; i < rowBytes; ++i)
+            out[i] = static_cast<byte>(src[i] + previous[i]);
+        break;
+    case FilterAverage:
+        for (size_t i = 0; i < rowBytes; ++i)
+            out[i] = static_cast<byte>(src[i] + (((i >= bpp ? out[i - bpp] : 0) + previous[i]) >> 1));
+        break;
+    case FilterPaeth:
+        for (size_t i = 0; i < rowBytes; ++i)
+            out[i] = static_cast<byte>(src[i] + (i >= bpp ? Paeth(out[i - bpp], previous[i], previous[i - bpp]) : previous[i]));
+        break;
+    default:
+        if (out != src)
+            memcpy(out, src, rowBytes);
+        break;
+    }
+}
+
+#if defined(PNG_DECODER_SSE2)
+// A pixel per vector for the filters that depend on the left neighbor, the same way libpng does it
+template<UINT Bpp>
+__m128i LoadPixel(const byte* data)
+{
+    int bits = 0;
+    memcpy(&bits, data, Bpp);
+    return _mm_cvtsi32_si128(bits);
+}
+
+template<UINT Bpp>
+void StorePixel(byte* data, __m128i pixel)
+{
+    int bits = _mm_cvtsi128_si32(pixel);
+    memcpy(data, &bits, Bpp);
+}
+
+__m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__m128i Abs16(__m128i value)
+{
+    return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+// SrcBpp 3 rows are unfiltered to 4 byte pixels, loaded with a whole 32 bit read instead of a 3 byte copy. The fourth byte
+// is whatever follows in the source, it's carried along in its own lane and never used. Previous is in the output layout.
+template<UINT SrcBpp, UINT DstBpp>
+void UnfilterPixels(byte filter, const byte* src, const byte* previous, byte* out, UINT width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero;
+    switch (filter)
+    {
+    case FilterNone:
+        for (UINT x = 0; x < width; ++x)
+            StorePixel<DstBpp>(out + x * DstBpp, LoadPixel<4>(src + x * SrcBpp));
+        break;
+    case FilterSub:
+        for (UINT x = 0; x < width; ++x)
+        {
+            a = _mm_add_epi8(a, LoadPixel<4>(src + x * SrcBpp));
+            StorePixel<DstBpp>(out + x * DstBpp, a);
+        }
+        break;
+    case FilterUp:
+        for (UINT x = 0; x < width; ++x)
+            StorePixel<DstBpp>(out + x * DstBpp, _mm_add_epi8(LoadPixel<4>(src + x * SrcBpp), LoadPixel<DstBpp>(previous + x * DstBpp)));
+        break;
+    case FilterAverage:
+    {
+        const __m128i one = _mm_set1_epi8(1);
+        for (UINT x = 0; x < width; ++x)
+        {
+            // avg_epu8 rounds up, the filter rounds down
+            __m128i b = LoadPixel<DstBpp>(previous + x * DstBpp);
+            __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(LoadPixel<4>(src + x * SrcBpp), average);
+            StorePixel<DstBpp>(out + x * DstBpp, a);
+        }
+        break;
+    }
+    case FilterPaeth:
+    {
+        // 16 bit lanes, a + b - 2c doesn't fit 8 bits
+        __m128i c = zero;
+        for (UINT x = 0; x < width; ++x)
+        {
+            __m128i b = _mm_unpacklo_epi8(LoadPixel<DstBpp>(previous + x * DstBpp), zero);
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = Abs16(_mm_add_epi16(pa, pb));
+            pa = Abs16(pa);
+            pb = Abs16(pb);
+            __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            __m128i predictor = Select(_mm_cmpeq_epi16(pa, smallest), a, Select(_mm_cmpeq_epi16(pb, smallest), b, c));
+            __m128i pixel = _mm_add_epi8(LoadPixel<4>(src + x * SrcBpp), _mm_packus_epi16(predictor, predictor));
+            StorePixel<DstBpp>(out + x * DstBpp, pixel);
+            a = _mm_unpacklo_epi8(pixel, zero);
+            c = b;
+        }
+        break;
+    }
+    }
+}
+
+void UnfilterUp(const byte* src, const byte* previous, byte* out, size_t rowBytes)
+{
+    size_t i = 0;
+    for (; i + 16 <= rowBytes; i += 16)
+    {
+        __m128i sum = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), sum);
+    }
+    UnfilterScalar(FilterUp, src + i, previous + i, out + i, rowBytes - i, 1);
+}
+#endif
+
+bool UnfilterRow(byte filter, const byte* src, const byte* previous, byte* out, size_t rowBytes, UINT bpp)
+{
+    if (filter > FilterPaeth)
+        return false;
+#if defined(PNG_DECODER_SSE2)
+    if (filter == FilterUp)
+    {
+        UnfilterUp(src, previous, out, rowBytes);
+        return true;
+    }
+    if (filter != FilterNone && bpp == 4)
+    {
+        UnfilterPixels<4, 4>(filter, src, previous, out, static_cast<UINT>(rowBytes / 4));
+        return true;
+    }
+#endif
+    UnfilterScalar(filter, src, previous, out, rowBytes, bpp);
+    return true;
+}
+
+#if defined(PNG_DECODER_SSE2)
+// RGB rows unfiltered to 4 byte pixels, see UnfilterPixels
+void ExpandRgbxRow(UINT width, const byte* src, const ColorTables& tables, byte* dst)
+{
+    for (UINT x = 0; x < width; ++x)
+    {
+        const byte* rgb = src + x * 4;
+        bool transparent = rgb[0] == tables.Key[0] && rgb[1] == tables.Key[1] && rgb[2] == tables.Key[2];
+        byte pixel[4] = { rgb[0], rgb[1], rgb[2], static_cast<byte>(transparent ? 0 : 255) };
+        memcpy(dst + x * 4, pixel, 4);
+    }
+}
+#endif
+
+// The destination is only written, never read back, so it can be write combined memory
+void ExpandRow(const PngInfo& info, const byte* src, const ColorTables& tables, byte* dst)
+{
+    switch (info.ColorType)
+    {
+    case 0:
+        for (UINT x = 0; x < info.Width; ++x)
+        {
+            byte gray = src[x];
+            byte pixel[4] = { gray, gray, gray, static_cast<byte>(gray == tables.Key[0] ? 0 : 255) };
+            memcpy(dst + x * 4, pixel, 4);
+        }
+        break;
+    case 2:
+        for (UINT x = 0; x < info.Width; ++x)
+        {
+            const byte* rgb = src + x * 3;
+            bool transparent = rgb[0] == tables.Key[0] && rgb[1] == tables.Key[1] && rgb[2] == tables.Key[2];
+            byte pixel[4] = { rgb[0], rgb[1], rgb[2], static_cast<byte>(transparent ? 0 : 255) };
+            memcpy(dst + x * 4, pixel, 4);
+        }
+        break;
+    case 3:
+        for (UINT x = 0; x < info.Width; ++x)
+            memcpy(dst + x * 4, &tables.Palette[src[x]], 4);
+        break;
+    case 4:
+        for (UINT x = 0; x < info.Width; ++x)
+        {
+            byte pixel[4] = { src[x * 2], src[x * 2], src[x * 2], src[x * 2 + 1] };
+            memcpy(dst + x * 4, pixel, 4);
+        }
+        break;
+    default:
+        memcpy(dst, src, size_t(info.Width) * 4);
+        break;
+    }
+}
+}
+
+bool ReadPngInfo(const byte* data, size_t size, PngInfo& info)
+{
+    // Signature and the whole IHDR, which has to come first
+    if (size < sizeof(PngSignature) + 8 + 13 + 4 || memcmp(data, PngSignature, sizeof(PngSignature)) != 0)
+        return false;
+    const byte* header = data + sizeof(PngSignature);
+    if (ReadBigEndian(header) != 13 || !IsChunk(header, "IHDR"))
+        return false;
+    const byte* fields = header + 8;
+    info.Width = ReadBigEndian(fields);
+    info.Height = ReadBigEndian(fields + 4);
+    info.BitDepth = fields[8];
+    info.ColorType = fields[9];
+    info.Interlaced = fields[12] != 0;
+    // Compression and filter methods have a single defined value
+    return info.Width > 0 && info.Height > 0 && info.Width <= INT_MAX && info.Height <= INT_MAX && fields[10] == 0 && fields[11] == 0;
+}
+
+bool IsPngFastPathSupported(const PngInfo& info)
+{
+    bool knownColorType = info.ColorType == 0 || info.ColorType == 2 || info.ColorType == 3 || info.ColorType == 4 || info.ColorType == 6;
+    return info.BitDepth == 8 && !info.Interlaced && knownColorType;
+}
+
+bool DecodePng(const byte* data, size_t size, const PngInfo& info, byte* dst, size_t dstPitch)
+{
+    if (!IsPngFastPathSupported(info) || dstPitch < size_t(info.Width) * 4)
+        return false;
+    PngChunks chunks;
+    if (!ReadChunks(data, size, chunks) || (info.ColorType == 3 && chunks.Palette == nullptr))
+        return false;
+
+    // Encoders usually split the stream in 8-64 KB chunks, it's inflated in one go
+    std::vector<byte> joined;
+    const byte* stream = chunks.Data.front().first;
+    size_t streamSize = chunks.Data.front().second;
+    if (chunks.Data.size() > 1)
+    {
+        for (const auto& [chunkData, chunkSize] : chunks.Data)
+            joined.insert(joined.end(), chunkData, chunkData + chunkSize);
+        stream = joined.data();
+        streamSize = joined.size();
+    }
+
+    UINT bpp = GetChannelsCount(info.ColorType);
+    size_t rowBytes = size_t(info.Width) * bpp;
+    size_t rawSize = (rowBytes + 1) * info.Height; // Every row starts with its filter type
+    std::unique_ptr<byte[]> raw(new byte[rawSize + 1]); // The 32 bit load of the last RGB pixel reads a byte past the rows
+    if (!InflateZlib(stream, streamSize, raw.get(), rawSize))
+        return false;
+    raw[rawSize] = 0;
+
+    ColorTables tables;
+    BuildColorTables(info, chunks, tables);
+#if defined(PNG_DECODER_SSE2)
+    if (bpp == 3)
+    {
+        // Unfiltered to RGBX rows, the one above stays in that layout. Both start as zeros, the first row's previous one.
+        size_t rgbxBytes = size_t(info.Width) * 4;
+        std::vector<byte> rgbxRows(rgbxBytes * 2, 0);
+        for (UINT y = 0; y < info.Height; ++y)
+        {
+            const byte* row = raw.get() + y * (rowBytes + 1);
+            byte* current = rgbxRows.data() + (y & 1) * rgbxBytes;
+            if (row[0] > FilterPaeth)
+                return false;
+            UnfilterPixels<3, 4>(row[0], row + 1, rgbxRows.data() + ((y + 1) & 1) * rgbxBytes, current, info.Width);
+            ExpandRgbxRow(info.Width, current, tables, dst + y * dstPitch);
+        }
+        return true;
+    }
+#endif
+    std::vector<byte> zeroRow(rowBytes, 0);
+    const byte* previous = zeroRow.data();
+    for (UINT y = 0; y < info.Height; ++y)
+    {
+        // Unfiltered in place, the row stays as the reference for the next one
+        byte* row = raw.get() + y * (rowBytes + 1);
+        if (!UnfilterRow(row[0], row + 1, previous, row + 1, rowBytes, bpp))
+            return false;
+        ExpandRow(info, row + 1, tables, dst + y * dstPitch);
+        previous = row + 1;
+    }
+    return true;
+}
+
+const char* GetPngDecoderIsaName()
+{
+#if defined(PNG_DECODER_SSE2)
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <d3d12.h>
+
+namespace DirectxPlayground
+{
+struct PngInfo
+{
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT BitDepth = 0;
+    UINT ColorType = 0; // 0 gray, 2 RGB, 3 palette, 4 gray alpha, 6 RGBA
+    bool Interlaced = false;
+};
+
+// Reads the header only, false if the data isn't a PNG
+bool ReadPngInfo(const byte* data, size_t size, PngInfo& info);
+
+// 8 bit, not interlaced images of any color type, tRNS included. Everything else is left to lodepng.
+bool IsPngFastPathSupported(const PngInfo& info);
+
+// Decodes the whole image to R8G8B8A8 rows dstPitch bytes apart, so it can go straight to upload memory. The stream is
+// inflated at once, rows are unfiltered with SSE2 for 3 and 4 byte pixels and then expanded to RGBA. CRCs aren't checked.
+bool DecodePng(const byte* data, size_t size, const PngInfo& info, byte* dst, size_t dstPitch);
+
+const char* GetPngDecoderIsaName();
+}
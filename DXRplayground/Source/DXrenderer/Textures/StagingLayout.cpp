@@ -0,0 +1,93 @@
+#include "DXrenderer/Textures/StagingLayout.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "DXrenderer/DXhelpers.h"
+#include "DXrenderer/Textures/PngDecoder.h"
+#include "External/lodepng/lodepng.h"
+#include "Utils/Logger.h"
+
+namespace DirectxPlayground
+{
+namespace
+{
+UINT64 AlignUp(UINT64 value, UINT64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+StagingLayout ComputeStagingLayout(DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels)
+{
+    // Footprints of block compressed mips cover whole blocks
+    UINT blockSize = GetBlockBytes(format) != 0 ? 4 : 1;
+    StagingLayout layout;
+    layout.Footprints.resize(mipLevels);
+    layout.RowsCount.resize(mipLevels);
+    layout.RowSizes.resize(mipLevels);
+    UINT64 offset = 0;
+    for (UINT level = 0; level < mipLevels; ++level)
+    {
+        UINT mipWidth = std::max(width >> level, 1U);
+        UINT mipHeight = std::max(height >> level, 1U);
+        offset = AlignUp(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = layout.Footprints[level];
+        footprint.Offset = offset;
+        footprint.Footprint.Format = format;
+        footprint.Footprint.Width = static_cast<UINT>(AlignUp(mipWidth, blockSize));
+        footprint.Footprint.Height = static_cast<UINT>(AlignUp(mipHeight, blockSize));
+        footprint.Footprint.Depth = 1;
+        layout.RowSizes[level] = GetRowPitch(format, mipWidth);
+        layout.RowsCount[level] = GetRowsCount(format, mipHeight);
+        footprint.Footprint.RowPitch = static_cast<UINT>(AlignUp(layout.RowSizes[level], D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+
+        // The last row isn't padded
+        layout.TotalSize = offset + UINT64(footprint.Footprint.RowPitch) * (layout.RowsCount[level] - 1) + layout.RowSizes[level];
+        offset = layout.TotalSize;
+    }
+    return layout;
+}
+
+StagingSpan GetStagingSpan(const StagingLayout& layout, byte* base, UINT subresource)
+{
+    StagingSpan span;
+    span.Data = base + layout.Footprints[subresource].Offset;
+    span.RowPitch = layout.Footprints[subresource].Footprint.RowPitch;
+    span.RowSize = layout.RowSizes[subresource];
+    span.RowsCount = layout.RowsCount[subresource];
+    return span;
+}
+
+void CopyToStaging(const byte* src, const StagingSpan& dst)
+{
+    if (dst.RowPitch == dst.RowSize)
+    {
+        memcpy(dst.Data, src, dst.RowSize * dst.RowsCount);
+        return;
+    }
+    for (UINT row = 0; row < dst.RowsCount; ++row)
+        memcpy(dst.Data + row * dst.RowPitch, src + row * dst.RowSize, dst.RowSize);
+}
+
+UINT DecodePngToStaging(const byte* data, size_t size, const PngInfo& info, const StagingSpan& dst)
+{
+    if (dst.RowSize != UINT64(info.Width) * 4 || dst.RowsCount != info.Height)
+        return 0;
+    if (DecodePng(data, size, info, dst.Data, dst.RowPitch))
+        return 1;
+
+    std::vector<byte> buffer;
+    UINT w = 0;
+    UINT h = 0;
+    UINT error = lodepng::decode(buffer, w, h, data, size);
+    if (error || w != info.Width || h != info.Height)
+    {
+        LOG("PNG decoding error ", error, " : ", lodepng_error_text(error));
+        return 0;
+    }
+    CopyToStaging(buffer.data(), dst);
+    return 2;
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+namespace DirectxPlayground
+{
+struct PngInfo;
+
+// Upload buffer layout of a 2D texture with its mips, the one GetCopyableFootprints gives: rows are
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT bytes apart and every mip starts at D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+// Computed without a device, so it works the same against plain heap memory.
+struct StagingLayout
+{
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Footprints;
+    std::vector<UINT> RowsCount; // Rows of pixels or rows of blocks
+    std::vector<UINT64> RowSizes; // Bytes of a row without the padding
+    UINT64 TotalSize = 0;
+};
+
+// One subresource of a staging layout. Decoders write RowsCount rows of RowSize bytes RowPitch apart and leave the padding alone,
+// the memory can be write-combined.
+struct StagingSpan
+{
+    byte* Data = nullptr;
+    UINT64 RowPitch = 0;
+    UINT64 RowSize = 0;
+    UINT RowsCount = 0;
+};
+
+StagingLayout ComputeStagingLayout(DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels);
+StagingSpan GetStagingSpan(const StagingLayout& layout, byte* base, UINT subresource);
+// Rows of the source are packed, RowSize bytes each
+void CopyToStaging(const byte* src, const StagingSpan& dst);
+
+// Decodes an 8 bit PNG to R8G8B8A8 rows of the span. Returns how many times the CPU wrote each texel: 1 when the fast path
+// writes the rows in place, 2 when lodepng decodes to memory first, 0 if the file can't be decoded.
+UINT DecodePngToStaging(const byte* data, size_t size, const PngInfo& info, const StagingSpan& dst);
+
+// CPU copies of the texels on their way to upload memory, weighted by the texels count
+struct StagingCopies
+{
+    UINT64 TexelsCount = 0;
+    UINT64 CopiedTexelsCount = 0;
+
+    void Add(UINT64 texels, UINT copies)
+    {
+        TexelsCount += texels;
+        CopiedTexelsCount += texels * copies;
+    }
+
+    float GetCopiesPerTexel() const
+    {
+        return TexelsCount > 0 ? float(CopiedTexelsCount) / float(TexelsCount) : 0.0f;
+    }
+};
+}
@@ -0,0 +1,139 @@
+#include "DXrenderer/Textures/StreamingBackendDX.h"
+
+namespace DirectxPlayground
+{
+StreamingBackendDX::StreamingBackendDX(RenderContext& ctx, TextureManager& textureManager)
+    : mCtx(ctx)
+    , mTextureManager(textureManager)
+{
+    mWorker = std::thread(&StreamingBackendDX::WorkerLoop, this);
+}
+
+StreamingBackendDX::~StreamingBackendDX()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShutdown = true;
+    }
+    mCondition.notify_one();
+    mWorker.join();
+}
+
+TexResourceData StreamingBackendDX::AddTexture(UINT index, DecodedImage&& image, UINT tailMip, const std::string& name)
+{
+    assert(image.Width > 0 && image.Height > 0 && "Image wasn't decoded");
+    assert(tailMip < image.MipLevels);
+    if (index >= mTextures.size())
+        mTextures.resize(index + 1);
+    // A reused index keeps its generation, the jobs of the removed texture can't match it
+    StreamedResource& texture = mTextures[index];
+    assert(texture.Source == nullptr && "The index is taken");
+    texture.Source = std::make_shared<DecodedImage>(std::move(image));
+    texture.Name = name;
+    texture.Landed = true;
+
+    const DecodedImage& source = *texture.Source;
+    TextureManager::StagedTexture staged = mTextureManager.BeginTextureUpload(mCtx, source.Format, source.GetMipWidth(tailMip), source.GetMipHeight(tailMip),
+        source.MipLevels - tailMip, name);
+    CopyMips(source, tailMip, staged);
+    texture.Current = mTextureManager.EndTextureUpload(mCtx, staged);
+    return texture.Current;
+}
+
+void StreamingBackendDX::RemoveTexture(UINT index)
+{
+    StreamedResource& texture = mTextures[index];
+    assert(texture.Source != nullptr && "The texture is already removed");
+    mRetired.push_back({ texture.Current, mFrame });
+    texture.Source = nullptr;
+    texture.Name.clear();
+    texture.Current = TexResourceData{};
+    ++texture.Generation;
+}
+
+void StreamingBackendDX::Update()
+{
+    ++mFrame;
+    std::vector<std::unique_ptr<Job>> done;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        done.swap(mDoneJobs);
+    }
+
+    for (auto& job : done)
+    {
+        StreamedResource& texture = mTextures[job->Texture];
+        if (job->Generation != texture.Generation)
+            continue; // Superseded before it landed, nothing references its resources
+        TexResourceData landed = mTextureManager.EndTextureUpload(mCtx, job->Staged);
+        mRetired.push_back({ texture.Current, mFrame });
+        texture.Current = landed;
+        texture.Landed = true;
+    }
+
+    while (!mRetired.empty() && mFrame - mRetired.front().Frame > RenderContext::FramesCount)
+    {
+        mTextureManager.FreeTexture(mRetired.front().Texture);
+        mRetired.pop_front();
+    }
+}
+
+void StreamingBackendDX::BeginLoad(UINT texture, UINT mostDetailedMip)
+{
+    mTextures[texture].Landed = false;
+    QueueJob(texture, mostDetailedMip);
+}
+
+bool StreamingBackendDX::IsLoadDone(UINT texture)
+{
+    return mTextures[texture].Landed;
+}
+
+// The memory goes when the smaller resource lands, the streamer counts it as gone right away
+void StreamingBackendDX::Evict(UINT texture, UINT mostDetailedMip)
+{
+    QueueJob(texture, mostDetailedMip);
+}
+
+void StreamingBackendDX::CopyMips(const DecodedImage& image, UINT mostDetailedMip, const TextureManager::StagedTexture& staged)
+{
+    for (UINT level = mostDetailedMip; level < image.MipLevels; ++level)
+        CopyToStaging(image.GetPixels() + image.GetMipOffset(level), GetStagingSpan(staged.Layout, staged.UploadData, level - mostDetailedMip));
+}
+
+// Resources are created here, the worker only writes the upload memory
+void StreamingBackendDX::QueueJob(UINT texture, UINT mostDetailedMip)
+{
+    StreamedResource& streamed = mTextures[texture];
+    const DecodedImage& source = *streamed.Source;
+    auto job = std::make_unique<Job>();
+    job->Texture = texture;
+    job->Generation = ++streamed.Generation;
+    job->MostDetailedMip = mostDetailedMip;
+    job->Source = streamed.Source;
+    job->Staged = mTextureManager.BeginTextureUpload(mCtx, source.Format, source.GetMipWidth(mostDetailedMip), source.GetMipHeight(mostDetailedMip),
+        source.MipLevels - mostDetailedMip, streamed.Name);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPendingJobs.push_back(std::move(job));
+    }
+    mCondition.notify_one();
+}
+
+void StreamingBackendDX::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        mCondition.wait(lock, [this] { return mShutdown || !mPendingJobs.empty(); });
+        if (mShutdown)
+            return;
+        std::unique_ptr<Job> job = std::move(mPendingJobs.front());
+        mPendingJobs.pop_front();
+        lock.unlock();
+        CopyMips(*job->Source, job->MostDetailedMip, job->Staged);
+        lock.lock();
+        mDoneJobs.push_back(std::move(job));
+    }
+}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DXrenderer/Textures/TextureManager.h"
+#include "DXrenderer/Textures/TextureStreamer.h"
+
+namespace DirectxPlayground
+{
+// Streams the mips from the decoded images, which stay on the CPU (or mapped from the texture cache). A load or an eviction creates
+// a resource with the mips from the new most detailed one down, a background thread fills its mapped upload buffer and Update
+// records the copy and switches the texture to a view of it. The replaced resource and its view are freed once the GPU is done with them.
+class StreamingBackendDX : public ITextureStreamingBackend
+{
+public:
+    StreamingBackendDX(RenderContext& ctx, TextureManager& textureManager);
+    ~StreamingBackendDX() override;
+
+    // Uploads the mips from tailMip down right away, the index is the one TextureStreamer::AddTexture returned
+    TexResourceData AddTexture(UINT index, DecodedImage&& image, UINT tailMip, const std::string& name);
+    // Retires the current resource and drops the image, the jobs in flight are dropped when they finish
+    void RemoveTexture(UINT index);
+    UINT GetSrvOffset(UINT texture) const;
+    // Once per frame before TextureStreamer::Update, on the thread that records the frame
+    void Update();
+
+    void BeginLoad(UINT texture, UINT mostDetailedMip) override;
+    bool IsLoadDone(UINT texture) override;
+    void Evict(UINT texture, UINT mostDetailedMip) override;
+
+private:
+    struct StreamedResource
+    {
+        std::shared_ptr<const DecodedImage> Source; // Jobs hold it too, the worker can still read it after a removal
+        std::string Name;
+        TexResourceData Current;
+        UINT Generation = 0; // Of the last queued job, the older ones are dropped when they finish
+        bool Landed = true; // The last load is current
+    };
+
+    struct Job
+    {
+        UINT Texture = 0;
+        UINT Generation = 0;
+        UINT MostDetailedMip = 0;
+        std::shared_ptr<const DecodedImage> Source;
+        TextureManager::StagedTexture Staged;
+    };
+
+    // Freed when the frames that could use them are done
+    struct RetiredTexture
+    {
+        TexResourceData Texture;
+        UINT64 Frame = 0;
+    };
+
+    static void CopyMips(const DecodedImage& image, UINT mostDetailedMip, const TextureManager::StagedTexture& staged);
+    void QueueJob(UINT texture, UINT mostDetailedMip);
+    void WorkerLoop();
+
+    RenderContext& mCtx;
+    TextureManager& mTextureManager;
+    std::vector<StreamedResource> mTextures;
+    std::deque<RetiredTexture> mRetired;
+    UINT64 mFrame = 0;
+
+    std::thread mWorker;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<std::unique_ptr<Job>> mPendingJobs;
+    std::vector<std::unique_ptr<Job>> mDoneJobs;
+    bool mShutdown = false;
+};
+
+inline UINT StreamingBackendDX::GetSrvOffset(UINT texture) const
+{
+    return mTextures[texture].Current.SRVOffset;
+}
+}
@@ -0,0 +1,210 @@
+#include "DXrenderer/Textures/TextureCache.h"
+
+#include "DXrenderer/DXhelpers.h"
+#include "DXrenderer/Textures/MipBuilder.h"
+#include "Utils/Hash.h"
+#include "Utils/Logger.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace DirectxPlayground
+{
+
+size_t DecodedImage::GetMipOffset(UINT level) const
+{
+    size_t offset = 0;
+    for (UINT i = 0; i < level; ++i)
+        offset += GetMipSize(i);
+    return offset;
+}
+
+size_t DecodedImage::GetMipSize(UINT level) const
+{
+    return static_cast<size_t>(GetRowPitch(Format, GetMipWidth(level)) * GetRowsCount(Format, GetMipHeight(level)));
+}
+
+void CopyWrappedRegion(const DecodedImage& image, UINT mip, int x, int y, UINT width, UINT height, byte* dst, UINT64 dstPitch)
+{
+    UINT blockSize = GetBlockBytes(image.Format) != 0 ? 4 : 1;
+    UINT elementBytes = blockSize == 4 ? GetBlockBytes(image.Format) : GetPixelSize(image.Format);
+    int mipWidth = static_cast<int>(GetRowPitch(image.Format, image.GetMipWidth(mip)) / elementBytes);
+    int mipHeight = static_cast<int>(GetRowsCount(image.Format, image.GetMipHeight(mip)));
+    auto wrap = [](int value, int size) { int wrapped = value % size; return wrapped < 0 ? wrapped + size : wrapped; };
+    const byte* src = image.GetPixels() + image.GetMipOffset(mip);
+    UINT64 srcPitch = UINT64(mipWidth) * elementBytes;
+
+    // Runs up to the mip edge are copied at once
+    int firstColumn = x / static_cast<int>(blockSize);
+    int firstRow = y / static_cast<int>(blockSize);
+    UINT columns = width / blockSize;
+    UINT rows = height / blockSize;
+    for (UINT row = 0; row < rows; ++row)
+    {
+        const byte* srcRow = src + wrap(firstRow + static_cast<int>(row), mipHeight) * srcPitch;
+        byte* dstRow = dst + row * dstPitch;
+        for (UINT column = 0; column < columns;)
+        {
+            int srcColumn = wrap(firstColumn + static_cast<int>(column), mipWidth);
+            UINT run = std::min(columns - column, static_cast<UINT>(mipWidth - srcColumn));
+            memcpy(dstRow + column * elementBytes, srcRow + srcColumn * elementBytes, size_t(run) * elementBytes);
+            column += run;
+        }
+    }
+}
+
+TextureCache::TextureCache(const std::string& directory)
+    : mDirectory(directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(mDirectory, error);
+    if (error)
+        LOG("Can't create texture cache directory ", mDirectory);
+}
+
+UINT64 TextureCache::GetSourceHash(const std::string& filename)
+{
+    MappedFile source(filename);
+    if (!source.IsValid())
+        return 0;
+    UINT64 hash = HashString(std::filesystem::path(filename).extension().string()); // The decoder is picked by the extension
+    hash = HashBytes(source.GetData(), source.GetSize(), hash);
+    return hash != 0 ? hash : 1;
+}
+
+UINT64 TextureCache::GetKey(UINT64 sourceHash, UINT64 optionsHash /*= 0*/)
+{
+    if (sourceHash == 0)
+        return 0;
+    UINT64 hash = HashValue(TextureCacheVersion);
+    hash = HashValue(optionsHash, hash);
+    hash = HashValue(sourceHash, hash);
+    return hash != 0 ? hash : 1;
+}
+
+UINT64 TextureCache::GetKey(const std::string& filename, UINT64 optionsHash /*= 0*/)
+{
+    return GetKey(GetSourceHash(filename), optionsHash);
+}
+
+std::string TextureCache::GetEntryPath(UINT64 key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(key));
+    return mDirectory + name;
+}
+
+bool TextureCache::Load(UINT64 key, DecodedImage& image) const
+{
+    auto file = std::make_unique<MappedFile>(GetEntryPath(key));
+    if (!file->IsValid() || file->GetSize() < sizeof(TextureCacheHeader))
+        return false;
+
+    const TextureCacheHeader& header = *reinterpret_cast<const TextureCacheHeader*>(file->GetData());
+    if (header.Magic != TextureCacheMagic || header.Version != TextureCacheVersion || header.Key != key || header.MipCount == 0)
+        return false;
+    if (file->GetSize() < sizeof(TextureCacheHeader) + sizeof(TextureCacheMip) * header.MipCount)
+        return false;
+
+    // The description has to be one the upload can trust: a known format, a chain no longer than the full one
+    DecodedImage description;
+    description.Width = header.Width;
+    description.Height = header.Height;
+    description.Format = header.Format;
+    description.MipLevels = header.MipCount;
+    bool knownFormat = GetBlockBytes(header.Format) != 0 || FindPixelSize(header.Format) != 0;
+    auto corrupted = [this, key]()
+    {
+        LOG("Texture cache entry ", GetEntryPath(key), " is corrupted");
+        return false;
+    };
+    if (!knownFormat || header.Width == 0 || header.Height == 0 || header.MipCount > GetMipLevelsCount(header.Width, header.Height))
+        return corrupted();
+
+    const TextureCacheMip* mips = reinterpret_cast<const TextureCacheMip*>(file->GetData() + sizeof(TextureCacheHeader));
+    UINT64 tablesSize = sizeof(TextureCacheHeader) + sizeof(TextureCacheMip) * header.MipCount;
+    UINT64 size = 0;
+    for (UINT i = 0; i < header.MipCount; ++i)
+    {
+        // The levels are mapped as one block, so they have to follow each other, tightly packed the way DecodedImage lays them out
+        if (mips[i].Offset < tablesSize || mips[i].Offset != mips[0].Offset + size || mips[i].Size != description.GetMipSize(i) ||
+            mips[i].Width != description.GetMipWidth(i) || mips[i].Height != description.GetMipHeight(i) ||
+            mips[i].Offset > file->GetSize() || mips[i].Size > file->GetSize() - mips[i].Offset)
+            return corrupted();
+        size += mips[i].Size;
+    }
+    // The payload is the tail of the file, a shorter chain in the header would leave levels behind it
+    if (size != description.GetMipOffset(header.MipCount) || mips[0].Offset + size != file->GetSize())
+        return corrupted();
+
+    image.Data.clear();
+    image.Width = header.Width;
+    image.Height = header.Height;
+    image.Format = header.Format;
+    image.MipLevels = header.MipCount;
+    image.CachedPixels = file->GetData() + mips[0].Offset;
+    image.CachedPixelsSize = static_cast<size_t>(size);
+    image.CachedFile = std::move(file);
+    return true;
+}
+
+bool TextureCache::Store(UINT64 key, const DecodedImage& image) const
+{
+    TextureCacheHeader header;
+    header.Key = key;
+    header.Width = image.Width;
+    header.Height = image.Height;
+    header.Format = image.Format;
+    header.MipCount = image.MipLevels;
+
+    std::vector<TextureCacheMip> mips(image.MipLevels);
+    size_t tablesSize = sizeof(header) + sizeof(TextureCacheMip) * mips.size();
+    size_t dataOffset = (tablesSize + TextureCacheDataAlignment - 1) & ~size_t(TextureCacheDataAlignment - 1);
+    for (UINT i = 0; i < image.MipLevels; ++i)
+    {
+        mips[i].Offset = dataOffset + image.GetMipOffset(i);
+        mips[i].Size = image.GetMipSize(i);
+        mips[i].Width = image.GetMipWidth(i);
+        mips[i].Height = image.GetMipHeight(i);
+        mips[i].RowPitch = static_cast<UINT>(GetRowPitch(image.Format, mips[i].Width));
+    }
+    assert(image.GetMipOffset(image.MipLevels) == image.GetPixelsSize() && "Decoded image size doesn't match its mips");
+
+    // Several threads can decode the same source, every one of them writes its own file and the last rename wins
+    std::string path = GetEntryPath(key);
+    std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOG("Can't write texture cache entry ", path);
+            return false;
+        }
+        const char padding[TextureCacheDataAlignment] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(mips.data()), sizeof(TextureCacheMip) * mips.size());
+        file.write(padding, dataOffset - tablesSize);
+        file.write(reinterpret_cast<const char*>(image.GetPixels()), image.GetPixelsSize());
+        if (!file)
+        {
+            LOG("Can't write texture cache entry ", path);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+}
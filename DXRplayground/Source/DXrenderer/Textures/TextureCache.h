@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <d3d12.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Utils/MappedFile.h"
+
+namespace DirectxPlayground
+{
+// CPU side result of an image file decode, doesn't touch the device so it can be produced on any thread.
+// Mip levels follow the top one, every level tightly packed.
+struct DecodedImage
+{
+    std::vector<byte> Data;
+    std::unique_ptr<MappedFile> CachedFile; // Set on a texture cache hit, the pixels are then read straight from the mapping
+    const byte* CachedPixels = nullptr;
+    size_t CachedPixelsSize = 0;
+    UINT Width = 0;
+    UINT Height = 0;
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT MipLevels = 1;
+
+    const byte* GetPixels() const;
+    size_t GetPixelsSize() const;
+
+    UINT GetMipWidth(UINT level) const;
+    UINT GetMipHeight(UINT level) const;
+    size_t GetMipOffset(UINT level) const;
+    size_t GetMipSize(UINT level) const;
+};
+
+// Copies width x height texels of a mip from x, y on to rows of dst, wrapped around the mip edges so the region can start outside it.
+// Block compressed images are copied by blocks, everything is in whole blocks then and the rows are block rows.
+void CopyWrappedRegion(const DecodedImage& image, UINT mip, int x, int y, UINT width, UINT height, byte* dst, UINT64 dstPitch);
+
+// Layout of a cache entry: header | mips | pixel data. Pixels are stored tightly packed, exactly as they are uploaded,
+// the levels one after another.
+constexpr UINT TextureCacheMagic = 0x54505844; // "DXPT"
+constexpr UINT TextureCacheVersion = 2;
+constexpr UINT TextureCacheDataAlignment = 16;
+
+struct TextureCacheHeader
+{
+    UINT Magic = TextureCacheMagic;
+    UINT Version = TextureCacheVersion;
+    UINT64 Key = 0;
+    UINT Width = 0;
+    UINT Height = 0;
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT MipCount = 0;
+};
+
+struct TextureCacheMip
+{
+    UINT64 Offset = 0; // From the beginning of the file
+    UINT64 Size = 0;
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT RowPitch = 0;
+};
+
+// Decoded images stored by the hash of their source bytes and decode options, so a renamed or copied file still hits
+// and an edited one never does. Entries are written once and only read afterwards, lookups are safe from any thread.
+class TextureCache
+{
+public:
+    TextureCache(const std::string& directory);
+    TextureCache(const TextureCache&) = delete;
+    TextureCache(TextureCache&&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+    TextureCache& operator=(TextureCache&&) = delete;
+    ~TextureCache() = default;
+
+    // Hash of the file content and extension, 0 if the file can't be read. Computed once per file, every decode of it builds its key on it.
+    static UINT64 GetSourceHash(const std::string& filename);
+    // Returns 0 for a 0 source hash
+    static UINT64 GetKey(UINT64 sourceHash, UINT64 optionsHash = 0);
+    static UINT64 GetKey(const std::string& filename, UINT64 optionsHash = 0);
+
+    bool Load(UINT64 key, DecodedImage& image) const;
+    bool Store(UINT64 key, const DecodedImage& image) const;
+
+    std::string GetEntryPath(UINT64 key) const;
+
+private:
+    std::string mDirectory;
+};
+
+inline const byte* DecodedImage::GetPixels() const
+{
+    return CachedFile ? CachedPixels : Data.data();
+}
+
+inline size_t DecodedImage::GetPixelsSize() const
+{
+    return CachedFile ? CachedPixelsSize : Data.size();
+}
+
+inline UINT DecodedImage::GetMipWidth(UINT level) const
+{
+    return std::max(Width >> level, 1U);
+}
+
+inline UINT DecodedImage::GetMipHeight(UINT level) const
+{
+    return std::max(Height >> level, 1U);
+}
+}
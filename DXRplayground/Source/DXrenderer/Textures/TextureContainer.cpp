@@ -0,0 +1,105 @@
+#include "DXrenderer/Textures/TextureContainer.h"
+
+#include "DXrenderer/Textures/ContainerParser.h"
+#include "Utils/Logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+namespace DirectxPlayground
+{
+namespace
+{
+static_assert(UINT(ContainerDimension::Texture1D) == D3D12_RESOURCE_DIMENSION_TEXTURE1D && UINT(ContainerDimension::Texture3D) == D3D12_RESOURCE_DIMENSION_TEXTURE3D,
+    "Container dimensions are the D3D12 ones");
+static_assert(UINT(TextureFormat::R32G32B32A32_TYPELESS) == DXGI_FORMAT_R32G32B32A32_TYPELESS && UINT(TextureFormat::R9G9B9E5_SHAREDEXP) == DXGI_FORMAT_R9G9B9E5_SHAREDEXP
+    && UINT(TextureFormat::BC7_UNORM_SRGB) == DXGI_FORMAT_BC7_UNORM_SRGB && UINT(TextureFormat::B4G4R4A4_UNORM) == DXGI_FORMAT_B4G4R4A4_UNORM, "Texture formats are the DXGI ones");
+
+// The subresources point into the data
+void SetContainer(const ContainerLayout& layout, const byte* data, TextureContainer& container)
+{
+    container.Dimension = static_cast<D3D12_RESOURCE_DIMENSION>(layout.Dimension);
+    container.Format = static_cast<DXGI_FORMAT>(layout.Format);
+    container.Width = layout.Width;
+    container.Height = layout.Height;
+    container.Depth = layout.Depth;
+    container.ArraySize = layout.ArraySize;
+    container.MipLevels = layout.MipLevels;
+    container.Cubemap = layout.Cubemap;
+    container.Subresources.resize(layout.Subresources.size());
+    for (size_t i = 0; i < layout.Subresources.size(); ++i)
+    {
+        container.Subresources[i].pData = data + layout.Subresources[i].Offset;
+        container.Subresources[i].RowPitch = static_cast<LONG_PTR>(layout.Subresources[i].RowPitch);
+        container.Subresources[i].SlicePitch = static_cast<LONG_PTR>(layout.Subresources[i].SlicePitch);
+    }
+}
+}
+
+TextureContainerType GetTextureContainerType(const std::string& filename)
+{
+    std::string extension = std::filesystem::path(filename).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    if (extension == ".dds")
+        return TextureContainerType::DDS;
+    if (extension == ".ktx2")
+        return TextureContainerType::KTX2;
+    return TextureContainerType::None;
+}
+
+bool ReadTextureContainer(const std::string& filename, TextureContainer& container)
+{
+    auto file = std::make_unique<MappedFile>(filename);
+    if (!file->IsValid())
+    {
+        LOG("Can't read texture ", filename);
+        return false;
+    }
+    bool parsed = false;
+    switch (GetTextureContainerType(filename))
+    {
+    case TextureContainerType::DDS:
+        parsed = ParseDDS(file->GetData(), file->GetSize(), container);
+        break;
+    case TextureContainerType::KTX2:
+        parsed = ParseKTX2(file->GetData(), file->GetSize(), container);
+        break;
+    default:
+        break;
+    }
+    if (!parsed)
+    {
+        LOG("Texture container ", filename, " can't be loaded");
+        return false;
+    }
+    container.File = std::move(file);
+    return true;
+}
+
+bool ParseDDS(const byte* data, size_t size, TextureContainer& container)
+{
+    ContainerLayout layout;
+    std::string error;
+    if (!ParseDdsLayout(data, size, layout, error))
+    {
+        LOG("DDS parsing failed: ", error);
+        return false;
+    }
+    SetContainer(layout, data, container);
+    return true;
+}
+
+bool ParseKTX2(const byte* data, size_t size, TextureContainer& container)
+{
+    ContainerLayout layout;
+    std::string error;
+    if (!ParseKtx2Layout(data, size, layout, error))
+    {
+        LOG("KTX2 parsing failed: ", error);
+        return false;
+    }
+    SetContainer(layout, data, container);
+    return true;
+}
+}
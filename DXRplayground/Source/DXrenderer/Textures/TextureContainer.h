@@ -0,0 +1,43 @@
+#pragma once
+
+#include <d3d12.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Utils/MappedFile.h"
+
+namespace DirectxPlayground
+{
+enum class TextureContainerType : UINT
+{
+    None,
+    DDS,
+    KTX2,
+};
+
+// Cooked texture read straight from its mapped file, nothing is decoded. Subresources are in the D3D12 order
+// (mip + slice * MipLevels) and point into the mapping, so the file has to live until they're uploaded.
+struct TextureContainer
+{
+    std::unique_ptr<MappedFile> File;
+    D3D12_RESOURCE_DIMENSION Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT Width = 0;
+    UINT Height = 1;
+    UINT Depth = 1;
+    UINT ArraySize = 1; // Faces included, a multiple of 6 for cubemaps
+    UINT MipLevels = 1;
+    bool Cubemap = false;
+    std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+};
+
+// By the file extension
+TextureContainerType GetTextureContainerType(const std::string& filename);
+
+bool ReadTextureContainer(const std::string& filename, TextureContainer& container);
+
+// Fill everything but File, see ContainerParser.h for what is rejected
+bool ParseDDS(const byte* data, size_t size, TextureContainer& container);
+bool ParseKTX2(const byte* data, size_t size, TextureContainer& container);
+}
@@ -0,0 +1,138 @@
+#include "DXrenderer/Textures/TextureFormat.h"
+
+namespace DirectxPlayground
+{
+uint32_t GetFormatPixelBytes(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::R8_TYPELESS:
+    case TextureFormat::R8_UNORM:
+    case TextureFormat::R8_UINT:
+    case TextureFormat::R8_SNORM:
+    case TextureFormat::R8_SINT:
+    case TextureFormat::A8_UNORM:
+        return 1;
+    case TextureFormat::R8G8_TYPELESS:
+    case TextureFormat::R8G8_UNORM:
+    case TextureFormat::R8G8_UINT:
+    case TextureFormat::R8G8_SNORM:
+    case TextureFormat::R8G8_SINT:
+    case TextureFormat::R16_TYPELESS:
+    case TextureFormat::R16_FLOAT:
+    case TextureFormat::D16_UNORM:
+    case TextureFormat::R16_UNORM:
+    case TextureFormat::R16_UINT:
+    case TextureFormat::R16_SNORM:
+    case TextureFormat::R16_SINT:
+    case TextureFormat::B5G6R5_UNORM:
+    case TextureFormat::B5G5R5A1_UNORM:
+    case TextureFormat::B4G4R4A4_UNORM:
+        return 2;
+    case TextureFormat::R10G10B10A2_TYPELESS:
+    case TextureFormat::R10G10B10A2_UNORM:
+    case TextureFormat::R10G10B10A2_UINT:
+    case TextureFormat::R11G11B10_FLOAT:
+    case TextureFormat::R8G8B8A8_TYPELESS:
+    case TextureFormat::R8G8B8A8_UNORM:
+    case TextureFormat::R8G8B8A8_UNORM_SRGB:
+    case TextureFormat::R8G8B8A8_UINT:
+    case TextureFormat::R8G8B8A8_SNORM:
+    case TextureFormat::R8G8B8A8_SINT:
+    case TextureFormat::R16G16_TYPELESS:
+    case TextureFormat::R16G16_FLOAT:
+    case TextureFormat::R16G16_UNORM:
+    case TextureFormat::R16G16_UINT:
+    case TextureFormat::R16G16_SNORM:
+    case TextureFormat::R16G16_SINT:
+    case TextureFormat::R32_TYPELESS:
+    case TextureFormat::D32_FLOAT:
+    case TextureFormat::R32_FLOAT:
+    case TextureFormat::R32_UINT:
+    case TextureFormat::R32_SINT:
+    case TextureFormat::R24G8_TYPELESS:
+    case TextureFormat::D24_UNORM_S8_UINT:
+    case TextureFormat::R24_UNORM_X8_TYPELESS:
+    case TextureFormat::X24_TYPELESS_G8_UINT:
+    case TextureFormat::R9G9B9E5_SHAREDEXP:
+    case TextureFormat::B8G8R8A8_UNORM:
+    case TextureFormat::B8G8R8X8_UNORM:
+    case TextureFormat::R10G10B10_XR_BIAS_A2_UNORM:
+    case TextureFormat::B8G8R8A8_TYPELESS:
+    case TextureFormat::B8G8R8A8_UNORM_SRGB:
+    case TextureFormat::B8G8R8X8_TYPELESS:
+    case TextureFormat::B8G8R8X8_UNORM_SRGB:
+        return 4;
+    case TextureFormat::R16G16B16A16_TYPELESS:
+    case TextureFormat::R16G16B16A16_FLOAT:
+    case TextureFormat::R16G16B16A16_UNORM:
+    case TextureFormat::R16G16B16A16_UINT:
+    case TextureFormat::R16G16B16A16_SNORM:
+    case TextureFormat::R16G16B16A16_SINT:
+    case TextureFormat::R32G32_TYPELESS:
+    case TextureFormat::R32G32_FLOAT:
+    case TextureFormat::R32G32_UINT:
+    case TextureFormat::R32G32_SINT:
+    case TextureFormat::R32G8X24_TYPELESS:
+    case TextureFormat::D32_FLOAT_S8X24_UINT:
+    case TextureFormat::R32_FLOAT_X8X24_TYPELESS:
+    case TextureFormat::X32_TYPELESS_G8X24_UINT:
+        return 8;
+    case TextureFormat::R32G32B32_TYPELESS:
+    case TextureFormat::R32G32B32_FLOAT:
+    case TextureFormat::R32G32B32_UINT:
+    case TextureFormat::R32G32B32_SINT:
+        return 12;
+    case TextureFormat::R32G32B32A32_TYPELESS:
+    case TextureFormat::R32G32B32A32_FLOAT:
+    case TextureFormat::R32G32B32A32_UINT:
+    case TextureFormat::R32G32B32A32_SINT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+uint32_t GetFormatBlockBytes(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::BC1_TYPELESS:
+    case TextureFormat::BC1_UNORM:
+    case TextureFormat::BC1_UNORM_SRGB:
+    case TextureFormat::BC4_TYPELESS:
+    case TextureFormat::BC4_UNORM:
+    case TextureFormat::BC4_SNORM:
+        return 8;
+    case TextureFormat::BC2_TYPELESS:
+    case TextureFormat::BC2_UNORM:
+    case TextureFormat::BC2_UNORM_SRGB:
+    case TextureFormat::BC3_TYPELESS:
+    case TextureFormat::BC3_UNORM:
+    case TextureFormat::BC3_UNORM_SRGB:
+    case TextureFormat::BC5_TYPELESS:
+    case TextureFormat::BC5_UNORM:
+    case TextureFormat::BC5_SNORM:
+    case TextureFormat::BC6H_TYPELESS:
+    case TextureFormat::BC6H_UF16:
+    case TextureFormat::BC6H_SF16:
+    case TextureFormat::BC7_TYPELESS:
+    case TextureFormat::BC7_UNORM:
+    case TextureFormat::BC7_UNORM_SRGB:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+uint64_t GetFormatRowPitch(TextureFormat format, uint32_t width)
+{
+    uint32_t blockBytes = GetFormatBlockBytes(format);
+    return blockBytes != 0 ? uint64_t((width + 3) / 4) * blockBytes : uint64_t(width) * GetFormatPixelBytes(format);
+}
+
+uint32_t GetFormatRowsCount(TextureFormat format, uint32_t height)
+{
+    return GetFormatBlockBytes(format) != 0 ? (height + 3) / 4 : height;
+}
+}
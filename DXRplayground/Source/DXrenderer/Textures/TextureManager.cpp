@@ -1,34 +1,180 @@
 #include "TextureManager.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <sstream>
 
 #include "External/Dx12Helpers/d3dx12.h"
 #include "External/lodepng/lodepng.h"
 
-#define TINYEXR_IMPLEMENTATION
-#include "External/TinyEXR/tinyexr.h"
-
 #define STB_IMAGE_IMPLEMENTATION
 #include "External/stb/stb_image.h"
 
+#include "Utils/Hash.h"
 #include "Utils/Logger.h"
+#include "Utils/ThreadPool.h"
 
 #include "DXrenderer/DXhelpers.h"
+#include "DXrenderer/Textures/ExrDecoder.h"
+#include "DXrenderer/Textures/StreamingBackendDX.h"
+#include "DXrenderer/Textures/TextureStreamer.h"
 
 namespace DirectxPlayground
 {
 namespace
 {
 static constexpr UINT MaxImguiTexturesCount = 128;
-static constexpr UINT MaxResources = 32768;
+static constexpr float MaxHdrPackingError = 0.004f; // log2 RMSE, about a quarter of what BC6H gets on the test environment maps
+static constexpr UINT64 TextureStreamingBudget = 512ull * 1024 * 1024; // Every streamed mip, the tails included
+static constexpr UINT64 TextureResidencyBudget = 1024ull * 1024 * 1024; // Every texture, the streamed and pinned ones count too
+
+// 1x1 stand-in for an image that can't be read: white, or a flat normal for normal maps
+DecodedImage GetFallbackImage(TextureUsage usage)
+{
+    DecodedImage image;
+    image.Width = 1;
+    image.Height = 1;
+    image.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    if (usage == TextureUsage::Normal)
+        image.Data = { 128, 128, 255, 255 };
+    else
+        image.Data = { 255, 255, 255, 255 };
+    return image;
+}
+
+// Key of a texture that is never shared, the resource index is unique while it's registered
+UINT64 GetUnsharedKey(UINT resourceIdx)
+{
+    return HashValue(resourceIdx, HashString("Unshared"));
+}
+
+// For R8G8B8A8 images
+bool HasTransparency(const DecodedImage& image)
+{
+    for (size_t i = 3; i < image.Data.size(); i += 4)
+    {
+        if (image.Data[i] != 255)
+            return true;
+    }
+    return false;
+}
+
+// Every level is compressed, the ones that aren't multiples of 4 (the end of the chain) are padded with their edge texels
+template<typename CompressFunc>
+std::vector<byte> CompressMips(const DecodedImage& image, BlockFormat format, UINT pixelSize, CompressFunc compress)
+{
+    std::vector<byte> blocks;
+    std::vector<byte> padded;
+    for (UINT level = 0; level < image.MipLevels; ++level)
+    {
+        UINT w = image.GetMipWidth(level);
+        UINT h = image.GetMipHeight(level);
+        const byte* pixels = image.Data.data() + image.GetMipOffset(level);
+        UINT paddedWidth = (w + 3) & ~3U;
+        UINT paddedHeight = (h + 3) & ~3U;
+        if (paddedWidth != w || paddedHeight != h)
+        {
+            padded.resize(size_t(paddedWidth) * paddedHeight * pixelSize);
+            for (UINT y = 0; y < paddedHeight; ++y)
+                for (UINT x = 0; x < paddedWidth; ++x)
+                    memcpy(padded.data() + (size_t(y) * paddedWidth + x) * pixelSize, pixels + (size_t(std::min(y, h - 1)) * w + std::min(x, w - 1)) * pixelSize, pixelSize);
+            pixels = padded.data();
+        }
+        size_t offset = blocks.size();
+        blocks.resize(offset + GetCompressedSize(format, paddedWidth, paddedHeight));
+        compress(pixels, paddedWidth, paddedHeight, blocks.data() + offset);
+    }
+    return blocks;
+}
+
+// HDR images go to BC6H whatever the usage is
+void CompressHdrImage(const std::string& filename, DecodedImage& image, TextureCompression compression, ThreadPool* workers)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<byte> blocks = CompressMips(image, BlockFormat::BC6H, sizeof(float) * 4, [&](const byte* pixels, UINT w, UINT h, byte* out)
+    {
+        CompressBlocksBC6H(reinterpret_cast<const float*>(pixels), w, h, compression, out, workers);
+    });
+    const float* pixels = reinterpret_cast<const float*>(image.Data.data());
+    auto compressTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::vector<float> decoded(size_t(image.Width) * image.Height * 4);
+    DecompressBlocksBC6H(blocks.data(), image.Width, image.Height, decoded.data());
+    float rmse = ComputeLogRmse(pixels, decoded.data(), image.Width, image.Height);
+    LOG("Compressed ", filename, " to BC6H in ", compressTime, " ms, log2 RMSE ", rmse);
+
+    image.Data.swap(blocks);
+    image.Format = GetBlockFormatDxgi(BlockFormat::BC6H);
+}
+
+// Uncompressed HDR images go to the smallest format that holds them well enough, see ChooseHdrFormat
+void PackHdrImage(const std::string& filename, DecodedImage& image, ThreadPool* workers)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t count = image.Data.size() / (sizeof(float) * 4);
+    const float* pixels = reinterpret_cast<const float*>(image.Data.data());
+    float error = 0.0f;
+    HdrFormat format = ChooseHdrFormat(pixels, count, MaxHdrPackingError, &error);
+    if (format == HdrFormat::Float32)
+    {
+        LOG("Texture ", filename, " is out of the half float range, it stays R32G32B32A32_FLOAT");
+        return;
+    }
+
+    std::vector<byte> packed(count * GetPixelSize(GetHdrFormatDxgi(format)));
+    PackHdr(format, pixels, count, packed.data(), workers);
+    auto packTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    LOG("Packed ", filename, " to ", GetHdrFormatName(format), " in ", packTime, " ms (", GetHdrPackingIsaName(), "), log2 RMSE ", error);
+
+    image.Data.swap(packed);
+    image.Format = GetHdrFormatDxgi(format);
+}
+
+// Leaves the image as is if it can't be block compressed
+void CompressImage(const std::string& filename, DecodedImage& image, TextureUsage usage, TextureCompression compression, ThreadPool* workers)
+{
+    bool hdr = image.Format == DXGI_FORMAT_R32G32B32A32_FLOAT;
+    if ((!hdr && image.Format != DXGI_FORMAT_R8G8B8A8_UNORM) || image.Width % 4 != 0 || image.Height % 4 != 0)
+    {
+        LOG("Texture ", filename, " can't be block compressed, it stays uncompressed");
+        return;
+    }
+    if (hdr)
+    {
+        CompressHdrImage(filename, image, compression, workers);
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    BlockFormat format = GetBlockFormat(usage, compression, usage == TextureUsage::Color && HasTransparency(image));
+    std::vector<byte> blocks = CompressMips(image, format, 4, [&](const byte* pixels, UINT w, UINT h, byte* out)
+    {
+        CompressBlocks(format, pixels, w, h, out, workers);
+    });
+    auto compressTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // Quality is measured on the top level
+    std::vector<byte> decoded(size_t(image.Width) * image.Height * 4);
+    DecompressBlocks(format, blocks.data(), image.Width, image.Height, decoded.data());
+    float psnr = ComputeBlockPsnr(format, image.Data.data(), decoded.data(), image.Width, image.Height);
+    LOG("Compressed ", filename, " to ", GetBlockFormatName(format), " in ", compressTime, " ms, PSNR ", psnr, " dB");
+
+    image.Data.swap(blocks);
+    image.Format = GetBlockFormatDxgi(format);
+}
 }
 
 TextureManager::TextureManager(RenderContext& ctx)
+    : mCtx(ctx)
 {
     mMipGenerator = new MipGenerator(ctx);
-    mResources.resize(MaxResources);
+    mCache = new TextureCache(ASSETS_DIR + std::string("TextureCache\\"));
+    mResidency = new TextureResidency(*this, TextureResidencyBudget);
     CreateSRVHeap(ctx);
     CreateRTVHeap(ctx);
     CreateUAVHeap(ctx);
@@ -36,51 +182,457 @@ TextureManager::TextureManager(RenderContext& ctx)
 
 TextureManager::~TextureManager()
 {
+    // The workers write into the upload buffers of the jobs
+    for (auto& job : mResidencyJobs)
+        job->Done.wait();
+    SafeDelete(mStreamer);
+    SafeDelete(mStreamingBackend);
+    SafeDelete(mResidency);
     SafeDelete(mMipGenerator);
+    SafeDelete(mCache);
 }
 
 TexResourceData TextureManager::CreateTexture(RenderContext& ctx, const std::string& filename, bool generateMips /*= true*/, bool allowUAV /*= false*/)
 {
-    std::vector<byte> buffer;
+    return CreateTextures(ctx, { filename }, {}, TextureCompression::None, generateMips).front();
+}
 
-    std::wstring extension{ std::filesystem::path(filename.c_str()).extension().c_str() };
+std::vector<TexResourceData> TextureManager::CreateTextures(RenderContext& ctx, const std::vector<std::string>& filenames, const std::vector<TextureUsage>& usages /*= {}*/,
+    TextureCompression compression /*= TextureCompression::None*/, bool generateMips /*= false*/, bool evictable /*= false*/)
+{
+    assert(usages.empty() || usages.size() == filenames.size());
+    auto getUsage = [&usages](size_t i) { return usages.empty() ? TextureUsage::Color : usages[i]; };
+
+    // Files with the same content and options share one texture, whether it was created before or earlier in this batch.
+    // Every file is hashed once, the texture cache key is built from the same hash. Unreadable files are keyed by the name.
+    // Evictable textures move to new views, so a pinned request never gets one of them.
+    std::vector<UINT64> sourceHashes(filenames.size());
+    std::vector<UINT64> keys(filenames.size());
+    ctx.Workers->ParallelFor(filenames.size(), [&](size_t i)
+    {
+        UINT64 options = HashValue(generateMips, HashValue(getUsage(i), HashValue(compression)));
+        sourceHashes[i] = TextureCache::GetSourceHash(filenames[i]);
+        keys[i] = sourceHashes[i] != 0 ? TextureCache::GetKey(sourceHashes[i], options) : HashString(filenames[i], options);
+        if (evictable)
+            keys[i] = HashValue(evictable, keys[i]);
+    });
+    std::vector<TexResourceData> textures(filenames.size());
+    std::vector<size_t> sources(filenames.size()); // The file that is loaded for this one
+    std::vector<bool> loaded(filenames.size(), false);
+    std::map<UINT64, size_t> batchKeys;
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        UINT resourceIdx = InvalidOffset;
+        if (mRegistry.AddReference(keys[i], resourceIdx))
+        {
+            textures[i] = mRegistryEntries.at(resourceIdx).Texture;
+            sources[i] = i;
+            continue;
+        }
+        sources[i] = batchKeys.emplace(keys[i], i).first->second;
+        loaded[i] = sources[i] == i;
+    }
+
+    // PNGs the fast path decodes get their resources first, the workers write the pixels into the mapped upload buffers
+    std::vector<StagedTexture> staged(filenames.size());
+    std::vector<std::unique_ptr<MappedFile>> pngFiles(filenames.size());
+    std::vector<PngInfo> pngInfos(filenames.size());
+    if (compression == TextureCompression::None && !generateMips)
+    {
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            std::wstring extension{ std::filesystem::path(filenames[i].c_str()).extension().c_str() };
+            if (!loaded[i] || (extension != L".png" && extension != L".PNG"))
+                continue;
+            auto file = std::make_unique<MappedFile>(filenames[i]);
+            if (!file->IsValid() || !ReadPngInfo(file->GetData(), file->GetSize(), pngInfos[i]) || !IsPngFastPathSupported(pngInfos[i]))
+                continue;
+            staged[i] = BeginTextureUpload(ctx, DXGI_FORMAT_R8G8B8A8_UNORM, pngInfos[i].Width, pngInfos[i].Height, 1, filenames[i]);
+            pngFiles[i] = std::move(file);
+        }
+    }
+
+    std::vector<DecodedImage> images(filenames.size());
+    std::vector<TextureContainer> containers(filenames.size());
+    std::vector<UINT> copies(filenames.size(), 1);
+    std::vector<UINT8> failed(filenames.size(), 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    ctx.Workers->ParallelFor(filenames.size(), [&](size_t i)
+    {
+        if (!loaded[i])
+            return;
+        bool read = false;
+        if (staged[i].UploadData != nullptr)
+        {
+            copies[i] = DecodePngToStaging(pngFiles[i]->GetData(), pngFiles[i]->GetSize(), pngInfos[i], GetStagingSpan(staged[i].Layout, staged[i].UploadData, 0));
+            pngFiles[i] = nullptr;
+            read = copies[i] != 0;
+        }
+        else if (GetTextureContainerType(filenames[i]) != TextureContainerType::None)
+        {
+            // Cooked containers are only mapped, they already have their final format and mips
+            read = ReadTextureContainer(filenames[i], containers[i]);
+        }
+        else
+        {
+            read = ReadImage(filenames[i], images[i], getUsage(i), compression, generateMips, ctx.Workers, sourceHashes[i]);
+            copies[i] = images[i].CachedFile != nullptr ? 1 : 2; // Decoded to memory and copied to the upload buffer
+        }
+        if (!read)
+        {
+            LOG("Error: can't read texture ", filenames[i], ", a 1x1 fallback is used");
+            staged[i] = StagedTexture{};
+            containers[i] = TextureContainer{};
+            images[i] = GetFallbackImage(getUsage(i));
+            copies[i] = 1;
+            failed[i] = 1;
+        }
+    });
+    auto decodeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    size_t loadedCount = std::count(loaded.begin(), loaded.end(), true);
+    size_t cachedCount = std::count_if(images.begin(), images.end(), [](const DecodedImage& image) { return image.CachedFile != nullptr; });
+    size_t containersCount = std::count_if(containers.begin(), containers.end(), [](const TextureContainer& container) { return container.File != nullptr; });
+    size_t stagedCount = std::count_if(staged.begin(), staged.end(), [](const StagedTexture& texture) { return texture.UploadData != nullptr; });
+    size_t failedCount = std::count(failed.begin(), failed.end(), UINT8(1));
+    LOG("Read ", loadedCount, " of ", filenames.size(), " images (", filenames.size() - loadedCount, " shared, ", cachedCount, " from the texture cache, ",
+        containersCount, " DDS/KTX2, ", stagedCount, " decoded to upload memory, ", failedCount, " failed) in ", decodeTime, " ms on ",
+        ctx.Workers->GetThreadsCount(), " threads, ", GetPngDecoderIsaName(), " PNG unfiltering");
+
+    StagingCopies stagingCopies;
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        if (!loaded[i])
+        {
+            if (sources[i] != i)
+            {
+                UINT resourceIdx = InvalidOffset;
+                mRegistry.AddReference(keys[i], resourceIdx);
+                textures[i] = textures[sources[i]];
+            }
+            continue;
+        }
+
+        UINT64 texels = 0;
+        if (staged[i].UploadData != nullptr)
+        {
+            texels = UINT64(pngInfos[i].Width) * pngInfos[i].Height;
+            textures[i] = EndTextureUpload(ctx, staged[i]);
+        }
+        else if (containers[i].File != nullptr)
+        {
+            texels = UINT64(containers[i].Width) * containers[i].Height * std::max(containers[i].Depth, containers[i].ArraySize);
+            textures[i] = CreateTexture(ctx, containers[i], filenames[i]);
+        }
+        else
+        {
+            texels = UINT64(images[i].Width) * images[i].Height;
+            textures[i] = CreateTexture(ctx, images[i], filenames[i]);
+        }
+        stagingCopies.Add(texels, copies[i]);
+        staged[i] = StagedTexture{};
+        images[i] = DecodedImage{}; // The upload buffer has its own copy
+        containers[i] = TextureContainer{};
+
+        RegistryEntry& entry = Register(keys[i], textures[i]);
+        entry.Filename = failed[i] ? std::string() : filenames[i]; // Fallbacks are never read again
+        entry.Usage = getUsage(i);
+        entry.Compression = compression;
+        entry.GenerateMips = generateMips;
+        if (evictable)
+            MakeEvictable(textures[i]);
+    }
+    TextureRegistryStats stats = GetRegistryStats();
+    LOG("Staged ", stagingCopies.TexelsCount, " texels with ", stagingCopies.GetCopiesPerTexel(), " CPU copies per texel");
+    LOG("Texture registry: ", stats.TexturesCount, " textures, ", stats.ReferencesCount, " references, ", stats.Bytes / 1024, " KB, ",
+        stats.DedupedBytes / 1024, " KB deduplicated");
+    return textures;
+}
+
+void TextureManager::ReleaseTexture(const TexResourceData& texture)
+{
+    if (texture.StreamIdx != InvalidOffset)
+    {
+        // Streamed textures have a single owner, the backend frees the resource once the frames in flight are done
+        mStreamer->RemoveTexture(texture.StreamIdx);
+        mStreamingBackend->RemoveTexture(texture.StreamIdx);
+        return;
+    }
+    if (!mRegistry.Release(texture.ResourceIdx))
+        return;
+    auto entry = mRegistryEntries.find(texture.ResourceIdx);
+    FreeTexture(entry->second.Texture);
+    mRegistryEntries.erase(entry);
+}
+
+TextureRegistryStats TextureManager::GetRegistryStats() const
+{
+    return mRegistry.GetStats();
+}
+
+std::vector<TexResourceData> TextureManager::CreateStreamedTextures(RenderContext& ctx, const std::vector<std::string>& filenames, const std::vector<TextureUsage>& usages /*= {}*/,
+    TextureCompression compression /*= TextureCompression::None*/)
+{
+    assert(usages.empty() || usages.size() == filenames.size());
+    if (mStreamer == nullptr)
+    {
+        mStreamingBackend = new StreamingBackendDX(ctx, *this);
+        mStreamer = new TextureStreamer(*mStreamingBackend, TextureStreamingBudget);
+    }
+
+    std::vector<DecodedImage> images(filenames.size());
+    auto start = std::chrono::high_resolution_clock::now();
+    ctx.Workers->ParallelFor(filenames.size(), [&](size_t i)
+    {
+        TextureUsage usage = usages.empty() ? TextureUsage::Color : usages[i];
+        if (!ReadImage(filenames[i], images[i], usage, compression, true, ctx.Workers))
+        {
+            LOG("Error: can't read texture ", filenames[i], ", a 1x1 fallback is used");
+            images[i] = GetFallbackImage(usage);
+        }
+    });
+    auto decodeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // The images are kept by the backend, the higher mips are uploaded from them later
+    std::vector<TexResourceData> textures(filenames.size());
+    UINT64 tailBytes = 0;
+    UINT64 fullBytes = 0;
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        const DecodedImage& image = images[i];
+        UINT streamIdx = mStreamer->AddTexture({ image.Format, image.Width, image.Height, image.MipLevels });
+        UINT tailMip = mStreamer->GetTailMip(streamIdx);
+        tailBytes += mStreamer->GetChainSize(streamIdx, tailMip);
+        fullBytes += mStreamer->GetChainSize(streamIdx, 0);
+        textures[i] = mStreamingBackend->AddTexture(streamIdx, std::move(images[i]), tailMip, filenames[i]);
+        textures[i].StreamIdx = streamIdx;
+    }
+    LOG("Read ", filenames.size(), " streamed images in ", decodeTime, " ms, ", tailBytes / 1024, " KB of mip tails resident out of ", fullBytes / 1024, " KB");
+    return textures;
+}
+
+std::vector<TexResourceData> TextureManager::CreatePackedTextures(RenderContext& ctx, const std::vector<std::string>& filenames, std::vector<TexturePlacement>& placements,
+    const std::vector<TextureUsage>& usages /*= {}*/, TextureCompression compression /*= TextureCompression::None*/, bool generateMips /*= false*/,
+    const TexturePackingOptions& options /*= {}*/)
+{
+    assert(usages.empty() || usages.size() == filenames.size());
+    std::vector<DecodedImage> images(filenames.size());
+    auto start = std::chrono::high_resolution_clock::now();
+    ctx.Workers->ParallelFor(filenames.size(), [&](size_t i)
+    {
+        TextureUsage usage = usages.empty() ? TextureUsage::Color : usages[i];
+        if (!ReadImage(filenames[i], images[i], usage, compression, generateMips, ctx.Workers))
+        {
+            LOG("Error: can't read texture ", filenames[i], ", a 1x1 fallback is used");
+            images[i] = GetFallbackImage(usage);
+        }
+    });
+    auto decodeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::vector<PackedTextureDesc> descs(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i)
+        descs[i] = { images[i].Format, images[i].Width, images[i].Height, images[i].MipLevels };
+    TexturePacking packing = PackTextures(descs, options);
+    placements = packing.Placements;
+
+    // Gaps between the padded rects are never sampled and keep whatever the upload buffer had
+    std::vector<TexResourceData> textures(filenames.size());
+    for (size_t page = 0; page < packing.Pages.size(); ++page)
+    {
+        const AtlasPage& atlas = packing.Pages[page];
+        StagedTexture staged = BeginTextureUpload(ctx, atlas.Format, atlas.Width, atlas.Height, atlas.MipLevels, "AtlasPage" + std::to_string(page));
+        ctx.Workers->ParallelFor(atlas.Textures.size() * atlas.MipLevels, [&](size_t i)
+        {
+            UINT texture = atlas.Textures[i / atlas.MipLevels];
+            UINT level = static_cast<UINT>(i % atlas.MipLevels);
+            CopyToAtlasPage(images[texture], placements[texture], options.Padding, level, GetStagingSpan(staged.Layout, staged.UploadData, level));
+        });
+        TexResourceData pageTexture = EndTextureUpload(ctx, staged);
+        Register(GetUnsharedKey(pageTexture.ResourceIdx), pageTexture, static_cast<UINT>(atlas.Textures.size()));
+        for (UINT texture : atlas.Textures)
+            textures[texture] = pageTexture;
+    }
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        if (placements[i].Page == InvalidAtlasPage)
+        {
+            textures[i] = CreateTexture(ctx, images[i], filenames[i]);
+            Register(GetUnsharedKey(textures[i].ResourceIdx), textures[i]);
+        }
+        images[i] = DecodedImage{};
+    }
+
+    const TexturePackingStats& stats = packing.Stats;
+    LOG("Read ", filenames.size(), " images in ", decodeTime, " ms, packed ", stats.PackedCount, " of them into ", stats.PagesCount, " atlas pages, ",
+        stats.GetResourcesCount(), " textures instead of ", stats.TexturesCount, ", ", stats.GetWastedFraction() * 100.0f, "% of the pages wasted");
+    return textures;
+}
+
+UINT TextureManager::GetSrvOffset(const TexResourceData& texture) const
+{
+    if (texture.StreamIdx != InvalidOffset)
+        return mStreamingBackend->GetSrvOffset(texture.StreamIdx);
+    auto entry = mRegistryEntries.find(texture.ResourceIdx);
+    return entry != mRegistryEntries.end() ? entry->second.Texture.SRVOffset : texture.SRVOffset;
+}
+
+void TextureManager::UpdateStreaming()
+{
+    if (mStreamer == nullptr)
+        return;
+    mStreamingBackend->Update();
+    bool settled = mStreamer->GetStats().FullQualityTime >= 0.0f;
+    mStreamer->Update();
+    TextureStreamingStats stats = mStreamer->GetStats();
+    if (!settled && stats.FullQualityTime >= 0.0f)
+    {
+        LOG("Texture streaming: first frame after ", stats.FirstFrameTime, " ms, full quality after ", stats.FullQualityTime, " ms, ",
+            stats.ResidentBytes / 1024, " KB resident, ", stats.WantedBytes / 1024, " KB wanted, ", stats.Budget / 1024, " KB budget");
+    }
+}
+
+void TextureManager::MakeEvictable(const TexResourceData& texture)
+{
+    auto entry = mRegistryEntries.find(texture.ResourceIdx);
+    assert(entry != mRegistryEntries.end() && "The texture wasn't created from a file");
+    if (entry == mRegistryEntries.end())
+        return;
+    const std::string& filename = entry->second.Filename;
+    if (filename.empty() || GetTextureContainerType(filename) != TextureContainerType::None)
+        return;
+    mResidency->SetEvictable(mResidencyIds.at(texture.ResourceIdx));
+}
+
+void TextureManager::MarkTextureUsed(const TexResourceData& texture)
+{
+    auto residencyIdx = mResidencyIds.find(texture.ResourceIdx);
+    if (residencyIdx != mResidencyIds.end())
+        mResidency->MarkUsed(residencyIdx->second);
+}
+
+void TextureManager::UpdateResidency()
+{
+    ++mResidencyFrame;
+    while (!mPendingUploads.empty() && mResidencyFrame - mPendingUploads.front().Frame > RenderContext::FramesCount)
+    {
+        const PendingUpload& upload = mPendingUploads.front();
+        mUploadResources[upload.UploadResourceIdx] = ResourceDX{};
+        mFreeUploadResources.push_back(upload.UploadResourceIdx);
+        if (upload.ResidencyIdx != InvalidOffset)
+            mResidency->ReleaseUploadBytes(upload.ResidencyIdx, upload.Bytes);
+        mPendingUploads.pop_front();
+    }
+    while (!mRetiredResources.empty() && mResidencyFrame - mRetiredResources.front().Frame > RenderContext::FramesCount)
+    {
+        UINT srvOffset = mRetiredResources.front().SRVOffset;
+        if (srvOffset != InvalidOffset && srvOffset < RenderContext::CubemapsRangeStarts)
+            mFreeSrvOffsets.push_back(srvOffset);
+        mRetiredResources.pop_front();
+    }
+    LandResidencyJobs();
+
+    TextureResidencyStats before = mResidency->GetStats();
+    mResidency->Update();
+    TextureResidencyStats after = mResidency->GetStats();
+    if (after.Demotions != before.Demotions || after.Evictions != before.Evictions)
+    {
+        LOG("Texture residency: ", after.Demotions - before.Demotions, " demoted, ", after.Evictions - before.Evictions, " evicted, ",
+            after.ResidentBytes / 1024, " KB resident of ", after.Budget / 1024, " KB budget");
+    }
+}
+
+TextureResidencyStats TextureManager::GetResidencyStats() const
+{
+    return mResidency->GetStats();
+}
 
-    UINT w = 0, h = 0;
-    DXGI_FORMAT textureFormat{};
+bool TextureManager::ReadImage(const std::string& filename, DecodedImage& image, TextureUsage usage /*= TextureUsage::Color*/,
+    TextureCompression compression /*= TextureCompression::None*/, bool generateMips /*= false*/, ThreadPool* workers /*= nullptr*/, UINT64 sourceHash /*= 0*/) const
+{
+    UINT64 options = compression == TextureCompression::None && !generateMips ? 0 : HashValue(generateMips, HashValue(usage, HashValue(compression)));
+    UINT64 key = TextureCache::GetKey(sourceHash != 0 ? sourceHash : TextureCache::GetSourceHash(filename), options);
+    if (key != 0 && mCache->Load(key, image))
+        return true;
+    if (!DecodeImage(filename, image, workers))
+        return false;
+    if (generateMips)
+    {
+        bool transparent = usage == TextureUsage::Color && image.Format == DXGI_FORMAT_R8G8B8A8_UNORM && HasTransparency(image);
+        BuildMips(image, GetMipBuildOptions(usage, compression, transparent), workers);
+    }
+    if (compression != TextureCompression::None)
+        CompressImage(filename, image, usage, compression, workers);
+    else if (image.Format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+        PackHdrImage(filename, image, workers);
+    if (key != 0)
+        mCache->Store(key, image);
+    return true;
+}
+
+bool TextureManager::DecodeImage(const std::string& filename, DecodedImage& image, ThreadPool* workers /*= nullptr*/)
+{
+    std::wstring extension{ std::filesystem::path(filename.c_str()).extension().c_str() };
 
     if (extension == L".png" || extension == L".PNG") // let's hope there won't be "pNg" or "PnG" etc
     {
-        bool success = ParsePNG(filename, buffer, w, h, textureFormat);
+        return ParsePNG(filename, image.Data, image.Width, image.Height, image.Format);
     }
     else if (extension == L".exr" || extension == L".EXR")
     {
-        bool success = ParseEXR(filename, buffer, w, h, textureFormat);
+        return ParseEXR(filename, image.Data, image.Width, image.Height, image.Format, workers);
     }
     else if (extension == L".hdr" || extension == L".HDR")
     {
-        bool success = ParseHDR(filename, buffer, w, h, textureFormat);
+        return ParseHDR(filename, image.Data, image.Width, image.Height, image.Format);
     }
     else
     {
         assert("Unknown image format for parsing" && false);
+        return false;
     }
+}
 
+TexResourceData TextureManager::CreateTexture(RenderContext& ctx, const DecodedImage& image, const std::string& name)
+{
+    assert(image.Width > 0 && image.Height > 0 && "Image wasn't decoded");
+    assert(image.GetPixelsSize() >= image.GetMipOffset(image.MipLevels) && "Decoded image is smaller than its description");
+    StagedTexture texture = BeginTextureUpload(ctx, image.Format, image.Width, image.Height, image.MipLevels, name);
+    for (UINT level = 0; level < image.MipLevels; ++level)
+        CopyToStaging(image.GetPixels() + image.GetMipOffset(level), GetStagingSpan(texture.Layout, texture.UploadData, level));
+    return EndTextureUpload(ctx, texture);
+}
+
+TexResourceData TextureManager::CreateTexture(RenderContext& ctx, const TextureContainer& container, const std::string& name)
+{
+    return CreateContainerTexture(ctx, container, name, InvalidOffset);
+}
+
+void TextureManager::ReplaceCubemap(RenderContext& ctx, TexResourceData& cubemap, const TextureContainer& container, const std::string& name)
+{
+    assert(container.Cubemap && cubemap.SRVOffset >= RenderContext::CubemapsRangeStarts && "Only cubemap views can be replaced");
+    TexResourceData replacement = CreateContainerTexture(ctx, container, name, cubemap.SRVOffset);
+    FreeTexture(cubemap);
+    cubemap.ResourceIdx = replacement.ResourceIdx;
+    cubemap.Resource = replacement.Resource;
+    cubemap.UAVOffset = InvalidOffset;
+}
+
+TexResourceData TextureManager::CreateContainerTexture(RenderContext& ctx, const TextureContainer& container, const std::string& name, UINT srvOffset)
+{
+    assert(!container.Subresources.empty() && "Texture container wasn't read");
     ResourceDX resource{ D3D12_RESOURCE_STATE_COPY_DEST };
     ResourceDX uploadResource{ D3D12_RESOURCE_STATE_GENERIC_READ };
-
-    UINT16 mipLevels = generateMips ? Log2(std::min(w, h)) + 1 : 1;
-    D3D12_RESOURCE_FLAGS flags = generateMips ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
+    bool volume = container.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
 
     D3D12_RESOURCE_DESC texDesc = {};
-    texDesc.MipLevels = mipLevels;
-    texDesc.Format = textureFormat;
-    texDesc.Width = w; // TODO: to the next pot (h too)
-    texDesc.Height = h;
-    texDesc.Flags = flags;
-    texDesc.DepthOrArraySize = 1;
+    texDesc.MipLevels = static_cast<UINT16>(container.MipLevels);
+    texDesc.Format = container.Format;
+    texDesc.Width = container.Width;
+    texDesc.Height = container.Height;
+    texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    texDesc.DepthOrArraySize = static_cast<UINT16>(volume ? container.Depth : container.ArraySize);
     texDesc.SampleDesc.Count = 1;
     texDesc.SampleDesc.Quality = 0;
-    texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    texDesc.Dimension = container.Dimension;
 
     CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
     ThrowIfFailed(ctx.Device->CreateCommittedResource(&heapProperties,
@@ -91,13 +643,13 @@ TexResourceData TextureManager::CreateTexture(RenderContext& ctx, const std::str
         IID_PPV_ARGS(resource.GetAddressOf())));
 
 #if defined(_DEBUG)
-    std::wstring s{ filename.begin(), filename.end() };
+    std::wstring s{ name.begin(), name.end() };
     SetDXobjectName(resource.Get(), s.c_str());
 #endif
 
-    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(resource.Get(), 0, 1);
+    UINT subresourcesCount = static_cast<UINT>(container.Subresources.size());
+    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(resource.Get(), 0, subresourcesCount);
 
-    size_t texSize = buffer.size() * sizeof(byte);
     CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
     CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
     ThrowIfFailed(ctx.Device->CreateCommittedResource(
@@ -108,36 +660,74 @@ TexResourceData TextureManager::CreateTexture(RenderContext& ctx, const std::str
         nullptr,
         IID_PPV_ARGS(uploadResource.GetAddressOf())));
 
-    D3D12_SUBRESOURCE_DATA texData = {};
-    texData.pData = buffer.data();
-    texData.RowPitch = size_t(w) * GetPixelSize(textureFormat);
-    texData.SlicePitch = texData.RowPitch * h;
-
-    UpdateSubresources(ctx.CommandList, resource.Get(), uploadResource.Get(), 0, 0, 1, &texData);
+    UpdateSubresources(ctx.CommandList, resource.Get(), uploadResource.Get(), 0, 0, subresourcesCount, container.Subresources.data());
     resource.Transition(ctx.CommandList, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
     D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
     viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    viewDesc.Format = resource.Get()->GetDesc().Format;
-    viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    viewDesc.Texture2D.MipLevels = resource.Get()->GetDesc().MipLevels;
-    viewDesc.Texture2D.MostDetailedMip = 0;
-    viewDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+    viewDesc.Format = container.Format;
+    TexResourceData res{};
+    if (container.Cubemap)
+    {
+        // Same descriptor range as the cubemaps made by CreateCubemap
+        if (container.ArraySize > 6)
+        {
+            viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBEARRAY;
+            viewDesc.TextureCubeArray.MipLevels = container.MipLevels;
+            viewDesc.TextureCubeArray.NumCubes = container.ArraySize / 6;
+        }
+        else
+        {
+            viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+            viewDesc.TextureCube.MipLevels = container.MipLevels;
+        }
+        res.SRVOffset = srvOffset != InvalidOffset ? srvOffset : RenderContext::CubemapsRangeStarts + mCurrentCubemapCount++;
+    }
+    else
+    {
+        switch (container.Dimension)
+        {
+        case D3D12_RESOURCE_DIMENSION_TEXTURE1D:
+            if (container.ArraySize > 1)
+            {
+                viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1DARRAY;
+                viewDesc.Texture1DArray.MipLevels = container.MipLevels;
+                viewDesc.Texture1DArray.ArraySize = container.ArraySize;
+            }
+            else
+            {
+                viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1D;
+                viewDesc.Texture1D.MipLevels = container.MipLevels;
+            }
+            break;
+        case D3D12_RESOURCE_DIMENSION_TEXTURE3D:
+            viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+            viewDesc.Texture3D.MipLevels = container.MipLevels;
+            break;
+        default:
+            if (container.ArraySize > 1)
+            {
+                viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+                viewDesc.Texture2DArray.MipLevels = container.MipLevels;
+                viewDesc.Texture2DArray.ArraySize = container.ArraySize;
+            }
+            else
+            {
+                viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+                viewDesc.Texture2D.MipLevels = container.MipLevels;
+            }
+            break;
+        }
+        res.SRVOffset = srvOffset != InvalidOffset ? srvOffset : AllocateSrvOffset();
+    }
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mSrvHeap->GetCPUDescriptorHandleForHeapStart());
-    handle.Offset(mCurrentTexCount * ctx.CbvSrvUavDescriptorSize);
+    handle.Offset(res.SRVOffset * ctx.CbvSrvUavDescriptorSize);
     ctx.Device->CreateShaderResourceView(resource.Get(), &viewDesc, handle);
 
-    mResources.push_back(resource);
-    mUploadResources.push_back(uploadResource);
-
-    TexResourceData res{};
-    res.SRVOffset = mCurrentTexCount++;
-    res.ResourceIdx = static_cast<UINT>(mResources.size()) - 1;
-    res.Resource = &mResources.back();
-
-    if (generateMips)
-        mMipGenerator->GenerateMips(ctx, &mResources.back());
+    res.ResourceIdx = AddResource(resource);
+    res.Resource = &mResources[res.ResourceIdx];
+    TrackResource(res.ResourceIdx, AddUploadResource(uploadResource));
 
     return res;
 }
@@ -173,9 +763,9 @@ DirectxPlayground::TexResourceData TextureManager::CreateTexture(RenderContext&
 
     res.SRVOffset = mCurrentTexCount++;
 
-    mResources.push_back(resource);
-    res.ResourceIdx = static_cast<UINT>(mResources.size()) - 1;
-    res.Resource = &mResources.back();
+    res.ResourceIdx = AddResource(resource);
+    res.Resource = &mResources[res.ResourceIdx];
+    TrackResource(res.ResourceIdx);
 
     return res;
 }
@@ -225,7 +815,6 @@ DirectxPlayground::TexResourceData TextureManager::CreateCubemap(RenderContext&
 
     TexResourceData res{};
     res.SRVOffset = RenderContext::CubemapsRangeStarts + mCurrentCubemapCount;
-    res.ResourceIdx = static_cast<UINT>(mResources.size()) - 1;
     ++mCurrentCubemapCount;
 
     if (allowUAV)
@@ -243,8 +832,9 @@ DirectxPlayground::TexResourceData TextureManager::CreateCubemap(RenderContext&
         res.UAVOffset = mCurrentUavCount++;
     }
 
-    mResources.push_back(resource);
-    res.Resource = &mResources.back();
+    res.ResourceIdx = AddResource(resource);
+    res.Resource = &mResources[res.ResourceIdx];
+    TrackResource(res.ResourceIdx);
 
     return res;
 }
@@ -292,6 +882,11 @@ UINT TextureManager::CreateDxrOutput(RenderContext& ctx, D3D12_RESOURCE_DESC des
     CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mSrvHeap->GetCPUDescriptorHandleForHeapStart());
     handle.Offset(mCurrentTexCount * ctx.CbvSrvUavDescriptorSize);
     ctx.Device->CreateShaderResourceView(mRtResource.Get(), &srvDesc, handle);
+
+    // Counted, it lives outside mResources though
+    D3D12_RESOURCE_DESC rtDesc = mRtResource.Get()->GetDesc();
+    UINT residencyIdx = mResidency->AddTexture({ rtDesc.Format, static_cast<UINT>(rtDesc.Width), rtDesc.Height, rtDesc.DepthOrArraySize, rtDesc.MipLevels });
+    mResidencyResources[residencyIdx] = InvalidOffset;
     return mCurrentTexCount++;
 }
 
@@ -300,48 +895,315 @@ void TextureManager::FlushMipsQueue(RenderContext& ctx)
     mMipGenerator->Flush(ctx);
 }
 
+UINT TextureManager::AddResource(const ResourceDX& resource)
+{
+    if (mFreeResources.empty())
+    {
+        mResources.push_back(resource);
+        return static_cast<UINT>(mResources.size()) - 1;
+    }
+    UINT index = mFreeResources.back();
+    mFreeResources.pop_back();
+    mResources[index] = resource;
+    return index;
+}
+
+UINT TextureManager::AddUploadResource(const ResourceDX& resource)
+{
+    if (mFreeUploadResources.empty())
+    {
+        mUploadResources.push_back(resource);
+        return static_cast<UINT>(mUploadResources.size()) - 1;
+    }
+    UINT index = mFreeUploadResources.back();
+    mFreeUploadResources.pop_back();
+    mUploadResources[index] = resource;
+    return index;
+}
+
+UINT TextureManager::AllocateSrvOffset()
+{
+    if (mFreeSrvOffsets.empty())
+        return mCurrentTexCount++;
+    UINT offset = mFreeSrvOffsets.back();
+    mFreeSrvOffsets.pop_back();
+    return offset;
+}
+
+TextureManager::StagedTexture TextureManager::BeginTextureUpload(RenderContext& ctx, DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels, const std::string& name) const
+{
+    StagedTexture texture;
+
+    D3D12_RESOURCE_DESC texDesc = {};
+    texDesc.MipLevels = static_cast<UINT16>(mipLevels);
+    texDesc.Format = format;
+    texDesc.Width = width; // TODO: to the next pot (h too)
+    texDesc.Height = height;
+    texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    texDesc.DepthOrArraySize = 1;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.SampleDesc.Quality = 0;
+    texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(ctx.Device->CreateCommittedResource(&heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &texDesc,
+        texture.Resource.GetCurrentState(),
+        nullptr,
+        IID_PPV_ARGS(texture.Resource.GetAddressOf())));
+
+#if defined(_DEBUG)
+    std::wstring s{ name.begin(), name.end() };
+    SetDXobjectName(texture.Resource.Get(), s.c_str());
+#endif
+
+    texture.Layout = ComputeStagingLayout(format, width, height, mipLevels);
+    assert(texture.Layout.TotalSize == GetRequiredIntermediateSize(texture.Resource.Get(), 0, mipLevels) && "Staging layout differs from the device one");
+
+    CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(texture.Layout.TotalSize);
+    ThrowIfFailed(ctx.Device->CreateCommittedResource(
+        &uploadHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        texture.UploadResource.GetCurrentState(),
+        nullptr,
+        IID_PPV_ARGS(texture.UploadResource.GetAddressOf())));
+
+    // Write-only from the CPU
+    CD3DX12_RANGE readRange(0, 0);
+    void* data = nullptr;
+    ThrowIfFailed(texture.UploadResource.Get()->Map(0, &readRange, &data));
+    texture.UploadData = static_cast<byte*>(data);
+    return texture;
+}
+
+TexResourceData TextureManager::EndTextureUpload(RenderContext& ctx, StagedTexture& texture, const TexResourceData* replaced /*= nullptr*/)
+{
+    texture.UploadResource.Get()->Unmap(0, nullptr);
+    texture.UploadData = nullptr;
+    for (UINT i = 0; i < static_cast<UINT>(texture.Layout.Footprints.size()); ++i)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION dst(texture.Resource.Get(), i);
+        CD3DX12_TEXTURE_COPY_LOCATION src(texture.UploadResource.Get(), texture.Layout.Footprints[i]);
+        ctx.CommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+    texture.Resource.Transition(ctx.CommandList, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+    viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    viewDesc.Format = texture.Resource.Get()->GetDesc().Format;
+    viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    viewDesc.Texture2D.MipLevels = texture.Resource.Get()->GetDesc().MipLevels;
+    viewDesc.Texture2D.MostDetailedMip = 0;
+    viewDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+    TexResourceData res{};
+    res.SRVOffset = AllocateSrvOffset();
+    CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mSrvHeap->GetCPUDescriptorHandleForHeapStart());
+    handle.Offset(res.SRVOffset * ctx.CbvSrvUavDescriptorSize);
+    ctx.Device->CreateShaderResourceView(texture.Resource.Get(), &viewDesc, handle);
+
+    UINT uploadResourceIdx = AddUploadResource(texture.UploadResource);
+    if (replaced != nullptr)
+    {
+        // The frames in flight still read the old view
+        UINT srvOffset = res.SRVOffset;
+        res = *replaced;
+        res.SRVOffset = srvOffset;
+        mRetiredResources.push_back({ mResources[res.ResourceIdx], replaced->SRVOffset, mResidencyFrame });
+        mResources[res.ResourceIdx] = texture.Resource;
+        TrackUpload(mResidencyIds.at(res.ResourceIdx), uploadResourceIdx);
+        return res;
+    }
+
+    res.ResourceIdx = AddResource(texture.Resource);
+    res.Resource = &mResources[res.ResourceIdx];
+    TrackResource(res.ResourceIdx, uploadResourceIdx);
+
+    return res;
+}
+
+void TextureManager::FreeTexture(const TexResourceData& texture)
+{
+    auto residencyIdx = mResidencyIds.find(texture.ResourceIdx);
+    if (residencyIdx != mResidencyIds.end())
+    {
+        // Its uploads in flight still go with their frames, the slot can be someone else's by then
+        for (auto& upload : mPendingUploads)
+        {
+            if (upload.ResidencyIdx == residencyIdx->second)
+                upload.ResidencyIdx = InvalidOffset;
+        }
+        mResidency->RemoveTexture(residencyIdx->second);
+        mResidencyResources.erase(residencyIdx->second);
+        mResidencyIds.erase(residencyIdx);
+    }
+    if (texture.ResourceIdx != InvalidOffset)
+    {
+        mResources[texture.ResourceIdx] = ResourceDX{};
+        mFreeResources.push_back(texture.ResourceIdx);
+    }
+    // Cubemap views have their own range, only the 2D ones are reused
+    if (texture.SRVOffset < RenderContext::CubemapsRangeStarts)
+        mFreeSrvOffsets.push_back(texture.SRVOffset);
+}
+
+void TextureManager::TrackResource(UINT resourceIdx, UINT uploadResourceIdx /*= InvalidOffset*/)
+{
+    D3D12_RESOURCE_DESC desc = mResources[resourceIdx].Get()->GetDesc();
+    bool volume = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+    UINT residencyIdx = mResidency->AddTexture({ desc.Format, static_cast<UINT>(desc.Width), desc.Height, desc.DepthOrArraySize, desc.MipLevels, volume });
+    mResidencyIds[resourceIdx] = residencyIdx;
+    mResidencyResources[residencyIdx] = resourceIdx;
+    if (uploadResourceIdx != InvalidOffset)
+        TrackUpload(residencyIdx, uploadResourceIdx);
+}
+
+// The copy is recorded in this frame, the buffer goes with the frame
+void TextureManager::TrackUpload(UINT residencyIdx, UINT uploadResourceIdx)
+{
+    UINT64 bytes = mUploadResources[uploadResourceIdx].Get()->GetDesc().Width;
+    mResidency->AddUploadBytes(residencyIdx, bytes);
+    mPendingUploads.push_back({ uploadResourceIdx, residencyIdx, bytes, mResidencyFrame });
+}
+
+TextureManager::RegistryEntry& TextureManager::Register(UINT64 key, const TexResourceData& texture, UINT refCount /*= 1*/)
+{
+    const PendingUpload& upload = mPendingUploads.back();
+    assert(upload.ResidencyIdx == mResidencyIds.at(texture.ResourceIdx) && "The texture wasn't the last one uploaded");
+    mRegistry.Add(key, texture.ResourceIdx, upload.Bytes, refCount);
+    RegistryEntry& entry = mRegistryEntries[texture.ResourceIdx];
+    entry = RegistryEntry{};
+    entry.Texture = texture;
+    return entry;
+}
+
+TextureManager::RegistryEntry& TextureManager::GetResidentEntry(UINT residencyIdx)
+{
+    return mRegistryEntries.at(mResidencyResources.at(residencyIdx));
+}
+
+// The texture moves to a new null view of the same format, the old view and resource are retired. A read in flight is dropped.
+void TextureManager::Evict(UINT texture)
+{
+    RegistryEntry& entry = GetResidentEntry(texture);
+    entry.ResidencyJob = 0;
+    D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+    viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    viewDesc.Format = mResidency->GetDesc(texture).Format;
+    viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    viewDesc.Texture2D.MipLevels = 1;
+    UINT srvOffset = AllocateSrvOffset();
+    CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mSrvHeap->GetCPUDescriptorHandleForHeapStart());
+    handle.Offset(srvOffset * mCtx.CbvSrvUavDescriptorSize);
+    mCtx.Device->CreateShaderResourceView(nullptr, &viewDesc, handle);
+
+    ResourceDX& resource = mResources[entry.Texture.ResourceIdx];
+    mRetiredResources.push_back({ resource, entry.Texture.SRVOffset, mResidencyFrame });
+    resource = ResourceDX{};
+    entry.Texture.SRVOffset = srvOffset;
+}
+
+// Reads the image again on the workers, it's in the texture cache when it has mips or compression. The texture keeps its view
+// until the read lands, a newer demotion, restore or eviction drops it.
+void TextureManager::SetResidentMip(UINT texture, UINT mostDetailedMip)
+{
+    RegistryEntry& entry = GetResidentEntry(texture);
+    const ResidentTextureDesc& desc = mResidency->GetDesc(texture);
+    mostDetailedMip = std::min(mostDetailedMip, desc.MipLevels - 1);
+    auto job = std::make_unique<ResidencyJob>();
+    job->Id = ++mLastResidencyJob;
+    job->ResourceIdx = entry.Texture.ResourceIdx;
+    job->Staged = BeginTextureUpload(mCtx, desc.Format, std::max(desc.Width >> mostDetailedMip, 1U), std::max(desc.Height >> mostDetailedMip, 1U),
+        desc.MipLevels - mostDetailedMip, entry.Filename);
+    entry.ResidencyJob = job->Id;
+
+    ResidencyJob* target = job.get();
+    auto read = std::make_shared<std::packaged_task<void()>>([this, target, entry, desc, mostDetailedMip]()
+    {
+        // Already on a worker, waiting on the pool from here could stall it
+        DecodedImage image;
+        if (!ReadImage(entry.Filename, image, entry.Usage, entry.Compression, entry.GenerateMips))
+            return;
+        if (image.Format != desc.Format || image.Width != desc.Width || image.Height != desc.Height || image.MipLevels != desc.MipLevels)
+            return; // The file changed since it was loaded
+        for (UINT level = mostDetailedMip; level < image.MipLevels; ++level)
+            CopyToStaging(image.GetPixels() + image.GetMipOffset(level), GetStagingSpan(target->Staged.Layout, target->Staged.UploadData, level - mostDetailedMip));
+        target->Read = true;
+    });
+    job->Done = read->get_future();
+    mResidencyJobs.push_back(std::move(job));
+    mCtx.Workers->Run([read]() { (*read)(); });
+}
+
+// The finished reads that are still wanted replace their textures, in the order they were queued
+void TextureManager::LandResidencyJobs()
+{
+    for (auto& job : mResidencyJobs)
+    {
+        if (job->Done.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+        auto entry = mRegistryEntries.find(job->ResourceIdx);
+        if (entry != mRegistryEntries.end() && entry->second.ResidencyJob == job->Id)
+        {
+            entry->second.ResidencyJob = 0;
+            if (job->Read)
+                entry->second.Texture = EndTextureUpload(mCtx, job->Staged, &entry->second.Texture);
+            else
+                LOG("Can't read ", entry->second.Filename, " again, the texture stays as it is");
+        }
+        job = nullptr;
+    }
+    mResidencyJobs.erase(std::remove(mResidencyJobs.begin(), mResidencyJobs.end(), nullptr), mResidencyJobs.end());
+}
+
+// The file is mapped, 8 bit images are decoded by PngDecoder straight to RGBA rows. 16 bit and interlaced ones are left to lodepng.
 bool TextureManager::ParsePNG(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat)
 {
-    std::vector<byte> bufferInMemory;
-    lodepng::load_file(bufferInMemory, filename);
-    UINT error = lodepng::decode(buffer, w, h, bufferInMemory);
+    MappedFile file(filename);
+    PngInfo info;
+    if (!file.IsValid() || !ReadPngInfo(file.GetData(), file.GetSize(), info))
+    {
+        LOG("PNG decoding error, ", filename, " isn't a PNG");
+        return false;
+    }
+
+    textureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+    if (IsPngFastPathSupported(info))
+    {
+        w = info.Width;
+        h = info.Height;
+        buffer.resize(size_t(w) * h * 4);
+        if (DecodePng(file.GetData(), file.GetSize(), info, buffer.data(), size_t(w) * 4))
+            return true;
+    }
+
+    UINT error = lodepng::decode(buffer, w, h, file.GetData(), file.GetSize());
     if (error)
     {
         LOG("PNG decoding error ", error, " : ", lodepng_error_text(error), "\n");
         return false;
     }
-    textureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
     return true;
 }
 
-bool TextureManager::ParseEXR(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat)
+// The file is mapped rather than read and decoded straight into the buffer, see DecodeExr
+bool TextureManager::ParseEXR(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat, ThreadPool* workers)
 {
-    int width = 0, height = 0;
-    float* out = nullptr;
-    const char* err = nullptr;
-    int ret = LoadEXR(&out, &width, &height, filename.c_str(), &err);
-    if (ret != TINYEXR_SUCCESS)
+    MappedFile file(filename);
+    if (!file.IsValid())
     {
-        if (err != nullptr)
-        {
-            LOG("EXR decoding error ", err);
-            FreeEXRErrorMessage(err);
-        }
+        LOG("EXR decoding error, can't open ", filename);
         return false;
     }
-    else
+    if (!DecodeExr(file.GetData(), file.GetSize(), buffer, w, h, workers))
     {
-        w = static_cast<UINT>(width);
-        h = static_cast<UINT>(height);
-
-        size_t imageSize = size_t(w) * size_t(h) * sizeof(float) * 4U;
-        buffer.resize(imageSize);
-        memcpy(buffer.data(), out, imageSize);
-
-        textureFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
-
-        free(out);
+        LOG("EXR decoding error in ", filename);
+        return false;
     }
+    textureFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
     return true;
 }
 
@@ -433,9 +1295,9 @@ TexResourceData TextureManager::CreateRT(RenderContext& ctx, D3D12_RESOURCE_DESC
 
         res.SRVOffset = mCurrentTexCount++;
     }
-    mResources.push_back(resource);
-    res.ResourceIdx = static_cast<UINT>(mResources.size()) - 1;
-    res.Resource = &mResources.back();
+    res.ResourceIdx = AddResource(resource);
+    res.Resource = &mResources[res.ResourceIdx];
+    TrackResource(res.ResourceIdx);
 
     return res;
 }
@@ -1,18 +1,34 @@
 #pragma once
 
 #include <cassert>
+#include <deque>
+#include <future>
+#include <memory>
 #include <string>
 #include <map>
+#include <vector>
 
 #include <wrl.h>
 #include "External/Dx12Helpers/d3dx12.h"
 #include "DXrenderer/RenderContext.h"
+#include "DXrenderer/Textures/BlockCompression.h"
+#include "DXrenderer/Textures/HdrPacking.h"
+#include "DXrenderer/Textures/MipBuilder.h"
 #include "DXrenderer/Textures/MipGenerator.h"
+#include "DXrenderer/Textures/PngDecoder.h"
+#include "DXrenderer/Textures/StagingLayout.h"
+#include "DXrenderer/Textures/TextureCache.h"
+#include "DXrenderer/Textures/TextureContainer.h"
+#include "DXrenderer/Textures/TexturePacker.h"
+#include "DXrenderer/Textures/TextureRegistry.h"
+#include "DXrenderer/Textures/TextureResidency.h"
 #include "DXrenderer/ResourceDX.h"
 
 namespace DirectxPlayground
 {
 struct RenderContext;
+class StreamingBackendDX;
+class TextureStreamer;
 
 constexpr UINT InvalidOffset = 0xFFFFFFFF;
 
@@ -22,21 +38,64 @@ struct TexResourceData
     UINT SRVOffset = InvalidOffset;
     UINT UAVOffset = InvalidOffset;
     UINT ResourceIdx = InvalidOffset;
+    UINT StreamIdx = InvalidOffset; // Set for streamed textures, their view changes as the mips come and go
 
     ResourceDX* Resource = nullptr;
 };
 
-class TextureManager
+// Every texture it creates is counted by the residency, see TextureResidency.h
+class TextureManager : private ITextureResidencyBackend
 {
 public:
     TextureManager(RenderContext& ctx);
-    ~TextureManager();
+    ~TextureManager() override;
 
     TexResourceData CreateTexture(RenderContext& ctx, const std::string& filename, bool generateMips = false, bool allowUAV = false);
+    // Uploads every mip level the image has
+    TexResourceData CreateTexture(RenderContext& ctx, const DecodedImage& image, const std::string& name);
+    // Subresource by subresource, arrays get array views and cubemaps go to the cubemaps range
+    TexResourceData CreateTexture(RenderContext& ctx, const TextureContainer& container, const std::string& name);
+    // Files are decoded on the worker pool, resources, descriptors and uploads are created on the calling thread in the files order.
+    // Usages can be empty, all the textures are Color then. Mips are built on the CPU before the compression, see MipBuilder.h.
+    // DDS and KTX2 files skip all of that and are uploaded as they are stored. PNGs that need neither are decoded straight into
+    // their mapped upload buffers. Textures are registered by the file content and the options, a repeated request returns
+    // the registered one and counts a reference. A file that can't be read gets a logged error and a 1x1 fallback texture.
+    // Evictable textures can be demoted and evicted over the budget, whoever draws with them has to call MarkTextureUsed and
+    // take the views from GetSrvOffset then. They are never shared with pinned ones. DDS and KTX2 textures always stay pinned.
+    std::vector<TexResourceData> CreateTextures(RenderContext& ctx, const std::vector<std::string>& filenames, const std::vector<TextureUsage>& usages = {},
+        TextureCompression compression = TextureCompression::None, bool generateMips = false, bool evictable = false);
+    // Drops a reference CreateTexture(s), CreateStreamedTextures or CreatePackedTextures returned for a file, the last one frees
+    // the texture. The GPU has to be done with it.
+    void ReleaseTexture(const TexResourceData& texture);
+    TextureRegistryStats GetRegistryStats() const;
+    // Textures start with their mip tail resident, TextureStreamer brings in the rest within the budget as the meshes request it.
+    // Mips are always built. Streamed textures aren't shared, GetSrvOffset gives their current view.
+    std::vector<TexResourceData> CreateStreamedTextures(RenderContext& ctx, const std::vector<std::string>& filenames, const std::vector<TextureUsage>& usages = {},
+        TextureCompression compression = TextureCompression::None);
+    // Current view of a texture the calls above returned, streamed and evictable ones move to new views as their mips change
+    UINT GetSrvOffset(const TexResourceData& texture) const;
+    // Small images of the same format share atlas pages, the placements give the uv remap of every file, see TexturePacker.h.
+    // Packed files return the page, the rest get their own textures. Nothing is shared with the other calls, a page is released
+    // once per file on it. Neither is evictable.
+    std::vector<TexResourceData> CreatePackedTextures(RenderContext& ctx, const std::vector<std::string>& filenames, std::vector<TexturePlacement>& placements,
+        const std::vector<TextureUsage>& usages = {}, TextureCompression compression = TextureCompression::None, bool generateMips = false,
+        const TexturePackingOptions& options = {});
+    TextureStreamer* GetStreamer();
+    // Once per frame before the material buffers are filled: lands the finished loads and starts new ones for the requests made since the last call
+    void UpdateStreaming();
+    void MarkTextureUsed(const TexResourceData& texture);
+    // Once per frame before the draws, with the command list open: frees the upload buffers of the finished copies, lands the
+    // textures the workers have read again and keeps the textures within the budget. Views and resources that were replaced
+    // are freed once the frames in flight are done with them.
+    void UpdateResidency();
+    TextureResidencyStats GetResidencyStats() const;
     TexResourceData CreateTexture(RenderContext& ctx, D3D12_RESOURCE_DESC desc, const std::wstring& name, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
     TexResourceData CreateRT(RenderContext& ctx, D3D12_RESOURCE_DESC desc, const std::wstring& name, D3D12_CLEAR_VALUE* clearValue = nullptr, bool createSRV = true, bool allowUAV = false);
 
     TexResourceData CreateCubemap(RenderContext& ctx, UINT size, DXGI_FORMAT format, bool allowUAV = false, const byte* data = nullptr);
+    // The cubemap gets a resource made from the container and keeps its view offset, it has no UAV after that.
+    // The GPU has to be done with the old resource.
+    void ReplaceCubemap(RenderContext& ctx, TexResourceData& cubemap, const TextureContainer& container, const std::string& name);
 
     ID3D12DescriptorHeap* GetDescriptorHeap() const;
     ID3D12DescriptorHeap* GetCubemapUAVHeap() const;
@@ -64,17 +123,97 @@ public:
 
     MipGenerator* GetMipGenerator();
 
+    // Decoded pixels come from the texture cache when the source was seen before, the decode result is cached otherwise.
+    // Mips and compression are applied after the decode and cached with it, uncompressed HDR images are packed to a smaller format.
+    // The source hash is TextureCache::GetSourceHash of the file, 0 hashes it here.
+    bool ReadImage(const std::string& filename, DecodedImage& image, TextureUsage usage = TextureUsage::Color,
+        TextureCompression compression = TextureCompression::None, bool generateMips = false, ThreadPool* workers = nullptr, UINT64 sourceHash = 0) const;
+    static bool DecodeImage(const std::string& filename, DecodedImage& image, ThreadPool* workers = nullptr);
+
 private:
+    friend class StreamingBackendDX;
+
     void CreateSRVHeap(RenderContext& ctx);
     void CreateRTVHeap(RenderContext& ctx);
     void CreateUAVHeap(RenderContext& ctx);
 
-    bool ParsePNG(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat);
-    bool ParseEXR(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat);
-    bool ParseHDR(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat);
+    // What the manager keeps for a registered texture
+    struct RegistryEntry
+    {
+        TexResourceData Texture;
+        // What the residency needs to read the texture again
+        std::string Filename;
+        TextureUsage Usage = TextureUsage::Color;
+        TextureCompression Compression = TextureCompression::None;
+        bool GenerateMips = false;
+        UINT64 ResidencyJob = 0; // The last one queued for it, the older ones are dropped when they finish
+    };
+
+    // Default resource and its upload buffer, mapped until the upload is recorded
+    struct StagedTexture
+    {
+        ResourceDX Resource{ D3D12_RESOURCE_STATE_COPY_DEST };
+        ResourceDX UploadResource{ D3D12_RESOURCE_STATE_GENERIC_READ };
+        StagingLayout Layout;
+        byte* UploadData = nullptr;
+    };
+    // Freed when the frames that could use them are done, every upload buffer goes this way
+    struct PendingUpload
+    {
+        UINT UploadResourceIdx = InvalidOffset;
+        UINT ResidencyIdx = InvalidOffset; // InvalidOffset once the texture is freed
+        UINT64 Bytes = 0;
+        UINT64 Frame = 0;
+    };
+
+    struct RetiredResource
+    {
+        ResourceDX Resource;
+        UINT SRVOffset = InvalidOffset; // Freed with the resource
+        UINT64 Frame = 0;
+    };
 
-    std::vector<ResourceDX> mResources;
+    // A demotion or a restore, the image is read again on the workers straight into the upload buffer
+    struct ResidencyJob
+    {
+        UINT64 Id = 0;
+        UINT ResourceIdx = InvalidOffset;
+        StagedTexture Staged;
+        bool Read = false;
+        std::future<void> Done;
+    };
+
+    // Free indices are taken first
+    UINT AddResource(const ResourceDX& resource);
+    UINT AddUploadResource(const ResourceDX& resource);
+    UINT AllocateSrvOffset();
+    // InvalidOffset picks a view offset
+    TexResourceData CreateContainerTexture(RenderContext& ctx, const TextureContainer& container, const std::string& name, UINT srvOffset);
+    StagedTexture BeginTextureUpload(RenderContext& ctx, DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels, const std::string& name) const;
+    // A replaced texture keeps its resource index and gets a new view, the old resource and view are retired
+    TexResourceData EndTextureUpload(RenderContext& ctx, StagedTexture& texture, const TexResourceData* replaced = nullptr);
+    // The resource and the view, the GPU has to be done with them. The upload buffers go with their frames.
+    void FreeTexture(const TexResourceData& texture);
+    void TrackResource(UINT resourceIdx, UINT uploadResourceIdx = InvalidOffset);
+    void TrackUpload(UINT residencyIdx, UINT uploadResourceIdx);
+    // The texture has to be the last one uploaded, its upload gives the size
+    RegistryEntry& Register(UINT64 key, const TexResourceData& texture, UINT refCount = 1);
+    RegistryEntry& GetResidentEntry(UINT residencyIdx);
+    // An evicted texture is read again from its image file when it comes back
+    void MakeEvictable(const TexResourceData& texture);
+    void LandResidencyJobs();
+
+    void Evict(UINT texture) override;
+    void SetResidentMip(UINT texture, UINT mostDetailedMip) override;
+
+    static bool ParsePNG(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat);
+    static bool ParseEXR(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat, ThreadPool* workers);
+    static bool ParseHDR(const std::string& filename, std::vector<byte>& buffer, UINT& w, UINT& h, DXGI_FORMAT& textureFormat);
+
+    std::deque<ResourceDX> mResources; // TexResourceData::Resource points in, it has to stay where it is as this grows
     std::vector<ResourceDX> mUploadResources;
+    std::vector<UINT> mFreeResources;
+    std::vector<UINT> mFreeUploadResources;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mSrvHeap = nullptr;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap = nullptr;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mUavHeap = nullptr;
@@ -85,6 +224,24 @@ private:
     ResourceDX mRtResource{ D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE };
     //
     MipGenerator* mMipGenerator = nullptr;
+    TextureCache* mCache = nullptr;
+
+    TextureRegistry mRegistry;
+    std::map<UINT, RegistryEntry> mRegistryEntries; // By resource index
+    std::vector<UINT> mFreeSrvOffsets;
+
+    StreamingBackendDX* mStreamingBackend = nullptr;
+    TextureStreamer* mStreamer = nullptr;
+
+    RenderContext& mCtx;
+    TextureResidency* mResidency = nullptr;
+    std::map<UINT, UINT> mResidencyIds; // Resource index to the residency index
+    std::map<UINT, UINT> mResidencyResources; // And back, InvalidOffset for the ones outside mResources
+    std::deque<PendingUpload> mPendingUploads;
+    std::deque<RetiredResource> mRetiredResources;
+    std::vector<std::unique_ptr<ResidencyJob>> mResidencyJobs;
+    UINT64 mLastResidencyJob = 0;
+    UINT64 mResidencyFrame = 0;
 
     UINT mCurrentTexCount = 0;
     UINT mCurrentCubemapCount = 0;
@@ -114,6 +271,11 @@ inline ID3D12Resource* TextureManager::GetResource(UINT index) const
     return mResources[index].Get();
 }
 
+inline TextureStreamer* TextureManager::GetStreamer()
+{
+    return mStreamer;
+}
+
 inline MipGenerator* TextureManager::GetMipGenerator()
 {
     return mMipGenerator;
@@ -0,0 +1,153 @@
+#include "DXrenderer/Textures/TexturePacker.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <utility>
+
+#include "DXrenderer/DXhelpers.h"
+#include "DXrenderer/Textures/TextureCache.h"
+
+// Its own static copy, the one in imgui_draw.cpp isn't visible from here
+#define STBRP_STATIC
+#include "External/IMGUI/imstb_rectpack.h"
+
+namespace
+{
+// qsort isn't stable, the rects of the same size could be placed in any order
+void StableSortRects(void* base, size_t count, size_t size, int (*compare)(const void*, const void*))
+{
+    assert(size == sizeof(stbrp_rect));
+    stbrp_rect* rects = static_cast<stbrp_rect*>(base);
+    std::stable_sort(rects, rects + count, [compare](const stbrp_rect& a, const stbrp_rect& b) { return compare(&a, &b) < 0; });
+}
+}
+
+#define STBRP_SORT StableSortRects
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "External/IMGUI/imstb_rectpack.h"
+
+namespace DirectxPlayground
+{
+UINT TexturePackingStats::GetResourcesCount() const
+{
+    return TexturesCount - PackedCount + PagesCount;
+}
+
+float TexturePackingStats::GetWastedFraction() const
+{
+    return PageTexels > 0 ? float(PageTexels - TextureTexels - PaddingTexels) / float(PageTexels) : 0.0f;
+}
+
+TexturePacking PackTextures(const std::vector<PackedTextureDesc>& textures, const TexturePackingOptions& options)
+{
+    const UINT unit = options.Padding;
+    assert(unit > 0 && (unit & (unit - 1)) == 0 && "Padding has to be a power of two");
+    assert(options.MaxTextureSize + 2 * unit <= options.PageSize && "The largest packed texture doesn't fit a page");
+
+    TexturePacking packing;
+    packing.Placements.resize(textures.size());
+    packing.Stats.TexturesCount = static_cast<UINT>(textures.size());
+
+    // Candidates by format and mips, a texture with fewer mips would cut the chain of the others
+    std::map<std::pair<DXGI_FORMAT, UINT>, std::vector<UINT>> groups;
+    for (UINT i = 0; i < static_cast<UINT>(textures.size()); ++i)
+    {
+        const PackedTextureDesc& desc = textures[i];
+        UINT blockSize = GetBlockBytes(desc.Format) != 0 ? 4 : 1;
+        if (unit < blockSize || desc.Width > options.MaxTextureSize || desc.Height > options.MaxTextureSize || desc.Width % unit != 0 || desc.Height % unit != 0)
+            continue;
+        // A page can't keep more mips than the padding allows, a texture that would lose some aliases in the distance
+        UINT pageMips = 1;
+        while ((blockSize << pageMips) <= unit)
+            ++pageMips;
+        if (desc.MipLevels > pageMips)
+            continue;
+        groups[{ desc.Format, desc.MipLevels }].push_back(i);
+    }
+
+    // The packer works in padding units, so every texture starts on a whole texel or block in every page mip
+    UINT pageUnits = options.PageSize / unit;
+    std::vector<stbrp_node> nodes(pageUnits);
+    for (const auto& [key, members] : groups)
+    {
+        std::vector<stbrp_rect> rects;
+        for (UINT i : members)
+        {
+            stbrp_rect rect = {};
+            rect.id = static_cast<int>(i);
+            rect.w = static_cast<stbrp_coord>(textures[i].Width / unit + 2);
+            rect.h = static_cast<stbrp_coord>(textures[i].Height / unit + 2);
+            rects.push_back(rect);
+        }
+
+        while (!rects.empty())
+        {
+            stbrp_context context;
+            stbrp_init_target(&context, static_cast<int>(pageUnits), static_cast<int>(pageUnits), nodes.data(), static_cast<int>(nodes.size()));
+            stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size()));
+
+            AtlasPage page;
+            page.Format = key.first;
+            page.MipLevels = key.second;
+            std::vector<stbrp_rect> left;
+            for (const auto& rect : rects)
+            {
+                if (!rect.was_packed)
+                {
+                    left.push_back(rect);
+                    continue;
+                }
+                TexturePlacement& placement = packing.Placements[rect.id];
+                placement.X = (rect.x + 1) * unit;
+                placement.Y = (rect.y + 1) * unit;
+                page.Textures.push_back(rect.id);
+                page.Width = std::max(page.Width, (rect.x + rect.w) * unit);
+                page.Height = std::max(page.Height, (rect.y + rect.h) * unit);
+            }
+            assert(!page.Textures.empty());
+            rects.swap(left);
+
+            // Pages are cropped to what they hold, a nearly empty one isn't worth its resource
+            if (page.Textures.size() < options.MinTexturesPerPage)
+            {
+                for (UINT i : page.Textures)
+                    packing.Placements[i] = TexturePlacement{};
+                continue;
+            }
+            UINT pageIndex = static_cast<UINT>(packing.Pages.size());
+            for (UINT i : page.Textures)
+            {
+                const PackedTextureDesc& desc = textures[i];
+                TexturePlacement& placement = packing.Placements[i];
+                placement.Page = pageIndex;
+                placement.UvScaleOffset[0] = float(desc.Width) / float(page.Width);
+                placement.UvScaleOffset[1] = float(desc.Height) / float(page.Height);
+                placement.UvScaleOffset[2] = float(placement.X) / float(page.Width);
+                placement.UvScaleOffset[3] = float(placement.Y) / float(page.Height);
+                packing.Stats.TextureTexels += UINT64(desc.Width) * desc.Height;
+                packing.Stats.PaddingTexels += UINT64(desc.Width + 2 * unit) * (desc.Height + 2 * unit) - UINT64(desc.Width) * desc.Height;
+            }
+            packing.Stats.PackedCount += static_cast<UINT>(page.Textures.size());
+            packing.Stats.PageTexels += UINT64(page.Width) * page.Height;
+            packing.Pages.push_back(std::move(page));
+        }
+    }
+    packing.Stats.PagesCount = static_cast<UINT>(packing.Pages.size());
+    return packing;
+}
+
+void CopyToAtlasPage(const DecodedImage& image, const TexturePlacement& placement, UINT padding, UINT mip, const StagingSpan& dst)
+{
+    assert(placement.Page != InvalidAtlasPage && mip < image.MipLevels);
+    UINT blockSize = GetBlockBytes(image.Format) != 0 ? 4 : 1;
+    UINT elementBytes = blockSize == 4 ? GetBlockBytes(image.Format) : GetPixelSize(image.Format);
+    UINT mipPadding = padding >> mip;
+    assert(mipPadding >= blockSize && "The page has more mips than the padding allows");
+    UINT x = (placement.X >> mip) - mipPadding;
+    UINT y = (placement.Y >> mip) - mipPadding;
+    byte* start = dst.Data + UINT64(y / blockSize) * dst.RowPitch + UINT64(x / blockSize) * elementBytes;
+    int border = static_cast<int>(mipPadding);
+    CopyWrappedRegion(image, mip, -border, -border, image.GetMipWidth(mip) + 2 * mipPadding, image.GetMipHeight(mip) + 2 * mipPadding, start, dst.RowPitch);
+}
+}
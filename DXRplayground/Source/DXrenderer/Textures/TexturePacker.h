@@ -0,0 +1,76 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+#include "DXrenderer/Textures/StagingLayout.h"
+
+namespace DirectxPlayground
+{
+struct DecodedImage;
+
+constexpr UINT InvalidAtlasPage = 0xFFFFFFFF;
+
+struct TexturePackingOptions
+{
+    UINT MaxTextureSize = 512; // Larger textures stay on their own
+    UINT PageSize = 2048;
+    // Texels around every texture, wrapped from its opposite edge. A power of two of at least a block, it sets the page mips:
+    // the last one keeps a texel, or a block, of it. Textures with more mips than that stay on their own, 8 keeps 4 of them.
+    UINT Padding = 8;
+    UINT MinTexturesPerPage = 2;
+};
+
+struct PackedTextureDesc
+{
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT MipLevels = 1;
+};
+
+// Where a texture went. Textures on their own have no page and the identity remap.
+struct TexturePlacement
+{
+    UINT Page = InvalidAtlasPage;
+    UINT X = 0; // Top left texel in the page, the padding excluded
+    UINT Y = 0;
+    float UvScaleOffset[4] = { 1.0f, 1.0f, 0.0f, 0.0f }; // Page uv = frac(uv) * xy + zw
+};
+
+struct AtlasPage
+{
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT MipLevels = 1;
+    std::vector<UINT> Textures;
+};
+
+struct TexturePackingStats
+{
+    UINT TexturesCount = 0;
+    UINT PackedCount = 0;
+    UINT PagesCount = 0;
+    UINT64 TextureTexels = 0; // Of the packed textures
+    UINT64 PaddingTexels = 0;
+    UINT64 PageTexels = 0;
+
+    UINT GetResourcesCount() const; // Pages and the textures on their own
+    float GetWastedFraction() const; // Page area with neither a texture nor its padding
+};
+
+struct TexturePacking
+{
+    std::vector<AtlasPage> Pages;
+    std::vector<TexturePlacement> Placements; // In the order of the textures
+    TexturePackingStats Stats;
+};
+
+// Gathers the small textures of the same format and mip count into atlas pages with the stb rect packer, CPU only.
+// Textures are packed in a fixed order and the packer ties are broken by that order, so the same input always gives the same pages.
+// Sizes have to be multiples of the padding, every mip of a page then has every texture on whole texels, or blocks.
+TexturePacking PackTextures(const std::vector<PackedTextureDesc>& textures, const TexturePackingOptions& options);
+// Copies a mip of the texture with its wrapped padding to its place in the same mip of the page
+void CopyToAtlasPage(const DecodedImage& image, const TexturePlacement& placement, UINT padding, UINT mip, const StagingSpan& dst);
+}
@@ -0,0 +1,63 @@
+#include "DXrenderer/Textures/TextureRegistry.h"
+
+#include <cassert>
+
+namespace DirectxPlayground
+{
+bool TextureRegistry::AddReference(UINT64 key, UINT& resourceIdx)
+{
+    auto entry = mEntries.find(key);
+    if (entry == mEntries.end())
+        return false;
+    ++entry->second.RefCount;
+    mDedupedBytes += entry->second.Bytes;
+    resourceIdx = entry->second.ResourceIdx;
+    return true;
+}
+
+void TextureRegistry::Add(UINT64 key, UINT resourceIdx, UINT64 bytes, UINT refCount /*= 1*/)
+{
+    assert(refCount > 0);
+    assert(mEntries.count(key) == 0 && mKeys.count(resourceIdx) == 0 && "The texture is already registered");
+    mEntries[key] = { resourceIdx, bytes, refCount };
+    mKeys[resourceIdx] = key;
+}
+
+bool TextureRegistry::Release(UINT resourceIdx)
+{
+    auto key = mKeys.find(resourceIdx);
+    assert(key != mKeys.end() && "The texture isn't registered");
+    if (key == mKeys.end())
+        return false;
+    auto entry = mEntries.find(key->second);
+    if (--entry->second.RefCount > 0)
+        return false;
+    mEntries.erase(entry);
+    mKeys.erase(key);
+    return true;
+}
+
+bool TextureRegistry::IsRegistered(UINT resourceIdx) const
+{
+    return mKeys.count(resourceIdx) != 0;
+}
+
+UINT TextureRegistry::GetRefCount(UINT resourceIdx) const
+{
+    auto key = mKeys.find(resourceIdx);
+    return key != mKeys.end() ? mEntries.at(key->second).RefCount : 0;
+}
+
+TextureRegistryStats TextureRegistry::GetStats() const
+{
+    TextureRegistryStats stats;
+    stats.TexturesCount = mEntries.size();
+    for (const auto& [key, entry] : mEntries)
+    {
+        stats.ReferencesCount += entry.RefCount;
+        stats.Bytes += entry.Bytes;
+    }
+    stats.DedupedBytes = mDedupedBytes;
+    return stats;
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <d3d12.h>
+#include <map>
+
+namespace DirectxPlayground
+{
+struct TextureRegistryStats
+{
+    size_t TexturesCount = 0;
+    size_t ReferencesCount = 0;
+    UINT64 Bytes = 0; // Upload size of the registered textures
+    UINT64 DedupedBytes = 0; // What the repeated requests would have loaded again, since the start
+};
+
+// Reference counts of the shared textures. A texture is registered under a key, the texture cache key of the file and the options
+// for the ones made from files, and found again by the key or by its resource index. It doesn't touch D3D, whoever drops
+// the last reference frees the texture.
+class TextureRegistry
+{
+public:
+    // Counts one more reference of the texture under the key, the bytes it saves count as deduplicated. False when there's none.
+    bool AddReference(UINT64 key, UINT& resourceIdx);
+    void Add(UINT64 key, UINT resourceIdx, UINT64 bytes, UINT refCount = 1);
+    // True when it was the last reference, the texture isn't registered anymore then
+    bool Release(UINT resourceIdx);
+    bool IsRegistered(UINT resourceIdx) const;
+    UINT GetRefCount(UINT resourceIdx) const;
+    TextureRegistryStats GetStats() const;
+
+private:
+    struct Entry
+    {
+        UINT ResourceIdx = 0;
+        UINT64 Bytes = 0;
+        UINT RefCount = 0;
+    };
+
+    std::map<UINT64, Entry> mEntries;
+    std::map<UINT, UINT64> mKeys; // Resource index to the key
+    UINT64 mDedupedBytes = 0;
+};
+}
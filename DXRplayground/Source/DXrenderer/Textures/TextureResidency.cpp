@@ -0,0 +1,170 @@
+#include "DXrenderer/Textures/TextureResidency.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "DXrenderer/DXhelpers.h"
+
+namespace DirectxPlayground
+{
+UINT64 GetTextureBytes(DXGI_FORMAT format, UINT width, UINT height, UINT depthOrArraySize, UINT mipLevels, bool volume /*= false*/)
+{
+    UINT64 bytes = 0;
+    for (UINT level = 0; level < mipLevels; ++level)
+    {
+        UINT slices = volume ? std::max(depthOrArraySize >> level, 1U) : depthOrArraySize;
+        bytes += GetRowPitch(format, std::max(width >> level, 1U)) * GetRowsCount(format, std::max(height >> level, 1U)) * slices;
+    }
+    return bytes;
+}
+
+TextureResidency::TextureResidency(ITextureResidencyBackend& backend, UINT64 budget)
+    : mBackend(backend)
+    , mBudget(budget)
+{
+}
+
+UINT TextureResidency::AddTexture(const ResidentTextureDesc& desc)
+{
+    assert(desc.MipLevels > 0 && desc.DepthOrArraySize > 0);
+    ResidentTexture texture;
+    texture.Desc = desc;
+    texture.LastUsedFrame = mFrame;
+    texture.ChainSizes.resize(desc.MipLevels + 1, 0);
+    for (UINT level = desc.MipLevels; level-- > 0;)
+    {
+        UINT slices = desc.Volume ? std::max(desc.DepthOrArraySize >> level, 1U) : desc.DepthOrArraySize;
+        texture.ChainSizes[level] = texture.ChainSizes[level + 1] +
+            GetTextureBytes(desc.Format, std::max(desc.Width >> level, 1U), std::max(desc.Height >> level, 1U), slices, 1);
+    }
+
+    while (texture.DemoteMip + 1 < desc.MipLevels && std::max(desc.Width >> (texture.DemoteMip + 1), desc.Height >> (texture.DemoteMip + 1)) >= DemoteSize)
+        ++texture.DemoteMip;
+    while (texture.DemoteMip > 0 && !IsBlockAlignedMip(desc.Format, desc.Width, desc.Height, texture.DemoteMip))
+        --texture.DemoteMip;
+
+    if (mFreeTextures.empty())
+    {
+        mTextures.push_back(texture);
+        return static_cast<UINT>(mTextures.size()) - 1;
+    }
+    UINT index = mFreeTextures.back();
+    mFreeTextures.pop_back();
+    mTextures[index] = texture;
+    return index;
+}
+
+void TextureResidency::RemoveTexture(UINT texture)
+{
+    assert(!mTextures[texture].Removed && "The texture is already removed");
+    mTextures[texture] = ResidentTexture{};
+    mTextures[texture].Removed = true;
+    mFreeTextures.push_back(texture);
+}
+
+void TextureResidency::SetEvictable(UINT texture)
+{
+    mTextures[texture].Evictable = true;
+}
+
+void TextureResidency::AddUploadBytes(UINT texture, UINT64 bytes)
+{
+    mTextures[texture].UploadBytes += bytes;
+}
+
+void TextureResidency::ReleaseUploadBytes(UINT texture, UINT64 bytes)
+{
+    assert(mTextures[texture].UploadBytes >= bytes);
+    mTextures[texture].UploadBytes -= bytes;
+}
+
+void TextureResidency::MarkUsed(UINT texture)
+{
+    ResidentTexture& resident = mTextures[texture];
+    resident.LastUsedFrame = mFrame;
+    if (!resident.Evicted && resident.ResidentMip == 0)
+        return;
+    resident.Evicted = false;
+    resident.ResidentMip = 0;
+    ++mRestores;
+    mBackend.SetResidentMip(texture, 0);
+}
+
+void TextureResidency::Update()
+{
+    UINT64 lastFrame = mFrame++;
+    UINT64 total = 0;
+    std::vector<UINT> candidates;
+    for (UINT i = 0; i < static_cast<UINT>(mTextures.size()); ++i)
+    {
+        const ResidentTexture& texture = mTextures[i];
+        if (texture.Removed)
+            continue;
+        total += GetResidentBytes(texture);
+        if (texture.Evictable && !texture.Evicted && texture.LastUsedFrame < lastFrame)
+            candidates.push_back(i);
+    }
+    if (total <= mBudget)
+        return;
+
+    // Ties go by the index, so the same frames always make the same choices
+    std::stable_sort(candidates.begin(), candidates.end(), [this](UINT a, UINT b) { return mTextures[a].LastUsedFrame < mTextures[b].LastUsedFrame; });
+    for (UINT i : candidates)
+    {
+        ResidentTexture& texture = mTextures[i];
+        UINT mip = texture.ResidentMip;
+        while (total > mBudget && mip < texture.DemoteMip)
+        {
+            UINT previous = mip;
+            do
+                ++mip;
+            while (mip < texture.DemoteMip && !IsBlockAlignedMip(texture.Desc.Format, texture.Desc.Width, texture.Desc.Height, mip));
+            total -= texture.ChainSizes[previous] - texture.ChainSizes[mip];
+        }
+        if (mip == texture.ResidentMip)
+            continue;
+        texture.ResidentMip = mip;
+        ++mDemotions;
+        mBackend.SetResidentMip(i, mip);
+    }
+    for (UINT i : candidates)
+    {
+        if (total <= mBudget)
+            break;
+        ResidentTexture& texture = mTextures[i];
+        total -= GetResidentBytes(texture);
+        texture.Evicted = true;
+        ++mEvictions;
+        mBackend.Evict(i);
+    }
+}
+
+TextureResidencyStats TextureResidency::GetStats() const
+{
+    TextureResidencyStats stats;
+    stats.Budget = mBudget;
+    for (const auto& texture : mTextures)
+    {
+        if (texture.Removed)
+            continue;
+        UINT64 bytes = GetResidentBytes(texture);
+        stats.ResidentBytes += bytes;
+        stats.PinnedBytes += texture.Evictable ? 0 : bytes;
+        stats.UploadBytes += texture.UploadBytes;
+        stats.SavedBytes += texture.ChainSizes[0] - bytes;
+        ++stats.TexturesCount;
+        stats.EvictableCount += texture.Evictable ? 1 : 0;
+        stats.DemotedCount += !texture.Evicted && texture.ResidentMip > 0 ? 1 : 0;
+        stats.EvictedCount += texture.Evicted ? 1 : 0;
+    }
+    stats.Demotions = mDemotions;
+    stats.Evictions = mEvictions;
+    stats.Restores = mRestores;
+    return stats;
+}
+
+UINT64 TextureResidency::GetResidentBytes(const ResidentTexture& texture) const
+{
+    return texture.Evicted ? 0 : texture.ChainSizes[texture.ResidentMip];
+}
+}
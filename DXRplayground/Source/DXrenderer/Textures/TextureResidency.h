@@ -0,0 +1,131 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+namespace DirectxPlayground
+{
+// Tight rows of every mip, array slice and depth slice, what the copyable footprints hold without their padding
+UINT64 GetTextureBytes(DXGI_FORMAT format, UINT width, UINT height, UINT depthOrArraySize, UINT mipLevels, bool volume = false);
+
+// GPU side of the residency. The accounting changes right away, the memory goes once the GPU is done with the old resource
+// and a restore can land frames later.
+class ITextureResidencyBackend
+{
+public:
+    virtual ~ITextureResidencyBackend() = default;
+
+    // Frees the texture, its view reads zeros until it's restored
+    virtual void Evict(UINT texture) = 0;
+    // Recreates the texture with the mips from mostDetailedMip down, a demotion or a restore with 0
+    virtual void SetResidentMip(UINT texture, UINT mostDetailedMip) = 0;
+};
+
+struct ResidentTextureDesc
+{
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT DepthOrArraySize = 1;
+    UINT MipLevels = 1;
+    bool Volume = false;
+};
+
+struct TextureResidencyStats
+{
+    UINT64 Budget = 0;
+    UINT64 ResidentBytes = 0; // Every texture as it is now
+    UINT64 PinnedBytes = 0; // The part that can't be evicted
+    UINT64 UploadBytes = 0; // Upload buffers the copies still hold, not in the budget
+    UINT64 SavedBytes = 0; // What the demoted and evicted textures would take on top
+    UINT TexturesCount = 0;
+    UINT EvictableCount = 0;
+    UINT DemotedCount = 0;
+    UINT EvictedCount = 0;
+    UINT64 Demotions = 0; // Since the start
+    UINT64 Evictions = 0;
+    UINT64 Restores = 0;
+};
+
+// Texture memory accounting and the eviction policy, CPU only.
+// Every texture is counted, the evictable ones also keep the frame they were last used in. When the total goes over the budget
+// Update demotes the least recently used ones to smaller mips, down to DemoteSize texels, then evicts them in the same order.
+// Textures the last frame used are never touched. MarkUsed restores a demoted or evicted texture right away, in the frame that
+// needs it, and the next Update makes room for it.
+class TextureResidency
+{
+public:
+    static constexpr UINT DemoteSize = 64;
+
+    TextureResidency(ITextureResidencyBackend& backend, UINT64 budget);
+
+    // Pinned until SetEvictable. The indices of the removed textures are reused.
+    UINT AddTexture(const ResidentTextureDesc& desc);
+    void RemoveTexture(UINT texture);
+    void SetEvictable(UINT texture);
+    // Upload buffers of the copies in flight, a texture can have more than one
+    void AddUploadBytes(UINT texture, UINT64 bytes);
+    void ReleaseUploadBytes(UINT texture, UINT64 bytes);
+    // Whenever a frame draws with the texture
+    void MarkUsed(UINT texture);
+    const ResidentTextureDesc& GetDesc(UINT texture) const;
+    // Once per frame before the draws
+    void Update();
+
+    void SetBudget(UINT64 budget);
+    UINT GetResidentMip(UINT texture) const;
+    bool IsEvicted(UINT texture) const;
+    UINT64 GetResidentBytes(UINT texture) const;
+    TextureResidencyStats GetStats() const;
+
+private:
+    struct ResidentTexture
+    {
+        ResidentTextureDesc Desc;
+        std::vector<UINT64> ChainSizes; // Bytes from the mip down to the last one
+        UINT64 UploadBytes = 0;
+        UINT64 LastUsedFrame = 0;
+        UINT ResidentMip = 0;
+        UINT DemoteMip = 0; // Smallest chain a demotion leaves
+        bool Evictable = false;
+        bool Evicted = false;
+        bool Removed = false;
+    };
+
+    UINT64 GetResidentBytes(const ResidentTexture& texture) const;
+
+    ITextureResidencyBackend& mBackend;
+    std::vector<ResidentTexture> mTextures;
+    std::vector<UINT> mFreeTextures;
+    UINT64 mBudget = 0;
+    UINT64 mFrame = 0;
+    UINT64 mDemotions = 0;
+    UINT64 mEvictions = 0;
+    UINT64 mRestores = 0;
+};
+
+inline void TextureResidency::SetBudget(UINT64 budget)
+{
+    mBudget = budget;
+}
+
+inline const ResidentTextureDesc& TextureResidency::GetDesc(UINT texture) const
+{
+    return mTextures[texture].Desc;
+}
+
+inline UINT TextureResidency::GetResidentMip(UINT texture) const
+{
+    return mTextures[texture].ResidentMip;
+}
+
+inline bool TextureResidency::IsEvicted(UINT texture) const
+{
+    return mTextures[texture].Evicted;
+}
+
+inline UINT64 TextureResidency::GetResidentBytes(UINT texture) const
+{
+    return GetResidentBytes(mTextures[texture]);
+}
+}
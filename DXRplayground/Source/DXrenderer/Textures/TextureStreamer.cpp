@@ -0,0 +1,194 @@
+#include "DXrenderer/Textures/TextureStreamer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "DXrenderer/DXhelpers.h"
+
+namespace DirectxPlayground
+{
+float ComputeWantedMip(UINT width, UINT height, float uvDensity, float distance, float projectionScale)
+{
+    float texelsPerUnit = uvDensity * std::sqrt(float(width) * float(height));
+    float pixelsPerUnit = projectionScale / std::max(distance, 0.001f);
+    return std::max(std::log2(texelsPerUnit / pixelsPerUnit), 0.0f);
+}
+
+TextureStreamer::TextureStreamer(ITextureStreamingBackend& backend, UINT64 budget)
+    : mBackend(backend)
+    , mBudget(budget)
+    , mStart(std::chrono::high_resolution_clock::now())
+{
+}
+
+UINT TextureStreamer::AddTexture(const StreamedTextureDesc& desc)
+{
+    StreamedTexture texture;
+    texture.Desc = desc;
+    texture.ChainSizes.resize(desc.MipLevels + 1, 0);
+    for (UINT level = desc.MipLevels; level-- > 0;)
+    {
+        UINT width = std::max(desc.Width >> level, 1U);
+        UINT height = std::max(desc.Height >> level, 1U);
+        texture.ChainSizes[level] = texture.ChainSizes[level + 1] + GetRowPitch(desc.Format, width) * GetRowsCount(desc.Format, height);
+    }
+
+    UINT tail = 0;
+    while (tail + 1 < desc.MipLevels && std::max(desc.Width >> tail, desc.Height >> tail) > TailSize)
+        ++tail;
+    texture.TailMip = GetStreamableMip(texture, tail);
+    texture.ResidentMip = texture.TailMip;
+    texture.LoadingMip = texture.TailMip;
+    texture.WantedMip = texture.TailMip;
+    if (mFreeTextures.empty())
+    {
+        mTextures.push_back(texture);
+        return static_cast<UINT>(mTextures.size()) - 1;
+    }
+    UINT index = mFreeTextures.back();
+    mFreeTextures.pop_back();
+    mTextures[index] = texture;
+    return index;
+}
+
+void TextureStreamer::RemoveTexture(UINT texture)
+{
+    StreamedTexture& streamed = mTextures[texture];
+    assert(!streamed.Removed && "The texture is already removed");
+    if (streamed.LoadingMip != streamed.ResidentMip)
+        --mLoadsInFlight;
+    streamed = StreamedTexture{};
+    streamed.Removed = true;
+    mFreeTextures.push_back(texture);
+}
+
+void TextureStreamer::Request(UINT texture, float mip, float screenArea)
+{
+    StreamedTexture& streamed = mTextures[texture];
+    assert(!streamed.Removed && "The texture is removed");
+    streamed.RequestedMip = streamed.Requested ? std::min(streamed.RequestedMip, mip) : mip;
+    streamed.ScreenArea += screenArea;
+    streamed.Requested = true;
+}
+
+void TextureStreamer::Update()
+{
+    float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - mStart).count();
+    if (mFirstFrameTime < 0.0f)
+        mFirstFrameTime = elapsed;
+
+    for (UINT i = 0; i < static_cast<UINT>(mTextures.size()); ++i)
+    {
+        StreamedTexture& texture = mTextures[i];
+        if (!texture.Removed && texture.LoadingMip != texture.ResidentMip && mBackend.IsLoadDone(i))
+        {
+            texture.ResidentMip = texture.LoadingMip;
+            --mLoadsInFlight;
+        }
+    }
+
+    // Textures nobody asked for want their tail, the extra mips they hold are the first to go
+    UINT64 committed = 0;
+    mWantedBytes = 0;
+    bool anyRequested = false;
+    std::vector<UINT> loads;
+    std::vector<UINT> evictions;
+    for (UINT i = 0; i < static_cast<UINT>(mTextures.size()); ++i)
+    {
+        StreamedTexture& texture = mTextures[i];
+        if (texture.Removed)
+            continue;
+        texture.WantedMip = texture.TailMip;
+        if (texture.Requested)
+            texture.WantedMip = GetStreamableMip(texture, std::min(static_cast<UINT>(texture.RequestedMip), texture.TailMip));
+        anyRequested |= texture.Requested;
+        committed += GetCommittedSize(texture);
+        mWantedBytes += texture.ChainSizes[texture.WantedMip];
+        bool idle = texture.LoadingMip == texture.ResidentMip;
+        if (idle && texture.WantedMip < texture.ResidentMip)
+            loads.push_back(i);
+        else if (idle && texture.WantedMip > texture.ResidentMip)
+            evictions.push_back(i);
+    }
+
+    auto missingArea = [this](UINT i) { return mTextures[i].ScreenArea * float(mTextures[i].ResidentMip - mTextures[i].WantedMip); };
+    std::sort(loads.begin(), loads.end(), [&missingArea](UINT a, UINT b) { return missingArea(a) > missingArea(b); });
+    std::sort(evictions.begin(), evictions.end(), [this](UINT a, UINT b) { return mTextures[a].ScreenArea < mTextures[b].ScreenArea; });
+
+    size_t nextEviction = 0;
+    bool loadStarted = false;
+    for (UINT i : loads)
+    {
+        if (mLoadsInFlight >= MaxLoadsInFlight)
+            break;
+        StreamedTexture& texture = mTextures[i];
+        auto getCost = [&texture](UINT mip) { return texture.ChainSizes[mip] - texture.ChainSizes[texture.ResidentMip]; };
+        UINT mip = texture.WantedMip;
+        while (committed + getCost(mip) > mBudget && nextEviction < evictions.size())
+        {
+            UINT victimIdx = evictions[nextEviction++];
+            StreamedTexture& victim = mTextures[victimIdx];
+            committed -= victim.ChainSizes[victim.ResidentMip] - victim.ChainSizes[victim.WantedMip];
+            victim.ResidentMip = victim.WantedMip;
+            victim.LoadingMip = victim.WantedMip;
+            mBackend.Evict(victimIdx, victim.WantedMip);
+        }
+        // What doesn't fit comes in with less detail
+        while (mip < texture.ResidentMip && committed + getCost(mip) > mBudget)
+        {
+            do
+            {
+                ++mip;
+            } while (mip < texture.ResidentMip && GetStreamableMip(texture, mip) != mip);
+        }
+        if (mip == texture.ResidentMip)
+            continue;
+
+        committed += getCost(mip);
+        texture.LoadingMip = mip;
+        ++mLoadsInFlight;
+        loadStarted = true;
+        mBackend.BeginLoad(i, mip);
+    }
+
+    if (mFullQualityTime < 0.0f && anyRequested && !loadStarted && mLoadsInFlight == 0)
+        mFullQualityTime = elapsed;
+
+    for (auto& texture : mTextures)
+    {
+        texture.Requested = false;
+        texture.ScreenArea = 0.0f;
+    }
+}
+
+TextureStreamingStats TextureStreamer::GetStats() const
+{
+    TextureStreamingStats stats;
+    for (const auto& texture : mTextures)
+    {
+        if (!texture.Removed)
+            stats.ResidentBytes += GetCommittedSize(texture);
+    }
+    stats.WantedBytes = mWantedBytes;
+    stats.Budget = mBudget;
+    stats.LoadsInFlight = mLoadsInFlight;
+    stats.FirstFrameTime = mFirstFrameTime;
+    stats.FullQualityTime = mFullQualityTime;
+    return stats;
+}
+
+// Most detailed mip at or above the given one a resource can start with
+UINT TextureStreamer::GetStreamableMip(const StreamedTexture& texture, UINT mip) const
+{
+    while (mip > 0 && !IsBlockAlignedMip(texture.Desc.Format, texture.Desc.Width, texture.Desc.Height, mip))
+        --mip;
+    return mip;
+}
+
+// A loading texture holds both chains until the new one lands, the larger one is counted
+UINT64 TextureStreamer::GetCommittedSize(const StreamedTexture& texture) const
+{
+    return texture.ChainSizes[std::min(texture.ResidentMip, texture.LoadingMip)];
+}
+}
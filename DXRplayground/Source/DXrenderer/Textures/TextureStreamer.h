@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <d3d12.h>
+#include <vector>
+
+namespace DirectxPlayground
+{
+// GPU side of the streaming. Loads are asynchronous, evictions count as done right away.
+class ITextureStreamingBackend
+{
+public:
+    virtual ~ITextureStreamingBackend() = default;
+
+    // Starts making the mips from mostDetailedMip down resident, the texture shows the current ones until the load is done
+    virtual void BeginLoad(UINT texture, UINT mostDetailedMip) = 0;
+    virtual bool IsLoadDone(UINT texture) = 0;
+    // Drops the mips above mostDetailedMip
+    virtual void Evict(UINT texture, UINT mostDetailedMip) = 0;
+};
+
+struct StreamedTextureDesc
+{
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    UINT Width = 0;
+    UINT Height = 0;
+    UINT MipLevels = 1;
+};
+
+struct TextureStreamingStats
+{
+    UINT64 ResidentBytes = 0; // Loads in flight included
+    UINT64 WantedBytes = 0; // What the requests of the last frame need, can be over the budget
+    UINT64 Budget = 0;
+    UINT LoadsInFlight = 0;
+    float FirstFrameTime = -1.0f; // ms from the streamer creation to the first update, -1 until then
+    float FullQualityTime = -1.0f; // ms to the first update with nothing left to load, every request resident or the budget full
+};
+
+// Mip a surface needs to get a texel per pixel. uvDensity is UV units per world unit, projectionScale is pixels per world unit
+// at distance 1, height * proj(1, 1) / 2 as for the LOD selection.
+float ComputeWantedMip(UINT width, UINT height, float uvDensity, float distance, float projectionScale);
+
+// Keeps the resident mips of the streamed textures within a budget. A texture starts with its tail, the mips up to TailSize
+// texels. Every frame the meshes request the mip they need, weighted by their screen area. Update then loads the textures that
+// miss the most detail on the biggest area first and evicts the least wanted extra mips once the budget runs out.
+// It doesn't touch D3D, so it runs the same against a fake backend.
+class TextureStreamer
+{
+public:
+    static constexpr UINT TailSize = 64;
+    static constexpr UINT MaxLoadsInFlight = 4;
+
+    TextureStreamer(ITextureStreamingBackend& backend, UINT64 budget);
+
+    // The tail is assumed resident. The indices of the removed textures are reused.
+    UINT AddTexture(const StreamedTextureDesc& desc);
+    // Its mips stop counting right away, a load in flight is dropped
+    void RemoveTexture(UINT texture);
+    const StreamedTextureDesc& GetDesc(UINT texture) const;
+    UINT GetTailMip(UINT texture) const;
+    UINT GetResidentMip(UINT texture) const;
+    UINT64 GetChainSize(UINT texture, UINT mostDetailedMip) const;
+
+    // Requests of a frame, the lowest mip and the summed area win
+    void Request(UINT texture, float mip, float screenArea);
+    // Lands the finished loads, then starts new loads and evictions for the requests since the last update and clears them
+    void Update();
+
+    TextureStreamingStats GetStats() const;
+
+private:
+    struct StreamedTexture
+    {
+        StreamedTextureDesc Desc;
+        std::vector<UINT64> ChainSizes; // Bytes from the mip down to the last one
+        UINT TailMip = 0;
+        UINT ResidentMip = 0;
+        UINT LoadingMip = 0; // Equals ResidentMip when nothing is loading
+        UINT WantedMip = 0;
+        float RequestedMip = 0.0f;
+        float ScreenArea = 0.0f;
+        bool Requested = false;
+        bool Removed = false;
+    };
+
+    UINT GetStreamableMip(const StreamedTexture& texture, UINT mip) const;
+    UINT64 GetCommittedSize(const StreamedTexture& texture) const;
+
+    ITextureStreamingBackend& mBackend;
+    std::vector<StreamedTexture> mTextures;
+    std::vector<UINT> mFreeTextures;
+    UINT64 mBudget = 0;
+    UINT64 mWantedBytes = 0;
+    UINT mLoadsInFlight = 0;
+    std::chrono::high_resolution_clock::time_point mStart;
+    float mFirstFrameTime = -1.0f;
+    float mFullQualityTime = -1.0f;
+};
+
+inline const StreamedTextureDesc& TextureStreamer::GetDesc(UINT texture) const
+{
+    return mTextures[texture].Desc;
+}
+
+inline UINT TextureStreamer::GetTailMip(UINT texture) const
+{
+    return mTextures[texture].TailMip;
+}
+
+inline UINT TextureStreamer::GetResidentMip(UINT texture) const
+{
+    return mTextures[texture].ResidentMip;
+}
+
+inline UINT64 TextureStreamer::GetChainSize(UINT texture, UINT mostDetailedMip) const
+{
+    return mTextures[texture].ChainSizes[mostDetailedMip];
+}
+}
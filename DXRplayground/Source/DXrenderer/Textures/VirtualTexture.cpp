@@ -0,0 +1,309 @@
+#include "DXrenderer/Textures/VirtualTexture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "DXrenderer/DXhelpers.h"
+#include "DXrenderer/Textures/TextureCache.h"
+
+namespace DirectxPlayground
+{
+namespace
+{
+UINT GetPagesCount(UINT size, UINT mip)
+{
+    return (std::max(size >> mip, 1U) + VirtualTileSize - 1) / VirtualTileSize;
+}
+}
+
+UINT PackVirtualTile(const VirtualTileId& tile)
+{
+    return tile.Texture | (tile.Mip << 12) | (tile.X << 16) | (tile.Y << 24);
+}
+
+VirtualTileId UnpackVirtualTile(UINT packed)
+{
+    return { packed & 0xfff, (packed >> 12) & 0xf, (packed >> 16) & 0xff, packed >> 24 };
+}
+
+UINT PackIndirectionEntry(UINT physicalX, UINT physicalY, UINT mip)
+{
+    return physicalX | (physicalY << 12) | (mip << 24);
+}
+
+void CutVirtualTile(const DecodedImage& image, UINT mip, UINT tileX, UINT tileY, byte* dst, UINT64 dstPitch)
+{
+    int border = static_cast<int>(VirtualTileBorder);
+    CopyWrappedRegion(image, mip, static_cast<int>(tileX * VirtualTileSize) - border, static_cast<int>(tileY * VirtualTileSize) - border,
+        VirtualTilePaddedSize, VirtualTilePaddedSize, dst, dstPitch);
+}
+
+float VirtualTextureStats::GetHitRate() const
+{
+    return Requests > 0 ? float(Hits) / float(Requests) : 0.0f;
+}
+
+float VirtualTextureStats::GetFaultsPerSecond() const
+{
+    return UpdateTime > 0.0f ? float(Uploads) * 1000.0f / UpdateTime : 0.0f;
+}
+
+VirtualTextureCache::VirtualTextureCache(UINT physicalTilesX, UINT physicalTilesY)
+    : mPhysicalTilesX(physicalTilesX)
+{
+    assert(physicalTilesX <= 4096 && physicalTilesY <= 4096 && "Physical tile coordinates don't fit the indirection entries");
+    mSlots.resize(physicalTilesX * physicalTilesY);
+    // Popped from the back, so the first slots go first
+    for (UINT slot = static_cast<UINT>(mSlots.size()); slot-- > 0;)
+        mFreeSlots.push_back(slot);
+}
+
+UINT VirtualTextureCache::AddTexture(UINT width, UINT height, UINT mipLevels)
+{
+    assert(mTextures.size() < 4096 && "Too many virtual textures for the feedback entries");
+    assert(GetPagesCount(width, 0) <= 256 && GetPagesCount(height, 0) <= 256 && "Virtual texture is too large for the feedback entries");
+    VirtualTexture texture;
+    texture.Width = width;
+    texture.Height = height;
+    while (texture.MipsCount < mipLevels && texture.MipsCount < 16)
+    {
+        texture.MipOffsets.push_back(static_cast<UINT>(mIndirectionTable.size()));
+        UINT pagesCount = GetPagesCount(width, texture.MipsCount) * GetPagesCount(height, texture.MipsCount);
+        mIndirectionTable.resize(mIndirectionTable.size() + pagesCount, InvalidIndirectionEntry);
+        mPageSlots.resize(mPageSlots.size() + pagesCount, InvalidVirtualSlot);
+        ++texture.MipsCount;
+        if (pagesCount == 1)
+            break;
+    }
+    UINT textureIdx = static_cast<UINT>(mTextures.size());
+    mTextures.push_back(texture);
+
+    // The whole last mip, one tile unless the image has no mip small enough. The slots are taken now, so the pinned tiles
+    // can't run out of them later.
+    UINT lastMip = texture.MipsCount - 1;
+    for (UINT y = 0; y < GetPagesY(textureIdx, lastMip); ++y)
+    {
+        for (UINT x = 0; x < GetPagesX(textureIdx, lastMip); ++x)
+        {
+            UINT slot = AllocateSlot();
+            assert(slot != InvalidVirtualSlot && "Physical cache can't hold the pinned tiles");
+            mSlots[slot].Pinned = true;
+            mPinnedUploads.push_back({ { textureIdx, lastMip, x, y }, slot % mPhysicalTilesX, slot / mPhysicalTilesX });
+        }
+    }
+    return textureIdx;
+}
+
+UINT VirtualTextureCache::GetPagesX(UINT texture, UINT mip) const
+{
+    return GetPagesCount(mTextures[texture].Width, mip);
+}
+
+UINT VirtualTextureCache::GetPagesY(UINT texture, UINT mip) const
+{
+    return GetPagesCount(mTextures[texture].Height, mip);
+}
+
+bool VirtualTextureCache::IsResident(const VirtualTileId& tile) const
+{
+    return IsValid(tile) && mPageSlots[GetPageIndex(tile)] != InvalidVirtualSlot;
+}
+
+void VirtualTextureCache::AddFeedback(const UINT* tiles, size_t count)
+{
+    mFeedback.insert(mFeedback.end(), tiles, tiles + count);
+}
+
+void VirtualTextureCache::AddMipFeedback(UINT texture, UINT mip)
+{
+    mip = std::min(mip, mTextures[texture].MipsCount - 1);
+    for (UINT y = 0; y < GetPagesY(texture, mip); ++y)
+    {
+        for (UINT x = 0; x < GetPagesX(texture, mip); ++x)
+            mFeedback.push_back(PackVirtualTile({ texture, mip, x, y }));
+    }
+}
+
+void VirtualTextureCache::Update(UINT maxUploads, std::vector<VirtualTileUpload>& uploads)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    ++mFrame;
+    uploads.clear();
+    size_t pinnedCount = std::min<size_t>(mPinnedUploads.size(), maxUploads);
+    for (size_t i = 0; i < pinnedCount; ++i)
+        MapTile(mPinnedUploads[i].Tile, mPinnedUploads[i].PhysicalY * mPhysicalTilesX + mPinnedUploads[i].PhysicalX, uploads);
+    mPinnedUploads.erase(mPinnedUploads.begin(), mPinnedUploads.begin() + pinnedCount);
+
+    std::sort(mFeedback.begin(), mFeedback.end());
+    mFeedback.erase(std::unique(mFeedback.begin(), mFeedback.end()), mFeedback.end());
+    std::vector<VirtualTileId> faults;
+    for (UINT packed : mFeedback)
+    {
+        VirtualTileId tile = UnpackVirtualTile(packed);
+        if (!IsValid(tile))
+            continue;
+        ++mStats.Requests;
+        UINT slot = mPageSlots[GetPageIndex(tile)];
+        if (slot == InvalidVirtualSlot)
+        {
+            faults.push_back(tile);
+            continue;
+        }
+        ++mStats.Hits;
+        mSlots[slot].LastRequestFrame = mFrame;
+        if (!mSlots[slot].Pinned)
+        {
+            Unlink(slot);
+            LinkFront(slot);
+        }
+    }
+    mFeedback.clear();
+    mStats.Faults += faults.size();
+
+    // Coarse tiles cover the most pages, they go first. Faults are only served once every pinned tile is handed out, so a fine
+    // page never gets mapped under a texture without its fallback.
+    std::stable_sort(faults.begin(), faults.end(), [](const VirtualTileId& a, const VirtualTileId& b) { return a.Mip > b.Mip; });
+    for (size_t i = 0; i < faults.size() && uploads.size() < maxUploads; ++i)
+    {
+        UINT slot = AllocateSlot();
+        if (slot == InvalidVirtualSlot)
+            break; // Everything in the cache is wanted by this frame
+        MapTile(faults[i], slot, uploads);
+        ++mStats.Uploads;
+    }
+    mStats.UpdateTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VirtualTextureCache::ResetStats()
+{
+    mStats = VirtualTextureStats{};
+}
+
+bool VirtualTextureCache::IsValid(const VirtualTileId& tile) const
+{
+    return tile.Texture < mTextures.size() && tile.Mip < mTextures[tile.Texture].MipsCount && tile.X < GetPagesX(tile.Texture, tile.Mip) &&
+        tile.Y < GetPagesY(tile.Texture, tile.Mip);
+}
+
+UINT VirtualTextureCache::GetPageIndex(const VirtualTileId& tile) const
+{
+    return mTextures[tile.Texture].MipOffsets[tile.Mip] + tile.Y * GetPagesX(tile.Texture, tile.Mip) + tile.X;
+}
+
+// A free slot or the least recently used one, unless this frame uses that one too
+UINT VirtualTextureCache::AllocateSlot()
+{
+    if (!mFreeSlots.empty())
+    {
+        UINT slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        return slot;
+    }
+    if (mLruTail == InvalidVirtualSlot || mSlots[mLruTail].LastRequestFrame == mFrame)
+        return InvalidVirtualSlot;
+    UINT slot = mLruTail;
+    EvictTile(slot);
+    return slot;
+}
+
+void VirtualTextureCache::MapTile(const VirtualTileId& tile, UINT slot, std::vector<VirtualTileUpload>& uploads)
+{
+    Slot& physical = mSlots[slot];
+    physical.Tile = tile;
+    physical.LastRequestFrame = mFrame;
+    if (!physical.Pinned)
+        LinkFront(slot);
+    mPageSlots[GetPageIndex(tile)] = slot;
+    RefreshPages(tile);
+    uploads.push_back({ tile, slot % mPhysicalTilesX, slot / mPhysicalTilesX });
+}
+
+void VirtualTextureCache::EvictTile(UINT slot)
+{
+    Unlink(slot);
+    const VirtualTileId& tile = mSlots[slot].Tile;
+    mPageSlots[GetPageIndex(tile)] = InvalidVirtualSlot;
+    RefreshPages(tile);
+    ++mStats.Evictions;
+}
+
+// Entries of the page and of every finer page under it, from the coarse ones down. Pages without a tile take their parent's entry.
+// The last page of a row or a column is also the parent of the extra pages odd sizes leave below it.
+void VirtualTextureCache::RefreshPages(const VirtualTileId& tile)
+{
+    const VirtualTexture& texture = mTextures[tile.Texture];
+    UINT x0 = tile.X;
+    UINT y0 = tile.Y;
+    UINT x1 = tile.X + 1;
+    UINT y1 = tile.Y + 1;
+    for (UINT mip = tile.Mip + 1; mip-- > 0;)
+    {
+        UINT pagesX = GetPagesX(tile.Texture, mip);
+        UINT pagesY = GetPagesY(tile.Texture, mip);
+        if (mip < tile.Mip)
+        {
+            x1 = x1 == GetPagesX(tile.Texture, mip + 1) ? pagesX : std::min(x1 * 2, pagesX);
+            y1 = y1 == GetPagesY(tile.Texture, mip + 1) ? pagesY : std::min(y1 * 2, pagesY);
+            x0 *= 2;
+            y0 *= 2;
+        }
+        for (UINT y = y0; y < y1; ++y)
+        {
+            for (UINT x = x0; x < x1; ++x)
+            {
+                UINT page = texture.MipOffsets[mip] + y * pagesX + x;
+                UINT slot = mPageSlots[page];
+                if (slot != InvalidVirtualSlot)
+                {
+                    mIndirectionTable[page] = PackIndirectionEntry(slot % mPhysicalTilesX, slot / mPhysicalTilesX, mip);
+                    continue;
+                }
+                assert(mip + 1 < texture.MipsCount && "Pinned page isn't resident");
+                UINT parentPagesX = GetPagesX(tile.Texture, mip + 1);
+                UINT parentX = std::min(x / 2, parentPagesX - 1);
+                UINT parentY = std::min(y / 2, GetPagesY(tile.Texture, mip + 1) - 1);
+                mIndirectionTable[page] = mIndirectionTable[texture.MipOffsets[mip + 1] + parentY * parentPagesX + parentX];
+            }
+        }
+    }
+}
+
+void VirtualTextureCache::LinkFront(UINT slot)
+{
+    mSlots[slot].Prev = InvalidVirtualSlot;
+    mSlots[slot].Next = mLruHead;
+    if (mLruHead != InvalidVirtualSlot)
+        mSlots[mLruHead].Prev = slot;
+    else
+        mLruTail = slot;
+    mLruHead = slot;
+}
+
+void VirtualTextureCache::Unlink(UINT slot)
+{
+    Slot& physical = mSlots[slot];
+    if (physical.Prev != InvalidVirtualSlot)
+        mSlots[physical.Prev].Next = physical.Next;
+    else
+        mLruHead = physical.Next;
+    if (physical.Next != InvalidVirtualSlot)
+        mSlots[physical.Next].Prev = physical.Prev;
+    else
+        mLruTail = physical.Prev;
+    physical.Prev = InvalidVirtualSlot;
+    physical.Next = InvalidVirtualSlot;
+}
+
+VirtualTextureStats ReplayVirtualTextureFeedback(VirtualTextureCache& cache, const std::vector<std::vector<UINT>>& frames, UINT maxUploadsPerFrame)
+{
+    cache.ResetStats();
+    std::vector<VirtualTileUpload> uploads;
+    for (const auto& frame : frames)
+    {
+        cache.AddFeedback(frame.data(), frame.size());
+        cache.Update(maxUploadsPerFrame, uploads);
+    }
+    return cache.GetStats();
+}
+}
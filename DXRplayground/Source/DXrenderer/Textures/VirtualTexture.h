@@ -0,0 +1,161 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+
+namespace DirectxPlayground
+{
+struct DecodedImage;
+
+constexpr UINT VirtualTileSize = 128; // Texels of a tile without its borders
+constexpr UINT VirtualTileBorder = 4; // On every side, enough for bilinear filtering with anisotropy and a whole block of the BC formats
+constexpr UINT VirtualTilePaddedSize = VirtualTileSize + 2 * VirtualTileBorder;
+constexpr UINT InvalidVirtualSlot = 0xFFFFFFFF;
+constexpr UINT InvalidIndirectionEntry = 0xFFFFFFFF; // The pinned tiles of the texture aren't uploaded yet
+
+struct VirtualTileId
+{
+    UINT Texture = 0;
+    UINT Mip = 0;
+    UINT X = 0;
+    UINT Y = 0;
+};
+
+// Feedback entries as the shaders write them: texture in the low 12 bits, then the mip in 4 bits and the tile x and y in 8 bits each
+UINT PackVirtualTile(const VirtualTileId& tile);
+VirtualTileId UnpackVirtualTile(UINT packed);
+// Indirection table entries: physical tile x and y in 12 bits each, the mip of the tile they point to in the top 8 bits
+UINT PackIndirectionEntry(UINT physicalX, UINT physicalY, UINT mip);
+
+// Copies a tile with its borders, wrapped around the mip edges, to VirtualTilePaddedSize rows of dst. Block compressed images
+// are copied by blocks, so the rows are block rows then.
+void CutVirtualTile(const DecodedImage& image, UINT mip, UINT tileX, UINT tileY, byte* dst, UINT64 dstPitch);
+
+struct VirtualTileUpload
+{
+    VirtualTileId Tile;
+    UINT PhysicalX = 0;
+    UINT PhysicalY = 0;
+};
+
+struct VirtualTextureStats
+{
+    UINT64 Requests = 0; // Distinct tiles of every frame
+    UINT64 Hits = 0;
+    UINT64 Faults = 0;
+    UINT64 Uploads = 0; // Faults served, the rest are asked for again by the next frames
+    UINT64 Evictions = 0;
+    float UpdateTime = 0.0f; // ms in VirtualTextureCache::Update
+
+    float GetHitRate() const;
+    float GetFaultsPerSecond() const; // Served faults per second of update time
+};
+
+// Page table of the virtual textures and the LRU cache of the physical tiles, CPU only.
+// Every texture gets a page per tile of every mip down to the first one that fits a tile, the tiles of that one are pinned resident.
+// An indirection table entry points to the tile of its page, or to the one of the closest resident coarser page, so once the
+// pinned tiles are in the shaders always find something to sample. A page is only mapped by the Update that hands out its upload.
+// Update never evicts the tiles its feedback asks for.
+class VirtualTextureCache
+{
+public:
+    VirtualTextureCache(UINT physicalTilesX, UINT physicalTilesY);
+
+    // The pinned tiles get their slots now and are uploaded and mapped by the next updates, the entries of the texture are
+    // InvalidIndirectionEntry until then. Returns the index the feedback uses.
+    UINT AddTexture(UINT width, UINT height, UINT mipLevels);
+    UINT GetWidth(UINT texture) const;
+    UINT GetHeight(UINT texture) const;
+    UINT GetVirtualMipsCount(UINT texture) const;
+    UINT GetPagesX(UINT texture, UINT mip) const;
+    UINT GetPagesY(UINT texture, UINT mip) const;
+    // First entry of the mip in the indirection table, the pages go row by row
+    UINT GetIndirectionOffset(UINT texture, UINT mip) const;
+    const std::vector<UINT>& GetIndirectionTable() const;
+    bool IsResident(const VirtualTileId& tile) const;
+
+    // Feedback of one frame, duplicates and out of range tiles are fine
+    void AddFeedback(const UINT* tiles, size_t count);
+    // Every tile of the mip, clamped to the virtual ones. What a surface that shows the whole texture at that mip asks for.
+    void AddMipFeedback(UINT texture, UINT mip);
+    // Serves the faults of the feedback, coarse mips first, up to maxUploads with the pinned tiles of the new textures ahead of them.
+    // The uploads have to land in the physical cache before the indirection table is used.
+    void Update(UINT maxUploads, std::vector<VirtualTileUpload>& uploads);
+
+    const VirtualTextureStats& GetStats() const;
+    void ResetStats();
+
+private:
+    struct VirtualTexture
+    {
+        UINT Width = 0;
+        UINT Height = 0;
+        UINT MipsCount = 0; // Virtual ones, the last one is pinned
+        std::vector<UINT> MipOffsets;
+    };
+
+    struct Slot
+    {
+        VirtualTileId Tile;
+        UINT Prev = InvalidVirtualSlot; // LRU list, the most recently used first
+        UINT Next = InvalidVirtualSlot;
+        UINT64 LastRequestFrame = 0;
+        bool Pinned = false;
+    };
+
+    bool IsValid(const VirtualTileId& tile) const;
+    UINT GetPageIndex(const VirtualTileId& tile) const;
+    UINT AllocateSlot();
+    void MapTile(const VirtualTileId& tile, UINT slot, std::vector<VirtualTileUpload>& uploads);
+    void EvictTile(UINT slot);
+    void RefreshPages(const VirtualTileId& tile);
+    void LinkFront(UINT slot);
+    void Unlink(UINT slot);
+
+    UINT mPhysicalTilesX = 0;
+    std::vector<VirtualTexture> mTextures;
+    std::vector<UINT> mIndirectionTable;
+    std::vector<UINT> mPageSlots; // Same layout as the indirection table
+    std::vector<Slot> mSlots;
+    std::vector<UINT> mFreeSlots;
+    std::vector<VirtualTileUpload> mPinnedUploads; // Mapped and handed out by the next updates
+    std::vector<UINT> mFeedback;
+    UINT mLruHead = InvalidVirtualSlot;
+    UINT mLruTail = InvalidVirtualSlot;
+    UINT64 mFrame = 0;
+    VirtualTextureStats mStats;
+};
+
+// Runs the frames through the cache and returns what they did, the stats are reset first
+VirtualTextureStats ReplayVirtualTextureFeedback(VirtualTextureCache& cache, const std::vector<std::vector<UINT>>& frames, UINT maxUploadsPerFrame);
+
+inline UINT VirtualTextureCache::GetWidth(UINT texture) const
+{
+    return mTextures[texture].Width;
+}
+
+inline UINT VirtualTextureCache::GetHeight(UINT texture) const
+{
+    return mTextures[texture].Height;
+}
+
+inline UINT VirtualTextureCache::GetVirtualMipsCount(UINT texture) const
+{
+    return mTextures[texture].MipsCount;
+}
+
+inline UINT VirtualTextureCache::GetIndirectionOffset(UINT texture, UINT mip) const
+{
+    return mTextures[texture].MipOffsets[mip];
+}
+
+inline const std::vector<UINT>& VirtualTextureCache::GetIndirectionTable() const
+{
+    return mIndirectionTable;
+}
+
+inline const VirtualTextureStats& VirtualTextureCache::GetStats() const
+{
+    return mStats;
+}
+}
@@ -0,0 +1,121 @@
+#include "DXrenderer/Textures/VirtualTextureDX.h"
+
+#include <cstring>
+
+#include "DXrenderer/RenderContext.h"
+#include "DXrenderer/Textures/TextureManager.h"
+#include "Utils/ThreadPool.h"
+
+namespace DirectxPlayground
+{
+namespace
+{
+byte* CreateMappedBuffer(RenderContext& ctx, UINT64 size, ResourceDX& buffer, const wchar_t* name)
+{
+    CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    ThrowIfFailed(ctx.Device->CreateCommittedResource(
+        &uploadHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        buffer.GetCurrentState(),
+        nullptr,
+        IID_PPV_ARGS(buffer.GetAddressOf())));
+    buffer.SetName(name);
+
+    // Write-only from the CPU, mapped for the whole lifetime
+    CD3DX12_RANGE readRange(0, 0);
+    void* data = nullptr;
+    ThrowIfFailed(buffer.Get()->Map(0, &readRange, &data));
+    return static_cast<byte*>(data);
+}
+}
+
+VirtualTextureDX::VirtualTextureDX(RenderContext& ctx, DXGI_FORMAT format, UINT physicalTilesX, UINT physicalTilesY)
+    : mCache(physicalTilesX, physicalTilesY)
+    , mFormat(format)
+{
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = UINT64(physicalTilesX) * VirtualTilePaddedSize;
+    desc.Height = physicalTilesY * VirtualTilePaddedSize;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = format;
+    desc.SampleDesc.Count = 1;
+    desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    TexResourceData physicalCache = ctx.TexManager->CreateTexture(ctx, desc, L"VirtualTextureCache");
+    mPhysicalCache = ctx.TexManager->GetResource(physicalCache.ResourceIdx);
+    mPhysicalCacheSrvOffset = physicalCache.SRVOffset;
+
+    mTileLayout = ComputeStagingLayout(format, VirtualTilePaddedSize, VirtualTilePaddedSize, 1);
+    mTileStride = Align(static_cast<UINT>(mTileLayout.TotalSize), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    mUploadRingData = CreateMappedBuffer(ctx, mTileStride * MaxUploadsPerFrame * RenderContext::FramesCount, mUploadRing, L"VirtualTextureUploadRing");
+    mIndirectionTablesData = CreateMappedBuffer(ctx, UINT64(MaxIndirectionEntries) * sizeof(UINT) * RenderContext::FramesCount, mIndirectionTables,
+        L"VirtualTextureIndirection");
+}
+
+VirtualTextureDX::~VirtualTextureDX()
+{
+    mUploadRing.Get()->Unmap(0, nullptr);
+    mIndirectionTables.Get()->Unmap(0, nullptr);
+}
+
+UINT VirtualTextureDX::AddTexture(DecodedImage&& image)
+{
+    assert(image.Format == mFormat && "Virtual textures share the format of the physical cache");
+    UINT texture = mCache.AddTexture(image.Width, image.Height, image.MipLevels);
+    assert(mCache.GetIndirectionTable().size() <= MaxIndirectionEntries && "Indirection table is full");
+    mImages.push_back(std::move(image));
+    return texture;
+}
+
+void VirtualTextureDX::AddFeedback(const UINT* tiles, size_t count)
+{
+    mCache.AddFeedback(tiles, count);
+}
+
+void VirtualTextureDX::AddMipFeedback(UINT texture, UINT mip)
+{
+    mCache.AddMipFeedback(texture, mip);
+}
+
+void VirtualTextureDX::Update(RenderContext& ctx, UINT frameIndex)
+{
+    mCache.Update(MaxUploadsPerFrame, mUploads);
+
+    // The frame that used this part of the ring is done on the GPU
+    UINT64 ringOffset = mTileStride * MaxUploadsPerFrame * frameIndex;
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = mTileLayout.Footprints[0];
+    ctx.Workers->ParallelFor(mUploads.size(), [&](size_t i)
+    {
+        const VirtualTileUpload& upload = mUploads[i];
+        byte* dst = mUploadRingData + ringOffset + mTileStride * i + footprint.Offset;
+        CutVirtualTile(mImages[upload.Tile.Texture], upload.Tile.Mip, upload.Tile.X, upload.Tile.Y, dst, footprint.Footprint.RowPitch);
+    });
+
+    if (!mUploads.empty())
+    {
+        auto toCopy = CD3DX12_RESOURCE_BARRIER::Transition(mPhysicalCache, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+        ctx.CommandList->ResourceBarrier(1, &toCopy);
+        for (size_t i = 0; i < mUploads.size(); ++i)
+        {
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT tileFootprint = footprint;
+            tileFootprint.Offset += ringOffset + mTileStride * i;
+            CD3DX12_TEXTURE_COPY_LOCATION dst(mPhysicalCache, 0);
+            CD3DX12_TEXTURE_COPY_LOCATION src(mUploadRing.Get(), tileFootprint);
+            ctx.CommandList->CopyTextureRegion(&dst, mUploads[i].PhysicalX * VirtualTilePaddedSize, mUploads[i].PhysicalY * VirtualTilePaddedSize, 0, &src, nullptr);
+        }
+        auto toShader = CD3DX12_RESOURCE_BARRIER::Transition(mPhysicalCache, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        ctx.CommandList->ResourceBarrier(1, &toShader);
+    }
+
+    const std::vector<UINT>& table = mCache.GetIndirectionTable();
+    memcpy(mIndirectionTablesData + UINT64(MaxIndirectionEntries) * sizeof(UINT) * frameIndex, table.data(), table.size() * sizeof(UINT));
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS VirtualTextureDX::GetIndirectionTableGpuAddress(UINT frameIndex) const
+{
+    return mIndirectionTables.Get()->GetGPUVirtualAddress() + UINT64(MaxIndirectionEntries) * sizeof(UINT) * frameIndex;
+}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+#include "DXrenderer/ResourceDX.h"
+#include "DXrenderer/Textures/StagingLayout.h"
+#include "DXrenderer/Textures/TextureCache.h"
+#include "DXrenderer/Textures/VirtualTexture.h"
+
+namespace DirectxPlayground
+{
+struct RenderContext;
+
+// GPU side of a VirtualTextureCache: the physical cache texture, an indirection table per frame in an upload buffer the shaders
+// read directly and the tile uploads. Tiles are cut from the images the textures were added with, on the worker pool, straight
+// into an upload ring.
+class VirtualTextureDX
+{
+public:
+    static constexpr UINT MaxUploadsPerFrame = 64;
+    static constexpr UINT MaxIndirectionEntries = 256 * 1024;
+
+    // Every texture has to be in this format, with its mips
+    VirtualTextureDX(RenderContext& ctx, DXGI_FORMAT format, UINT physicalTilesX, UINT physicalTilesY);
+    VirtualTextureDX(const VirtualTextureDX&) = delete;
+    VirtualTextureDX& operator=(const VirtualTextureDX&) = delete;
+    ~VirtualTextureDX();
+
+    UINT AddTexture(DecodedImage&& image);
+    // Tiles a frame sampled, packed with PackVirtualTile
+    void AddFeedback(const UINT* tiles, size_t count);
+    void AddMipFeedback(UINT texture, UINT mip);
+    // Once per frame before the draws: serves the faults, records the tile copies and fills the indirection table of the frame
+    void Update(RenderContext& ctx, UINT frameIndex);
+
+    DXGI_FORMAT GetFormat() const;
+    UINT GetPhysicalCacheSrvOffset() const;
+    D3D12_GPU_VIRTUAL_ADDRESS GetIndirectionTableGpuAddress(UINT frameIndex) const;
+    const VirtualTextureCache& GetCache() const;
+
+private:
+    VirtualTextureCache mCache;
+    DXGI_FORMAT mFormat = DXGI_FORMAT_UNKNOWN;
+    std::vector<DecodedImage> mImages;
+    std::vector<VirtualTileUpload> mUploads;
+
+    UINT mPhysicalCacheSrvOffset = 0;
+    ID3D12Resource* mPhysicalCache = nullptr; // Owned by the texture manager
+    StagingLayout mTileLayout;
+    UINT64 mTileStride = 0;
+    ResourceDX mUploadRing{ D3D12_RESOURCE_STATE_GENERIC_READ }; // MaxUploadsPerFrame tiles for every frame
+    byte* mUploadRingData = nullptr;
+    ResourceDX mIndirectionTables{ D3D12_RESOURCE_STATE_GENERIC_READ };
+    byte* mIndirectionTablesData = nullptr;
+};
+
+inline DXGI_FORMAT VirtualTextureDX::GetFormat() const
+{
+    return mFormat;
+}
+
+inline UINT VirtualTextureDX::GetPhysicalCacheSrvOffset() const
+{
+    return mPhysicalCacheSrvOffset;
+}
+
+inline const VirtualTextureCache& VirtualTextureDX::GetCache() const
+{
+    return mCache;
+}
+}
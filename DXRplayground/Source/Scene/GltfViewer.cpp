@@ -13,7 +13,9 @@
 
 #include "DXrenderer/Buffers/UploadBuffer.h"
 #include "DXrenderer/Textures/EnvironmentMap.h"
+#include "DXrenderer/Textures/VirtualTextureDX.h"
 
+#include "Utils/Logger.h"
 #include "Utils/PixProfiler.h"
 #include "External/IMGUI/imgui.h"
 
@@ -31,6 +33,22 @@ GltfViewer::~GltfViewer()
     SafeDelete(mTonemapper);
     SafeDelete(mLightManager);
     SafeDelete(mEnvMap);
+    SafeDelete(mVirtualTexture);
+}
+
+void GltfViewer::ReleaseResources(RenderContext& context)
+{
+    if (mVirtualTexture != nullptr)
+    {
+        const VirtualTextureStats& stats = mVirtualTexture->GetCache().GetStats();
+        LOG("Virtual texture: hit rate ", stats.GetHitRate() * 100.0f, "%, ", stats.GetFaultsPerSecond(), " faults/s, ", stats.Uploads, " uploads, ",
+            stats.Evictions, " evictions");
+    }
+    mGltfMesh->ReleaseTextures(*context.TexManager);
+    mSkybox->ReleaseTextures(*context.TexManager);
+    mEnvMap->ReleaseTextures(*context.TexManager);
+    // Every owner of a file texture is above, a leftover is a missed release
+    assert(context.TexManager->GetRegistryStats().TexturesCount == 0 && "A file texture wasn't released");
 }
 
 void GltfViewer::InitResources(RenderContext& context)
@@ -39,16 +57,22 @@ void GltfViewer::InitResources(RenderContext& context)
 
     mCamera = new Camera(1.0472f, 1.77864583f, 0.001f, 1000.0f);
     mCameraCb = new UploadBuffer(*context.Device, sizeof(CameraShaderData), true, context.FramesCount);
-    mObjectCb = new UploadBuffer(*context.Device, sizeof(XMFLOAT4X4), true, context.FramesCount);
     mCameraController = new CameraController(mCamera);
     mLightManager = new LightManager(context);
 
     auto path = ASSETS_DIR + std::string("Textures//colorful_studio_4k.hdr");
-    mEnvMap = new EnvironmentMap(context, path, 2048, 256);
+    mEnvMap = new EnvironmentMap(context, path, 2048, 256, TextureCompression::Fast);
     Light l = { { 300.0f, 300.0f, 300.0f, 1.0f}, { 0.0f, 0.0f, 0.0f } };
     mDirectionalLightInd = mLightManager->AddLight(l);
 
     LoadGeometry(context);
+    if (mUseVirtualTexture)
+    {
+        mVirtualTexture = new VirtualTextureDX(context, DXGI_FORMAT_R8G8B8A8_UNORM, 16, 16);
+        mGltfMesh->AddVirtualTextures(context, *mVirtualTexture);
+    }
+    // One constant buffer slot per instance and frame
+    mObjectCb = new UploadBuffer(*context.Device, sizeof(XMFLOAT4X4), true, context.FramesCount * static_cast<UINT>(mGltfMesh->GetInstances().size()));
     CreateRootSignature(context);
 
     mTonemapper = new Tonemapper();
@@ -64,20 +88,22 @@ void GltfViewer::Render(RenderContext& context)
 {
     GPU_SCOPED_EVENT(context, "Render frame");
     mEnvMap->ConvertToCubemap(context);
+    context.TexManager->UpdateStreaming();
     mCameraController->Update();
     UpdateLights(context);
 
     UINT frameIndex = context.SwapChain->GetCurrentBackBufferIndex();
+    // Serves the feedback of the previous frame
+    if (mVirtualTexture != nullptr)
+        mVirtualTexture->Update(context, frameIndex);
 
-    XMFLOAT4X4 toWorld;
-    XMStoreFloat4x4(&toWorld, XMMatrixTranspose(XMMatrixTranslation(0.0f, 0.0f, 3.0f)));
+    XMMATRIX world = XMMatrixTranslation(0.0f, 0.0f, 3.0f);
     mCameraData.ViewProj = TransposeMatrix(mCamera->GetViewProjection());
     XMFLOAT4 camPos = mCamera->GetPosition();
     mCameraData.Position = { camPos.x, camPos.y, camPos.z };
     mCameraData.View = TransposeMatrix(mCamera->GetView());
     mCameraData.Proj = TransposeMatrix(mCamera->GetProjection());
     mCameraCb->UploadData(frameIndex, mCameraData);
-    mObjectCb->UploadData(frameIndex, toWorld);
     mGltfMesh->UpdateMeshes(frameIndex);
 
     auto toRt = CD3DX12_RESOURCE_BARRIER::Transition(context.SwapChain->GetCurrentBackBuffer(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
@@ -103,11 +129,9 @@ void GltfViewer::Render(RenderContext& context)
     context.CommandList->ClearDepthStencilView(context.SwapChain->GetDSCPUhandle(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
     context.CommandList->SetGraphicsRootSignature(mCommonRootSig.Get());
-    context.CommandList->SetPipelineState(context.PsoManager->GetPso(mPsoName));
     ID3D12DescriptorHeap* descHeap[] = { context.TexManager->GetDescriptorHeap() };
     context.CommandList->SetDescriptorHeaps(1, descHeap);
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(0), mCameraCb->GetFrameDataGpuAddress(frameIndex));
-    context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCb->GetFrameDataGpuAddress(frameIndex));
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(3), mLightManager->GetLightsBufferGpuAddress(frameIndex));
     context.CommandList->SetGraphicsRootDescriptorTable(TextureTableIndex, context.TexManager->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart());
 
@@ -115,16 +139,81 @@ void GltfViewer::Render(RenderContext& context)
     cubeHeapBegin.Offset(context.CbvSrvUavDescriptorSize * RenderContext::MaxTextures);
     context.CommandList->SetGraphicsRootDescriptorTable(CubemapTableIndex, cubeHeapBegin);
 
-    for (const auto mesh : mGltfMesh->GetMeshes())
+    float projectionScale = mCamera->GetProjection()(1, 1) * 0.5f * static_cast<float>(context.Height);
+    mCullingStats = {};
+    mBindStats = {};
+    // Meshes of a merged model share the buffers, so binds only happen when the view actually changes.
+    D3D12_VERTEX_BUFFER_VIEW boundVertexBuffer{};
+    D3D12_INDEX_BUFFER_VIEW boundIndexBuffer{};
+
+    const auto& instances = mGltfMesh->GetInstances();
+    UINT instancesCount = static_cast<UINT>(instances.size());
+    for (UINT i = 0; i < instancesCount; ++i)
     {
+        const MeshInstance& instance = instances[i];
+        const Model::Mesh* mesh = mGltfMesh->GetMeshes()[instance.MeshIndex];
+        XMMATRIX meshToWorld = XMMatrixMultiply(XMLoadFloat4x4(&instance.Transform), world);
+        XMFLOAT4X4 toWorld;
+        XMStoreFloat4x4(&toWorld, XMMatrixTranspose(meshToWorld));
+        UINT objectCbSlot = frameIndex * instancesCount + i;
+        mObjectCb->UploadData(objectCbSlot, toWorld);
+        context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCb->GetFrameDataGpuAddress(objectCbSlot));
+
+        // Meshlets are in the mesh space, so is the culling view.
+        XMFLOAT4X4 meshToClip;
+        XMStoreFloat4x4(&meshToClip, XMMatrixMultiply(meshToWorld, XMLoadFloat4x4(&mCamera->GetViewProjection())));
+        XMFLOAT3 viewerPosition;
+        XMStoreFloat3(&viewerPosition, XMVector3TransformCoord(XMLoadFloat4(&camPos), XMMatrixInverse(nullptr, meshToWorld)));
+        MeshletCullingView cullingView(meshToClip, viewerPosition);
+        mGltfMesh->RequestTextureMips(*context.TexManager, mesh, viewerPosition, projectionScale);
+        mGltfMesh->MarkTexturesUsed(*context.TexManager, mesh);
+        if (mVirtualTexture != nullptr)
+            mGltfMesh->RequestVirtualTiles(*mVirtualTexture, mesh, viewerPosition, projectionScale);
+
+        const std::string& psoName = mesh->GetVertexLayout() == VertexLayout::Compact ? mCompactPsoName : mPsoName;
+        context.CommandList->SetPipelineState(context.PsoManager->GetPso(psoName));
         context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(2), mesh->GetMaterialBufferGpuAddress(frameIndex));
 
-        context.CommandList->IASetVertexBuffers(0, 1, &mesh->GetVertexBufferView());
-        context.CommandList->IASetIndexBuffer(&mesh->GetIndexBufferView());
+        const D3D12_VERTEX_BUFFER_VIEW& vertexBuffer = mesh->GetVertexBufferView();
+        if (vertexBuffer.BufferLocation != boundVertexBuffer.BufferLocation || vertexBuffer.StrideInBytes != boundVertexBuffer.StrideInBytes)
+        {
+            context.CommandList->IASetVertexBuffers(0, 1, &vertexBuffer);
+            boundVertexBuffer = vertexBuffer;
+            ++mBindStats.VertexBufferBinds;
+        }
+        const D3D12_INDEX_BUFFER_VIEW& indexBuffer = mesh->GetIndexBufferView();
+        if (indexBuffer.BufferLocation != boundIndexBuffer.BufferLocation || indexBuffer.Format != boundIndexBuffer.Format)
+        {
+            context.CommandList->IASetIndexBuffer(&indexBuffer);
+            boundIndexBuffer = indexBuffer;
+            ++mBindStats.IndexBufferBinds;
+        }
+        ++mBindStats.DrawnMeshes;
 
         context.CommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, 0, 0, 0);
+        UINT firstIndex = mesh->GetFirstIndex();
+        UINT baseVertex = mesh->GetBaseVertex();
+        UINT lod = mesh->SelectLod(viewerPosition, projectionScale, mMaxLodPixelError);
+        if (lod > 0)
+        {
+            const MeshLod& meshLod = mesh->GetLods()[lod];
+            context.CommandList->DrawIndexedInstanced(meshLod.IndexCount, 1, firstIndex + meshLod.FirstIndex, baseVertex, 0);
+        }
+        else if (mCullMeshlets && !mesh->GetMeshlets().Meshlets.empty())
+        {
+            mVisibleRanges.clear();
+            CullMeshlets(mesh->GetMeshlets().Meshlets, cullingView, mVisibleRanges, mCullingStats);
+            for (const auto& range : mVisibleRanges)
+                context.CommandList->DrawIndexedInstanced(range.IndexCount, 1, firstIndex + range.FirstIndex, baseVertex, 0);
+        }
+        else
+        {
+            context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), 1, firstIndex, baseVertex, 0);
+        }
     }
+    DrawGeometryStats();
+    if (mVirtualTexture != nullptr)
+        DrawVirtualTextureStats();
 
     DrawSkybox(context);
 
@@ -136,9 +225,20 @@ void GltfViewer::Render(RenderContext& context)
 
 void GltfViewer::LoadGeometry(RenderContext& context)
 {
-    auto path = ASSETS_DIR + std::string("Models//Avocado//glTF//Avocado.gltf");
+    auto path = ASSETS_DIR + std::string("Models//Avocado//glTF-Quantized//Avocado.gltf");
+    //auto path = ASSETS_DIR + std::string("Models//Avocado//glTF//Avocado.gltf");
     //auto path = ASSETS_DIR + std::string("Models//FlightHelmet//glTF//FlightHelmet.gltf");
-    mGltfMesh = new Model(context, path);
+    ModelLoadOptions options;
+    options.OptimizeMeshes = true;
+    options.BuildMeshlets = true;
+    options.LodCount = 4;
+    options.Layout = VertexLayout::Compact;
+    options.MergeBuffers = true;
+    options.Compression = TextureCompression::Fast;
+    options.GenerateMips = true;
+    // Or StreamTextures instead, the streaming calls in Render are already there
+    options.EvictableTextures = true;
+    mGltfMesh = new Model(context, path, options);
     path = ASSETS_DIR + std::string("Models//sphere//sphere.gltf");
     mSkybox = new Model(context, path);
 }
@@ -161,6 +261,13 @@ void GltfViewer::CreatePSOs(RenderContext& context)
     auto shaderPath = ASSETS_DIR_W + std::wstring(L"Shaders//PbrNonInstanced.hlsl");
     context.PsoManager->CreatePso(context, mPsoName, shaderPath, desc);
 
+    auto& compactInputLayout = GetVertexInputLayout(VertexLayout::Compact);
+    desc.InputLayout = { compactInputLayout.data(), static_cast<UINT>(compactInputLayout.size()) };
+    shaderPath = ASSETS_DIR_W + std::wstring(L"Shaders//PbrNonInstancedCompact.hlsl");
+    context.PsoManager->CreatePso(context, mCompactPsoName, shaderPath, desc);
+
+    desc.InputLayout = { inputLayout.data(), static_cast<UINT>(inputLayout.size()) };
+
     desc.RasterizerState.CullMode = D3D12_CULL_MODE_FRONT;
 
     shaderPath = ASSETS_DIR_W + std::wstring(L"Shaders//Skybox.hlsl");
@@ -178,6 +285,34 @@ void GltfViewer::UpdateLights(RenderContext& context)
     mLightManager->UpdateLights(context.SwapChain->GetCurrentBackBufferIndex());
 }
 
+void GltfViewer::DrawGeometryStats()
+{
+    ImGui::Begin("Geometry");
+    ImGui::SliderFloat("LOD error (px)", &mMaxLodPixelError, 0.0f, 16.0f);
+    ImGui::Checkbox("Cull meshlets", &mCullMeshlets);
+    ImGui::Text("Meshlets culled: %zu / %zu", mCullingStats.CulledMeshletsCount, mCullingStats.MeshletsCount);
+    ImGui::Text("Triangles outside of frustum: %zu", mCullingStats.FrustumCulledTrianglesCount);
+    ImGui::Text("Triangles backfacing: %zu", mCullingStats.BackfaceCulledTrianglesCount);
+    ImGui::Text("Triangles total: %zu", mCullingStats.TrianglesCount);
+    ModelMemoryStats memory = mGltfMesh->GetMemoryStats();
+    ImGui::Text("Vertices: %zu KB (%zu KB as floats)", memory.VertexBytes / 1024, memory.FloatVertexBytes / 1024);
+    ImGui::Text("Indices: %zu KB (%zu KB as 32-bit)", memory.IndexBytes / 1024, memory.WideIndexBytes / 1024);
+    ImGui::Text("Geometry buffers: %u (%u with a buffer per mesh)", memory.GeometryBuffersCount, memory.UnmergedGeometryBuffersCount);
+    ImGui::Text("VB/IB binds: %u/%u for %u meshes", mBindStats.VertexBufferBinds, mBindStats.IndexBufferBinds, mBindStats.DrawnMeshes);
+    ImGui::End();
+}
+
+void GltfViewer::DrawVirtualTextureStats()
+{
+    const VirtualTextureStats& stats = mVirtualTexture->GetCache().GetStats();
+    ImGui::Begin("Virtual texturing");
+    ImGui::Text("Hit rate: %.1f%%", stats.GetHitRate() * 100.0f);
+    ImGui::Text("Faults/s of update time: %.0f", stats.GetFaultsPerSecond());
+    ImGui::Text("Requests: %llu, faults: %llu", stats.Requests, stats.Faults);
+    ImGui::Text("Uploads: %llu, evictions: %llu", stats.Uploads, stats.Evictions);
+    ImGui::End();
+}
+
 void GltfViewer::DrawSkybox(RenderContext& context)
 {
     GPU_SCOPED_EVENT(context, "Skybox");
@@ -187,7 +322,7 @@ void GltfViewer::DrawSkybox(RenderContext& context)
     context.CommandList->IASetIndexBuffer(&skybox->GetIndexBufferView());
 
     context.CommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    context.CommandList->DrawIndexedInstanced(skybox->GetIndexCount(), 1, 0, 0, 0);
+    context.CommandList->DrawIndexedInstanced(skybox->GetIndexCount(), 1, skybox->GetFirstIndex(), skybox->GetBaseVertex(), 0);
 }
 
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 
 #include "CameraController.h"
 #include "Camera.h"
+#include "DXrenderer/Geometry/Meshlets.h"
 
 #include <array>
 
@@ -17,6 +18,7 @@ class TextureManager;
 class Tonemapper;
 class LightManager;
 class EnvironmentMap;
+class VirtualTextureDX;
 
 class GltfViewer : public Scene
 {
@@ -25,6 +27,7 @@ public:
 
     void InitResources(RenderContext& context) override;
     void Render(RenderContext& context) override;
+    void ReleaseResources(RenderContext& context) override;
 
 private:
     void LoadGeometry(RenderContext& context);
@@ -32,6 +35,8 @@ private:
     void CreatePSOs(RenderContext& context);
     void UpdateLights(RenderContext& context);
     void DrawSkybox(RenderContext& context);
+    void DrawGeometryStats();
+    void DrawVirtualTextureStats();
 
     Model* mGltfMesh = nullptr;
     Model* mSkybox = nullptr;
@@ -39,6 +44,7 @@ private:
     UploadBuffer* mCameraCb = nullptr;
     UploadBuffer* mObjectCb = nullptr;
     const std::string mPsoName = "Opaque_PBR";
+    const std::string mCompactPsoName = "Opaque_PBR_Compact";
     const std::string mSkyboxPsoName = "Skybox";
 
     Camera* mCamera = nullptr;
@@ -46,7 +52,23 @@ private:
     Tonemapper* mTonemapper = nullptr;
     LightManager* mLightManager = nullptr;
     EnvironmentMap* mEnvMap = nullptr;
+    VirtualTextureDX* mVirtualTexture = nullptr; // Base color tiles, driven by the CPU feedback of the draws
+    // No shader samples the virtual texture yet, so it's off by default. On, it only exercises the tile cache and its uploads.
+    bool mUseVirtualTexture = false;
     UINT mDirectionalLightInd = 0;
     CameraShaderData mCameraData{};
+
+    float mMaxLodPixelError = 1.0f;
+    bool mCullMeshlets = true;
+    std::vector<IndexRange> mVisibleRanges;
+    MeshletCullingStats mCullingStats;
+
+    struct BindStats
+    {
+        UINT VertexBufferBinds = 0;
+        UINT IndexBufferBinds = 0;
+        UINT DrawnMeshes = 0;
+    };
+    BindStats mBindStats;
 };
 }
\ No newline at end of file
@@ -30,13 +30,17 @@ PbrTester::~PbrTester()
     SafeDelete(mLightManager);
 }
 
+void PbrTester::ReleaseResources(RenderContext& context)
+{
+    mGltfMesh->ReleaseTextures(*context.TexManager);
+}
+
 void PbrTester::InitResources(RenderContext& context)
 {
     using Microsoft::WRL::ComPtr;
 
     mCamera = new Camera(1.0472f, 1.77864583f, 0.001f, 1000.0f);
     mCameraCb = new UploadBuffer(*context.Device, sizeof(CameraShaderData), true, context.FramesCount);
-    mObjectCbs = new UploadBuffer(*context.Device, sizeof(InstanceBuffers), true, context.FramesCount);
     mMaterials = new UploadBuffer(*context.Device, sizeof(InstanceMaterials), true, context.FramesCount);
     mCameraController = new CameraController(mCamera, 1.0f, 12.0f);
     mLightManager = new LightManager(context);
@@ -49,7 +53,6 @@ void PbrTester::InitResources(RenderContext& context)
     l.Direction = { -5.0f, -5.0f, 5.0f };
     mLightManager->AddLight(l);
 
-    InstanceBuffers transforms;
     for (UINT i = 0; i < 10; ++i)
     {
         for (UINT j = 0; j < 10; ++j)
@@ -63,16 +66,26 @@ void PbrTester::InitResources(RenderContext& context)
             float x = -6.25f + j * 1.25f;
             float y = -6.25f + i * 1.25f;
             float z = 10.0f;
-
-            XMFLOAT4X4 toWorld;
-            XMStoreFloat4x4(&toWorld, XMMatrixTranspose(XMMatrixTranslation(x, y, z)));
-            transforms.ToWorld[index] = toWorld;
+            mInstancePositions[index] = { x, y, z };
         }
     }
-    mObjectCbs->UploadData(0, transforms.ToWorld);
     mMaterials->UploadData(0, mInstanceMaterials.Materials);
 
     LoadGeometry(context);
+    // The transforms don't change, one slot per glTF node holds all the spheres of it
+    const auto& instances = mGltfMesh->GetInstances();
+    mObjectCbs = new UploadBuffer(*context.Device, sizeof(InstanceBuffers), true, static_cast<UINT>(instances.size()));
+    for (UINT i = 0; i < static_cast<UINT>(instances.size()); ++i)
+    {
+        InstanceBuffers transforms;
+        for (UINT j = 0; j < m_instanceCount; ++j)
+        {
+            const XMFLOAT3& position = mInstancePositions[j];
+            XMMATRIX toWorld = XMMatrixMultiply(XMLoadFloat4x4(&instances[i].Transform), XMMatrixTranslation(position.x, position.y, position.z));
+            XMStoreFloat4x4(&transforms.ToWorld[j], XMMatrixTranspose(toWorld));
+        }
+        mObjectCbs->UploadData(i, transforms.ToWorld);
+    }
     CreateRootSignature(context);
 
     mTonemapper = new Tonemapper();
@@ -121,18 +134,34 @@ void PbrTester::Render(RenderContext& context)
     ID3D12DescriptorHeap* descHeap[] = { context.TexManager->GetDescriptorHeap() };
     context.CommandList->SetDescriptorHeaps(1, descHeap);
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(0), mCameraCb->GetFrameDataGpuAddress(frameIndex));
-    context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCbs->GetFrameDataGpuAddress(0));
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(2), mMaterials->GetFrameDataGpuAddress(frameIndex));
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(3), mLightManager->GetLightsBufferGpuAddress(frameIndex));
     context.CommandList->SetGraphicsRootDescriptorTable(TextureTableIndex, context.TexManager->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart());
 
-    for (const auto mesh : mGltfMesh->GetMeshes())
+    // All instances share a draw, so the closest one picks the LOD.
+    float projectionScale = mCamera->GetProjection()(1, 1) * 0.5f * static_cast<float>(context.Height);
+    const auto& instances = mGltfMesh->GetInstances();
+    for (UINT i = 0; i < static_cast<UINT>(instances.size()); ++i)
     {
+        const Model::Mesh* mesh = mGltfMesh->GetMeshes()[instances[i].MeshIndex];
+        XMMATRIX nodeToModel = XMLoadFloat4x4(&instances[i].Transform);
+        UINT lod = static_cast<UINT>(mesh->GetLods().size() - 1);
+        for (const auto& position : mInstancePositions)
+        {
+            // The LOD error is measured in the mesh space
+            XMMATRIX meshToWorld = XMMatrixMultiply(nodeToModel, XMMatrixTranslation(position.x, position.y, position.z));
+            XMFLOAT3 viewerPosition;
+            XMStoreFloat3(&viewerPosition, XMVector3TransformCoord(XMLoadFloat4(&camPos), XMMatrixInverse(nullptr, meshToWorld)));
+            lod = std::min(lod, mesh->SelectLod(viewerPosition, projectionScale));
+        }
+        const MeshLod& meshLod = mesh->GetLods()[lod];
+
+        context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCbs->GetFrameDataGpuAddress(i));
         context.CommandList->IASetVertexBuffers(0, 1, &mesh->GetVertexBufferView());
         context.CommandList->IASetIndexBuffer(&mesh->GetIndexBufferView());
 
         context.CommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), m_instanceCount, 0, 0, 0);
+        context.CommandList->DrawIndexedInstanced(meshLod.IndexCount, m_instanceCount, mesh->GetFirstIndex() + meshLod.FirstIndex, mesh->GetBaseVertex(), 0);
     }
     mTonemapper->Render(context);
 
@@ -143,7 +172,9 @@ void PbrTester::Render(RenderContext& context)
 void PbrTester::LoadGeometry(RenderContext& context)
 {
     auto path = ASSETS_DIR + std::string("Models//sphere//sphere.gltf");
-    mGltfMesh = new Model(context, path);
+    ModelLoadOptions options;
+    options.LodCount = 4;
+    mGltfMesh = new Model(context, path, options);
 }
 
 void PbrTester::CreateRootSignature(RenderContext& context)
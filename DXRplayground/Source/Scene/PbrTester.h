@@ -25,6 +25,7 @@ public:
 
     void InitResources(RenderContext& context) override;
     void Render(RenderContext& context) override;
+    void ReleaseResources(RenderContext& context) override;
 
 private:
     inline static constexpr UINT m_instanceCount = 100;
@@ -65,5 +66,6 @@ private:
     CameraShaderData mCameraData{};
 
     InstanceMaterials mInstanceMaterials;
+    std::array<XMFLOAT3, m_instanceCount> mInstancePositions;
 };
 }
\ No newline at end of file
@@ -26,6 +26,8 @@ namespace
 static constexpr UINT AccelStructSlot = 0;
 static constexpr UINT DXROutputSlot = 1;
 static constexpr UINT SceneCBSlot = 2;
+// Suzanne is drawn twice, with a single instanced draw per glTF node
+const XMFLOAT3 SuzannePositions[2] = { { 0.0f, 2.0f, 3.0f }, { 5.0f, 2.0f, 3.0f } };
 }
 
 using Microsoft::WRL::ComPtr;
@@ -45,7 +47,8 @@ RtTester::~RtTester()
 
     // dxr
     SafeDelete(mTlas);
-    SafeDelete(mModelBlas);
+    for (auto& blas : mModelBlases)
+        SafeDelete(blas);
     SafeDelete(mFloorBlas);
     SafeDelete(mSdfBlas);
     SafeDelete(mMissShaderTable);
@@ -58,6 +61,12 @@ RtTester::~RtTester()
     SafeDelete(mRtShadowRaysBuffer);
 }
 
+void RtTester::ReleaseResources(RenderContext& context)
+{
+    mSuzanne->ReleaseTextures(*context.TexManager);
+    mFloor->ReleaseTextures(*context.TexManager);
+}
+
 void RtTester::InitResources(RenderContext& context)
 {
     using Microsoft::WRL::ComPtr;
@@ -65,13 +74,8 @@ void RtTester::InitResources(RenderContext& context)
     mCamera = new Camera(1.0472f, 1.77864583f, 0.001f, 1000.0f);
     mCamera->SetWorldPosition({ 0.0f, 2.0f, -2.0f });
     mCameraCb = new UploadBuffer(*context.Device, sizeof(CameraShaderData), true, context.FramesCount);
-    mObjectCb = new UploadBuffer(*context.Device, sizeof(XMFLOAT4X4) * 2, true, 1);
 
     XMFLOAT4X4 toWorld[2];
-    XMStoreFloat4x4(&toWorld[0], XMMatrixTranspose(XMMatrixTranslation(0.0f, 2.0f, 3.0f)));
-    XMStoreFloat4x4(&toWorld[1], XMMatrixTranspose(XMMatrixTranslation(5.0f, 2.0f, 3.0f)));
-    mObjectCb->UploadData(0, toWorld);
-
     mFloorTransformCb = new UploadBuffer(*context.Device, sizeof(XMFLOAT4X4), true, context.FramesCount);
     XMStoreFloat4x4(&toWorld[0], XMMatrixTranspose(XMMatrixTranslation(0.0f, 0.0f, 0.0f)));
     for (UINT i = 0; i < context.FramesCount; ++i)
@@ -92,6 +96,18 @@ void RtTester::InitResources(RenderContext& context)
     mDirectionalLightInd = mLightManager->AddLight(l);
 
     LoadGeometry(context);
+    // The transforms don't change, one slot per glTF node holds both placements of it
+    const auto& instances = mSuzanne->GetInstances();
+    mObjectCb = new UploadBuffer(*context.Device, sizeof(XMFLOAT4X4) * 2, true, static_cast<UINT>(instances.size()));
+    for (UINT i = 0; i < static_cast<UINT>(instances.size()); ++i)
+    {
+        for (UINT j = 0; j < 2; ++j)
+        {
+            XMMATRIX placement = XMMatrixTranslation(SuzannePositions[j].x, SuzannePositions[j].y, SuzannePositions[j].z);
+            XMStoreFloat4x4(&toWorld[j], XMMatrixTranspose(XMMatrixMultiply(XMLoadFloat4x4(&instances[i].Transform), placement)));
+        }
+        mObjectCb->UploadData(i, toWorld);
+    }
     CreateRootSignature(context);
 
     mTonemapper = new Tonemapper();
@@ -159,17 +175,19 @@ void RtTester::DepthPrepass(RenderContext& context)
     ID3D12DescriptorHeap* descHeap[] = { context.TexManager->GetDescriptorHeap() };
     context.CommandList->SetDescriptorHeaps(1, descHeap);
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(0), mCameraCb->GetFrameDataGpuAddress(frameIndex));
-    context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCb->GetFrameDataGpuAddress(0));
 
     if (mDrawSuzanne)
     {
-        for (const auto mesh : mSuzanne->GetMeshes())
+        const auto& instances = mSuzanne->GetInstances();
+        for (UINT i = 0; i < static_cast<UINT>(instances.size()); ++i)
         {
+            const Model::Mesh* mesh = mSuzanne->GetMeshes()[instances[i].MeshIndex];
+            context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCb->GetFrameDataGpuAddress(i));
             context.CommandList->IASetVertexBuffers(0, 1, &mesh->GetVertexBufferView());
             context.CommandList->IASetIndexBuffer(&mesh->GetIndexBufferView());
 
             context.CommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), 2, 0, 0, 0);
+            context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), 2, mesh->GetFirstIndex(), mesh->GetBaseVertex(), 0);
         }
     }
 
@@ -197,21 +215,23 @@ void RtTester::RenderForwardObjects(RenderContext& context)
     ID3D12DescriptorHeap* descHeap[] = { context.TexManager->GetDescriptorHeap() };
     context.CommandList->SetDescriptorHeaps(1, descHeap);
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(0), mCameraCb->GetFrameDataGpuAddress(frameIndex));
-    context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCb->GetFrameDataGpuAddress(0));
     context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(3), mLightManager->GetLightsBufferGpuAddress(frameIndex));
     context.CommandList->SetGraphicsRootDescriptorTable(TextureTableIndex, context.TexManager->GetDescriptorHeap()->GetGPUDescriptorHandleForHeapStart());
 
     if (mDrawSuzanne)
     {
-        for (const auto mesh : mSuzanne->GetMeshes())
+        const auto& instances = mSuzanne->GetInstances();
+        for (UINT i = 0; i < static_cast<UINT>(instances.size()); ++i)
         {
+            const Model::Mesh* mesh = mSuzanne->GetMeshes()[instances[i].MeshIndex];
+            context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(1), mObjectCb->GetFrameDataGpuAddress(i));
             context.CommandList->SetGraphicsRootConstantBufferView(GetCBRootParamIndex(2), mesh->GetMaterialBufferGpuAddress(frameIndex));
 
             context.CommandList->IASetVertexBuffers(0, 1, &mesh->GetVertexBufferView());
             context.CommandList->IASetIndexBuffer(&mesh->GetIndexBufferView());
 
             context.CommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), 2, 0, 0, 0);
+            context.CommandList->DrawIndexedInstanced(mesh->GetIndexCount(), 2, mesh->GetFirstIndex(), mesh->GetBaseVertex(), 0);
         }
     }
 
@@ -229,7 +249,12 @@ void RtTester::RenderForwardObjects(RenderContext& context)
 void RtTester::LoadGeometry(RenderContext& context)
 {
     auto path = ASSETS_DIR + std::string("Models//Suzanne//glTF//Suzanne.gltf");
-    mSuzanne = new Model(context, path);
+    // Both 1024 textures share a page. No mips, so none are lost to the padding.
+    ModelLoadOptions options;
+    options.PackTextures = true;
+    options.Packing.MaxTextureSize = 1024;
+    options.Packing.PageSize = 4096;
+    mSuzanne = new Model(context, path, options);
 
     std::vector<Vertex> verts;
     verts.resize(4);
@@ -353,7 +378,8 @@ void RtTester::CreateRtRootSigs(RenderContext& context)
 
 void RtTester::BuildAccelerationStructures(RenderContext& context)
 {
-    mModelBlas = new DXR::BottomLevelAccelerationStructure(context, mSuzanne);
+    for (const auto mesh : mSuzanne->GetMeshes())
+        mModelBlases.push_back(new DXR::BottomLevelAccelerationStructure(context, mesh));
     mFloorBlas = new DXR::BottomLevelAccelerationStructure(context, mFloor);
 
     D3D12_RAYTRACING_AABB aabb =
@@ -363,7 +389,8 @@ void RtTester::BuildAccelerationStructures(RenderContext& context)
 
     mTlas = new DXR::TopLevelAccelerationStructure();
 
-    mModelBlas->Prebuild(context);
+    for (auto blas : mModelBlases)
+        blas->Prebuild(context);
     mFloorBlas->Prebuild(context);
     mSdfBlas->Prebuild(context);
 
@@ -371,13 +398,12 @@ void RtTester::BuildAccelerationStructures(RenderContext& context)
 
     mTlas->AddDescriptor(*mFloorBlas, transform, 2);
 
-    transform._24 = 2.0f;
-    transform._34 = 3.0f;
-
-    mTlas->AddDescriptor(*mModelBlas, transform, 1);
-
-    transform._14 = 5.0f;
-    mTlas->AddDescriptor(*mModelBlas, transform, 1);
+    for (const auto& position : SuzannePositions)
+    {
+        XMFLOAT4X4 toWorld;
+        XMStoreFloat4x4(&toWorld, XMMatrixTranslation(position.x, position.y, position.z));
+        mTlas->AddInstances(*mSuzanne, mModelBlases, toWorld, 1);
+    }
 
     transform._14 = -6.0f;
     transform._24 = 2.0f;
@@ -386,9 +412,12 @@ void RtTester::BuildAccelerationStructures(RenderContext& context)
     mTlas->AddDescriptor(*mSdfBlas, transform, 1, 0, 0, 1);
     mTlas->Prebuild(context);
 
-    UINT64 maxScratchBufferSize = DXR::AccelerationStructure::GetMaxScratchSize({ mModelBlas, mFloorBlas, mSdfBlas, mTlas });
+    std::vector<DXR::AccelerationStructure*> structs = { mFloorBlas, mSdfBlas, mTlas };
+    structs.insert(structs.end(), mModelBlases.begin(), mModelBlases.end());
+    UINT64 maxScratchBufferSize = DXR::AccelerationStructure::GetMaxScratchSize(structs);
     mScratchBuffer = new UnorderedAccessBuffer(context.CommandList, *context.Device, UINT(maxScratchBufferSize));
-    mModelBlas->Build(context, mScratchBuffer, true);
+    for (auto blas : mModelBlases)
+        blas->Build(context, mScratchBuffer, true);
     mFloorBlas->Build(context, mScratchBuffer, true);
     mSdfBlas->Build(context, mScratchBuffer, true);
     mTlas->Build(context, mScratchBuffer, false);
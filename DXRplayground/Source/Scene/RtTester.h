@@ -35,6 +35,7 @@ public:
 
     void InitResources(RenderContext& context) override;
     void Render(RenderContext& context) override;
+    void ReleaseResources(RenderContext& context) override;
 
 private:
     struct NonTexturedMaterial
@@ -113,7 +114,7 @@ private:
     Shader mRayGenShader;
     Shader mClosestHitShader;
     Shader mMissShader;
-    DXR::BottomLevelAccelerationStructure* mModelBlas = nullptr;
+    std::vector<DXR::BottomLevelAccelerationStructure*> mModelBlases; // One per unique mesh
     DXR::BottomLevelAccelerationStructure* mFloorBlas = nullptr;
     DXR::BottomLevelAccelerationStructure* mSdfBlas = nullptr;
     DXR::TopLevelAccelerationStructure* mTlas = nullptr;
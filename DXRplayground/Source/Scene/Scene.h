@@ -9,6 +9,8 @@ class Scene
 public:
     virtual void InitResources(RenderContext& context) abstract;
     virtual void Render(RenderContext& context) abstract;
+    // At shutdown, before the managers go. The GPU is done with everything by then.
+    virtual void ReleaseResources(RenderContext& context) {}
     virtual ~Scene() = default;
 };
 }
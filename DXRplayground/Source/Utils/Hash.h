@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+// 64 bit FNV-1a. Not cryptographic, only used to detect changed assets.
+constexpr UINT64 HashSeed = 0xcbf29ce484222325ull;
+
+inline UINT64 HashBytes(const void* data, size_t size, UINT64 hash = HashSeed)
+{
+    const byte* bytes = reinterpret_cast<const byte*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline UINT64 HashString(const std::string& str, UINT64 hash = HashSeed)
+{
+    return HashBytes(str.data(), str.size(), hash);
+}
+
+template <typename T>
+inline UINT64 HashValue(const T& value, UINT64 hash = HashSeed)
+{
+    return HashBytes(&value, sizeof(T), hash);
+}
+}
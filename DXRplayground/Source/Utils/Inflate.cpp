@@ -0,0 +1,370 @@
+#include "Utils/Inflate.h"
+
+#include <cstring>
+
+namespace DirectxPlayground
+{
+namespace
+{
+constexpr UINT MaxCodeLength = 15;
+constexpr UINT FastBits = 10;
+constexpr UINT MaxLitLenSymbols = 288;
+constexpr UINT MaxDistanceSymbols = 32;
+
+constexpr UINT16 LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr byte LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr UINT16 DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr byte DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+constexpr byte CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+UINT ReverseBits(UINT code, UINT length)
+{
+    UINT reversed = 0;
+    for (UINT i = 0; i < length; ++i)
+    {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+// LSB first reader over a 64 bit buffer. A refill loads a whole word and keeps the bytes it couldn't fit, they're loaded
+// again at the same position by the next refill. Past the end it reads zeros and counts them.
+class BitReader
+{
+public:
+    BitReader(const byte* data, size_t size)
+        : mIn(data)
+        , mEnd(data + size)
+    {
+    }
+
+    // At least 48 bits afterwards, enough for a length and a distance with their extra bits
+    void Refill()
+    {
+        if (mCount >= 48)
+            return;
+        if (mEnd - mIn >= 8)
+        {
+            UINT64 word;
+            memcpy(&word, mIn, sizeof(word));
+            mBits |= word << mCount;
+            mIn += (63 - mCount) >> 3;
+            mCount |= 56;
+            return;
+        }
+        while (mCount <= 56)
+        {
+            UINT64 value = 0;
+            if (mIn < mEnd)
+                value = *mIn++;
+            else
+                ++mOverrun;
+            mBits |= value << mCount;
+            mCount += 8;
+        }
+    }
+
+    UINT Peek(UINT count) const
+    {
+        return static_cast<UINT>(mBits & ((UINT64(1) << count) - 1));
+    }
+
+    void Consume(UINT count)
+    {
+        mBits >>= count;
+        mCount -= count;
+    }
+
+    UINT Take(UINT count)
+    {
+        UINT value = Peek(count);
+        Consume(count);
+        return value;
+    }
+
+    // Stored blocks are read as bytes, the buffered ones are handed back. Nullptr if zeros past the end were consumed.
+    const byte* AlignToByte()
+    {
+        Consume(mCount & 7);
+        UINT buffered = mCount >> 3;
+        if (buffered < mOverrun)
+            return nullptr;
+        mIn -= buffered - mOverrun;
+        mBits = 0;
+        mCount = 0;
+        mOverrun = 0;
+        return mIn;
+    }
+
+    size_t GetRemainingBytes() const
+    {
+        return static_cast<size_t>(mEnd - mIn);
+    }
+
+    void SkipBytes(size_t count)
+    {
+        mIn += count;
+    }
+
+    bool IsOverrun() const
+    {
+        return mCount < mOverrun * 8;
+    }
+
+private:
+    const byte* mIn = nullptr;
+    const byte* mEnd = nullptr;
+    UINT64 mBits = 0;
+    UINT mCount = 0;
+    UINT mOverrun = 0;
+};
+
+// Canonical Huffman code. Codes up to FastBits long take one lookup of the next bits, longer ones walk the code lengths.
+struct HuffmanTable
+{
+    UINT16 Fast[1 << FastBits]; // Symbol << 4 | length, 0 for the longer codes
+    UINT FirstCode[MaxCodeLength + 1];
+    UINT FirstSymbol[MaxCodeLength + 1];
+    UINT CodeLimit[MaxCodeLength + 1]; // First code past the length, aligned to 16 bits
+    UINT16 Symbols[MaxLitLenSymbols]; // Sorted by code
+
+    bool Build(const byte* lengths, UINT count);
+    int Decode(BitReader& reader) const;
+};
+
+// Incomplete codes are fine, the missing codes fail when they're decoded
+bool HuffmanTable::Build(const byte* lengths, UINT count)
+{
+    UINT counts[MaxCodeLength + 1] = {};
+    for (UINT i = 0; i < count; ++i)
+        ++counts[lengths[i]];
+    int left = 1;
+    for (UINT length = 1; length <= MaxCodeLength; ++length)
+    {
+        left = (left << 1) - static_cast<int>(counts[length]);
+        if (left < 0)
+            return false;
+    }
+
+    UINT nextCode[MaxCodeLength + 1] = {};
+    UINT nextSymbol[MaxCodeLength + 1] = {};
+    UINT code = 0;
+    UINT symbol = 0;
+    for (UINT length = 1; length <= MaxCodeLength; ++length)
+    {
+        FirstCode[length] = nextCode[length] = code;
+        FirstSymbol[length] = nextSymbol[length] = symbol;
+        code += counts[length];
+        symbol += counts[length];
+        CodeLimit[length] = code << (16 - length);
+        code <<= 1;
+    }
+
+    memset(Fast, 0, sizeof(Fast));
+    for (UINT i = 0; i < count; ++i)
+    {
+        UINT length = lengths[i];
+        if (length == 0)
+            continue;
+        Symbols[nextSymbol[length]++] = static_cast<UINT16>(i);
+        UINT symbolCode = nextCode[length]++;
+        if (length <= FastBits)
+        {
+            for (UINT bits = ReverseBits(symbolCode, length); bits < (1U << FastBits); bits += 1U << length)
+                Fast[bits] = static_cast<UINT16>((i << 4) | length);
+        }
+    }
+    return true;
+}
+
+int HuffmanTable::Decode(BitReader& reader) const
+{
+    UINT entry = Fast[reader.Peek(FastBits)];
+    if (entry != 0)
+    {
+        reader.Consume(entry & 15);
+        return static_cast<int>(entry >> 4);
+    }
+    UINT code = ReverseBits(reader.Peek(16), 16);
+    for (UINT length = FastBits + 1; length <= MaxCodeLength; ++length)
+    {
+        if (code < CodeLimit[length])
+        {
+            reader.Consume(length);
+            return Symbols[(code >> (16 - length)) - FirstCode[length] + FirstSymbol[length]];
+        }
+    }
+    return -1;
+}
+
+void BuildFixedTables(HuffmanTable& litLen, HuffmanTable& distance)
+{
+    byte lengths[MaxLitLenSymbols];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    litLen.Build(lengths, MaxLitLenSymbols);
+    memset(lengths, 5, MaxDistanceSymbols);
+    distance.Build(lengths, MaxDistanceSymbols);
+}
+
+bool ReadDynamicTables(BitReader& reader, HuffmanTable& litLen, HuffmanTable& distance)
+{
+    reader.Refill();
+    UINT litLenCount = reader.Take(5) + 257;
+    UINT distanceCount = reader.Take(5) + 1;
+    UINT codeLengthCount = reader.Take(4) + 4;
+    if (litLenCount > 286 || distanceCount > 30)
+        return false;
+
+    byte codeLengthLengths[19] = {};
+    for (UINT i = 0; i < codeLengthCount; ++i)
+    {
+        reader.Refill();
+        codeLengthLengths[CodeLengthOrder[i]] = static_cast<byte>(reader.Take(3));
+    }
+    HuffmanTable codeLengths;
+    if (!codeLengths.Build(codeLengthLengths, 19))
+        return false;
+
+    // Both codes are one sequence, repeats can cross from one to the other
+    byte lengths[286 + 30];
+    UINT total = litLenCount + distanceCount;
+    for (UINT i = 0; i < total;)
+    {
+        reader.Refill();
+        int symbol = codeLengths.Decode(reader);
+        if (symbol < 0)
+            return false;
+        if (symbol < 16)
+        {
+            lengths[i++] = static_cast<byte>(symbol);
+            continue;
+        }
+        byte value = 0;
+        UINT repeat = 0;
+        if (symbol == 16)
+        {
+            if (i == 0)
+                return false;
+            value = lengths[i - 1];
+            repeat = 3 + reader.Take(2);
+        }
+        else
+        {
+            repeat = symbol == 17 ? 3 + reader.Take(3) : 11 + reader.Take(7);
+        }
+        if (repeat > total - i)
+            return false;
+        memset(lengths + i, value, repeat);
+        i += repeat;
+    }
+    if (lengths[256] == 0)
+        return false;
+    return litLen.Build(lengths, litLenCount) && distance.Build(lengths + litLenCount, distanceCount);
+}
+
+void CopyMatch(byte* out, size_t distance, size_t length, const byte* end)
+{
+    const byte* src = out - distance;
+    if (distance >= 8 && size_t(end - out) >= length + 8)
+    {
+        // Words never overlap at this distance. Up to 7 bytes past the match get written, the next symbols overwrite them.
+        byte* matchEnd = out + length;
+        do
+        {
+            UINT64 word;
+            memcpy(&word, src, sizeof(word));
+            memcpy(out, &word, sizeof(word));
+            out += 8;
+            src += 8;
+        } while (out < matchEnd);
+    }
+    else if (distance == 1)
+    {
+        memset(out, *src, length);
+    }
+    else
+    {
+        for (size_t i = 0; i < length; ++i)
+            out[i] = src[i];
+    }
+}
+
+bool InflateBlock(BitReader& reader, const HuffmanTable& litLen, const HuffmanTable& distances, const byte* start, byte*& out, const byte* end)
+{
+    for (;;)
+    {
+        reader.Refill();
+        int symbol = litLen.Decode(reader);
+        if (symbol < 256)
+        {
+            if (symbol < 0 || out == end)
+                return false;
+            *out++ = static_cast<byte>(symbol);
+            continue;
+        }
+        if (symbol == 256)
+            return true;
+
+        symbol -= 257;
+        if (symbol >= 29)
+            return false;
+        size_t length = LengthBase[symbol] + reader.Take(LengthExtra[symbol]);
+        int distanceSymbol = distances.Decode(reader);
+        if (distanceSymbol < 0 || distanceSymbol >= 30)
+            return false;
+        size_t distance = DistanceBase[distanceSymbol] + reader.Take(DistanceExtra[distanceSymbol]);
+        if (distance > size_t(out - start) || length > size_t(end - out))
+            return false;
+        CopyMatch(out, distance, length, end);
+        out += length;
+    }
+}
+}
+
+bool InflateZlib(const byte* src, size_t srcSize, byte* dst, size_t dstSize)
+{
+    // Deflate with a window up to 32 KB and no preset dictionary
+    if (srcSize < 2 || (src[0] & 15) != 8 || (src[0] >> 4) > 7 || (src[0] * 256 + src[1]) % 31 != 0 || (src[1] & 0x20) != 0)
+        return false;
+
+    BitReader reader(src + 2, srcSize - 2);
+    HuffmanTable litLen;
+    HuffmanTable distance;
+    byte* out = dst;
+    const byte* end = dst + dstSize;
+    bool lastBlock = false;
+    while (!lastBlock)
+    {
+        reader.Refill();
+        lastBlock = reader.Take(1) != 0;
+        UINT type = reader.Take(2);
+        if (type == 0)
+        {
+            const byte* in = reader.AlignToByte();
+            if (in == nullptr || reader.GetRemainingBytes() < 4)
+                return false;
+            size_t length = in[0] | (in[1] << 8);
+            size_t inverted = in[2] | (in[3] << 8);
+            if ((length ^ 0xffff) != inverted || reader.GetRemainingBytes() - 4 < length || size_t(end - out) < length)
+                return false;
+            memcpy(out, in + 4, length);
+            out += length;
+            reader.SkipBytes(4 + length);
+            continue;
+        }
+
+        if (type == 1)
+            BuildFixedTables(litLen, distance);
+        else if (type != 2 || !ReadDynamicTables(reader, litLen, distance))
+            return false;
+        if (!InflateBlock(reader, litLen, distance, dst, out, end))
+            return false;
+    }
+    return out == end && !reader.IsOverrun();
+}
+}
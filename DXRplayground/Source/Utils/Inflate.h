@@ -0,0 +1,10 @@
+#pragma once
+
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+// Decompresses a complete zlib stream into a buffer it has to fill exactly, so the output size has to be known up front as it
+// is for PNG pixels. Fails on corrupt streams, the Adler-32 at the end isn't checked.
+bool InflateZlib(const byte* src, size_t srcSize, byte* dst, size_t dstSize);
+}
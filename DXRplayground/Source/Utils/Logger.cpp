@@ -6,7 +6,13 @@ ImguiLogger ImguiLogger::Logger{};
 
 ImguiLogger::ImguiLogger()
 {
-    Clear();
+    ClearInternal();
+}
+
+void ImguiLogger::Clear()
+{
+    std::scoped_lock l(mMutex);
+    ClearInternal();
 }
 
 void ImguiLogger::Draw(const char* title, bool* p_open /*= NULL*/)
@@ -17,6 +23,8 @@ void ImguiLogger::Draw(const char* title, bool* p_open /*= NULL*/)
         return;
     }
 
+    // Held for the whole window, the workers can't append while the lines are drawn
+    std::scoped_lock l(mMutex);
     if (ImGui::Checkbox("Auto-scroll", &mAutoScroll))
         if (mAutoScroll)
             mScrollToBottom = true;
@@ -29,7 +37,7 @@ void ImguiLogger::Draw(const char* title, bool* p_open /*= NULL*/)
     ImGui::BeginChild("scrolling", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
 
     if (clear)
-        Clear();
+        ClearInternal();
     if (copy)
         ImGui::LogToClipboard();
 
@@ -70,6 +78,7 @@ void ImguiLogger::Draw(const char* title, bool* p_open /*= NULL*/)
 
 void ImguiLogger::AddLogInternal(const char* fmt, ...)
 {
+    std::scoped_lock l(mMutex);
     int old_size = mTextBuffer.size();
     va_list args;
     va_start(args, fmt);
@@ -81,4 +90,11 @@ void ImguiLogger::AddLogInternal(const char* fmt, ...)
     if (mAutoScroll)
         mScrollToBottom = true;
 }
+
+void ImguiLogger::ClearInternal()
+{
+    mTextBuffer.clear();
+    mLineOffsets.clear();
+    mLineOffsets.push_back(0);
+}
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <string>
 #include <sstream>
 #include <locale>
+#include <mutex>
 // See from imgui_demo.cpp
 
 namespace DirectxPlayground
@@ -24,20 +25,15 @@ public:
 
 private:
     void AddLogInternal(const char* fmt, ...);
+    void ClearInternal();
 
     ImGuiTextBuffer mTextBuffer;
     ImVector<int> mLineOffsets; // Index to lines offset. We maintain this with AddLog() calls, allowing us to have a random access on lines
     bool mAutoScroll = true;
     bool mScrollToBottom = false;
+    std::mutex mMutex; // Assets are parsed on worker threads, they log while the render thread draws or clears
 };
 
-inline void ImguiLogger::Clear()
-{
-    mTextBuffer.clear();
-    mLineOffsets.clear();
-    mLineOffsets.push_back(0);
-}
-
 inline void ImguiLogger::AddLog(const std::string& msg)
 {
     AddLogInternal("%s \n", msg.c_str());
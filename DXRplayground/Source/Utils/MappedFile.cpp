@@ -0,0 +1,35 @@
+#include "Utils/MappedFile.h"
+
+namespace DirectxPlayground
+{
+
+MappedFile::MappedFile(const std::string& path)
+{
+    mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+        return;
+
+    mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mMapping == nullptr)
+        return;
+
+    mData = reinterpret_cast<const byte*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    if (mData != nullptr)
+        mSize = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+}
+
+}
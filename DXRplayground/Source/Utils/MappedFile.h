@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+// Read only view of a whole file. The view stays valid until the object is destroyed.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+    ~MappedFile();
+
+    bool IsValid() const;
+    const byte* GetData() const;
+    size_t GetSize() const;
+
+private:
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+    const byte* mData = nullptr;
+    size_t mSize = 0;
+};
+
+inline bool MappedFile::IsValid() const
+{
+    return mData != nullptr;
+}
+
+inline const byte* MappedFile::GetData() const
+{
+    return mData;
+}
+
+inline size_t MappedFile::GetSize() const
+{
+    return mSize;
+}
+}
@@ -0,0 +1,103 @@
+#include "Utils/ThreadPool.h"
+
+#include <algorithm>
+
+namespace DirectxPlayground
+{
+
+ThreadPool::ThreadPool(UINT workersCount /*= GetDefaultWorkersCount()*/)
+{
+    mWorkers.reserve(workersCount);
+    for (UINT i = 0; i < workersCount; ++i)
+        mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock l(mMutex);
+        mShutdown = true;
+    }
+    mCondition.notify_all();
+    for (auto& worker : mWorkers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+    if (count == 0)
+        return;
+    if (count == 1 || mWorkers.empty())
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    // Helpers may start after the loop is over, so the loop state is shared with them instead of living on the stack.
+    auto data = std::make_shared<LoopData>();
+    data->Count = count;
+    data->Func = &func;
+
+    size_t helpersCount = std::min(count - 1, mWorkers.size());
+    for (size_t i = 0; i < helpersCount; ++i)
+        Push([data]() { ProcessLoop(*data); });
+
+    ProcessLoop(*data);
+
+    std::unique_lock l(data->Mutex);
+    data->Done.wait(l, [&data]() { return data->Completed.load() == data->Count; });
+}
+
+void ThreadPool::Run(std::function<void()> task)
+{
+    if (mWorkers.empty())
+        task();
+    else
+        Push(std::move(task));
+}
+
+void ThreadPool::ProcessLoop(LoopData& data)
+{
+    size_t processed = 0;
+    for (size_t i = data.Next++; i < data.Count; i = data.Next++)
+    {
+        (*data.Func)(i);
+        ++processed;
+    }
+    if (processed == 0)
+        return;
+    if (data.Completed.fetch_add(processed) + processed == data.Count)
+    {
+        std::scoped_lock l(data.Mutex);
+        data.Done.notify_all();
+    }
+}
+
+void ThreadPool::Push(std::function<void()> task)
+{
+    {
+        std::scoped_lock l(mMutex);
+        mTasks.push(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock l(mMutex);
+            mCondition.wait(l, [this]() { return mShutdown || !mTasks.empty(); });
+            if (mShutdown && mTasks.empty())
+                return;
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+        task();
+    }
+}
+
+}
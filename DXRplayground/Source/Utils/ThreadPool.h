@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <windows.h>
+
+namespace DirectxPlayground
+{
+// Fixed set of workers for CPU side asset processing. ParallelFor can be called from any thread (workers included),
+// the calling thread always takes part in the loop, so nested calls can't starve each other.
+class ThreadPool
+{
+public:
+    ThreadPool(UINT workersCount = GetDefaultWorkersCount());
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+    ~ThreadPool();
+
+    UINT GetWorkersCount() const;
+    UINT GetThreadsCount() const;
+
+    void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+    // Queues the task for a worker and returns, without workers it runs right here. The pool finishes its queue before it's destroyed.
+    void Run(std::function<void()> task);
+
+    static UINT GetDefaultWorkersCount();
+
+private:
+    struct LoopData
+    {
+        std::atomic<size_t> Next{ 0 };
+        std::atomic<size_t> Completed{ 0 };
+        size_t Count = 0;
+        const std::function<void(size_t)>* Func = nullptr;
+        std::mutex Mutex;
+        std::condition_variable Done;
+    };
+
+    static void ProcessLoop(LoopData& data);
+    void Push(std::function<void()> task);
+    void WorkerLoop();
+
+    std::vector<std::thread> mWorkers;
+    std::queue<std::function<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mShutdown = false;
+};
+
+inline UINT ThreadPool::GetWorkersCount() const
+{
+    return static_cast<UINT>(mWorkers.size());
+}
+
+inline UINT ThreadPool::GetThreadsCount() const
+{
+    return GetWorkersCount() + 1;
+}
+
+inline UINT ThreadPool::GetDefaultWorkersCount()
+{
+    UINT hwThreads = std::thread::hardware_concurrency();
+    return hwThreads > 1 ? hwThreads - 1 : 0;
+}
+}
@@ -0,0 +1,103 @@
+#include "Test.h"
+
+#include <cstddef>
+#include <cstring>
+#include <random>
+
+#include "DXrenderer/Geometry/AccessorDecoder.h"
+#include "DXrenderer/Geometry/Vertex.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+// The per-component conversion ParseVertices used before the kernels
+float ReadComponent(const byte* data, AccessorComponent component, bool normalized)
+{
+    switch (component)
+    {
+    case AccessorComponent::Float:
+        return *reinterpret_cast<const float*>(data);
+    case AccessorComponent::Int8:
+        return normalized ? std::max(*reinterpret_cast<const INT8*>(data) / 127.0f, -1.0f) : *reinterpret_cast<const INT8*>(data);
+    case AccessorComponent::UInt8:
+        return normalized ? *data / 255.0f : *data;
+    case AccessorComponent::Int16:
+        return normalized ? std::max(*reinterpret_cast<const INT16*>(data) / 32767.0f, -1.0f) : *reinterpret_cast<const INT16*>(data);
+    case AccessorComponent::UInt16:
+        return normalized ? *reinterpret_cast<const UINT16*>(data) / 65535.0f : *reinterpret_cast<const UINT16*>(data);
+    default:
+        return 0.0f;
+    }
+}
+
+void DecodeLoop(const AccessorView& view, float* destination)
+{
+    UINT componentSize = GetComponentSize(view.Component);
+    float c[4] = {};
+    for (size_t i = 0; i < view.Count; ++i)
+    {
+        const byte* element = view.Data + size_t(view.Stride) * i;
+        for (UINT j = 0; j < view.ComponentsCount; ++j)
+            c[j] = ReadComponent(element + j * componentSize, view.Component, view.Normalized);
+        float* target = reinterpret_cast<float*>(reinterpret_cast<byte*>(destination) + i * sizeof(Vertex));
+        for (UINT j = 0; j < view.ComponentsCount; ++j)
+            target[j] = c[j];
+    }
+}
+}
+
+// A quantized mesh: float3 positions, unorm16 uvs and snorm8 normals, interleaved in one buffer view like exporters write them
+BENCHMARK(AccessorDecoderBench, MillionVertices)
+{
+    constexpr size_t count = 1 << 20;
+    constexpr UINT stride = 12 + 4 + 4;
+    std::vector<byte> data(count * stride);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    for (size_t i = 0; i < count; ++i)
+    {
+        float position[3] = { distribution(random), distribution(random), distribution(random) };
+        memcpy(&data[i * stride], position, sizeof(position));
+        for (UINT j = 12; j < stride; ++j)
+            data[i * stride + j] = static_cast<byte>(random());
+    }
+
+    AccessorView views[3];
+    views[0] = { data.data(), count, stride, AccessorComponent::Float, 3, 1, false };
+    views[1] = { data.data() + 12, count, stride, AccessorComponent::UInt16, 2, 1, true };
+    views[2] = { data.data() + 16, count, stride, AccessorComponent::Int8, 3, 1, true };
+    const size_t fieldOffsets[3] = { offsetof(Vertex, Pos), offsetof(Vertex, Uv), offsetof(Vertex, Norm) };
+
+    std::vector<Vertex> loopVertices(count);
+    std::vector<Vertex> scalarVertices(count);
+    std::vector<Vertex> simdVertices(count);
+    auto decodeWith = [&](std::vector<Vertex>& vertices, void (*decode)(const AccessorView&, const DecodeTarget&))
+    {
+        for (UINT a = 0; a < 3; ++a)
+        {
+            DecodeTarget target;
+            target.Data = reinterpret_cast<byte*>(vertices.data()) + fieldOffsets[a];
+            target.Stride = sizeof(Vertex);
+            decode(views[a], target);
+        }
+    };
+    float loopTime = MeasureMilliseconds([&]()
+    {
+        for (UINT a = 0; a < 3; ++a)
+            DecodeLoop(views[a], reinterpret_cast<float*>(reinterpret_cast<byte*>(loopVertices.data()) + fieldOffsets[a]));
+    }, 5);
+    float scalarTime = MeasureMilliseconds([&]() { decodeWith(scalarVertices, DecodeAccessorScalar); }, 5);
+    float simdTime = MeasureMilliseconds([&]() { decodeWith(simdVertices, DecodeAccessor); }, 5);
+
+    CHECK(memcmp(scalarVertices.data(), simdVertices.data(), count * sizeof(Vertex)) == 0);
+    float maxDifference = 0.0f;
+    for (size_t i = 0; i < count; ++i)
+    {
+        maxDifference = std::max({ maxDifference, std::abs(loopVertices[i].Pos.x - simdVertices[i].Pos.x), std::abs(loopVertices[i].Uv.y - simdVertices[i].Uv.y),
+            std::abs(loopVertices[i].Norm.z - simdVertices[i].Norm.z) });
+    }
+    CHECK(maxDifference < 1e-6f);
+    printf("  %zu vertices: old loop %.2f ms, scalar kernels %.2f ms, %s kernels %.2f ms\n", count, loopTime, scalarTime, GetAccessorDecoderIsaName(), simdTime);
+}
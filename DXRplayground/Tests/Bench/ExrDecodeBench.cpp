@@ -0,0 +1,168 @@
+#include "Test.h"
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "DXrenderer/Textures/ExrDecoder.h"
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
+
+#include "External/TinyEXR/tinyexr.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+constexpr int TileSize = 64;
+
+// Half float B, G, R planes the way EXR writers order them: smooth gradients with blocky noise, so the compressors
+// have some work to do without the data turning into random bits
+std::vector<byte> MakeExr(int width, int height, int compression, bool tiled)
+{
+    std::vector<float> planes[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        planes[c].resize(size_t(width) * height);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                UINT seed = (UINT(x / 8) * 73856093u) ^ (UINT(y / 8) * 19349663u) ^ (UINT(c) * 83492791u);
+                seed = seed * 1664525u + 1013904223u;
+                float noise = float(seed >> 8) / float(1 << 24);
+                planes[c][size_t(y) * width + x] = std::exp2(8.0f * float(x) / float(width) - 4.0f) * (0.5f + 0.5f * float(y + c * 97) / float(height)) + 0.05f * noise;
+            }
+        }
+    }
+
+    EXRHeader header;
+    InitEXRHeader(&header);
+    EXRChannelInfo channels[3] = {};
+    int pixelTypes[3] = { TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT };
+    int requestedTypes[3] = { TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF };
+    strcpy(channels[0].name, "B");
+    strcpy(channels[1].name, "G");
+    strcpy(channels[2].name, "R");
+    header.num_channels = 3;
+    header.channels = channels;
+    header.pixel_types = pixelTypes;
+    header.requested_pixel_types = requestedTypes;
+    header.compression_type = compression;
+    header.data_window = { 0, 0, width - 1, height - 1 };
+    header.display_window = header.data_window;
+
+    EXRImage image;
+    InitEXRImage(&image);
+    image.width = width;
+    image.height = height;
+    image.num_channels = 3;
+    unsigned char* planePointers[3] = { reinterpret_cast<unsigned char*>(planes[2].data()), reinterpret_cast<unsigned char*>(planes[1].data()),
+        reinterpret_cast<unsigned char*>(planes[0].data()) };
+
+    // Tiles hold their own planes, the size is a multiple of the tile size so they're all full
+    std::vector<EXRTile> tiles;
+    std::vector<std::vector<float>> tilePlanes;
+    std::vector<unsigned char*> tilePointers;
+    if (tiled)
+    {
+        header.tiled = 1;
+        header.tile_size_x = TileSize;
+        header.tile_size_y = TileSize;
+        header.tile_level_mode = TINYEXR_TILE_ONE_LEVEL;
+        int tilesX = width / TileSize;
+        int tilesY = height / TileSize;
+        tiles.resize(size_t(tilesX) * tilesY);
+        tilePlanes.resize(tiles.size() * 3);
+        tilePointers.resize(tiles.size() * 3);
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            EXRTile& tile = tiles[i];
+            tile.offset_x = int(i % tilesX);
+            tile.offset_y = int(i / tilesX);
+            tile.width = TileSize;
+            tile.height = TileSize;
+            for (int c = 0; c < 3; ++c)
+            {
+                std::vector<float>& plane = tilePlanes[i * 3 + c];
+                plane.resize(TileSize * TileSize);
+                const float* src = reinterpret_cast<const float*>(planePointers[c]);
+                for (int y = 0; y < TileSize; ++y)
+                    memcpy(&plane[y * TileSize], src + size_t(tile.offset_y * TileSize + y) * width + tile.offset_x * TileSize, TileSize * sizeof(float));
+                tilePointers[i * 3 + c] = reinterpret_cast<unsigned char*>(plane.data());
+            }
+            tile.images = &tilePointers[i * 3];
+        }
+        image.tiles = tiles.data();
+        image.num_tiles = static_cast<int>(tiles.size());
+    }
+    else
+    {
+        image.images = planePointers;
+    }
+
+    unsigned char* memory = nullptr;
+    const char* err = nullptr;
+    size_t size = SaveEXRImageToMemory(&image, &header, &memory, &err);
+    if (err != nullptr)
+        FreeEXRErrorMessage(err);
+    std::vector<byte> data(memory, memory + size);
+    free(memory);
+    return data;
+}
+
+// The decode before: tinyexr's RGBA loader, then a copy of its malloc'd image into the texture buffer
+bool DecodeExrRgba(const std::vector<byte>& data, std::vector<byte>& pixels)
+{
+    float* rgba = nullptr;
+    int width = 0;
+    int height = 0;
+    if (LoadEXRFromMemory(&rgba, &width, &height, data.data(), data.size(), nullptr) != TINYEXR_SUCCESS)
+        return false;
+    pixels.resize(size_t(width) * height * sizeof(float) * 4);
+    memcpy(pixels.data(), rgba, pixels.size());
+    free(rgba);
+    return true;
+}
+
+void BenchmarkExr(const char* name, const std::vector<byte>& data)
+{
+    REQUIRE(!data.empty());
+    ThreadPool workers(ThreadPool::GetDefaultWorkersCount());
+    std::vector<byte> before;
+    std::vector<byte> serial;
+    std::vector<byte> pooled;
+    UINT width = 0;
+    UINT height = 0;
+    bool decoded = true;
+    float beforeTime = MeasureMilliseconds([&]() { decoded &= DecodeExrRgba(data, before); }, 3);
+    float serialTime = MeasureMilliseconds([&]() { decoded &= DecodeExr(data.data(), data.size(), serial, width, height, nullptr); }, 3);
+    float pooledTime = MeasureMilliseconds([&]() { decoded &= DecodeExr(data.data(), data.size(), pooled, width, height, &workers); }, 3);
+    CHECK(decoded);
+    CHECK(serial == before);
+    CHECK(pooled == before);
+    printf("  %s %ux%u, %.1f MB: LoadEXR + copy %.1f ms, DecodeExr %.1f ms on 1 thread, %.1f ms on %u threads (tinyexr uses %u threads for the chunks)\n",
+        name, width, height, data.size() / (1024.0f * 1024.0f), beforeTime, serialTime, pooledTime, workers.GetThreadsCount(), std::thread::hardware_concurrency());
+}
+}
+
+BENCHMARK(ExrDecodeBench, Asakusa)
+{
+    MappedFile file(ASSETS_DIR + std::string("Textures//asakusa.exr"));
+    if (!file.IsValid())
+        SKIP("asakusa.exr isn't available");
+    BenchmarkExr("asakusa.exr", std::vector<byte>(file.GetData(), file.GetData() + file.GetSize()));
+}
+
+BENCHMARK(ExrDecodeBench, SyntheticScanlines)
+{
+    BenchmarkExr("Uncompressed", MakeExr(4096, 2048, TINYEXR_COMPRESSIONTYPE_NONE, false));
+    BenchmarkExr("ZIP", MakeExr(4096, 2048, TINYEXR_COMPRESSIONTYPE_ZIP, false));
+    BenchmarkExr("PIZ", MakeExr(4096, 2048, TINYEXR_COMPRESSIONTYPE_PIZ, false));
+}
+
+BENCHMARK(ExrDecodeBench, SyntheticTiles)
+{
+    BenchmarkExr("Tiled ZIP", MakeExr(2048, 2048, TINYEXR_COMPRESSIONTYPE_ZIP, true));
+}
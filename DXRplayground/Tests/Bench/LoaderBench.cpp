@@ -0,0 +1,65 @@
+#include "Test.h"
+#include "GltfGeometry.h"
+
+#include <cstring>
+
+#include "DXrenderer/Geometry/GltfPrimitive.h"
+#include "Utils/ThreadPool.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+bool IsSameGeometry(const GltfPrimitiveGeometry& a, const GltfPrimitiveGeometry& b)
+{
+    return a.Indices == b.Indices && a.Vertices.size() == b.Vertices.size() &&
+        memcmp(a.Vertices.data(), b.Vertices.data(), a.Vertices.size() * sizeof(Vertex)) == 0;
+}
+
+// Model's CPU load path without the device: LoadGltf parses the file, then DecodeGltfPrimitive converts every primitive
+// on the pool the way ParseGLTFMeshes does it. The decode is timed over the thread counts up to the default pool.
+void BenchmarkLoad(const char* name, const std::string& path)
+{
+    GltfGeometrySource probe(path);
+    if (!probe.IsValid())
+        SKIP(std::string(path) + " or its buffers aren't in the tree");
+
+    float parseTime = MeasureMilliseconds([&path]() { GltfGeometrySource source(path); }, 3);
+    std::vector<GltfPrimitiveGeometry> reference(probe.GetPrimitivesCount());
+    for (size_t i = 0; i < reference.size(); ++i)
+        DecodeGltfPrimitive(probe.GetModel(), probe.GetPrimitive(i), reference[i]);
+    size_t verticesCount = 0;
+    for (const auto& primitive : reference)
+        verticesCount += primitive.Vertices.size();
+    printf("  %s: %zu primitives, %zu vertices, LoadGltf %.1f ms\n", name, reference.size(), verticesCount, parseTime);
+
+    float singleThreadTime = 0.0f;
+    for (UINT threads : GetThreadCounts(ThreadPool::GetDefaultWorkersCount() + 1))
+    {
+        ThreadPool workers(threads - 1);
+        std::vector<GltfPrimitiveGeometry> primitives(reference.size());
+        float time = MeasureMilliseconds([&]()
+        {
+            workers.ParallelFor(primitives.size(), [&](size_t i) { DecodeGltfPrimitive(probe.GetModel(), probe.GetPrimitive(i), primitives[i]); });
+        }, 5);
+        if (threads == 1)
+            singleThreadTime = time;
+        bool same = true;
+        for (size_t i = 0; i < primitives.size(); ++i)
+            same = same && IsSameGeometry(primitives[i], reference[i]);
+        CHECK(same);
+        printf("  %s: DecodeGltfPrimitive on %u threads, %.2f ms, %.2fx of 1 thread\n", name, workers.GetThreadsCount(), time, singleThreadTime / time);
+    }
+}
+}
+
+BENCHMARK(LoaderBench, Sponza)
+{
+    BenchmarkLoad("Sponza", ASSETS_DIR + std::string("Models//Sponza//glTF//Sponza.gltf"));
+}
+
+BENCHMARK(LoaderBench, FlightHelmet)
+{
+    BenchmarkLoad("FlightHelmet", ASSETS_DIR + std::string("Models//FlightHelmet//glTF//FlightHelmet.gltf"));
+}
@@ -0,0 +1,81 @@
+#include "Test.h"
+#include "GltfGeometry.h"
+#include "TestMeshes.h"
+
+#include "DXrenderer/Geometry/MeshOptimizer.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+void BenchmarkOptimizer(const char* name, std::vector<GltfPrimitiveGeometry> meshes)
+{
+    for (UINT cacheSize : { 12u, 16u, 24u })
+    {
+        VertexCacheStats before;
+        VertexCacheStats after;
+        for (const auto& mesh : meshes)
+        {
+            std::vector<UINT> indices = mesh.Indices;
+            VertexCacheStats meshBefore = AnalyzeVertexCache(indices, mesh.Vertices.size(), cacheSize);
+            OptimizeVertexCache(indices, mesh.Vertices.size(), cacheSize);
+            VertexCacheStats meshAfter = AnalyzeVertexCache(indices, mesh.Vertices.size(), cacheSize);
+            for (auto [total, stats] : { std::make_pair(&before, meshBefore), std::make_pair(&after, meshAfter) })
+            {
+                total->TrianglesCount += stats.TrianglesCount;
+                total->VerticesCount += stats.VerticesCount;
+                total->TransformedCount += stats.TransformedCount;
+            }
+        }
+        printf("  %s, %u entry FIFO: Tipsify ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name, cacheSize, before.GetAcmr(), after.GetAcmr(), before.GetAtvr(), after.GetAtvr());
+    }
+
+    size_t trianglesCount = 0;
+    VertexCacheStats optimized;
+    float time = MeasureMilliseconds([&]()
+    {
+        trianglesCount = 0;
+        optimized = {};
+        for (auto mesh : meshes)
+        {
+            OptimizeMesh(mesh.Vertices, mesh.Indices);
+            VertexCacheStats stats = AnalyzeVertexCache(mesh.Indices, mesh.Vertices.size());
+            optimized.TrianglesCount += stats.TrianglesCount;
+            optimized.VerticesCount += stats.VerticesCount;
+            optimized.TransformedCount += stats.TransformedCount;
+            trianglesCount += mesh.Indices.size() / 3;
+        }
+    }, 3);
+    printf("  %s: OptimizeMesh ACMR %.3f ATVR %.3f, %zu triangles in %.1f ms\n", name, optimized.GetAcmr(), optimized.GetAtvr(), trianglesCount, time);
+}
+}
+
+BENCHMARK(MeshOptimizerBench, Sponza)
+{
+    GltfGeometrySource source(ASSETS_DIR + std::string("Models//Sponza//glTF//Sponza.gltf"));
+    if (!source.IsValid())
+        SKIP("Sponza.gltf or its Sponza.bin isn't in Assets/Models/Sponza/glTF");
+    std::vector<GltfPrimitiveGeometry> meshes(source.GetPrimitivesCount());
+    for (size_t i = 0; i < meshes.size(); ++i)
+        source.DecodePrimitive(i, meshes[i]);
+    BenchmarkOptimizer("Sponza", std::move(meshes));
+}
+
+BENCHMARK(MeshOptimizerBench, FlightHelmet)
+{
+    GltfGeometrySource source(ASSETS_DIR + std::string("Models//FlightHelmet//glTF//FlightHelmet.gltf"));
+    if (!source.IsValid())
+        SKIP("FlightHelmet.gltf isn't in Assets/Models/FlightHelmet/glTF");
+    std::vector<GltfPrimitiveGeometry> meshes(source.GetPrimitivesCount());
+    for (size_t i = 0; i < meshes.size(); ++i)
+        source.DecodePrimitive(i, meshes[i]);
+    BenchmarkOptimizer("FlightHelmet", std::move(meshes));
+}
+
+BENCHMARK(MeshOptimizerBench, Grid)
+{
+    std::vector<GltfPrimitiveGeometry> meshes(1);
+    BuildGrid(256, meshes[0].Vertices, meshes[0].Indices);
+    BenchmarkOptimizer("Grid 256x256", std::move(meshes));
+}
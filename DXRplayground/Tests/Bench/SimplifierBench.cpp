@@ -0,0 +1,81 @@
+#include "Test.h"
+#include "GltfGeometry.h"
+#include "TestMeshes.h"
+
+#include "DXrenderer/Geometry/Simplifier.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+// The same chain Model builds: every LOD halves the previous one
+void BenchmarkLodChain(const char* name, const std::vector<GltfPrimitiveGeometry>& meshes)
+{
+    size_t sourceTriangles = 0;
+    size_t lodTriangles[3] = {};
+    bool deterministic = true;
+    float time = MeasureMilliseconds([&]()
+    {
+        sourceTriangles = 0;
+        std::fill(std::begin(lodTriangles), std::end(lodTriangles), 0);
+        for (const auto& mesh : meshes)
+        {
+            sourceTriangles += mesh.Indices.size() / 3;
+            std::vector<UINT> source = mesh.Indices;
+            for (size_t lod = 0; lod < 3; ++lod)
+            {
+                std::vector<UINT> result;
+                SimplifyMesh(mesh.Vertices, source, source.size() / 2, FLT_MAX, result);
+                lodTriangles[lod] += result.size() / 3;
+                source.swap(result);
+            }
+        }
+    }, 3);
+    for (const auto& mesh : meshes)
+    {
+        std::vector<UINT> first;
+        std::vector<UINT> second;
+        SimplifyMesh(mesh.Vertices, mesh.Indices, mesh.Indices.size() / 2, FLT_MAX, first);
+        SimplifyMesh(mesh.Vertices, mesh.Indices, mesh.Indices.size() / 2, FLT_MAX, second);
+        deterministic = deterministic && first == second;
+    }
+    CHECK(deterministic);
+    printf("  %s: %zu meshes, %zu triangles -> %zu / %zu / %zu, %.1f ms (%.1f Mtri/s)\n", name, meshes.size(), sourceTriangles,
+        lodTriangles[0], lodTriangles[1], lodTriangles[2], time, sourceTriangles / (time * 1000.0f));
+}
+
+bool LoadMeshes(const std::string& path, std::vector<GltfPrimitiveGeometry>& meshes)
+{
+    GltfGeometrySource source(path);
+    if (!source.IsValid())
+        return false;
+    meshes.resize(source.GetPrimitivesCount());
+    for (size_t i = 0; i < meshes.size(); ++i)
+        source.DecodePrimitive(i, meshes[i]);
+    return true;
+}
+}
+
+BENCHMARK(SimplifierBench, Sponza)
+{
+    std::vector<GltfPrimitiveGeometry> meshes;
+    if (!LoadMeshes(ASSETS_DIR + std::string("Models//Sponza//glTF//Sponza.gltf"), meshes))
+        SKIP("Sponza.gltf or its Sponza.bin isn't in Assets/Models/Sponza/glTF");
+    BenchmarkLodChain("Sponza", meshes);
+}
+
+BENCHMARK(SimplifierBench, FlightHelmet)
+{
+    std::vector<GltfPrimitiveGeometry> meshes;
+    if (!LoadMeshes(ASSETS_DIR + std::string("Models//FlightHelmet//glTF//FlightHelmet.gltf"), meshes))
+        SKIP("FlightHelmet.gltf isn't in Assets/Models/FlightHelmet/glTF");
+    BenchmarkLodChain("FlightHelmet", meshes);
+}
+
+BENCHMARK(SimplifierBench, Sphere)
+{
+    std::vector<GltfPrimitiveGeometry> meshes(1);
+    BuildSphere(256, 512, meshes[0].Vertices, meshes[0].Indices);
+    BenchmarkLodChain("Sphere 256x512", meshes);
+}
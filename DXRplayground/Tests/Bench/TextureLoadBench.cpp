@@ -0,0 +1,159 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define STB_IMAGE_IMPLEMENTATION
+#include "External/stb/stb_image.h"
+
+#include "Test.h"
+
+#include <filesystem>
+
+#include "DXrenderer/Textures/PngDecoder.h"
+#include "External/lodepng/lodepng.h"
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+std::vector<std::string> GetPngFiles(const std::string& directory)
+{
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".png" || extension == ".PNG")
+            files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool DecodeFile(const std::string& filename, std::vector<byte>& pixels)
+{
+    MappedFile file(filename);
+    PngInfo info;
+    if (!file.IsValid() || !ReadPngInfo(file.GetData(), file.GetSize(), info) || !IsPngFastPathSupported(info))
+        return false;
+    pixels.resize(size_t(info.Width) * info.Height * 4);
+    return DecodePng(file.GetData(), file.GetSize(), info, pixels.data(), size_t(info.Width) * 4);
+}
+
+// What a model load spent on its images before and after they were decoded once, on the pool.
+// Before, tinygltf decoded every external image with stb_image and dropped the pixels, then the texture manager decoded it again
+// on the loading thread. Both halves of the change are measured apart: the dropped decode on one thread, then the same decoder
+// on 1, 2, 4 ... threads.
+void BenchmarkModelImages(const char* name, const std::string& directory)
+{
+    std::vector<std::string> files = GetPngFiles(directory);
+    if (files.empty())
+        SKIP(directory + " has no PNGs");
+
+    std::vector<std::vector<byte>> pixels(files.size());
+    std::vector<UINT8> decoded(files.size(), 0);
+    float stbTime = MeasureMilliseconds([&]()
+    {
+        for (const std::string& file : files)
+        {
+            int width = 0;
+            int height = 0;
+            int components = 0;
+            stbi_uc* data = stbi_load(file.c_str(), &width, &height, &components, 4);
+            stbi_image_free(data);
+        }
+    });
+    float decoderTime = MeasureMilliseconds([&]()
+    {
+        for (size_t i = 0; i < files.size(); ++i)
+            decoded[i] = DecodeFile(files[i], pixels[i]);
+    });
+    size_t decodedCount = std::count(decoded.begin(), decoded.end(), UINT8(1));
+    printf("  %s: %zu PNGs (%zu on the fast path) on 1 thread, stb_image %.0f ms, PngDecoder %.0f ms, %.0f ms for both as before\n",
+        name, files.size(), decodedCount, stbTime, decoderTime, stbTime + decoderTime);
+
+    for (UINT threads : GetThreadCounts(ThreadPool::GetDefaultWorkersCount() + 1))
+    {
+        ThreadPool workers(threads - 1);
+        std::vector<std::vector<byte>> parallelPixels(files.size());
+        float time = MeasureMilliseconds([&]()
+        {
+            workers.ParallelFor(files.size(), [&](size_t i) { DecodeFile(files[i], parallelPixels[i]); });
+        });
+        bool same = true;
+        for (size_t i = 0; i < files.size(); ++i)
+            same = same && pixels[i] == parallelPixels[i];
+        CHECK(same);
+        printf("    PngDecoder on %u threads: %.0f ms, %.2fx of 1 thread\n", workers.GetThreadsCount(), time, decoderTime / time);
+    }
+}
+
+// The three PNG decoders on one thread, every file of the set: lodepng as ParsePNG used it (the file read into a vector,
+// then decoded into another), stb_image from memory and PngDecoder from the mapped file. Outputs of lodepng and PngDecoder
+// have to be the same.
+void BenchmarkPngDecoders(const char* name, const std::string& directory)
+{
+    std::vector<std::string> files = GetPngFiles(directory);
+    if (files.empty())
+        SKIP(directory + " has no PNGs");
+
+    std::vector<std::vector<byte>> lodepngPixels(files.size());
+    std::vector<std::vector<byte>> pixels(files.size());
+    size_t texels = 0;
+    float lodepngTime = 0.0f;
+    float stbTime = 0.0f;
+    float decoderTime = 0.0f;
+    size_t fastPathCount = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        lodepngTime += MeasureMilliseconds([&]()
+        {
+            std::vector<byte> file;
+            UINT width = 0;
+            UINT height = 0;
+            lodepng::load_file(file, files[i]);
+            lodepng::decode(lodepngPixels[i], width, height, file);
+            texels += size_t(width) * height;
+        });
+        stbTime += MeasureMilliseconds([&]()
+        {
+            MappedFile file(files[i]);
+            int width = 0;
+            int height = 0;
+            int components = 0;
+            stbi_uc* data = stbi_load_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, &components, 4);
+            stbi_image_free(data);
+        });
+        decoderTime += MeasureMilliseconds([&]() { fastPathCount += DecodeFile(files[i], pixels[i]) ? 1 : 0; });
+    }
+
+    bool same = true;
+    for (size_t i = 0; i < files.size(); ++i)
+        same = same && (pixels[i].empty() || pixels[i] == lodepngPixels[i]);
+    CHECK(same);
+    float megaTexels = texels / 1000000.0f;
+    printf("  %s: %zu PNGs (%zu on the fast path), %.1f MTexels. lodepng %.0f ms, stb_image %.0f ms, PngDecoder %.0f ms (%.1f / %.1f / %.1f MTexels/s)\n",
+        name, files.size(), fastPathCount, megaTexels, lodepngTime, stbTime, decoderTime,
+        megaTexels * 1000.0f / lodepngTime, megaTexels * 1000.0f / stbTime, megaTexels * 1000.0f / decoderTime);
+}
+}
+
+BENCHMARK(TextureLoadBench, FlightHelmetImages)
+{
+    BenchmarkModelImages("FlightHelmet", ASSETS_DIR + std::string("Models//FlightHelmet//glTF"));
+}
+
+BENCHMARK(TextureLoadBench, SponzaImages)
+{
+    BenchmarkModelImages("Sponza", ASSETS_DIR + std::string("Models//Sponza//glTF"));
+}
+
+BENCHMARK(TextureLoadBench, FlightHelmetDecoders)
+{
+    BenchmarkPngDecoders("FlightHelmet", ASSETS_DIR + std::string("Models//FlightHelmet//glTF"));
+}
+
+BENCHMARK(TextureLoadBench, SponzaDecoders)
+{
+    BenchmarkPngDecoders("Sponza", ASSETS_DIR + std::string("Models//Sponza//glTF"));
+}
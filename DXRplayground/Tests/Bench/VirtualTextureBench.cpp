@@ -0,0 +1,59 @@
+#include "Test.h"
+
+#include <cmath>
+#include <vector>
+
+#include "DXrenderer/Textures/VirtualTexture.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+constexpr UINT TexturesCount = 64;
+constexpr UINT TextureSize = 2048;
+constexpr UINT FramesCount = 2000;
+
+// A camera walking along a row of textured walls and back. Every wall in reach asks for the mip its distance needs,
+// a window of up to 4x4 tiles that slides as the camera passes. The pinned tiles take 64 of the physical ones.
+std::vector<std::vector<UINT>> MakeCameraWalk(const VirtualTextureCache& cache)
+{
+    std::vector<std::vector<UINT>> frames(FramesCount);
+    for (UINT frame = 0; frame < FramesCount; ++frame)
+    {
+        float walk = float(frame % (FramesCount / 2)) / float(FramesCount / 2);
+        float camera = (frame < FramesCount / 2 ? walk : 1.0f - walk) * float(TexturesCount) * 10.0f;
+        for (UINT texture = 0; texture < TexturesCount; ++texture)
+        {
+            float distance = std::abs(float(texture) * 10.0f - camera);
+            if (distance > 40.0f)
+                continue;
+            UINT mip = std::min(static_cast<UINT>(std::log2(std::max(distance, 1.0f))), cache.GetVirtualMipsCount(texture) - 1);
+            UINT pagesX = cache.GetPagesX(texture, mip);
+            UINT pagesY = cache.GetPagesY(texture, mip);
+            UINT windowX = std::min(pagesX, 4u);
+            UINT windowY = std::min(pagesY, 4u);
+            UINT startX = (frame / 8) % (pagesX - windowX + 1);
+            for (UINT y = 0; y < windowY; ++y)
+            {
+                for (UINT x = 0; x < windowX; ++x)
+                    frames[frame].push_back(PackVirtualTile({ texture, mip, startX + x, y }));
+            }
+        }
+    }
+    return frames;
+}
+}
+
+BENCHMARK(VirtualTextureBench, CameraWalk)
+{
+    for (UINT tilesX : { 12u, 16u, 32u })
+    {
+        VirtualTextureCache cache(tilesX, tilesX);
+        for (UINT i = 0; i < TexturesCount; ++i)
+            cache.AddTexture(TextureSize, TextureSize, 12);
+        std::vector<std::vector<UINT>> frames = MakeCameraWalk(cache);
+        VirtualTextureStats stats = ReplayVirtualTextureFeedback(cache, frames, 64);
+        printf("  %ux%u tiles: hit rate %.1f%%, %llu faults, %llu uploads, %llu evictions, %.0f faults/s of update time (%.2f ms)\n", tilesX, tilesX,
+            stats.GetHitRate() * 100.0f, stats.Faults, stats.Uploads, stats.Evictions, stats.GetFaultsPerSecond(), stats.UpdateTime);
+    }
+}
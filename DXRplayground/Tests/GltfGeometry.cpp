@@ -0,0 +1,37 @@
+#include "GltfGeometry.h"
+
+#define TINYGLTF_NOEXCEPTION
+#define JSON_NOEXCEPTION
+#define TINYGLTF_NO_STB_IMAGE
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE
+#include "External/TinyGLTF/tiny_gltf.h"
+
+namespace DirectxPlayground
+{
+GltfGeometrySource::GltfGeometrySource(const std::string& path)
+{
+    auto model = std::make_unique<tinygltf::Model>();
+    std::string error;
+    if (!LoadGltf(path, *model, error))
+        return;
+
+    for (const auto& mesh : model->meshes)
+    {
+        for (const auto& primitive : mesh.primitives)
+        {
+            if (primitive.indices != -1 && primitive.attributes.count("POSITION") == 1 &&
+                (primitive.mode == TINYGLTF_MODE_TRIANGLES || primitive.mode == -1))
+                mPrimitives.push_back(&primitive);
+        }
+    }
+    mModel = std::move(model);
+}
+
+GltfGeometrySource::~GltfGeometrySource() = default;
+
+void GltfGeometrySource::DecodePrimitive(size_t index, GltfPrimitiveGeometry& geometry) const
+{
+    DecodeGltfPrimitive(*mModel, *mPrimitives[index], geometry);
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <windows.h>
+
+#include "DXrenderer/Geometry/GltfPrimitive.h"
+
+namespace DirectxPlayground
+{
+// Headless glTF geometry for the tests and benchmarks: the indexed triangle primitives of the file,
+// loaded and decoded by the model loader's own LoadGltf and DecodeGltfPrimitive.
+class GltfGeometrySource
+{
+public:
+    explicit GltfGeometrySource(const std::string& path);
+    ~GltfGeometrySource();
+
+    bool IsValid() const;
+    size_t GetPrimitivesCount() const;
+    const tinygltf::Model& GetModel() const;
+    const tinygltf::Primitive& GetPrimitive(size_t index) const;
+    // Can be called from any thread
+    void DecodePrimitive(size_t index, GltfPrimitiveGeometry& geometry) const;
+
+private:
+    std::unique_ptr<tinygltf::Model> mModel;
+    std::vector<const tinygltf::Primitive*> mPrimitives;
+};
+
+inline bool GltfGeometrySource::IsValid() const
+{
+    return mModel != nullptr;
+}
+
+inline size_t GltfGeometrySource::GetPrimitivesCount() const
+{
+    return mPrimitives.size();
+}
+
+inline const tinygltf::Model& GltfGeometrySource::GetModel() const
+{
+    return *mModel;
+}
+
+inline const tinygltf::Primitive& GltfGeometrySource::GetPrimitive(size_t index) const
+{
+    return *mPrimitives[index];
+}
+}
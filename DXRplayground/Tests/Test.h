@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Minimal console test runner, so the tests build wherever the units they cover build.
+// TEST bodies register themselves, the runner executes every one whose "Suite.Name" contains the command line filter.
+// Benchmarks are tests too, they live in their own target and print what they measure.
+namespace DirectxPlayground
+{
+namespace Testing
+{
+using TestFunction = void (*)();
+
+struct TestCase
+{
+    const char* Suite = nullptr;
+    const char* Name = nullptr;
+    TestFunction Function = nullptr;
+};
+
+std::vector<TestCase>& GetTestCases();
+void ReportFailure(const char* file, int line, const std::string& message);
+// Ends nothing by itself, the test returns right after
+void ReportSkip(const std::string& reason);
+
+struct TestRegistrar
+{
+    TestRegistrar(const char* suite, const char* name, TestFunction function)
+    {
+        GetTestCases().push_back({ suite, name, function });
+    }
+};
+
+template <typename TA, typename TB>
+std::string FormatComparison(const char* a, const char* b, const TA& valueA, const TB& valueB)
+{
+    std::stringstream ss;
+    ss << a << " == " << b << " (" << valueA << " vs " << valueB << ")";
+    return ss.str();
+}
+
+// Best of the runs, in milliseconds
+template <typename TF>
+float MeasureMilliseconds(TF&& function, int runs = 1)
+{
+    float best = 0.0f;
+    for (int i = 0; i < runs; ++i)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        function();
+        float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        best = i == 0 ? time : std::min(best, time);
+    }
+    return best;
+}
+
+// Thread counts of a scaling sweep: the powers of two below the maximum, then the maximum
+inline std::vector<unsigned> GetThreadCounts(unsigned maxThreads)
+{
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(std::max(maxThreads, 1u));
+    return counts;
+}
+}
+}
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static DirectxPlayground::Testing::TestRegistrar suite##_##name##_Registrar(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define BENCHMARK(suite, name) TEST(suite, name)
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+            DirectxPlayground::Testing::ReportFailure(__FILE__, __LINE__, #condition); \
+    } while (false)
+
+#define CHECK_EQ(a, b) \
+    do \
+    { \
+        auto&& valueA = (a); \
+        auto&& valueB = (b); \
+        if (!(valueA == valueB)) \
+            DirectxPlayground::Testing::ReportFailure(__FILE__, __LINE__, DirectxPlayground::Testing::FormatComparison(#a, #b, valueA, valueB)); \
+    } while (false)
+
+#define CHECK_NEAR(a, b, tolerance) \
+    do \
+    { \
+        double valueA = static_cast<double>(a); \
+        double valueB = static_cast<double>(b); \
+        if (!(std::abs(valueA - valueB) <= static_cast<double>(tolerance))) \
+            DirectxPlayground::Testing::ReportFailure(__FILE__, __LINE__, DirectxPlayground::Testing::FormatComparison(#a, #b, valueA, valueB)); \
+    } while (false)
+
+// Stops the test, for preconditions the rest of it depends on
+#define REQUIRE(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            DirectxPlayground::Testing::ReportFailure(__FILE__, __LINE__, #condition); \
+            return; \
+        } \
+    } while (false)
+
+#define SKIP(reason) \
+    do \
+    { \
+        DirectxPlayground::Testing::ReportSkip(reason); \
+        return; \
+    } while (false)
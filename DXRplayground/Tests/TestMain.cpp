@@ -0,0 +1,59 @@
+#include "Test.h"
+
+namespace DirectxPlayground
+{
+namespace Testing
+{
+namespace
+{
+int FailuresCount = 0;
+bool Skipped = false;
+}
+
+std::vector<TestCase>& GetTestCases()
+{
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+void ReportFailure(const char* file, int line, const std::string& message)
+{
+    printf("%s(%d): failed: %s\n", file, line, message.c_str());
+    ++FailuresCount;
+}
+
+void ReportSkip(const std::string& reason)
+{
+    printf("  skipped: %s\n", reason.c_str());
+    Skipped = true;
+}
+}
+}
+
+// Usage: <tests> [filter], the exit code is the number of failed tests
+int main(int argc, char** argv)
+{
+    using namespace DirectxPlayground::Testing;
+    const char* filter = argc > 1 ? argv[1] : "";
+    int failedCount = 0;
+    int runCount = 0;
+    int skippedCount = 0;
+    for (const auto& test : GetTestCases())
+    {
+        std::string fullName = std::string(test.Suite) + "." + test.Name;
+        if (fullName.find(filter) == std::string::npos)
+            continue;
+
+        printf("[ RUN  ] %s\n", fullName.c_str());
+        fflush(stdout);
+        FailuresCount = 0;
+        Skipped = false;
+        test.Function();
+        ++runCount;
+        skippedCount += Skipped ? 1 : 0;
+        failedCount += FailuresCount > 0 ? 1 : 0;
+        printf("[ %s ] %s\n", FailuresCount > 0 ? "FAIL" : (Skipped ? "SKIP" : " OK "), fullName.c_str());
+    }
+    printf("%d tests, %d failed, %d skipped\n", runCount, failedCount, skippedCount);
+    return failedCount;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <windows.h>
+
+#include "DXrenderer/Geometry/Vertex.h"
+
+namespace DirectxPlayground
+{
+namespace Testing
+{
+// Unit UV sphere, rows x columns quads with a UV seam along the first column, counter-clockwise outside like glTF
+inline void BuildSphere(UINT rows, UINT columns, std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    const float pi = 3.14159265f;
+    vertices.clear();
+    indices.clear();
+    for (UINT r = 0; r <= rows; ++r)
+    {
+        for (UINT c = 0; c <= columns; ++c)
+        {
+            float theta = pi * r / rows;
+            float phi = 2.0f * pi * c / columns;
+            Vertex v = {};
+            v.Pos = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+            v.Norm = v.Pos;
+            v.Uv = { float(c) / columns, float(r) / rows };
+            v.Tangent = { -std::sin(phi), 0.0f, std::cos(phi), 1.0f };
+            vertices.push_back(v);
+        }
+    }
+    for (UINT r = 0; r < rows; ++r)
+    {
+        for (UINT c = 0; c < columns; ++c)
+        {
+            UINT a = r * (columns + 1) + c;
+            UINT b = a + 1;
+            UINT d = a + columns + 1;
+            UINT e = d + 1;
+            indices.insert(indices.end(), { a, b, d, b, e, d });
+        }
+    }
+}
+
+// Flat grid on the XZ plane, size x size quads spanning [0, 1], counter-clockwise seen from +Y
+inline void BuildGrid(UINT size, std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    for (UINT y = 0; y <= size; ++y)
+    {
+        for (UINT x = 0; x <= size; ++x)
+        {
+            Vertex v = {};
+            v.Pos = { float(x) / size, 0.0f, float(y) / size };
+            v.Norm = { 0.0f, 1.0f, 0.0f };
+            v.Uv = { float(x) / size, float(y) / size };
+            v.Tangent = { 1.0f, 0.0f, 0.0f, 1.0f };
+            vertices.push_back(v);
+        }
+    }
+    for (UINT y = 0; y < size; ++y)
+    {
+        for (UINT x = 0; x < size; ++x)
+        {
+            UINT a = y * (size + 1) + x;
+            UINT b = a + 1;
+            UINT d = a + size + 1;
+            UINT e = d + 1;
+            indices.insert(indices.end(), { a, d, b, b, d, e });
+        }
+    }
+}
+}
+}
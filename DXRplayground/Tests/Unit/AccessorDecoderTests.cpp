@@ -0,0 +1,156 @@
+#include "Test.h"
+
+#include <cstring>
+#include <random>
+
+#include "DXrenderer/Geometry/AccessorDecoder.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+const AccessorComponent Components[] = { AccessorComponent::Int8, AccessorComponent::UInt8, AccessorComponent::Int16, AccessorComponent::UInt16, AccessorComponent::UInt32, AccessorComponent::Float };
+constexpr UINT TargetStride = 80; // Room for a mat4 and a guard float on both sides
+constexpr UINT TargetFieldOffset = 8;
+const float Guard = -12345.0f;
+
+std::vector<byte> GetRandomSource(const AccessorView& view, UINT seed)
+{
+    std::mt19937 random(seed);
+    std::vector<byte> data(size_t(view.Stride) * view.Count);
+    for (auto& b : data)
+        b = static_cast<byte>(random());
+    // Random floats bits would be NaNs and denormals, keep them finite
+    if (view.Component == AccessorComponent::Float)
+    {
+        std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+        for (size_t i = 0; i + 4 <= data.size(); i += 4)
+        {
+            float value = distribution(random);
+            memcpy(&data[i], &value, sizeof(float));
+        }
+    }
+    return data;
+}
+
+std::vector<float> Decode(const AccessorView& view, bool scalar)
+{
+    std::vector<float> decoded(size_t(TargetStride / sizeof(float)) * view.Count, Guard);
+    DecodeTarget target;
+    target.Data = reinterpret_cast<byte*>(decoded.data()) + TargetFieldOffset;
+    target.Stride = TargetStride;
+    for (UINT i = 0; i < 4; ++i)
+    {
+        target.Scale[i] = 0.5f + i;
+        target.Offset[i] = -1.0f + i;
+    }
+    if (scalar)
+        DecodeAccessorScalar(view, target);
+    else
+        DecodeAccessor(view, target);
+    return decoded;
+}
+
+void CheckKernel(AccessorComponent component, bool normalized, UINT componentsCount, UINT columnsCount, UINT extraStride)
+{
+    AccessorView view;
+    view.Component = component;
+    view.Normalized = normalized;
+    view.ComponentsCount = componentsCount;
+    view.ColumnsCount = columnsCount;
+    view.Count = 37; // Not a multiple of any SIMD width
+    view.Stride = GetElementSize(component, componentsCount, columnsCount) + extraStride;
+    std::vector<byte> source = GetRandomSource(view, componentsCount * 7 + columnsCount + static_cast<UINT>(component) * 31);
+    view.Data = source.data();
+
+    std::vector<float> reference = Decode(view, true);
+    std::vector<float> decoded = Decode(view, false);
+    bool same = memcmp(reference.data(), decoded.data(), decoded.size() * sizeof(float)) == 0;
+    if (!same)
+        printf("  component %u, normalized %d, %ux%u, stride %u differs from the scalar path\n", static_cast<UINT>(component), normalized, componentsCount, columnsCount, view.Stride);
+    CHECK(same);
+
+    // Nothing outside the element's floats is written
+    UINT floatsCount = componentsCount * columnsCount;
+    UINT first = TargetFieldOffset / sizeof(float);
+    bool guarded = true;
+    for (size_t i = 0; i < view.Count; ++i)
+    {
+        const float* element = decoded.data() + i * TargetStride / sizeof(float);
+        for (UINT j = 0; j < TargetStride / sizeof(float); ++j)
+        {
+            bool inside = j >= first && j < first + floatsCount;
+            guarded = guarded && (inside || element[j] == Guard);
+        }
+    }
+    CHECK(guarded);
+}
+
+float DecodeSingle(AccessorComponent component, bool normalized, const void* value)
+{
+    AccessorView view;
+    view.Component = component;
+    view.Normalized = normalized;
+    view.Count = 1;
+    view.Stride = GetComponentSize(component);
+    view.Data = static_cast<const byte*>(value);
+    float result = 0.0f;
+    DecodeTarget target;
+    target.Data = reinterpret_cast<byte*>(&result);
+    target.Stride = sizeof(float);
+    DecodeAccessor(view, target);
+    return result;
+}
+}
+
+TEST(AccessorDecoder, SimdMatchesScalarForEveryKernel)
+{
+    printf("  %s kernels\n", GetAccessorDecoderIsaName());
+    for (AccessorComponent component : Components)
+    {
+        for (bool normalized : { false, true })
+        {
+            // Floats and 32-bit integers have no normalized form
+            if (normalized && (component == AccessorComponent::Float || component == AccessorComponent::UInt32))
+                continue;
+            for (UINT componentsCount = 1; componentsCount <= 4; ++componentsCount)
+            {
+                CheckKernel(component, normalized, componentsCount, 1, 0);
+                CheckKernel(component, normalized, componentsCount, 1, 4); // Interleaved source
+            }
+            for (UINT size = 2; size <= 4; ++size)
+                CheckKernel(component, normalized, size, size, 0);
+        }
+    }
+}
+
+TEST(AccessorDecoder, MatrixColumnsAreAligned)
+{
+    // Every column of a 1 or 2 byte component matrix starts at a 4 byte boundary
+    CHECK_EQ(GetElementSize(AccessorComponent::Int8, 2, 2), 8u);
+    CHECK_EQ(GetElementSize(AccessorComponent::Int8, 3, 3), 12u);
+    CHECK_EQ(GetElementSize(AccessorComponent::Int16, 3, 3), 24u);
+    CHECK_EQ(GetElementSize(AccessorComponent::Int16, 2, 2), 8u);
+    CHECK_EQ(GetElementSize(AccessorComponent::Float, 3, 3), 36u);
+    // Vectors are tightly packed
+    CHECK_EQ(GetElementSize(AccessorComponent::Int8, 3, 1), 3u);
+    CHECK_EQ(GetElementSize(AccessorComponent::UInt16, 3, 1), 6u);
+}
+
+TEST(AccessorDecoder, NormalizedRanges)
+{
+    const INT8 minInt8 = -128;
+    const INT8 maxInt8 = 127;
+    const byte maxUInt8 = 255;
+    const INT16 minInt16 = -32768;
+    const UINT16 maxUInt16 = 65535;
+    const UINT16 plainUInt16 = 1000;
+    // The most negative value clamps to -1 as the spec requires
+    CHECK_EQ(DecodeSingle(AccessorComponent::Int8, true, &minInt8), -1.0f);
+    CHECK_EQ(DecodeSingle(AccessorComponent::Int8, true, &maxInt8), 1.0f);
+    CHECK_EQ(DecodeSingle(AccessorComponent::UInt8, true, &maxUInt8), 1.0f);
+    CHECK_EQ(DecodeSingle(AccessorComponent::Int16, true, &minInt16), -1.0f);
+    CHECK_EQ(DecodeSingle(AccessorComponent::UInt16, true, &maxUInt16), 1.0f);
+    CHECK_EQ(DecodeSingle(AccessorComponent::UInt16, false, &plainUInt16), 1000.0f);
+    CHECK_EQ(DecodeSingle(AccessorComponent::Int8, false, &minInt8), -128.0f);
+}
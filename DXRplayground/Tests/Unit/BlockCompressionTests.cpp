@@ -0,0 +1,291 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <utility>
+
+#include "DXrenderer/Textures/BlockCompression.h"
+#include "DXrenderer/Textures/ExrDecoder.h"
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
+
+using namespace DirectxPlayground;
+
+namespace DirectxPlayground
+{
+std::ostream& operator<<(std::ostream& stream, BlockFormat format)
+{
+    return stream << GetBlockFormatName(format);
+}
+}
+
+namespace
+{
+struct FloatImage
+{
+    std::vector<float> Pixels;
+    UINT Width = 0;
+    UINT Height = 0;
+};
+
+// Cropped to whole blocks
+FloatImage LoadAsakusa()
+{
+    FloatImage image;
+    MappedFile file(ASSETS_DIR + std::string("Textures//asakusa.exr"));
+    std::vector<byte> pixels;
+    UINT width = 0;
+    UINT height = 0;
+    if (!file.IsValid() || !DecodeExr(file.GetData(), file.GetSize(), pixels, width, height, nullptr))
+        return image;
+    const float* rgba = reinterpret_cast<const float*>(pixels.data());
+    image.Width = width & ~3u;
+    image.Height = height & ~3u;
+    image.Pixels.resize(size_t(image.Width) * image.Height * 4);
+    for (UINT y = 0; y < image.Height; ++y)
+        memcpy(&image.Pixels[size_t(y) * image.Width * 4], rgba + size_t(y) * width * 4, image.Width * sizeof(float) * 4);
+    return image;
+}
+
+FloatImage Crop(const FloatImage& source, UINT x, UINT y, UINT width, UINT height)
+{
+    FloatImage image;
+    image.Width = width;
+    image.Height = height;
+    image.Pixels.resize(size_t(width) * height * 4);
+    for (UINT row = 0; row < height; ++row)
+        memcpy(&image.Pixels[size_t(row) * width * 4], &source.Pixels[(size_t(y + row) * source.Width + x) * 4], width * sizeof(float) * 4);
+    return image;
+}
+
+float EncodeLogRmse(const FloatImage& image, TextureCompression quality, ThreadPool* workers, std::vector<byte>* encoded = nullptr)
+{
+    std::vector<byte> blocks(GetCompressedSize(BlockFormat::BC6H, image.Width, image.Height));
+    CompressBlocksBC6H(image.Pixels.data(), image.Width, image.Height, quality, blocks.data(), workers);
+    std::vector<float> decoded(image.Pixels.size());
+    DecompressBlocksBC6H(blocks.data(), image.Width, image.Height, decoded.data());
+    if (encoded != nullptr)
+        encoded->swap(blocks);
+    return ComputeLogRmse(image.Pixels.data(), decoded.data(), image.Width, image.Height);
+}
+
+// Smooth color and alpha fields with some noise, like a photo more than a synthetic pattern
+std::vector<byte> MakeTestImage(UINT width, UINT height, UINT seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    std::vector<byte> rgba(size_t(width) * height * 4);
+    for (UINT y = 0; y < height; ++y)
+    {
+        for (UINT x = 0; x < width; ++x)
+        {
+            float u = float(x) / width;
+            float v = float(y) / height;
+            float fields[4] = {
+                0.5f + 0.45f * std::sin(6.0f * u + 1.0f),
+                0.5f + 0.45f * std::cos(5.0f * v + 3.0f * u),
+                0.5f + 0.45f * std::sin(4.0f * (u + v)),
+                0.5f + 0.5f * std::cos(7.0f * u * v),
+            };
+            for (UINT c = 0; c < 4; ++c)
+                rgba[(size_t(y) * width + x) * 4 + c] = static_cast<byte>(std::clamp(int(fields[c] * 255.0f) + noise(random), 0, 255));
+        }
+    }
+    return rgba;
+}
+
+// Red falls where green rises in every block, about half the blocks fit their axis with the smaller 565 color first
+std::vector<byte> MakeRedToGreenImage(UINT width, UINT height, UINT seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> noise(-4, 4);
+    std::vector<byte> rgba(size_t(width) * height * 4);
+    for (UINT y = 0; y < height; ++y)
+    {
+        for (UINT x = 0; x < width; ++x)
+        {
+            int t = int(x & 3) * 85;
+            byte* pixel = &rgba[(size_t(y) * width + x) * 4];
+            pixel[0] = static_cast<byte>(std::clamp(255 - t + noise(random), 0, 255));
+            pixel[1] = static_cast<byte>(std::clamp(t + noise(random), 0, 255));
+            pixel[2] = static_cast<byte>(std::clamp(64 + noise(random), 0, 255));
+            pixel[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+float EncodePsnr(BlockFormat format, const std::vector<byte>& rgba, UINT width, UINT height, std::vector<byte>* decoded = nullptr)
+{
+    std::vector<byte> blocks(GetCompressedSize(format, width, height));
+    CompressBlocks(format, rgba.data(), width, height, blocks.data(), nullptr);
+    std::vector<byte> result(rgba.size());
+    DecompressBlocks(format, blocks.data(), width, height, result.data());
+    float psnr = ComputeBlockPsnr(format, rgba.data(), result.data(), width, height);
+    if (decoded != nullptr)
+        decoded->swap(result);
+    return psnr;
+}
+}
+
+TEST(BlockCompression, BC6HSizeIsABytePerTexel)
+{
+    CHECK_EQ(GetBlockBytes(BlockFormat::BC6H), 16u);
+    CHECK_EQ(GetBlockFormatDxgi(BlockFormat::BC6H), DXGI_FORMAT_BC6H_UF16);
+    CHECK_EQ(GetCompressedSize(BlockFormat::BC6H, 660, 440), size_t(660) * 440);
+    CHECK_EQ(GetCompressedSize(BlockFormat::BC6H, 2048, 2048 * 6), size_t(2048) * 2048 * 6);
+    CHECK_EQ(GetCompressedSize(BlockFormat::BC6H, 1, 1), size_t(16)); // Partial blocks are whole blocks
+}
+
+TEST(BlockCompression, BC6HQualityOnAsakusa)
+{
+    FloatImage image = LoadAsakusa();
+    REQUIRE(image.Width > 0);
+    ThreadPool workers(4);
+    std::vector<byte> blocks;
+    float fast = EncodeLogRmse(image, TextureCompression::Fast, &workers, &blocks);
+    printf("  %ux%u: %zu bytes against %zu as RGBA32F, fast log2 RMSE %g\n", image.Width, image.Height, blocks.size(), image.Pixels.size() * sizeof(float), fast);
+    CHECK_EQ(blocks.size(), size_t(image.Width) * image.Height);
+    // A sixteenth of RGBA32F, an eighth of RGBA16F
+    CHECK_EQ(blocks.size() * 16, image.Pixels.size() * sizeof(float));
+    // 0.0153 when this was written
+    CHECK(fast < 0.02f);
+
+    // High quality is slow, a crop shows the difference
+    FloatImage crop = Crop(image, 200, 100, 128, 128);
+    float cropFast = EncodeLogRmse(crop, TextureCompression::Fast, &workers);
+    float cropHigh = EncodeLogRmse(crop, TextureCompression::HighQuality, &workers);
+    printf("  128x128 crop: fast log2 RMSE %g, high quality %g\n", cropFast, cropHigh);
+    CHECK(cropHigh <= cropFast);
+    CHECK(cropHigh < 0.02f);
+}
+
+TEST(BlockCompression, BC6HIsDeterministicAcrossThreads)
+{
+    FloatImage image = LoadAsakusa();
+    REQUIRE(image.Width > 0);
+    FloatImage crop = Crop(image, 0, 0, 256, 256);
+    ThreadPool workers(4);
+    std::vector<byte> serial;
+    std::vector<byte> threaded;
+    EncodeLogRmse(crop, TextureCompression::Fast, nullptr, &serial);
+    EncodeLogRmse(crop, TextureCompression::Fast, &workers, &threaded);
+    CHECK(serial == threaded);
+}
+
+// The environment map sends its six faces stacked, every face has to come out the way it does alone
+TEST(BlockCompression, BC6HCubemapFacesDontMix)
+{
+    FloatImage image = LoadAsakusa();
+    REQUIRE(image.Width >= 64 && image.Height >= 6 * 64);
+    const UINT size = 64;
+    FloatImage faces = Crop(image, 0, 0, size, size * 6);
+    ThreadPool workers(4);
+    std::vector<byte> stacked;
+    EncodeLogRmse(faces, TextureCompression::Fast, &workers, &stacked);
+    const size_t faceBytes = GetCompressedSize(BlockFormat::BC6H, size, size);
+    REQUIRE(stacked.size() == faceBytes * 6);
+    for (UINT face = 0; face < 6; ++face)
+    {
+        std::vector<byte> alone;
+        EncodeLogRmse(Crop(faces, 0, face * size, size, size), TextureCompression::Fast, nullptr, &alone);
+        CHECK(memcmp(alone.data(), stacked.data() + face * faceBytes, faceBytes) == 0);
+    }
+}
+
+TEST(BlockCompression, FormatFollowsTheUsage)
+{
+    for (TextureCompression compression : { TextureCompression::Fast, TextureCompression::HighQuality })
+    {
+        CHECK_EQ(GetBlockFormat(TextureUsage::Normal, compression, false), BlockFormat::BC5);
+        CHECK_EQ(GetBlockFormat(TextureUsage::Mask, compression, true), BlockFormat::BC4);
+    }
+    CHECK_EQ(GetBlockFormat(TextureUsage::Color, TextureCompression::Fast, false), BlockFormat::BC1);
+    CHECK_EQ(GetBlockFormat(TextureUsage::Color, TextureCompression::Fast, true), BlockFormat::BC3);
+    CHECK_EQ(GetBlockFormat(TextureUsage::Color, TextureCompression::HighQuality, true), BlockFormat::BC7);
+    // Metallic-roughness alpha is unused, it never costs BC3's extra 8 bytes
+    CHECK_EQ(GetBlockFormat(TextureUsage::Data, TextureCompression::Fast, true), BlockFormat::BC1);
+    CHECK_EQ(GetBlockFormat(TextureUsage::Data, TextureCompression::HighQuality, false), BlockFormat::BC7);
+}
+
+TEST(BlockCompression, SolidBlocksRoundTrip)
+{
+    // Colors 565 keeps as they are, every one with a single parity for the shared p-bit of BC7
+    const byte colors[4][4] = { { 189, 255, 255, 129 }, { 0, 130, 0, 254 }, { 66, 130, 132, 200 }, { 8, 4, 8, 0 } };
+    const UINT size = 8;
+    std::vector<byte> rgba(size * size * 4);
+    for (UINT y = 0; y < size; ++y)
+        for (UINT x = 0; x < size; ++x)
+            memcpy(&rgba[(y * size + x) * 4], colors[(y / 4) * 2 + x / 4], 4);
+
+    const std::pair<BlockFormat, UINT> formats[] = {
+        { BlockFormat::BC1, 3 }, { BlockFormat::BC3, 4 }, { BlockFormat::BC4, 1 }, { BlockFormat::BC5, 2 }, { BlockFormat::BC7, 4 }
+    };
+    for (const auto& [format, channels] : formats)
+    {
+        std::vector<byte> decoded;
+        EncodePsnr(format, rgba, size, size, &decoded);
+        bool same = true;
+        for (size_t i = 0; i < rgba.size(); i += 4)
+            same &= memcmp(&rgba[i], &decoded[i], channels) == 0;
+        CHECK(same);
+        if (format == BlockFormat::BC1)
+        {
+            bool opaque = true;
+            for (size_t i = 3; i < decoded.size(); i += 4)
+                opaque &= decoded[i] == 255;
+            CHECK(opaque);
+        }
+    }
+}
+
+TEST(BlockCompression, QualityOnASmoothImage)
+{
+    const UINT size = 128;
+    std::vector<byte> rgba = MakeTestImage(size, size, 3);
+    // 36.6, 37.7, 50.0, 49.9 and 37.8 dB when this was written
+    const std::pair<BlockFormat, float> floors[] = {
+        { BlockFormat::BC1, 35.5f }, { BlockFormat::BC3, 36.5f }, { BlockFormat::BC4, 48.0f }, { BlockFormat::BC5, 48.0f }, { BlockFormat::BC7, 36.5f }
+    };
+    for (const auto& [format, floor] : floors)
+    {
+        float psnr = EncodePsnr(format, rgba, size, size);
+        printf("  %s: %g dB\n", GetBlockFormatName(format), psnr);
+        CHECK(psnr > floor);
+    }
+
+    ThreadPool workers(4);
+    std::vector<byte> serial(GetCompressedSize(BlockFormat::BC7, size, size));
+    std::vector<byte> threaded(serial.size());
+    CompressBlocks(BlockFormat::BC7, rgba.data(), size, size, serial.data(), nullptr);
+    CompressBlocks(BlockFormat::BC7, rgba.data(), size, size, threaded.data(), &workers);
+    CHECK(serial == threaded);
+}
+
+// The endpoints swap to keep the four color mode, the refinement has to fit them in their stored order
+TEST(BlockCompression, BC1RefinesSwappedEndpoints)
+{
+    const UINT size = 64;
+    std::vector<byte> rgba = MakeRedToGreenImage(size, size, 5);
+    for (BlockFormat format : { BlockFormat::BC1, BlockFormat::BC3 })
+    {
+        std::vector<byte> blocks(GetCompressedSize(format, size, size));
+        CompressBlocks(format, rgba.data(), size, size, blocks.data(), nullptr);
+        bool fourColors = true;
+        for (size_t offset = format == BlockFormat::BC3 ? 8 : 0; offset < blocks.size(); offset += GetBlockBytes(format))
+        {
+            UINT16 c0;
+            UINT16 c1;
+            memcpy(&c0, &blocks[offset], 2);
+            memcpy(&c1, &blocks[offset + 2], 2);
+            fourColors &= c0 > c1;
+        }
+        CHECK(fourColors);
+        // 39.9 and 41.1 dB when this was written
+        float psnr = EncodePsnr(format, rgba, size, size);
+        printf("  %s: %g dB\n", GetBlockFormatName(format), psnr);
+        CHECK(psnr > 38.5f);
+    }
+}
@@ -0,0 +1,394 @@
+#include "Test.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <string>
+
+#include "DXrenderer/Textures/ContainerParser.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+constexpr uint32_t DdsFourCC = 0x4;
+constexpr uint32_t DdsRgb = 0x40;
+constexpr uint32_t DdsCubemap = 0x200;
+constexpr uint32_t DdsAllFaces = 0xfc00;
+constexpr uint32_t DdsVolume = 0x200000;
+constexpr uint32_t DdsDxt1 = 0x31545844; // "DXT1"
+constexpr uint32_t DdsDx10 = 0x30315844; // "DX10"
+
+struct DdsDesc
+{
+    uint32_t HeaderSize = 124;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t Depth = 0;
+    uint32_t MipCount = 0;
+    uint32_t PixelFormatSize = 32;
+    uint32_t PixelFormatFlags = DdsFourCC;
+    uint32_t FourCC = DdsDxt1;
+    uint32_t BitCount = 0;
+    uint32_t Masks[4] = {};
+    uint32_t Caps2 = 0;
+    // The DX10 header, when FourCC asks for it
+    uint32_t DxgiFormat = 0;
+    uint32_t Dimension = 3;
+    uint32_t MiscFlag = 0;
+    uint32_t ArraySize = 1;
+    size_t PayloadSize = 0;
+};
+
+void Append(std::vector<uint8_t>& data, std::initializer_list<uint32_t> values)
+{
+    for (uint32_t value : values)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(value));
+    }
+}
+
+void Append64(std::vector<uint8_t>& data, std::initializer_list<uint64_t> values)
+{
+    for (uint64_t value : values)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(value));
+    }
+}
+
+std::vector<uint8_t> MakeDds(const DdsDesc& desc)
+{
+    std::vector<uint8_t> data = { 'D', 'D', 'S', ' ' };
+    Append(data, { desc.HeaderSize, 0, desc.Height, desc.Width, 0, desc.Depth, desc.MipCount });
+    Append(data, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+    Append(data, { desc.PixelFormatSize, desc.PixelFormatFlags, desc.FourCC, desc.BitCount, desc.Masks[0], desc.Masks[1], desc.Masks[2], desc.Masks[3] });
+    Append(data, { 0x1000, desc.Caps2, 0, 0, 0 });
+    if ((desc.PixelFormatFlags & DdsFourCC) && desc.FourCC == DdsDx10)
+        Append(data, { desc.DxgiFormat, desc.Dimension, desc.MiscFlag, desc.ArraySize, 0 });
+    data.resize(data.size() + desc.PayloadSize, 0xcd);
+    return data;
+}
+
+struct Ktx2Desc
+{
+    uint32_t VkFormat = 37; // R8G8B8A8_UNORM
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t Depth = 0;
+    uint32_t Layers = 0;
+    uint32_t Faces = 1;
+    uint32_t Supercompression = 0;
+    std::vector<uint64_t> LevelSizes; // The payload of every level, the largest first
+};
+
+// Levels are stored smallest first as the format recommends, the index still lists them largest first
+std::vector<uint8_t> MakeKtx2(const Ktx2Desc& desc)
+{
+    std::vector<uint8_t> data = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+    Append(data, { desc.VkFormat, 1, desc.Width, desc.Height, desc.Depth, desc.Layers, desc.Faces, static_cast<uint32_t>(desc.LevelSizes.size()), desc.Supercompression });
+    Append(data, { 0, 0, 0, 0 });
+    Append64(data, { 0, 0 });
+    uint64_t offset = data.size() + desc.LevelSizes.size() * 24;
+    std::vector<uint64_t> offsets(desc.LevelSizes.size());
+    for (size_t i = desc.LevelSizes.size(); i-- > 0;)
+    {
+        offsets[i] = offset;
+        offset += desc.LevelSizes[i];
+    }
+    for (size_t i = 0; i < desc.LevelSizes.size(); ++i)
+        Append64(data, { offsets[i], desc.LevelSizes[i], desc.LevelSizes[i] });
+    data.resize(static_cast<size_t>(offset), 0xcd);
+    return data;
+}
+
+DdsDesc GetBc1Dds()
+{
+    DdsDesc desc;
+    desc.Width = 16;
+    desc.Height = 8;
+    desc.MipCount = 3;
+    desc.PayloadSize = 64 + 16 + 8;
+    return desc;
+}
+
+Ktx2Desc GetRgbaKtx2()
+{
+    Ktx2Desc desc;
+    desc.Width = 8;
+    desc.Height = 4;
+    desc.LevelSizes = { 8 * 4 * 4, 4 * 2 * 4, 2 * 1 * 4, 1 * 1 * 4 };
+    return desc;
+}
+
+bool ParsesDds(const DdsDesc& desc, std::string* reason = nullptr)
+{
+    std::vector<uint8_t> data = MakeDds(desc);
+    ContainerLayout layout;
+    std::string error;
+    bool parsed = ParseDdsLayout(data.data(), data.size(), layout, error);
+    if (reason != nullptr)
+        *reason = error;
+    return parsed;
+}
+
+bool ParsesKtx2(const Ktx2Desc& desc, std::string* reason = nullptr)
+{
+    std::vector<uint8_t> data = MakeKtx2(desc);
+    ContainerLayout layout;
+    std::string error;
+    bool parsed = ParseKtx2Layout(data.data(), data.size(), layout, error);
+    if (reason != nullptr)
+        *reason = error;
+    return parsed;
+}
+}
+
+TEST(ContainerParser, FormatSizes)
+{
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R32G32B32A32_UINT), 16u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R32G32B32_SINT), 12u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R16G16B16A16_TYPELESS), 8u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R32G8X24_TYPELESS), 8u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R8G8B8A8_SINT), 4u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R10G10B10A2_UINT), 4u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::B8G8R8X8_TYPELESS), 4u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R16_SINT), 2u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::B5G6R5_UNORM), 2u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::B5G5R5A1_UNORM), 2u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::B4G4R4A4_UNORM), 2u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::R8_UINT), 1u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::A8_UNORM), 1u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::BC1_UNORM), 0u);
+    CHECK_EQ(GetFormatPixelBytes(TextureFormat::Unknown), 0u);
+    CHECK_EQ(GetFormatPixelBytes(static_cast<TextureFormat>(68)), 0u); // R8G8_B8G8_UNORM, two pixels share 4 bytes
+
+    CHECK_EQ(GetFormatBlockBytes(TextureFormat::BC1_TYPELESS), 8u);
+    CHECK_EQ(GetFormatBlockBytes(TextureFormat::BC4_SNORM), 8u);
+    CHECK_EQ(GetFormatBlockBytes(TextureFormat::BC6H_TYPELESS), 16u);
+    CHECK_EQ(GetFormatBlockBytes(TextureFormat::BC7_UNORM_SRGB), 16u);
+    CHECK_EQ(GetFormatBlockBytes(TextureFormat::R8G8B8A8_UNORM), 0u);
+
+    CHECK_EQ(GetFormatRowPitch(TextureFormat::BC1_UNORM, 5), 16ull); // Partial blocks are whole
+    CHECK_EQ(GetFormatRowsCount(TextureFormat::BC1_UNORM, 5), 2u);
+    CHECK_EQ(GetFormatRowPitch(TextureFormat::B5G6R5_UNORM, 5), 10ull);
+    CHECK_EQ(GetFormatRowsCount(TextureFormat::B5G6R5_UNORM, 5), 5u);
+    CHECK_EQ(GetFormatRowPitch(TextureFormat::Unknown, 5), 0ull);
+}
+
+TEST(ContainerParser, DdsFootprints)
+{
+    std::vector<uint8_t> data = MakeDds(GetBc1Dds());
+    ContainerLayout layout;
+    std::string error;
+    REQUIRE(ParseDdsLayout(data.data(), data.size(), layout, error));
+    CHECK(layout.Format == TextureFormat::BC1_UNORM);
+    CHECK(layout.Dimension == ContainerDimension::Texture2D);
+    REQUIRE(layout.Subresources.size() == 3);
+    const uint64_t offsets[] = { 128, 192, 208 };
+    const uint64_t pitches[] = { 32, 16, 8 };
+    const uint64_t slices[] = { 64, 16, 8 };
+    for (uint32_t mip = 0; mip < 3; ++mip)
+    {
+        CHECK_EQ(layout.Subresources[mip].Offset, offsets[mip]);
+        CHECK_EQ(layout.Subresources[mip].RowPitch, pitches[mip]);
+        CHECK_EQ(layout.Subresources[mip].SlicePitch, slices[mip]);
+    }
+
+    // DX10 BC7 cube array: 2 cubes, 12 slices of one 8x8 level
+    DdsDesc cube;
+    cube.Width = 8;
+    cube.Height = 8;
+    cube.FourCC = DdsDx10;
+    cube.DxgiFormat = uint32_t(TextureFormat::BC7_UNORM);
+    cube.MiscFlag = 0x4;
+    cube.ArraySize = 2;
+    cube.PayloadSize = 12 * 64;
+    data = MakeDds(cube);
+    REQUIRE(ParseDdsLayout(data.data(), data.size(), layout, error));
+    CHECK(layout.Cubemap);
+    CHECK_EQ(layout.ArraySize, 12u);
+    REQUIRE(layout.Subresources.size() == 12);
+    CHECK_EQ(layout.Subresources[11].Offset, 148ull + 11 * 64);
+
+    // Legacy 16 bit packed and a volume with its depth halving
+    DdsDesc packed;
+    packed.Width = 4;
+    packed.Height = 4;
+    packed.PixelFormatFlags = DdsRgb;
+    packed.FourCC = 0;
+    packed.BitCount = 16;
+    packed.Masks[0] = 0xf800;
+    packed.Masks[1] = 0x7e0;
+    packed.Masks[2] = 0x1f;
+    packed.PayloadSize = 4 * 4 * 2;
+    data = MakeDds(packed);
+    REQUIRE(ParseDdsLayout(data.data(), data.size(), layout, error));
+    CHECK(layout.Format == TextureFormat::B5G6R5_UNORM);
+    CHECK_EQ(layout.Subresources[0].RowPitch, 8ull);
+
+    DdsDesc volume = packed;
+    volume.BitCount = 32;
+    volume.Masks[0] = 0xff;
+    volume.Masks[1] = 0xff00;
+    volume.Masks[2] = 0xff0000;
+    volume.Masks[3] = 0xff000000;
+    volume.Depth = 4;
+    volume.MipCount = 3;
+    volume.Caps2 = DdsVolume;
+    volume.PayloadSize = 4 * 4 * 4 * 4 + 2 * 2 * 2 * 4 + 4;
+    data = MakeDds(volume);
+    REQUIRE(ParseDdsLayout(data.data(), data.size(), layout, error));
+    CHECK(layout.Dimension == ContainerDimension::Texture3D);
+    REQUIRE(layout.Subresources.size() == 3);
+    CHECK_EQ(layout.Subresources[1].Offset, 128ull + 256);
+    CHECK_EQ(layout.Subresources[2].Offset, 128ull + 256 + 32);
+}
+
+TEST(ContainerParser, Ktx2Footprints)
+{
+    std::vector<uint8_t> data = MakeKtx2(GetRgbaKtx2());
+    ContainerLayout layout;
+    std::string error;
+    REQUIRE(ParseKtx2Layout(data.data(), data.size(), layout, error));
+    CHECK(layout.Format == TextureFormat::R8G8B8A8_UNORM);
+    REQUIRE(layout.Subresources.size() == 4);
+    // 80 byte header, 4 level entries, then the levels smallest first
+    CHECK_EQ(layout.Subresources[3].Offset, 80ull + 4 * 24);
+    CHECK_EQ(layout.Subresources[0].Offset, 80ull + 4 * 24 + 4 + 8 + 32);
+    CHECK_EQ(layout.Subresources[0].RowPitch, 32ull);
+    CHECK_EQ(layout.Subresources[1].SlicePitch, 32ull);
+
+    Ktx2Desc cube;
+    cube.VkFormat = 131; // BC1_RGB
+    cube.Width = 8;
+    cube.Height = 8;
+    cube.Faces = 6;
+    cube.LevelSizes = { 6 * 32, 6 * 8 };
+    data = MakeKtx2(cube);
+    REQUIRE(ParseKtx2Layout(data.data(), data.size(), layout, error));
+    CHECK(layout.Cubemap);
+    REQUIRE(layout.Subresources.size() == 12);
+    // Slice 5 of level 1 is the last face of the smallest level
+    CHECK_EQ(layout.Subresources[1 + 5 * 2].Offset, layout.Subresources[1].Offset + 5 * 8);
+}
+
+TEST(ContainerParser, TruncatedFilesAreRejected)
+{
+    for (const std::vector<uint8_t>& data : { MakeDds(GetBc1Dds()), MakeKtx2(GetRgbaKtx2()) })
+    {
+        ContainerLayout layout;
+        std::string error;
+        bool dds = data[0] == 'D';
+        for (size_t size = 0; size < data.size(); ++size)
+            CHECK(!(dds ? ParseDdsLayout(data.data(), size, layout, error) : ParseKtx2Layout(data.data(), size, layout, error)));
+    }
+}
+
+TEST(ContainerParser, OversizedDescriptionsAreRejected)
+{
+    DdsDesc desc = GetBc1Dds();
+    desc.Width = 16385;
+    CHECK(!ParsesDds(desc));
+    desc = GetBc1Dds();
+    desc.Width = 0xffffffff;
+    desc.Height = 0xffffffff;
+    CHECK(!ParsesDds(desc));
+    desc = GetBc1Dds();
+    desc.MipCount = 6; // 16x8 has 5
+    CHECK(!ParsesDds(desc));
+    desc.MipCount = 0xffffffff;
+    CHECK(!ParsesDds(desc));
+
+    DdsDesc array = GetBc1Dds();
+    array.FourCC = DdsDx10;
+    array.DxgiFormat = uint32_t(TextureFormat::BC1_UNORM);
+    array.ArraySize = 2049;
+    CHECK(!ParsesDds(array));
+    array.MiscFlag = 0x4;
+    array.ArraySize = 0x2aaaaaab; // Times 6 wraps around to 2
+    CHECK(!ParsesDds(array));
+    DdsDesc volume = array;
+    volume.MiscFlag = 0;
+    volume.ArraySize = 1;
+    volume.Dimension = 4;
+    volume.Depth = 4096;
+    CHECK(!ParsesDds(volume));
+
+    Ktx2Desc ktx = GetRgbaKtx2();
+    ktx.Width = 1u << 20;
+    CHECK(!ParsesKtx2(ktx));
+    ktx = GetRgbaKtx2();
+    ktx.Layers = 0xffffffff;
+    ktx.Faces = 6;
+    CHECK(!ParsesKtx2(ktx));
+    ktx = GetRgbaKtx2();
+    ktx.LevelSizes.push_back(4); // Five levels for 8x4
+    CHECK(!ParsesKtx2(ktx));
+}
+
+TEST(ContainerParser, MismatchedHeadersAreRejected)
+{
+    CHECK(ParsesDds(GetBc1Dds()));
+    DdsDesc desc = GetBc1Dds();
+    desc.HeaderSize = 120;
+    CHECK(!ParsesDds(desc));
+    desc = GetBc1Dds();
+    desc.PixelFormatSize = 0;
+    CHECK(!ParsesDds(desc));
+    desc = GetBc1Dds();
+    desc.FourCC = 0x12345678;
+    CHECK(!ParsesDds(desc));
+    desc = GetBc1Dds();
+    desc.Caps2 = DdsCubemap | 0x400; // One face only
+    CHECK(!ParsesDds(desc));
+    desc.Caps2 = DdsCubemap | DdsAllFaces; // 16x8 faces
+    desc.PayloadSize *= 6;
+    CHECK(!ParsesDds(desc));
+
+    DdsDesc dx10 = GetBc1Dds();
+    dx10.FourCC = DdsDx10;
+    dx10.DxgiFormat = uint32_t(TextureFormat::BC1_UNORM);
+    CHECK(ParsesDds(dx10));
+    dx10.Dimension = 1; // Buffer
+    CHECK(!ParsesDds(dx10));
+    dx10.Dimension = 5;
+    CHECK(!ParsesDds(dx10));
+    dx10.Dimension = 3;
+    dx10.DxgiFormat = 200;
+    CHECK(!ParsesDds(dx10));
+    dx10.DxgiFormat = 68; // R8G8_B8G8_UNORM
+    std::string reason;
+    CHECK(!ParsesDds(dx10, &reason));
+    CHECK_EQ(reason, std::string("format 68 isn't supported"));
+    dx10.DxgiFormat = uint32_t(TextureFormat::BC1_UNORM);
+    dx10.Dimension = 4;
+    dx10.ArraySize = 2; // Volumes can't be arrays
+    CHECK(!ParsesDds(dx10));
+
+    CHECK(ParsesKtx2(GetRgbaKtx2()));
+    Ktx2Desc ktx = GetRgbaKtx2();
+    ktx.Faces = 3;
+    CHECK(!ParsesKtx2(ktx));
+    ktx = GetRgbaKtx2();
+    ktx.Supercompression = 2;
+    CHECK(!ParsesKtx2(ktx, &reason));
+    CHECK_EQ(reason, std::string("supercompressed KTX2 textures aren't supported"));
+    ktx = GetRgbaKtx2();
+    ktx.VkFormat = 1000054000; // PVRTC
+    CHECK(!ParsesKtx2(ktx));
+    ktx = GetRgbaKtx2();
+    ktx.LevelSizes[1] -= 4; // Shorter than the level footprint
+    CHECK(!ParsesKtx2(ktx));
+    ktx = GetRgbaKtx2();
+    ktx.Faces = 6; // Non square faces, and the levels hold one face
+    CHECK(!ParsesKtx2(ktx));
+
+    // A level offset past the end
+    std::vector<uint8_t> data = MakeKtx2(GetRgbaKtx2());
+    uint64_t offset = data.size() + 1;
+    memcpy(data.data() + 80, &offset, sizeof(offset));
+    ContainerLayout layout;
+    std::string error;
+    CHECK(!ParseKtx2Layout(data.data(), data.size(), layout, error));
+}
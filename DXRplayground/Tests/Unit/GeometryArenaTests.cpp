@@ -0,0 +1,100 @@
+#include "Test.h"
+#include "GltfGeometry.h"
+
+#include "DXrenderer/Geometry/GeometryArena.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+std::vector<byte> GetPattern(size_t size, byte seed)
+{
+    std::vector<byte> data(size);
+    for (size_t i = 0; i < size; ++i)
+        data[i] = static_cast<byte>(seed + i * 7);
+    return data;
+}
+}
+
+TEST(GeometryArena, RangesStartAtTheirOwnStride)
+{
+    GeometryArena arena;
+    // Float vertices with 32-bit indices, then compact ones with 16-bit indices and so on
+    const UINT vertexStrides[] = { 48, 16, 48, 12, 16 };
+    const UINT indexStrides[] = { 4, 2, 2, 4, 2 };
+    const UINT vertexCounts[] = { 3, 5, 7, 1, 9 };
+    const UINT indexCounts[] = { 3, 9, 3, 3, 21 };
+    for (UINT i = 0; i < 5; ++i)
+        CHECK_EQ(arena.Add(vertexStrides[i], vertexCounts[i], indexStrides[i], indexCounts[i]), i);
+    REQUIRE(arena.GetRangesCount() == 5);
+
+    UINT64 vertexEnd = 0;
+    UINT64 indexEnd = 0;
+    for (UINT i = 0; i < arena.GetRangesCount(); ++i)
+    {
+        const GeometryRange& range = arena.GetRange(i);
+        UINT64 vertexOffset = UINT64(range.BaseVertex) * range.VertexStride;
+        UINT64 indexOffset = UINT64(range.FirstIndex) * range.IndexStride;
+        // Packed in order without overlaps, with less than a stride of padding
+        CHECK(vertexOffset >= vertexEnd && vertexOffset - vertexEnd < range.VertexStride);
+        CHECK(indexOffset >= indexEnd && indexOffset - indexEnd < range.IndexStride);
+        CHECK_EQ(range.VertexCount, vertexCounts[i]);
+        CHECK_EQ(range.IndexCount, indexCounts[i]);
+        vertexEnd = vertexOffset + UINT64(range.VertexStride) * range.VertexCount;
+        indexEnd = indexOffset + UINT64(range.IndexStride) * range.IndexCount;
+    }
+    CHECK_EQ(arena.GetVertexDataSize(), vertexEnd);
+    CHECK_EQ(arena.GetIndexDataSize(), indexEnd);
+}
+
+TEST(GeometryArena, WriteCopiesEveryMeshToItsRange)
+{
+    GeometryArena arena;
+    arena.Add(16, 10, 2, 30);
+    arena.Add(48, 3, 4, 3);
+    arena.Add(16, 4, 2, 6);
+
+    std::vector<std::vector<byte>> vertices;
+    std::vector<std::vector<byte>> indices;
+    std::vector<byte> vertexData(arena.GetVertexDataSize(), 0xCD);
+    std::vector<byte> indexData(arena.GetIndexDataSize(), 0xCD);
+    for (UINT i = 0; i < arena.GetRangesCount(); ++i)
+    {
+        const GeometryRange& range = arena.GetRange(i);
+        vertices.push_back(GetPattern(size_t(range.VertexStride) * range.VertexCount, static_cast<byte>(i * 31)));
+        indices.push_back(GetPattern(size_t(range.IndexStride) * range.IndexCount, static_cast<byte>(i * 17 + 5)));
+        arena.Write(i, vertices.back().data(), indices.back().data(), vertexData.data(), indexData.data());
+    }
+    for (UINT i = 0; i < arena.GetRangesCount(); ++i)
+    {
+        const GeometryRange& range = arena.GetRange(i);
+        CHECK(std::equal(vertices[i].begin(), vertices[i].end(), vertexData.begin() + size_t(range.BaseVertex) * range.VertexStride));
+        CHECK(std::equal(indices[i].begin(), indices[i].end(), indexData.begin() + size_t(range.FirstIndex) * range.IndexStride));
+    }
+}
+
+TEST(GeometryArena, FlightHelmetNeedsTwoBuffers)
+{
+    GltfGeometrySource source(ASSETS_DIR + std::string("Models//FlightHelmet//glTF//FlightHelmet.gltf"));
+    if (!source.IsValid())
+        SKIP("FlightHelmet.gltf isn't in Assets/Models/FlightHelmet/glTF");
+
+    GeometryArena arena;
+    UINT64 vertexBytes = 0;
+    UINT64 indexBytes = 0;
+    for (size_t i = 0; i < source.GetPrimitivesCount(); ++i)
+    {
+        GltfPrimitiveGeometry geometry;
+        source.DecodePrimitive(i, geometry);
+        UINT indexStride = geometry.Vertices.size() <= 0xFFFF ? 2 : 4;
+        arena.Add(sizeof(Vertex), static_cast<UINT>(geometry.Vertices.size()), indexStride, static_cast<UINT>(geometry.Indices.size()));
+        vertexBytes += sizeof(Vertex) * geometry.Vertices.size();
+        indexBytes += indexStride * geometry.Indices.size();
+    }
+    printf("  %u meshes: 2 buffers merged, %u with a buffer per mesh, %llu KB of geometry\n", arena.GetRangesCount(), arena.GetRangesCount() * 2,
+        static_cast<unsigned long long>((arena.GetVertexDataSize() + arena.GetIndexDataSize()) / 1024));
+    CHECK_EQ(arena.GetRangesCount(), UINT(source.GetPrimitivesCount()));
+    // Same stride everywhere, so no padding at all; 16-bit index ranges may need 2 bytes before a 32-bit one
+    CHECK_EQ(arena.GetVertexDataSize(), vertexBytes);
+    CHECK(arena.GetIndexDataSize() - indexBytes < 4 * arena.GetRangesCount());
+}
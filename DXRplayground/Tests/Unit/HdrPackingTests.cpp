@@ -0,0 +1,204 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "DXrenderer/Textures/ExrDecoder.h"
+#include "DXrenderer/Textures/HdrPacking.h"
+#include "Utils/MappedFile.h"
+#include "Utils/ThreadPool.h"
+
+using namespace DirectxPlayground;
+
+namespace DirectxPlayground
+{
+std::ostream& operator<<(std::ostream& stream, HdrFormat format)
+{
+    return stream << GetHdrFormatName(format);
+}
+}
+
+namespace
+{
+constexpr HdrFormat PackedFormats[] = { HdrFormat::Float16, HdrFormat::R11G11B10, HdrFormat::RGB9E5 };
+constexpr float MaxHdrPackingError = 0.004f; // Same threshold as TextureManager
+
+size_t GetTexelBytes(HdrFormat format)
+{
+    return format == HdrFormat::Float32 ? 16 : format == HdrFormat::Float16 ? 8 : 4;
+}
+
+// Log spaced positive values over the whole range the formats store, the channels go through it at different rates
+std::vector<float> MakeRamp(size_t count)
+{
+    std::vector<float> rgba(count * 4);
+    for (size_t i = 0; i < count; ++i)
+    {
+        float t = float(i) / float(count - 1);
+        rgba[i * 4 + 0] = std::exp2(-20.0f + 35.0f * t);
+        rgba[i * 4 + 1] = std::exp2(-20.0f + 35.0f * std::fmod(t * 7.0f, 1.0f));
+        rgba[i * 4 + 2] = std::exp2(-20.0f + 35.0f * std::fmod(t * 13.0f, 1.0f));
+        rgba[i * 4 + 3] = 1.0f;
+    }
+    return rgba;
+}
+
+// Closer to real images: one intensity up to maxValue with a tint, so the shared exponent fits all the channels
+std::vector<float> MakeTintedRamp(size_t count, float maxValue)
+{
+    std::vector<float> rgba(count * 4);
+    float maxExponent = std::log2(maxValue);
+    for (size_t i = 0; i < count; ++i)
+    {
+        float t = float(i) / float(count - 1);
+        float intensity = std::exp2(-12.0f + (maxExponent + 12.0f) * t);
+        rgba[i * 4 + 0] = intensity;
+        rgba[i * 4 + 1] = intensity * (0.4f + 0.6f * std::fmod(t * 17.0f, 1.0f));
+        rgba[i * 4 + 2] = intensity * (0.2f + 0.8f * std::fmod(t * 29.0f, 1.0f));
+        rgba[i * 4 + 3] = 1.0f;
+    }
+    return rgba;
+}
+
+std::vector<float> Unpack(HdrFormat format, const std::vector<float>& rgba, ThreadPool* workers = nullptr)
+{
+    size_t count = rgba.size() / 4;
+    std::vector<byte> packed(count * GetTexelBytes(format));
+    PackHdr(format, rgba.data(), count, packed.data(), workers);
+    std::vector<float> decoded(rgba.size());
+    UnpackHdr(format, packed.data(), count, decoded.data());
+    return decoded;
+}
+}
+
+TEST(HdrPacking, VectorKernelsMatchScalar)
+{
+    // Odd count so the scalar tail runs too, special values mixed in
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> exponent(-30.0f, 20.0f);
+    std::uniform_real_distribution<float> sign(-0.2f, 1.0f);
+    std::vector<float> rgba(100003 * 4);
+    for (float& value : rgba)
+        value = std::exp2(exponent(random)) * (sign(random) < 0.0f ? -1.0f : 1.0f);
+    const float specials[] = { 0.0f, -0.0f, NAN, INFINITY, -INFINITY, 65504.0f, 65520.0f, 1e9f, 6.1e-5f, 1e-8f };
+    for (size_t i = 0; i < std::size(specials); ++i)
+        rgba[i * 37] = specials[i];
+
+    ThreadPool workers(4);
+    size_t count = rgba.size() / 4;
+    for (HdrFormat format : PackedFormats)
+    {
+        std::vector<byte> reference(count * GetTexelBytes(format));
+        std::vector<byte> packed(reference.size());
+        PackHdrScalar(format, rgba.data(), count, reference.data());
+        PackHdr(format, rgba.data(), count, packed.data(), &workers);
+        CHECK(packed == reference);
+    }
+}
+
+TEST(HdrPacking, QuantizationErrorIsBounded)
+{
+    std::vector<float> rgba = MakeRamp(65536);
+    size_t count = rgba.size() / 4;
+    for (HdrFormat format : PackedFormats)
+    {
+        std::vector<float> decoded = Unpack(format, rgba);
+        // Half an ulp of the mantissa, relative to the value or to the largest channel for the shared exponent.
+        // Below the smallest normal the ulp stops shrinking.
+        float worst = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float* texel = &rgba[i * 4];
+            float maxChannel = std::max(texel[0], std::max(texel[1], texel[2]));
+            for (UINT c = 0; c < 3; ++c)
+            {
+                float value = std::min(texel[c], 65000.0f);
+                float bound = 0.0f;
+                if (format == HdrFormat::Float16)
+                    bound = std::max(value, 6.103515625e-05f) * std::exp2(-11.0f);
+                else if (format == HdrFormat::R11G11B10)
+                    bound = std::max(value, 6.103515625e-05f) * std::exp2(c == 2 ? -6.0f : -7.0f);
+                else
+                    bound = std::max(std::min(maxChannel, 65000.0f), 1.52587890625e-05f) * std::exp2(-9.0f);
+                worst = std::max(worst, std::abs(decoded[i * 4 + c] - value) / bound);
+            }
+        }
+        CHECK(worst <= 1.001f);
+
+        std::vector<float> tinted = MakeTintedRamp(65536, 60000.0f);
+        std::vector<float> tintedDecoded = Unpack(format, tinted);
+        float error = ComputeHdrLogRmse(tinted.data(), tintedDecoded.data(), count);
+        printf("%-10s log2 RMSE %.6f, worst error %.3f of the bound\n", GetHdrFormatName(format), error, worst);
+        // Uniform rounding of a mantissa of that many bits
+        float mantissaBits = format == HdrFormat::Float16 ? 10.0f : format == HdrFormat::R11G11B10 ? 5.0f : 8.0f;
+        CHECK(error < std::exp2(-mantissaBits) / std::sqrt(12.0f) * 1.4427f);
+    }
+}
+
+TEST(HdrPacking, OutOfRangeValuesAreClamped)
+{
+    std::vector<float> rgba = { 1e6f, -2.0f, NAN, 0.5f };
+    std::vector<float> half = Unpack(HdrFormat::Float16, rgba);
+    CHECK_EQ(half[0], 65504.0f);
+    CHECK_EQ(half[1], -2.0f);
+    CHECK_EQ(half[2], 0.0f);
+    CHECK_EQ(half[3], 0.5f);
+
+    std::vector<float> r11g11b10 = Unpack(HdrFormat::R11G11B10, rgba);
+    CHECK_EQ(r11g11b10[0], 65024.0f);
+    CHECK_EQ(r11g11b10[1], 0.0f);
+    CHECK_EQ(r11g11b10[2], 0.0f);
+    CHECK_EQ(r11g11b10[3], 1.0f);
+
+    std::vector<float> rgb9e5 = Unpack(HdrFormat::RGB9E5, rgba);
+    CHECK_EQ(rgb9e5[0], 65408.0f);
+    CHECK_EQ(rgb9e5[1], 0.0f);
+    CHECK_EQ(rgb9e5[2], 0.0f);
+}
+
+TEST(HdrPacking, FormatFollowsTheContent)
+{
+    std::vector<float> rgba = MakeTintedRamp(4096, 1000.0f);
+    float error = 0.0f;
+    HdrFormat format = ChooseHdrFormat(rgba.data(), rgba.size() / 4, MaxHdrPackingError, &error);
+    CHECK(format == HdrFormat::R11G11B10 || format == HdrFormat::RGB9E5);
+    CHECK(error <= MaxHdrPackingError);
+
+    std::vector<float> alpha = rgba;
+    alpha[3] = 0.5f;
+    CHECK_EQ(ChooseHdrFormat(alpha.data(), alpha.size() / 4, MaxHdrPackingError), HdrFormat::Float16);
+    std::vector<float> negative = rgba;
+    negative[4] = -1.0f;
+    CHECK_EQ(ChooseHdrFormat(negative.data(), negative.size() / 4, MaxHdrPackingError), HdrFormat::Float16);
+    std::vector<float> large = rgba;
+    large[8] = 1e5f;
+    CHECK_EQ(ChooseHdrFormat(large.data(), large.size() / 4, MaxHdrPackingError), HdrFormat::Float32);
+    // Nothing 4 byte is good enough under a threshold that tight
+    CHECK_EQ(ChooseHdrFormat(rgba.data(), rgba.size() / 4, 1e-5f), HdrFormat::Float16);
+}
+
+TEST(HdrPacking, Asakusa)
+{
+    MappedFile file(ASSETS_DIR + std::string("Textures//asakusa.exr"));
+    std::vector<byte> pixels;
+    UINT width = 0;
+    UINT height = 0;
+    if (!file.IsValid() || !DecodeExr(file.GetData(), file.GetSize(), pixels, width, height, nullptr))
+        SKIP("asakusa.exr isn't available");
+    const float* decodedPixels = reinterpret_cast<const float*>(pixels.data());
+    std::vector<float> rgba(decodedPixels, decodedPixels + size_t(width) * height * 4);
+
+    size_t count = rgba.size() / 4;
+    float sampleError = 0.0f;
+    HdrFormat format = ChooseHdrFormat(rgba.data(), count, MaxHdrPackingError, &sampleError);
+    CHECK_EQ(format, HdrFormat::RGB9E5);
+
+    // The sampled estimate has to hold for the whole image
+    ThreadPool workers(4);
+    std::vector<float> decoded = Unpack(format, rgba, &workers);
+    float error = ComputeHdrLogRmse(rgba.data(), decoded.data(), count);
+    printf("asakusa.exr %s, log2 RMSE %.6f, sampled %.6f\n", GetHdrFormatName(format), error, sampleError);
+    CHECK(error <= MaxHdrPackingError);
+    CHECK_NEAR(error, sampleError, 0.25f * sampleError);
+}
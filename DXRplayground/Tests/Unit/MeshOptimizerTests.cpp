@@ -0,0 +1,125 @@
+#include "Test.h"
+#include "TestMeshes.h"
+
+#include <random>
+
+#include "DXrenderer/Geometry/MeshOptimizer.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+// Same triangles in any order, each with the same winding
+std::vector<std::vector<UINT>> GetSortedTriangles(const std::vector<UINT>& indices)
+{
+    std::vector<std::vector<UINT>> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        std::vector<UINT> t = { indices[i], indices[i + 1], indices[i + 2] };
+        std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        triangles.push_back(t);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+void ShuffleTriangles(std::vector<UINT>& indices, UINT seed)
+{
+    std::vector<size_t> order(indices.size() / 3);
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+    std::vector<UINT> shuffled;
+    for (size_t t : order)
+        shuffled.insert(shuffled.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+    indices.swap(shuffled);
+}
+}
+
+TEST(MeshOptimizer, AnalyzeCountsFifoMisses)
+{
+    // Two triangles sharing an edge: 4 transforms with any cache that holds 3 vertices
+    std::vector<UINT> indices = { 0, 1, 2, 2, 1, 3 };
+    VertexCacheStats stats = AnalyzeVertexCache(indices, 4, 3);
+    CHECK_EQ(stats.TrianglesCount, size_t(2));
+    CHECK_EQ(stats.VerticesCount, size_t(4));
+    CHECK_EQ(stats.TransformedCount, size_t(4));
+    CHECK_NEAR(stats.GetAcmr(), 2.0f, 1e-6f);
+    CHECK_NEAR(stats.GetAtvr(), 1.0f, 1e-6f);
+
+    // A 1 entry cache misses everything but the repeated index
+    indices = { 0, 1, 1 };
+    CHECK_EQ(AnalyzeVertexCache(indices, 2, 1).TransformedCount, size_t(2));
+}
+
+TEST(MeshOptimizer, TipsifyKeepsTrianglesAndLowersAcmr)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildGrid(100, vertices, indices);
+    ShuffleTriangles(indices, 7);
+    auto triangles = GetSortedTriangles(indices);
+
+    VertexCacheStats before = AnalyzeVertexCache(indices, vertices.size());
+    OptimizeVertexCache(indices, vertices.size());
+    VertexCacheStats after = AnalyzeVertexCache(indices, vertices.size());
+    printf("  100x100 grid, shuffled: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.GetAcmr(), after.GetAcmr(), before.GetAtvr(), after.GetAtvr());
+    CHECK(GetSortedTriangles(indices) == triangles);
+    CHECK(before.GetAcmr() > 2.5f);
+    // 0.5 is the limit for a regular grid
+    CHECK(after.GetAcmr() < 0.75f);
+}
+
+TEST(MeshOptimizer, TipsifyIsDeterministic)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(32, 64, vertices, indices);
+    ShuffleTriangles(indices, 3);
+    std::vector<UINT> first = indices;
+    std::vector<UINT> second = indices;
+    OptimizeVertexCache(first, vertices.size());
+    OptimizeVertexCache(second, vertices.size());
+    CHECK(first == second);
+}
+
+TEST(MeshOptimizer, TipsifyHandlesUnreferencedVertices)
+{
+    // Vertex 0 isn't used, the fan starts at the first index
+    std::vector<UINT> indices = { 3, 1, 2, 2, 1, 4 };
+    OptimizeVertexCache(indices, 6);
+    CHECK_EQ(indices.size(), size_t(6));
+    CHECK(GetSortedTriangles(indices) == GetSortedTriangles({ 3, 1, 2, 2, 1, 4 }));
+}
+
+TEST(MeshOptimizer, OverdrawKeepsTrianglesWithinThreshold)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(64, 128, vertices, indices);
+    ShuffleTriangles(indices, 11);
+    OptimizeVertexCache(indices, vertices.size());
+    auto triangles = GetSortedTriangles(indices);
+    float tipsifyAcmr = AnalyzeVertexCache(indices, vertices.size()).GetAcmr();
+
+    OptimizeOverdraw(indices, vertices, DefaultVertexCacheSize, 1.05f);
+    float overdrawAcmr = AnalyzeVertexCache(indices, vertices.size()).GetAcmr();
+    printf("  sphere 64x128: ACMR after Tipsify %.3f, after overdraw clusters %.3f\n", tipsifyAcmr, overdrawAcmr);
+    CHECK(GetSortedTriangles(indices) == triangles);
+    // Splitting only happens where the piece is within the threshold, reordering at the boundaries costs a little more
+    CHECK(overdrawAcmr <= tipsifyAcmr * 1.15f);
+}
+
+TEST(MeshOptimizer, VertexFetchRemapsInFirstUseOrder)
+{
+    std::vector<Vertex> vertices(5);
+    for (UINT i = 0; i < 5; ++i)
+        vertices[i].Pos = { float(i), 0.0f, 0.0f };
+    std::vector<UINT> indices = { 4, 2, 3, 3, 2, 0 };
+    OptimizeVertexFetch(vertices, indices);
+    CHECK_EQ(vertices.size(), size_t(4)); // Vertex 1 is dropped
+    CHECK(indices == std::vector<UINT>({ 0, 1, 2, 2, 1, 3 }));
+    CHECK_EQ(vertices[0].Pos.x, 4.0f);
+    CHECK_EQ(vertices[3].Pos.x, 0.0f);
+}
@@ -0,0 +1,168 @@
+#include "Test.h"
+#include "TestMeshes.h"
+
+#include "DXrenderer/Geometry/Meshlets.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+using DirectX::XMFLOAT3;
+
+namespace
+{
+// Left handed perspective looking down +Z from (0, 0, -distance), row vector matrices like the renderer uses
+DirectX::XMFLOAT4X4 GetMeshToClip(float distance, float fovY, float nearZ = 0.1f, float farZ = 100.0f)
+{
+    float yScale = 1.0f / std::tan(fovY * 0.5f);
+    float range = farZ / (farZ - nearZ);
+    DirectX::XMFLOAT4X4 m{};
+    m(0, 0) = yScale;
+    m(1, 1) = yScale;
+    m(2, 2) = range;
+    m(2, 3) = 1.0f;
+    m(3, 2) = distance * range - nearZ * range;
+    m(3, 3) = distance;
+    return m;
+}
+
+XMFLOAT3 GetFaceNormal(const std::vector<Vertex>& vertices, const UINT* triangle)
+{
+    const XMFLOAT3& p0 = vertices[triangle[0]].Pos;
+    const XMFLOAT3& p1 = vertices[triangle[1]].Pos;
+    const XMFLOAT3& p2 = vertices[triangle[2]].Pos;
+    XMFLOAT3 e0 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+    XMFLOAT3 e1 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+    return { e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x };
+}
+
+bool IsBackfacing(const std::vector<Vertex>& vertices, const UINT* triangle, const XMFLOAT3& viewer)
+{
+    XMFLOAT3 n = GetFaceNormal(vertices, triangle);
+    const XMFLOAT3& p = vertices[triangle[0]].Pos;
+    return (viewer.x - p.x) * n.x + (viewer.y - p.y) * n.y + (viewer.z - p.z) * n.z <= 0.0f;
+}
+}
+
+TEST(Meshlets, RespectLimitsAndCoverIndices)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(64, 128, vertices, indices);
+    MeshletData data;
+    BuildMeshlets(vertices, indices, data);
+
+    size_t trianglesCount = 0;
+    for (const auto& meshlet : data.Meshlets)
+    {
+        CHECK(meshlet.VertexCount <= MaxMeshletVertices);
+        CHECK(meshlet.TriangleCount <= MaxMeshletTriangles && meshlet.TriangleCount > 0);
+        for (UINT t = 0; t < meshlet.TriangleCount * 3; ++t)
+        {
+            UINT local = data.Triangles[meshlet.TriangleOffset * 3 + t];
+            REQUIRE(local < meshlet.VertexCount);
+            CHECK_EQ(data.Vertices[meshlet.VertexOffset + local], indices[meshlet.FirstIndex + t]);
+        }
+        for (UINT v = 0; v < meshlet.VertexCount; ++v)
+        {
+            const XMFLOAT3& p = vertices[data.Vertices[meshlet.VertexOffset + v]].Pos;
+            float dx = p.x - meshlet.Center.x;
+            float dy = p.y - meshlet.Center.y;
+            float dz = p.z - meshlet.Center.z;
+            CHECK(std::sqrt(dx * dx + dy * dy + dz * dz) <= meshlet.Radius * 1.0001f);
+        }
+        trianglesCount += meshlet.TriangleCount;
+    }
+    CHECK_EQ(trianglesCount, indices.size() / 3);
+}
+
+TEST(Meshlets, ConesIgnoreShadingNormals)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(32, 64, vertices, indices);
+    MeshletData reference;
+    BuildMeshlets(vertices, indices, reference);
+
+    // Normals pointing inside used to flip every cone
+    for (auto& v : vertices)
+        v.Norm = { -v.Norm.x, -v.Norm.y, -v.Norm.z };
+    MeshletData flipped;
+    BuildMeshlets(vertices, indices, flipped);
+    REQUIRE(flipped.Meshlets.size() == reference.Meshlets.size());
+    for (size_t i = 0; i < reference.Meshlets.size(); ++i)
+    {
+        CHECK_EQ(flipped.Meshlets[i].ConeAxis.x, reference.Meshlets[i].ConeAxis.x);
+        CHECK_EQ(flipped.Meshlets[i].ConeAxis.y, reference.Meshlets[i].ConeAxis.y);
+        CHECK_EQ(flipped.Meshlets[i].ConeAxis.z, reference.Meshlets[i].ConeAxis.z);
+        CHECK_EQ(flipped.Meshlets[i].ConeCutoff, reference.Meshlets[i].ConeCutoff);
+    }
+}
+
+TEST(Meshlets, GridIsCulledFromBelowOnly)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildGrid(32, vertices, indices);
+    MeshletData data;
+    BuildMeshlets(vertices, indices, data);
+    DirectX::XMFLOAT4X4 everything{};
+    everything(0, 0) = 0.01f;
+    everything(1, 1) = 0.01f;
+    everything(2, 2) = 0.01f;
+    everything(3, 2) = 0.5f;
+    everything(3, 3) = 1.0f;
+
+    for (float height : { 2.0f, -2.0f })
+    {
+        MeshletCullingView view(everything, { 0.5f, height, 0.5f });
+        std::vector<IndexRange> ranges;
+        MeshletCullingStats stats;
+        CullMeshlets(data.Meshlets, view, ranges, stats);
+        CHECK_EQ(stats.FrustumCulledTrianglesCount, size_t(0));
+        if (height > 0.0f)
+            CHECK_EQ(stats.BackfaceCulledTrianglesCount, size_t(0));
+        else
+            CHECK_EQ(stats.BackfaceCulledTrianglesCount, stats.TrianglesCount);
+    }
+}
+
+TEST(Meshlets, FixedCameraRejectsOnlyHiddenTriangles)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(64, 128, vertices, indices);
+    MeshletData data;
+    BuildMeshlets(vertices, indices, data);
+
+    // A sphere 3 units in front of the camera, half of it faces away
+    XMFLOAT3 viewer = { 0.0f, 0.0f, -3.0f };
+    MeshletCullingView view(GetMeshToClip(3.0f, 1.0f), viewer);
+    std::vector<IndexRange> ranges;
+    MeshletCullingStats stats;
+    CullMeshlets(data.Meshlets, view, ranges, stats);
+
+    size_t backfacing = 0;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        backfacing += IsBackfacing(vertices, &indices[i], viewer) ? 1 : 0;
+    printf("  sphere %zu triangles, %zu meshlets: %zu culled (%zu backfacing, %zu outside), %zu of the triangles face away\n", stats.TrianglesCount,
+        stats.MeshletsCount, stats.BackfaceCulledTrianglesCount + stats.FrustumCulledTrianglesCount, stats.BackfaceCulledTrianglesCount,
+        stats.FrustumCulledTrianglesCount, backfacing);
+    CHECK_EQ(stats.FrustumCulledTrianglesCount, size_t(0));
+    CHECK(stats.BackfaceCulledTrianglesCount > backfacing / 2);
+    CHECK(stats.BackfaceCulledTrianglesCount <= backfacing);
+
+    // Conservative: nothing facing the camera goes
+    for (const auto& meshlet : data.Meshlets)
+    {
+        if (TestMeshlet(meshlet, view) != MeshletVisibility::Backfacing)
+            continue;
+        for (UINT t = 0; t < meshlet.TriangleCount; ++t)
+            CHECK(IsBackfacing(vertices, &indices[meshlet.FirstIndex + t * 3], viewer));
+    }
+
+    // Looking the other way culls it all by the frustum
+    MeshletCullingView away(GetMeshToClip(-3.0f, 1.0f), { 0.0f, 0.0f, 3.0f });
+    MeshletCullingStats awayStats;
+    ranges.clear();
+    CullMeshlets(data.Meshlets, away, ranges, awayStats);
+    CHECK(ranges.empty());
+}
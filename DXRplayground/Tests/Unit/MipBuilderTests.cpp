@@ -0,0 +1,232 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "DXrenderer/Textures/MipBuilder.h"
+#include "DXrenderer/Textures/TextureCache.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+// 4x4 RGBA8 checker of the two values, alpha opaque
+DecodedImage GetChecker(byte a, byte b)
+{
+    DecodedImage image;
+    image.Width = 4;
+    image.Height = 4;
+    image.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    for (UINT y = 0; y < 4; ++y)
+    {
+        for (UINT x = 0; x < 4; ++x)
+        {
+            byte value = (x + y) % 2 == 0 ? a : b;
+            image.Data.insert(image.Data.end(), { value, value, value, 255 });
+        }
+    }
+    return image;
+}
+
+DecodedImage GetImage(UINT width, UINT height, const std::function<void(UINT, UINT, byte*)>& texel)
+{
+    DecodedImage image;
+    image.Width = width;
+    image.Height = height;
+    image.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    image.Data.resize(size_t(width) * height * 4);
+    for (UINT y = 0; y < height; ++y)
+        for (UINT x = 0; x < width; ++x)
+            texel(x, y, &image.Data[(size_t(y) * width + x) * 4]);
+    return image;
+}
+
+const byte* GetTexel(const DecodedImage& image, UINT level, UINT x, UINT y)
+{
+    return image.Data.data() + image.GetMipOffset(level) + (size_t(y) * image.GetMipWidth(level) + x) * 4;
+}
+
+float GetCoverage(const DecodedImage& image, UINT level, float cutoff)
+{
+    UINT passed = 0;
+    for (UINT y = 0; y < image.GetMipHeight(level); ++y)
+        for (UINT x = 0; x < image.GetMipWidth(level); ++x)
+            passed += GetTexel(image, level, x, y)[3] / 255.0f >= cutoff ? 1 : 0;
+    return float(passed) / float(image.GetMipWidth(level) * image.GetMipHeight(level));
+}
+}
+
+TEST(MipBuilder, OnlyColorIsSrgb)
+{
+    for (TextureCompression compression : { TextureCompression::None, TextureCompression::Fast, TextureCompression::HighQuality })
+    {
+        CHECK(GetMipBuildOptions(TextureUsage::Color, compression, false).Srgb);
+        CHECK(!GetMipBuildOptions(TextureUsage::Data, compression, false).Srgb);
+        CHECK(!GetMipBuildOptions(TextureUsage::Mask, compression, false).Srgb);
+        CHECK(!GetMipBuildOptions(TextureUsage::Normal, compression, false).Srgb);
+        CHECK(GetMipBuildOptions(TextureUsage::Normal, compression, false).NormalMap);
+    }
+    CHECK_EQ(GetMipBuildOptions(TextureUsage::Color, TextureCompression::Fast, true).AlphaTestCutoff, 0.5f);
+    CHECK_EQ(GetMipBuildOptions(TextureUsage::Data, TextureCompression::Fast, true).AlphaTestCutoff, 0.0f);
+    CHECK(GetMipBuildOptions(TextureUsage::Data, TextureCompression::HighQuality, false).Filter == MipFilter::Kaiser);
+}
+
+// Roughness 0 and 1 average to 0.5, in sRGB the same texels would come out at 188
+TEST(MipBuilder, DataMipsAreLinear)
+{
+    DecodedImage data = GetChecker(0, 255);
+    REQUIRE(BuildMips(data, GetMipBuildOptions(TextureUsage::Data, TextureCompression::Fast, false), nullptr));
+    REQUIRE(data.MipLevels == 3);
+    const byte* last = data.Data.data() + data.GetMipOffset(2);
+    CHECK_NEAR(last[0], 128, 1);
+    CHECK_NEAR(last[1], 128, 1);
+    CHECK_EQ(last[3], 255);
+
+    DecodedImage color = GetChecker(0, 255);
+    REQUIRE(BuildMips(color, GetMipBuildOptions(TextureUsage::Color, TextureCompression::Fast, false), nullptr));
+    CHECK_NEAR(color.Data[color.GetMipOffset(2)], 188, 1);
+}
+
+// 5x3 goes to 2x1, the last column and row weigh in instead of being dropped
+TEST(MipBuilder, OddSizesKeepTheirEdges)
+{
+    DecodedImage image = GetImage(5, 3, [](UINT x, UINT y, byte* texel)
+    {
+        texel[0] = x == 4 ? 255 : 0;
+        texel[1] = y == 2 ? 255 : 0;
+        texel[2] = 0;
+        texel[3] = 255;
+    });
+    REQUIRE(BuildMips(image, GetMipBuildOptions(TextureUsage::Data, TextureCompression::Fast, false), nullptr));
+    REQUIRE(image.MipLevels == 3);
+    REQUIRE(image.GetMipWidth(1) == 2 && image.GetMipHeight(1) == 1);
+    // The right texel covers the source from 2.5 to 5, the edge column is 1 of its 2.5 texels
+    CHECK_EQ(GetTexel(image, 1, 0, 0)[0], 0);
+    CHECK_NEAR(GetTexel(image, 1, 1, 0)[0], 102, 1);
+    CHECK_NEAR(GetTexel(image, 1, 0, 0)[1], 85, 1);
+    CHECK_NEAR(GetTexel(image, 1, 1, 0)[1], 85, 1);
+    // The last level is the mean of the whole image
+    CHECK_NEAR(GetTexel(image, 2, 0, 0)[0], 51, 1);
+    CHECK_NEAR(GetTexel(image, 2, 0, 0)[1], 85, 1);
+}
+
+TEST(MipBuilder, AlphaTestCoverageIsKept)
+{
+    // Thin blades, a third of the texels pass. Box filtering blends them with the gaps under the cutoff.
+    auto blades = [](UINT x, UINT y, byte* texel)
+    {
+        texel[0] = texel[1] = texel[2] = 128;
+        texel[3] = (x + 2 * y) % 3 == 0 ? 255 : byte((x * 37 + y * 11) % 100);
+    };
+    const float cutoff = 0.5f;
+    DecodedImage kept = GetImage(32, 32, blades);
+    REQUIRE(BuildMips(kept, GetMipBuildOptions(TextureUsage::Color, TextureCompression::Fast, true), nullptr));
+    MipBuildOptions options = GetMipBuildOptions(TextureUsage::Color, TextureCompression::Fast, false);
+    DecodedImage plain = GetImage(32, 32, blades);
+    REQUIRE(BuildMips(plain, options, nullptr));
+
+    float coverage = GetCoverage(kept, 0, cutoff);
+    for (UINT level = 1; level < 4; ++level)
+    {
+        float keptCoverage = GetCoverage(kept, level, cutoff);
+        float plainCoverage = GetCoverage(plain, level, cutoff);
+        printf("  level %u: coverage %g kept, %g plain, %g at the top\n", level, keptCoverage, plainCoverage, coverage);
+        CHECK(std::fabs(keptCoverage - coverage) < 0.05f);
+    }
+    CHECK(GetCoverage(plain, 3, cutoff) < coverage * 0.5f);
+}
+
+TEST(MipBuilder, KaiserKeepsRampsAndIsSharper)
+{
+    MipBuildOptions kaiser = GetMipBuildOptions(TextureUsage::Data, TextureCompression::HighQuality, false);
+    MipBuildOptions box = GetMipBuildOptions(TextureUsage::Data, TextureCompression::Fast, false);
+    REQUIRE(kaiser.Filter == MipFilter::Kaiser);
+
+    // The weights add up to 1 and are symmetric, a flat level stays flat and a ramp keeps its values at the texel centers
+    DecodedImage ramp = GetImage(32, 32, [](UINT x, UINT y, byte* texel)
+    {
+        texel[0] = byte(x * 8);
+        texel[1] = 100;
+        texel[2] = byte(y * 8);
+        texel[3] = 255;
+    });
+    REQUIRE(BuildMips(ramp, kaiser, nullptr));
+    for (UINT x = 3; x < 13; ++x)
+    {
+        CHECK_NEAR(GetTexel(ramp, 1, x, 8)[0], 16 * x + 4, 1);
+        CHECK_NEAR(GetTexel(ramp, 1, 8, x)[2], 16 * x + 4, 1);
+    }
+    bool flat = true;
+    for (UINT level = 1; level < ramp.MipLevels; ++level)
+        for (UINT y = 0; y < ramp.GetMipHeight(level); ++y)
+            for (UINT x = 0; x < ramp.GetMipWidth(level); ++x)
+                flat &= GetTexel(ramp, level, x, y)[1] == 100;
+    CHECK(flat);
+
+    // A wave 8 texels long, half the destination Nyquist, peaks at the destination texel centers. The box filter flattens it more.
+    auto wave = [](UINT x, UINT y, byte* texel)
+    {
+        texel[0] = texel[1] = texel[2] = byte(std::lround(128.0f + 100.0f * std::cos(3.14159265f * (x - 0.5f) / 4.0f)));
+        texel[3] = 255;
+    };
+    auto getContrast = [&wave](const MipBuildOptions& options)
+    {
+        DecodedImage image = GetImage(64, 16, wave);
+        BuildMips(image, options, nullptr);
+        int low = 255;
+        int high = 0;
+        for (UINT x = 4; x < 28; ++x)
+        {
+            low = std::min<int>(low, GetTexel(image, 1, x, 4)[0]);
+            high = std::max<int>(high, GetTexel(image, 1, x, 4)[0]);
+        }
+        return high - low;
+    };
+    int kaiserContrast = getContrast(kaiser);
+    int boxContrast = getContrast(box);
+    printf("  wave contrast: %d Kaiser, %d box\n", kaiserContrast, boxContrast);
+    CHECK(kaiserContrast > boxContrast);
+}
+
+TEST(MipBuilder, NormalsStayUnitLength)
+{
+    // Normals tilted both ways average to a short vector straight up
+    auto bumps = [](UINT x, UINT y, byte* texel)
+    {
+        float angle = 0.3f * float(x) + 0.7f * float(y);
+        float tilt = (x + y) % 2 == 0 ? 0.6f : -0.6f;
+        float n[3] = { tilt * std::cos(angle), tilt * std::sin(angle), 0.8f };
+        for (UINT c = 0; c < 3; ++c)
+            texel[c] = byte(std::lround((n[c] * 0.5f + 0.5f) * 255.0f));
+        texel[3] = 255;
+    };
+    for (TextureCompression compression : { TextureCompression::Fast, TextureCompression::HighQuality })
+    {
+        DecodedImage image = GetImage(16, 16, bumps);
+        REQUIRE(BuildMips(image, GetMipBuildOptions(TextureUsage::Normal, compression, false), nullptr));
+        float worst = 0.0f;
+        for (UINT level = 1; level < image.MipLevels; ++level)
+        {
+            for (UINT y = 0; y < image.GetMipHeight(level); ++y)
+            {
+                for (UINT x = 0; x < image.GetMipWidth(level); ++x)
+                {
+                    const byte* texel = GetTexel(image, level, x, y);
+                    float length = 0.0f;
+                    for (UINT c = 0; c < 3; ++c)
+                        length += (texel[c] / 255.0f * 2.0f - 1.0f) * (texel[c] / 255.0f * 2.0f - 1.0f);
+                    worst = std::max(worst, std::fabs(std::sqrt(length) - 1.0f));
+                }
+            }
+        }
+        // 8 bit channels are off by up to half a step each
+        CHECK(worst < 0.015f);
+    }
+
+    // Without the flag the same level comes out short
+    MipBuildOptions options;
+    DecodedImage plain = GetImage(16, 16, bumps);
+    REQUIRE(BuildMips(plain, options, nullptr));
+    CHECK(GetTexel(plain, 1, 4, 4)[2] < 240);
+}
@@ -0,0 +1,132 @@
+#include "Test.h"
+
+#include "DXrenderer/Textures/PngDecoder.h"
+#include "External/lodepng/lodepng.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+// Noise over gradients, so every filter gets picked by the adaptive strategies and the left neighbor matters
+std::vector<byte> MakePixels(UINT width, UINT height, UINT channels)
+{
+    std::vector<byte> pixels(size_t(width) * height * channels);
+    UINT seed = 3;
+    for (UINT y = 0; y < height; ++y)
+    {
+        for (UINT x = 0; x < width; ++x)
+        {
+            for (UINT c = 0; c < channels; ++c)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                pixels[(size_t(y) * width + x) * channels + c] = static_cast<byte>(x * (c + 1) + y * 3 + ((seed >> 24) & 15));
+            }
+        }
+    }
+    return pixels;
+}
+
+std::vector<byte> Encode(const std::vector<byte>& pixels, UINT width, UINT height, LodePNGColorType colorType, LodePNGFilterStrategy strategy, bool key = false)
+{
+    lodepng::State state;
+    state.encoder.auto_convert = 0;
+    state.encoder.filter_strategy = strategy;
+    state.info_raw.colortype = colorType;
+    state.info_raw.bitdepth = 8;
+    state.info_png.color.colortype = colorType;
+    state.info_png.color.bitdepth = 8;
+    if (colorType == LCT_PALETTE)
+    {
+        for (UINT i = 0; i < 256; ++i)
+        {
+            lodepng_palette_add(&state.info_raw, byte(i), byte(255 - i), byte(i * 7), byte(i < 16 ? i * 16 : 255));
+            lodepng_palette_add(&state.info_png.color, byte(i), byte(255 - i), byte(i * 7), byte(i < 16 ? i * 16 : 255));
+        }
+    }
+    if (key)
+    {
+        // The first pixel's color, so it turns transparent
+        state.info_png.color.key_defined = 1;
+        state.info_png.color.key_r = pixels[0];
+        state.info_png.color.key_g = colorType == LCT_RGB ? pixels[1] : pixels[0];
+        state.info_png.color.key_b = colorType == LCT_RGB ? pixels[2] : pixels[0];
+        state.info_raw.key_defined = state.info_png.color.key_defined;
+        state.info_raw.key_r = state.info_png.color.key_r;
+        state.info_raw.key_g = state.info_png.color.key_g;
+        state.info_raw.key_b = state.info_png.color.key_b;
+    }
+    std::vector<byte> png;
+    lodepng::encode(png, pixels.data(), width, height, state);
+    return png;
+}
+
+// Decodes with lodepng and PngDecoder into rows with padding, the padding has to be left alone
+bool DecodesLikeLodepng(const std::vector<byte>& png)
+{
+    std::vector<byte> expected;
+    UINT width = 0;
+    UINT height = 0;
+    if (png.empty() || lodepng::decode(expected, width, height, png) != 0)
+        return false;
+
+    PngInfo info;
+    if (!ReadPngInfo(png.data(), png.size(), info) || !IsPngFastPathSupported(info) || info.Width != width || info.Height != height)
+        return false;
+    size_t pitch = size_t(width) * 4 + 12;
+    std::vector<byte> decoded(pitch * height, 0xcd);
+    if (!DecodePng(png.data(), png.size(), info, decoded.data(), pitch))
+        return false;
+    for (UINT y = 0; y < height; ++y)
+    {
+        if (memcmp(&decoded[y * pitch], &expected[size_t(y) * width * 4], size_t(width) * 4) != 0)
+            return false;
+        for (size_t i = size_t(width) * 4; i < pitch; ++i)
+        {
+            if (decoded[y * pitch + i] != 0xcd)
+                return false;
+        }
+    }
+    return true;
+}
+}
+
+TEST(PngDecoder, MatchesLodepng)
+{
+    const std::pair<LodePNGColorType, UINT> colorTypes[] = { { LCT_GREY, 1 }, { LCT_GREY_ALPHA, 2 }, { LCT_RGB, 3 }, { LCT_RGBA, 4 }, { LCT_PALETTE, 1 } };
+    const LodePNGFilterStrategy strategies[] = { LFS_ZERO, LFS_ONE, LFS_TWO, LFS_THREE, LFS_FOUR, LFS_MINSUM, LFS_ENTROPY };
+    // Odd sizes so rows don't line up with vectors
+    for (const auto& [colorType, channels] : colorTypes)
+    {
+        std::vector<byte> pixels = MakePixels(67, 33, channels);
+        for (LodePNGFilterStrategy strategy : strategies)
+        {
+            bool same = DecodesLikeLodepng(Encode(pixels, 67, 33, colorType, strategy));
+            if (!same)
+                printf("Color type %d, filter strategy %d differs\n", colorType, strategy);
+            CHECK(same);
+        }
+    }
+}
+
+TEST(PngDecoder, TransparentKey)
+{
+    for (LodePNGColorType colorType : { LCT_GREY, LCT_RGB })
+    {
+        UINT channels = colorType == LCT_RGB ? 3 : 1;
+        std::vector<byte> pixels = MakePixels(19, 7, channels);
+        for (LodePNGFilterStrategy strategy : { LFS_ZERO, LFS_FOUR, LFS_MINSUM })
+            CHECK(DecodesLikeLodepng(Encode(pixels, 19, 7, colorType, strategy, true)));
+    }
+}
+
+TEST(PngDecoder, CorruptedStreamsAreRejected)
+{
+    std::vector<byte> png = Encode(MakePixels(32, 32, 3), 32, 32, LCT_RGB, LFS_MINSUM);
+    PngInfo info;
+    REQUIRE(ReadPngInfo(png.data(), png.size(), info));
+    std::vector<byte> decoded(32 * 32 * 4);
+    // Cut in the middle of the image data
+    CHECK(!DecodePng(png.data(), png.size() / 2, info, decoded.data(), 32 * 4));
+    // A pitch shorter than a row
+    CHECK(!DecodePng(png.data(), png.size(), info, decoded.data(), 32 * 4 - 1));
+}
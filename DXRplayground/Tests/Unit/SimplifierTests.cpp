@@ -0,0 +1,80 @@
+#include "Test.h"
+#include "TestMeshes.h"
+
+#include "DXrenderer/Geometry/Simplifier.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+TEST(Simplifier, IsDeterministic)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(64, 128, vertices, indices);
+
+    std::vector<UINT> first;
+    std::vector<UINT> second;
+    float firstError = SimplifyMesh(vertices, indices, indices.size() / 4, FLT_MAX, first);
+    float secondError = SimplifyMesh(vertices, indices, indices.size() / 4, FLT_MAX, second);
+    CHECK(first == second);
+    CHECK_EQ(firstError, secondError);
+}
+
+TEST(Simplifier, ReachesTargetOnClosedMesh)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(64, 128, vertices, indices);
+
+    std::vector<UINT> result;
+    size_t target = indices.size() / 4 / 3 * 3;
+    float error = SimplifyMesh(vertices, indices, target, FLT_MAX, result);
+    CHECK(result.size() <= target);
+    CHECK(result.size() % 3 == 0);
+    CHECK(error > 0.0f && error < 0.1f);
+    for (UINT i : result)
+        CHECK(i < vertices.size());
+    for (size_t i = 0; i < result.size(); i += 3)
+        CHECK(result[i] != result[i + 1] && result[i + 1] != result[i + 2] && result[i] != result[i + 2]);
+}
+
+TEST(Simplifier, StopsAtMaxError)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildSphere(64, 128, vertices, indices);
+
+    std::vector<UINT> result;
+    float error = SimplifyMesh(vertices, indices, 0, 1e-4f, result);
+    CHECK(error <= 1e-4f);
+    CHECK(result.size() < indices.size());
+    CHECK(!result.empty());
+}
+
+TEST(Simplifier, FlatInteriorCollapsesWithoutError)
+{
+    std::vector<Vertex> vertices;
+    std::vector<UINT> indices;
+    BuildGrid(32, vertices, indices);
+
+    std::vector<UINT> result;
+    float error = SimplifyMesh(vertices, indices, 0, 1e-6f, result);
+    CHECK_NEAR(error, 0.0f, 1e-6f);
+    CHECK(result.size() < indices.size() / 2);
+    // Open borders stay where they are
+    for (UINT i : result)
+    {
+        const Vertex& v = vertices[i];
+        CHECK(v.Pos.x >= 0.0f && v.Pos.x <= 1.0f && v.Pos.z >= 0.0f && v.Pos.z <= 1.0f);
+    }
+}
+
+TEST(Simplifier, SelectLodByProjectedError)
+{
+    std::vector<MeshLod> lods = { { 0, 300, 0.0f }, { 300, 150, 0.01f }, { 450, 60, 0.1f } };
+    // 0.01 at distance 1 is 10 pixels with a scale of 1000
+    CHECK_EQ(SelectLod(lods, 1.0f, 1000.0f, 1.0f), 0u);
+    CHECK_EQ(SelectLod(lods, 20.0f, 1000.0f, 1.0f), 1u);
+    CHECK_EQ(SelectLod(lods, 200.0f, 1000.0f, 1.0f), 2u);
+    CHECK_EQ(SelectLod(lods, 20.0f, 1000.0f, 0.1f), 0u);
+}
@@ -0,0 +1,192 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "DXrenderer/Textures/PngDecoder.h"
+#include "DXrenderer/Textures/StagingLayout.h"
+#include "External/lodepng/lodepng.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+constexpr byte Padding = 0xcd;
+
+struct ExpectedFootprint
+{
+    UINT64 Offset;
+    UINT Width;
+    UINT Height;
+    UINT RowPitch;
+    UINT RowsCount;
+    UINT64 RowSize;
+};
+
+void CheckLayout(const StagingLayout& layout, const std::vector<ExpectedFootprint>& expected, UINT64 totalSize)
+{
+    REQUIRE(layout.Footprints.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = layout.Footprints[i];
+        CHECK_EQ(footprint.Offset, expected[i].Offset);
+        CHECK_EQ(footprint.Footprint.Width, expected[i].Width);
+        CHECK_EQ(footprint.Footprint.Height, expected[i].Height);
+        CHECK_EQ(footprint.Footprint.Depth, 1u);
+        CHECK_EQ(footprint.Footprint.RowPitch, expected[i].RowPitch);
+        CHECK_EQ(layout.RowsCount[i], expected[i].RowsCount);
+        CHECK_EQ(layout.RowSizes[i], expected[i].RowSize);
+    }
+    CHECK_EQ(layout.TotalSize, totalSize);
+}
+
+// Every byte outside the rows of the span still holds the padding value
+bool IsPaddingUntouched(const std::vector<byte>& memory, const StagingSpan& span)
+{
+    for (size_t i = 0; i < memory.size(); ++i)
+    {
+        size_t offset = i - size_t(span.Data - memory.data());
+        bool inRows = memory.data() + i >= span.Data && offset / span.RowPitch < span.RowsCount && offset % span.RowPitch < span.RowSize;
+        if (!inRows && memory[i] != Padding)
+            return false;
+    }
+    return true;
+}
+
+bool RowsMatch(const StagingSpan& span, const byte* packed)
+{
+    for (UINT row = 0; row < span.RowsCount; ++row)
+    {
+        if (memcmp(span.Data + row * span.RowPitch, packed + row * span.RowSize, span.RowSize) != 0)
+            return false;
+    }
+    return true;
+}
+
+std::vector<byte> EncodePng(UINT width, UINT height, UINT bitDepth, bool interlaced)
+{
+    std::vector<byte> pixels(size_t(width) * height * 4 * (bitDepth / 8));
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<byte>(i * 7 + i / 13);
+    lodepng::State state;
+    state.encoder.auto_convert = 0;
+    state.info_raw.colortype = LCT_RGBA;
+    state.info_raw.bitdepth = bitDepth;
+    state.info_png.color.colortype = LCT_RGBA;
+    state.info_png.color.bitdepth = bitDepth;
+    state.info_png.interlace_method = interlaced ? 1 : 0;
+    std::vector<byte> png;
+    lodepng::encode(png, pixels.data(), width, height, state);
+    return png;
+}
+}
+
+// Expected values are the ones GetCopyableFootprints returns for the same descriptions
+TEST(StagingLayout, Footprints)
+{
+    CheckLayout(ComputeStagingLayout(DXGI_FORMAT_R8G8B8A8_UNORM, 100, 50, 7),
+        {
+            { 0, 100, 50, 512, 50, 400 },
+            { 25600, 50, 25, 256, 25, 200 },
+            { 32256, 25, 12, 256, 12, 100 },
+            { 35328, 12, 6, 256, 6, 48 },
+            { 36864, 6, 3, 256, 3, 24 },
+            { 37888, 3, 1, 256, 1, 12 },
+            { 38400, 1, 1, 256, 1, 4 },
+        }, 38404);
+
+    // Block compressed footprints cover whole blocks, rows are rows of blocks
+    CheckLayout(ComputeStagingLayout(DXGI_FORMAT_BC1_UNORM, 130, 66, 3),
+        {
+            { 0, 132, 68, 512, 17, 264 },
+            { 8704, 68, 36, 256, 9, 136 },
+            { 11264, 32, 16, 256, 4, 64 },
+        }, 12096);
+    CheckLayout(ComputeStagingLayout(DXGI_FORMAT_BC7_UNORM, 8, 8, 4),
+        {
+            { 0, 8, 8, 256, 2, 32 },
+            { 512, 4, 4, 256, 1, 16 },
+            { 1024, 4, 4, 256, 1, 16 },
+            { 1536, 4, 4, 256, 1, 16 },
+        }, 1552);
+
+    // Rows that are already aligned aren't padded
+    CheckLayout(ComputeStagingLayout(DXGI_FORMAT_R32G32B32A32_FLOAT, 64, 64, 1), { { 0, 64, 64, 1024, 64, 1024 } }, 65536);
+}
+
+TEST(StagingLayout, CopiesStayInTheRows)
+{
+    for (UINT width : { 64u, 100u })
+    {
+        StagingLayout layout = ComputeStagingLayout(DXGI_FORMAT_R8G8B8A8_UNORM, width, 9, 2);
+        std::vector<byte> memory(size_t(layout.TotalSize) + 64, Padding);
+        for (UINT level = 0; level < 2; ++level)
+        {
+            StagingSpan span = GetStagingSpan(layout, memory.data(), level);
+            std::vector<byte> packed(size_t(span.RowSize) * span.RowsCount);
+            for (size_t i = 0; i < packed.size(); ++i)
+                packed[i] = static_cast<byte>(i % 251); // Never the padding value
+            CopyToStaging(packed.data(), span);
+            CHECK(RowsMatch(span, packed.data()));
+        }
+        // Both mips written, everything else is padding
+        StagingSpan first = GetStagingSpan(layout, memory.data(), 0);
+        StagingSpan second = GetStagingSpan(layout, memory.data(), 1);
+        for (UINT level = 0; level < 2; ++level)
+        {
+            const StagingSpan& span = level == 0 ? first : second;
+            for (UINT row = 0; row < span.RowsCount; ++row)
+                memset(span.Data + row * span.RowPitch, Padding, size_t(span.RowSize));
+        }
+        CHECK(std::all_of(memory.begin(), memory.end(), [](byte value) { return value == Padding; }));
+    }
+}
+
+TEST(StagingLayout, PngsDecodeIntoTheSpan)
+{
+    struct Case
+    {
+        UINT BitDepth;
+        bool Interlaced;
+        UINT Copies; // Fast path in place, or lodepng to memory and a copy
+    };
+    for (const Case& test : { Case{ 8, false, 1 }, Case{ 16, false, 2 }, Case{ 8, true, 2 } })
+    {
+        std::vector<byte> png = EncodePng(37, 21, test.BitDepth, test.Interlaced);
+        std::vector<byte> expected;
+        UINT width = 0;
+        UINT height = 0;
+        REQUIRE(lodepng::decode(expected, width, height, png) == 0);
+
+        PngInfo info;
+        REQUIRE(ReadPngInfo(png.data(), png.size(), info));
+        StagingLayout layout = ComputeStagingLayout(DXGI_FORMAT_R8G8B8A8_UNORM, info.Width, info.Height, 1);
+        std::vector<byte> memory(size_t(layout.TotalSize), Padding);
+        StagingSpan span = GetStagingSpan(layout, memory.data(), 0);
+        CHECK_EQ(DecodePngToStaging(png.data(), png.size(), info, span), test.Copies);
+        CHECK(RowsMatch(span, expected.data()));
+        CHECK(IsPaddingUntouched(memory, span));
+    }
+
+    // A span for another image or a broken file
+    std::vector<byte> png = EncodePng(16, 16, 8, false);
+    PngInfo info;
+    REQUIRE(ReadPngInfo(png.data(), png.size(), info));
+    StagingLayout layout = ComputeStagingLayout(DXGI_FORMAT_R8G8B8A8_UNORM, 16, 8, 1);
+    std::vector<byte> memory(size_t(layout.TotalSize), Padding);
+    CHECK_EQ(DecodePngToStaging(png.data(), png.size(), info, GetStagingSpan(layout, memory.data(), 0)), 0u);
+    layout = ComputeStagingLayout(DXGI_FORMAT_R8G8B8A8_UNORM, 16, 16, 1);
+    memory.assign(size_t(layout.TotalSize), Padding);
+    CHECK_EQ(DecodePngToStaging(png.data(), png.size() / 2, info, GetStagingSpan(layout, memory.data(), 0)), 0u);
+}
+
+TEST(StagingLayout, CopiesPerTexel)
+{
+    StagingCopies copies;
+    CHECK_EQ(copies.GetCopiesPerTexel(), 0.0f);
+    copies.Add(1024 * 1024, 1); // A PNG decoded in place
+    copies.Add(512 * 512, 2); // A decoded image copied to the upload buffer
+    copies.Add(256 * 256, 1); // A texture cache hit
+    CHECK_EQ(copies.TexelsCount, 1024ull * 1024 + 512 * 512 + 256 * 256);
+    CHECK_NEAR(copies.GetCopiesPerTexel(), float(1024 * 1024 + 2 * 512 * 512 + 256 * 256) / float(1024 * 1024 + 512 * 512 + 256 * 256), 1e-6f);
+}
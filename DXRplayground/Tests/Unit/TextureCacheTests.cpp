@@ -0,0 +1,142 @@
+#include "Test.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "DXrenderer/Textures/MipBuilder.h"
+#include "DXrenderer/Textures/TextureCache.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+std::string GetTestDirectory(const char* name)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "DXRplaygroundTests" / name;
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    return directory.string() + "/";
+}
+
+DecodedImage GetImage(DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels)
+{
+    DecodedImage image;
+    image.Format = format;
+    image.Width = width;
+    image.Height = height;
+    image.MipLevels = mipLevels;
+    image.Data.resize(image.GetMipOffset(mipLevels));
+    for (size_t i = 0; i < image.Data.size(); ++i)
+        image.Data[i] = static_cast<byte>(i * 13 + 1);
+    return image;
+}
+
+std::vector<byte> ReadFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<byte>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string& path, const std::vector<byte>& data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+TextureCacheMip* GetMips(std::vector<byte>& entry)
+{
+    return reinterpret_cast<TextureCacheMip*>(entry.data() + sizeof(TextureCacheHeader));
+}
+}
+
+TEST(TextureCache, StoredImagesLoadBack)
+{
+    TextureCache cache(GetTestDirectory("RoundTrip"));
+    const DecodedImage images[] = { GetImage(DXGI_FORMAT_R8G8B8A8_UNORM, 16, 8, 5), GetImage(DXGI_FORMAT_BC1_UNORM, 12, 20, 3),
+        GetImage(DXGI_FORMAT_R16G16B16A16_FLOAT, 7, 3, 1) };
+    for (UINT64 key = 1; key <= 3; ++key)
+    {
+        const DecodedImage& image = images[key - 1];
+        REQUIRE(cache.Store(key, image));
+        DecodedImage loaded;
+        REQUIRE(cache.Load(key, loaded));
+        CHECK_EQ(loaded.Width, image.Width);
+        CHECK_EQ(loaded.Height, image.Height);
+        CHECK_EQ(loaded.Format, image.Format);
+        CHECK_EQ(loaded.MipLevels, image.MipLevels);
+        CHECK_EQ(loaded.GetPixelsSize(), image.Data.size());
+        CHECK(memcmp(loaded.GetPixels(), image.Data.data(), image.Data.size()) == 0);
+    }
+    DecodedImage missing;
+    CHECK(!cache.Load(4, missing));
+}
+
+TEST(TextureCache, CorruptedEntriesAreRejected)
+{
+    std::string directory = GetTestDirectory("Corrupted");
+    TextureCache cache(directory);
+    const UINT64 key = 42;
+    REQUIRE(cache.Store(key, GetImage(DXGI_FORMAT_R8G8B8A8_UNORM, 16, 16, 5)));
+    const std::vector<byte> valid = ReadFile(cache.GetEntryPath(key));
+    REQUIRE(valid.size() > sizeof(TextureCacheHeader));
+
+    auto rejects = [&](std::vector<byte> entry)
+    {
+        WriteFile(cache.GetEntryPath(key), entry);
+        DecodedImage image;
+        return !cache.Load(key, image);
+    };
+    auto withHeader = [&](void (*change)(TextureCacheHeader&))
+    {
+        std::vector<byte> entry = valid;
+        change(*reinterpret_cast<TextureCacheHeader*>(entry.data()));
+        return entry;
+    };
+    auto withMips = [&](void (*change)(TextureCacheMip*))
+    {
+        std::vector<byte> entry = valid;
+        change(GetMips(entry));
+        return entry;
+    };
+
+    CHECK(!rejects(valid));
+    CHECK(rejects(std::vector<byte>(valid.begin(), valid.end() - 1))); // Truncated pixels
+    CHECK(rejects(std::vector<byte>(valid.begin(), valid.begin() + sizeof(TextureCacheHeader) + 8))); // Truncated mip table
+    CHECK(rejects(withHeader([](TextureCacheHeader& h) { h.Width = 32; }))); // Mip sizes don't match the description
+    CHECK(rejects(withHeader([](TextureCacheHeader& h) { h.Format = DXGI_FORMAT_R8_UNORM; })));
+    CHECK(rejects(withHeader([](TextureCacheHeader& h) { h.Format = DXGI_FORMAT_UNKNOWN; })));
+    CHECK(rejects(withHeader([](TextureCacheHeader& h) { h.Height = 0; })));
+    CHECK(rejects(withHeader([](TextureCacheHeader& h) { h.MipCount = 4; }))); // The payload is bigger than the chain
+    CHECK(rejects(withHeader([](TextureCacheHeader& h) { h.Key = 43; })));
+    CHECK(rejects(withMips([](TextureCacheMip* mips) { mips[2].Size -= 4; mips[3].Offset -= 4; mips[4].Offset -= 4; })));
+    CHECK(rejects(withMips([](TextureCacheMip* mips) { mips[4].Size = 0; })));
+    CHECK(rejects(withMips([](TextureCacheMip* mips) { mips[1].Offset += 4; })));
+    CHECK(rejects(withMips([](TextureCacheMip* mips) { for (UINT i = 0; i < 5; ++i) mips[i].Offset = ~0ull - 8; })));
+    // Oversized: a chain longer than the full one
+    std::vector<byte> longer = valid;
+    reinterpret_cast<TextureCacheHeader*>(longer.data())->MipCount = 6;
+    longer.insert(longer.begin() + sizeof(TextureCacheHeader) + sizeof(TextureCacheMip) * 5, sizeof(TextureCacheMip), 0);
+    CHECK(rejects(longer));
+}
+
+TEST(TextureCache, KeysFollowTheContent)
+{
+    std::string directory = GetTestDirectory("Keys");
+    std::filesystem::create_directories(directory);
+    WriteFile(directory + "a.png", { 1, 2, 3, 4 });
+    WriteFile(directory + "b.png", { 1, 2, 3, 4 });
+    WriteFile(directory + "c.png", { 1, 2, 3, 5 });
+    WriteFile(directory + "a.exr", { 1, 2, 3, 4 });
+
+    UINT64 source = TextureCache::GetSourceHash(directory + "a.png");
+    CHECK(source != 0);
+    CHECK_EQ(TextureCache::GetSourceHash(directory + "b.png"), source); // Renamed or copied
+    CHECK(TextureCache::GetSourceHash(directory + "c.png") != source); // Edited
+    CHECK(TextureCache::GetSourceHash(directory + "a.exr") != source); // Another decoder
+    CHECK_EQ(TextureCache::GetSourceHash(directory + "missing.png"), 0ull);
+
+    CHECK_EQ(TextureCache::GetKey(directory + "a.png", 7), TextureCache::GetKey(source, 7));
+    CHECK(TextureCache::GetKey(source, 7) != TextureCache::GetKey(source, 8));
+    CHECK_EQ(TextureCache::GetKey(0ull, 7), 0ull);
+}
@@ -0,0 +1,143 @@
+#include "Test.h"
+
+#include <random>
+#include <vector>
+
+#include "DXrenderer/Textures/TexturePacker.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+std::vector<PackedTextureDesc> MakeRandomTextures(UINT count, UINT seed)
+{
+    std::mt19937 random(seed);
+    std::vector<PackedTextureDesc> textures(count);
+    for (auto& texture : textures)
+    {
+        texture.Format = random() % 4 == 0 ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+        texture.Width = 8 * (1 + random() % 64);
+        texture.Height = 8 * (1 + random() % 64);
+        texture.MipLevels = 1 + random() % 4;
+    }
+    return textures;
+}
+
+// Padded rects inside their pages and apart from each other
+void CheckPlacements(const std::vector<PackedTextureDesc>& textures, const TexturePacking& packing, UINT padding)
+{
+    for (const AtlasPage& page : packing.Pages)
+    {
+        for (UINT a : page.Textures)
+        {
+            const TexturePlacement& placement = packing.Placements[a];
+            CHECK(placement.X >= padding && placement.Y >= padding);
+            CHECK(placement.X + textures[a].Width + padding <= page.Width);
+            CHECK(placement.Y + textures[a].Height + padding <= page.Height);
+            for (UINT b : page.Textures)
+            {
+                if (a == b)
+                    continue;
+                const TexturePlacement& other = packing.Placements[b];
+                bool apart = placement.X + textures[a].Width + 2 * padding <= other.X || other.X + textures[b].Width + 2 * padding <= placement.X ||
+                    placement.Y + textures[a].Height + 2 * padding <= other.Y || other.Y + textures[b].Height + 2 * padding <= placement.Y;
+                CHECK(apart);
+            }
+        }
+    }
+}
+}
+
+TEST(TexturePacker, PackingIsDeterministic)
+{
+    std::vector<PackedTextureDesc> textures = MakeRandomTextures(300, 5);
+    TexturePackingOptions options;
+    TexturePacking first = PackTextures(textures, options);
+    TexturePacking second = PackTextures(textures, options);
+    REQUIRE(first.Pages.size() > 1);
+    REQUIRE(first.Pages.size() == second.Pages.size());
+    for (size_t i = 0; i < first.Pages.size(); ++i)
+    {
+        CHECK_EQ(first.Pages[i].Width, second.Pages[i].Width);
+        CHECK_EQ(first.Pages[i].Height, second.Pages[i].Height);
+        CHECK(first.Pages[i].Textures == second.Pages[i].Textures);
+    }
+    for (size_t i = 0; i < textures.size(); ++i)
+    {
+        CHECK_EQ(first.Placements[i].Page, second.Placements[i].Page);
+        CHECK_EQ(first.Placements[i].X, second.Placements[i].X);
+        CHECK_EQ(first.Placements[i].Y, second.Placements[i].Y);
+    }
+    CheckPlacements(textures, first, options.Padding);
+
+    // A page only holds textures that keep their whole chain
+    for (const AtlasPage& page : first.Pages)
+    {
+        for (UINT texture : page.Textures)
+        {
+            CHECK_EQ(textures[texture].Format, page.Format);
+            CHECK_EQ(textures[texture].MipLevels, page.MipLevels);
+        }
+    }
+}
+
+TEST(TexturePacker, WastedAreaIsReported)
+{
+    TexturePackingOptions options;
+    // Four 80x80 padded rects in a row fill their page
+    std::vector<PackedTextureDesc> textures(4, { DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1 });
+    TexturePacking packing = PackTextures(textures, options);
+    REQUIRE(packing.Pages.size() == 1);
+    CHECK_EQ(packing.Pages[0].Width * packing.Pages[0].Height, 4u * 80 * 80);
+    CHECK_EQ(packing.Stats.TextureTexels, 4ull * 64 * 64);
+    CHECK_EQ(packing.Stats.PaddingTexels, 4ull * (80 * 80 - 64 * 64));
+    CHECK_EQ(packing.Stats.GetWastedFraction(), 0.0f);
+
+    // The random set leaves gaps, they are whatever the page holds beyond the padded rects
+    textures = MakeRandomTextures(300, 9);
+    packing = PackTextures(textures, options);
+    UINT64 paddedTexels = 0;
+    UINT64 pageTexels = 0;
+    for (const AtlasPage& page : packing.Pages)
+    {
+        pageTexels += UINT64(page.Width) * page.Height;
+        for (UINT texture : page.Textures)
+            paddedTexels += UINT64(textures[texture].Width + 2 * options.Padding) * (textures[texture].Height + 2 * options.Padding);
+    }
+    CHECK_EQ(packing.Stats.PageTexels, pageTexels);
+    CHECK_EQ(packing.Stats.TextureTexels + packing.Stats.PaddingTexels, paddedTexels);
+    float wasted = packing.Stats.GetWastedFraction();
+    CHECK(wasted > 0.0f && wasted < 0.5f);
+    CHECK_EQ(wasted, float(pageTexels - paddedTexels) / float(pageTexels));
+    CHECK_EQ(packing.Stats.GetResourcesCount(), packing.Stats.TexturesCount - packing.Stats.PackedCount + packing.Stats.PagesCount);
+}
+
+TEST(TexturePacker, TexturesThatWouldLoseMipsStayOnTheirOwn)
+{
+    // Padding 8 keeps 4 mips of RGBA and 2 of BC1
+    TexturePackingOptions options;
+    std::vector<PackedTextureDesc> textures = {
+        { DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 7 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 7 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 4 },
+        { DXGI_FORMAT_R8G8B8A8_UNORM, 64, 128, 4 },
+        { DXGI_FORMAT_BC1_UNORM, 64, 64, 3 },
+        { DXGI_FORMAT_BC1_UNORM, 64, 64, 3 },
+        { DXGI_FORMAT_BC1_UNORM, 64, 64, 2 },
+        { DXGI_FORMAT_BC1_UNORM, 64, 64, 2 },
+    };
+    TexturePacking packing = PackTextures(textures, options);
+    for (UINT i : { 0u, 1u, 4u, 5u })
+        CHECK_EQ(packing.Placements[i].Page, InvalidAtlasPage);
+    REQUIRE(packing.Pages.size() == 2);
+    CHECK_EQ(packing.Pages[0].MipLevels, 4u);
+    CHECK_EQ(packing.Pages[1].MipLevels, 2u);
+    CHECK_EQ(packing.Stats.PackedCount, 4u);
+    CHECK_EQ(packing.Stats.GetResourcesCount(), 6u);
+
+    // A larger padding keeps more of them
+    options.Padding = 64;
+    packing = PackTextures(textures, options);
+    CHECK_EQ(packing.Stats.PackedCount, 8u);
+    CHECK_EQ(packing.Stats.PagesCount, 4u);
+}
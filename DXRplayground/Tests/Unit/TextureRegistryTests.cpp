@@ -0,0 +1,95 @@
+#include "Test.h"
+
+#include "DXrenderer/Textures/TextureRegistry.h"
+
+using namespace DirectxPlayground;
+
+TEST(TextureRegistry, LastReleaseUnregisters)
+{
+    TextureRegistry registry;
+    registry.Add(0x1234, 7, 1000);
+    UINT resourceIdx = 0;
+    CHECK(registry.AddReference(0x1234, resourceIdx));
+    CHECK_EQ(resourceIdx, 7u);
+    CHECK(registry.AddReference(0x1234, resourceIdx));
+    CHECK_EQ(registry.GetRefCount(7), 3u);
+    CHECK(!registry.AddReference(0x5678, resourceIdx));
+
+    TextureRegistryStats stats = registry.GetStats();
+    CHECK_EQ(stats.TexturesCount, size_t(1));
+    CHECK_EQ(stats.ReferencesCount, size_t(3));
+    CHECK_EQ(stats.Bytes, 1000ull);
+    CHECK_EQ(stats.DedupedBytes, 2000ull);
+
+    CHECK(!registry.Release(7));
+    CHECK(!registry.Release(7));
+    CHECK(registry.IsRegistered(7));
+    CHECK(registry.Release(7));
+    CHECK(!registry.IsRegistered(7));
+    CHECK_EQ(registry.GetRefCount(7), 0u);
+    CHECK(!registry.AddReference(0x1234, resourceIdx));
+
+    // The deduplicated bytes are counted since the start
+    stats = registry.GetStats();
+    CHECK_EQ(stats.TexturesCount, size_t(0));
+    CHECK_EQ(stats.ReferencesCount, size_t(0));
+    CHECK_EQ(stats.Bytes, 0ull);
+    CHECK_EQ(stats.DedupedBytes, 2000ull);
+}
+
+TEST(TextureRegistry, PagesAreReleasedOncePerFile)
+{
+    TextureRegistry registry;
+    registry.Add(1, 0, 4096, 3);
+    registry.Add(2, 1, 512);
+    CHECK_EQ(registry.GetStats().ReferencesCount, size_t(4));
+    CHECK(!registry.Release(0));
+    CHECK(registry.Release(1));
+    CHECK(!registry.Release(0));
+    CHECK(registry.Release(0));
+    CHECK_EQ(registry.GetStats().TexturesCount, size_t(0));
+}
+
+TEST(TextureRegistry, ReleasedIndicesAreRegisteredAgain)
+{
+    TextureRegistry registry;
+    registry.Add(1, 5, 100);
+    CHECK(registry.Release(5));
+    // A freed resource index goes to the next texture, under another key
+    registry.Add(2, 5, 200);
+    UINT resourceIdx = 0;
+    CHECK(!registry.AddReference(1, resourceIdx));
+    CHECK(registry.AddReference(2, resourceIdx));
+    CHECK_EQ(resourceIdx, 5u);
+    CHECK_EQ(registry.GetRefCount(5), 2u);
+    CHECK_EQ(registry.GetStats().Bytes, 200ull);
+}
+
+// GltfViewer's owners: the model with a repeated image, the environment map with its equirect source. Nothing stays after
+// the teardown releases them all, the environment map's reference is the last one.
+TEST(TextureRegistry, ViewerTeardownReleasesEveryOwner)
+{
+    TextureRegistry registry;
+    const UINT baseColor = 0;
+    const UINT normals = 1;
+    const UINT equirect = 2;
+    registry.Add(10, baseColor, 4096, 2);
+    registry.Add(11, normals, 2048);
+    registry.Add(12, equirect, 1 << 20);
+    CHECK_EQ(registry.GetStats().ReferencesCount, size_t(4));
+
+    // Model::ReleaseTextures
+    for (UINT texture : { baseColor, baseColor, normals })
+        registry.Release(texture);
+    TextureRegistryStats stats = registry.GetStats();
+    CHECK_EQ(stats.TexturesCount, size_t(1));
+    CHECK_EQ(stats.Bytes, UINT64(1 << 20));
+    CHECK(registry.IsRegistered(equirect));
+
+    // EnvironmentMap::ReleaseTextures
+    CHECK(registry.Release(equirect));
+    stats = registry.GetStats();
+    CHECK_EQ(stats.TexturesCount, size_t(0));
+    CHECK_EQ(stats.ReferencesCount, size_t(0));
+    CHECK_EQ(stats.Bytes, 0ull);
+}
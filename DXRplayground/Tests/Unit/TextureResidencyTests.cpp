@@ -0,0 +1,155 @@
+#include "Test.h"
+
+#include <vector>
+
+#include "DXrenderer/Textures/TextureResidency.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+// Records the calls, in order
+class FakeResidencyBackend : public ITextureResidencyBackend
+{
+public:
+    void Evict(UINT texture) override
+    {
+        Evictions.push_back(texture);
+    }
+
+    void SetResidentMip(UINT texture, UINT mostDetailedMip) override
+    {
+        ResidentMips.push_back({ texture, mostDetailedMip });
+    }
+
+    std::vector<UINT> Evictions;
+    std::vector<std::pair<UINT, UINT>> ResidentMips;
+};
+
+constexpr ResidentTextureDesc Texture256 = { DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 1, 9 };
+}
+
+TEST(TextureResidency, RemovedSlotsAreReused)
+{
+    FakeResidencyBackend backend;
+    TextureResidency residency(backend, 1ull << 30);
+    UINT first = residency.AddTexture(Texture256);
+    UINT second = residency.AddTexture(Texture256);
+    UINT third = residency.AddTexture({ DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, 7 });
+    UINT64 bytes = residency.GetResidentBytes(first);
+    residency.SetEvictable(second);
+    residency.AddUploadBytes(second, 1000);
+
+    residency.RemoveTexture(second);
+    TextureResidencyStats stats = residency.GetStats();
+    CHECK_EQ(stats.TexturesCount, 2u);
+    CHECK_EQ(stats.EvictableCount, 0u);
+    CHECK_EQ(stats.UploadBytes, 0ull);
+    CHECK_EQ(stats.ResidentBytes, bytes + residency.GetResidentBytes(third));
+
+    // The slot comes back pinned and without the uploads of the removed texture
+    UINT fourth = residency.AddTexture(Texture256);
+    CHECK_EQ(fourth, second);
+    stats = residency.GetStats();
+    CHECK_EQ(stats.TexturesCount, 3u);
+    CHECK_EQ(stats.EvictableCount, 0u);
+    CHECK_EQ(stats.UploadBytes, 0ull);
+    CHECK_EQ(residency.AddTexture(Texture256), 3u);
+}
+
+TEST(TextureResidency, RemovedTexturesAreLeftAlone)
+{
+    FakeResidencyBackend backend;
+    TextureResidency residency(backend, 1ull << 30);
+    std::vector<UINT> textures;
+    for (UINT i = 0; i < 4; ++i)
+    {
+        textures.push_back(residency.AddTexture(Texture256));
+        residency.SetEvictable(textures.back());
+    }
+    residency.Update();
+    residency.Update();
+
+    // Nothing fits, every texture but the removed one is demoted and then evicted
+    residency.RemoveTexture(textures[1]);
+    residency.SetBudget(0);
+    residency.Update();
+    CHECK_EQ(backend.ResidentMips.size(), size_t(3));
+    CHECK_EQ(backend.Evictions.size(), size_t(3));
+    for (const auto& [texture, mip] : backend.ResidentMips)
+        CHECK(texture != textures[1]);
+    for (UINT texture : backend.Evictions)
+        CHECK(texture != textures[1]);
+    CHECK_EQ(residency.GetStats().ResidentBytes, 0ull);
+}
+
+TEST(TextureResidency, DemotesThenEvictsInLruOrder)
+{
+    FakeResidencyBackend backend;
+    TextureResidency residency(backend, 1ull << 30);
+    UINT a = residency.AddTexture(Texture256);
+    UINT b = residency.AddTexture(Texture256);
+    UINT c = residency.AddTexture(Texture256);
+    for (UINT texture : { a, b, c })
+        residency.SetEvictable(texture);
+    // Down to 64x64
+    const UINT64 fullBytes = residency.GetResidentBytes(a);
+    const UINT64 demotedBytes = GetTextureBytes(DXGI_FORMAT_R8G8B8A8_UNORM, 64, 64, 1, 7);
+
+    // Used in the frames a, b, c
+    for (UINT texture : { a, b, c })
+    {
+        residency.Update();
+        residency.MarkUsed(texture);
+    }
+    residency.SetBudget(2 * fullBytes + demotedBytes);
+    residency.Update();
+    REQUIRE(backend.ResidentMips.size() == 1);
+    CHECK(backend.ResidentMips[0] == std::make_pair(a, 2u));
+    CHECK(backend.Evictions.empty());
+
+    // Every candidate is demoted before the first eviction, c was used by the last frame and stays
+    residency.MarkUsed(c);
+    residency.SetBudget(fullBytes + demotedBytes);
+    residency.Update();
+    REQUIRE(backend.ResidentMips.size() == 2);
+    CHECK(backend.ResidentMips[1] == std::make_pair(b, 2u));
+    REQUIRE(backend.Evictions.size() == 1);
+    CHECK_EQ(backend.Evictions[0], a);
+    CHECK_EQ(residency.GetResidentMip(c), 0u);
+    CHECK_EQ(residency.GetStats().ResidentBytes, fullBytes + demotedBytes);
+}
+
+TEST(TextureResidency, UseRestoresRightAway)
+{
+    FakeResidencyBackend backend;
+    TextureResidency residency(backend, 0);
+    UINT a = residency.AddTexture(Texture256);
+    UINT b = residency.AddTexture(Texture256);
+    residency.SetEvictable(a);
+    residency.SetEvictable(b);
+    residency.Update();
+    residency.Update();
+    CHECK(residency.IsEvicted(a) && residency.IsEvicted(b));
+    size_t residentMipsCount = backend.ResidentMips.size();
+
+    // The restore goes out with the use, not with the next update
+    residency.MarkUsed(a);
+    REQUIRE(backend.ResidentMips.size() == residentMipsCount + 1);
+    CHECK(backend.ResidentMips.back() == std::make_pair(a, 0u));
+    CHECK(!residency.IsEvicted(a));
+    CHECK_EQ(residency.GetResidentMip(a), 0u);
+    residency.MarkUsed(a);
+    CHECK_EQ(backend.ResidentMips.size(), residentMipsCount + 1);
+    CHECK_EQ(residency.GetStats().Restores, 1ull);
+
+    // The next update leaves it alone even over the budget, then it goes again once it isn't used
+    size_t evictionsCount = backend.Evictions.size();
+    residency.Update();
+    CHECK_EQ(backend.Evictions.size(), evictionsCount);
+    CHECK_EQ(backend.ResidentMips.size(), residentMipsCount + 1);
+    residency.Update();
+    CHECK(backend.ResidentMips.back() == std::make_pair(a, 2u));
+    CHECK(backend.Evictions.back() == a);
+    CHECK(residency.IsEvicted(a));
+}
@@ -0,0 +1,181 @@
+#include "Test.h"
+
+#include <vector>
+
+#include "DXrenderer/Textures/TextureStreamer.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+// Loads finish when the test says so
+class FakeStreamingBackend : public ITextureStreamingBackend
+{
+public:
+    void BeginLoad(UINT texture, UINT mostDetailedMip) override
+    {
+        Loads.push_back(texture);
+        LoadMips.push_back(mostDetailedMip);
+    }
+
+    bool IsLoadDone(UINT texture) override
+    {
+        return LoadsDone;
+    }
+
+    void Evict(UINT texture, UINT mostDetailedMip) override
+    {
+        Evictions.push_back(texture);
+    }
+
+    std::vector<UINT> Loads;
+    std::vector<UINT> LoadMips;
+    std::vector<UINT> Evictions;
+    bool LoadsDone = false;
+};
+
+const StreamedTextureDesc TestDesc = { DXGI_FORMAT_R8G8B8A8_UNORM, 1024, 1024, 11 };
+}
+
+TEST(TextureStreamer, RemovedTexturesStopCounting)
+{
+    FakeStreamingBackend backend;
+    TextureStreamer streamer(backend, 64ull * 1024 * 1024);
+    const StreamedTextureDesc desc = { DXGI_FORMAT_R8G8B8A8_UNORM, 1024, 1024, 11 };
+    UINT first = streamer.AddTexture(desc);
+    UINT second = streamer.AddTexture(desc);
+    UINT64 tailBytes = streamer.GetChainSize(first, streamer.GetTailMip(first));
+    CHECK_EQ(streamer.GetStats().ResidentBytes, 2 * tailBytes);
+
+    // A load in flight goes with the texture
+    streamer.Request(first, 0.0f, 1.0f);
+    streamer.Update();
+    REQUIRE(backend.Loads.size() == 1);
+    CHECK_EQ(streamer.GetStats().LoadsInFlight, 1u);
+    streamer.RemoveTexture(first);
+    TextureStreamingStats stats = streamer.GetStats();
+    CHECK_EQ(stats.LoadsInFlight, 0u);
+    CHECK_EQ(stats.ResidentBytes, tailBytes);
+
+    backend.LoadsDone = true;
+    streamer.Update();
+    CHECK_EQ(streamer.GetStats().ResidentBytes, tailBytes);
+
+    // The index is reused with the tail of the new texture
+    UINT third = streamer.AddTexture({ DXGI_FORMAT_R8G8B8A8_UNORM, 256, 256, 9 });
+    CHECK_EQ(third, first);
+    CHECK_EQ(streamer.GetStats().ResidentBytes, tailBytes + streamer.GetChainSize(third, streamer.GetTailMip(third)));
+    CHECK_EQ(streamer.GetResidentMip(second), streamer.GetTailMip(second));
+}
+
+TEST(TextureStreamer, MissingDetailOnTheBiggestAreaLoadsFirst)
+{
+    FakeStreamingBackend backend;
+    TextureStreamer streamer(backend, 1024ull * 1024 * 1024);
+    // Area times the missing mips: 4, 12, 10, 8, 2, 1
+    const float mips[] = { 0.0f, 0.0f, 3.0f, 0.0f, 2.0f, 0.0f };
+    const float areas[] = { 1.0f, 3.0f, 10.0f, 2.0f, 1.0f, 0.25f };
+    for (UINT i = 0; i < 6; ++i)
+        streamer.AddTexture(TestDesc);
+    REQUIRE(streamer.GetTailMip(0) == 4);
+
+    auto request = [&]()
+    {
+        for (UINT i = 0; i < 6; ++i)
+            streamer.Request(i, mips[i], areas[i]);
+        streamer.Update();
+    };
+    request();
+    CHECK(backend.Loads == std::vector<UINT>({ 1, 2, 3, 0 }));
+    CHECK(backend.LoadMips == std::vector<UINT>({ 0, 3, 0, 0 }));
+    CHECK_EQ(streamer.GetStats().LoadsInFlight, TextureStreamer::MaxLoadsInFlight);
+
+    // The rest waits for a free slot
+    request();
+    CHECK_EQ(backend.Loads.size(), 4u);
+    backend.LoadsDone = true;
+    request();
+    CHECK(backend.Loads == std::vector<UINT>({ 1, 2, 3, 0, 4, 5 }));
+    CHECK_EQ(streamer.GetResidentMip(2), 3u);
+    request();
+    request();
+    CHECK_EQ(streamer.GetStats().LoadsInFlight, 0u);
+    CHECK_EQ(backend.Loads.size(), 6u);
+    CHECK(streamer.GetStats().FullQualityTime >= 0.0f);
+}
+
+TEST(TextureStreamer, LoadsStayWithinTheBudget)
+{
+    FakeStreamingBackend backend;
+    TextureStreamer streamer(backend, 7ull * 1024 * 1024 + 512 * 1024);
+    for (UINT i = 0; i < 3; ++i)
+        streamer.AddTexture(TestDesc);
+
+    // A full chain fits once, the others come in with less detail
+    for (UINT frame = 0; frame < 4; ++frame)
+    {
+        backend.LoadsDone = frame > 0;
+        for (UINT i = 0; i < 3; ++i)
+            streamer.Request(i, 0.0f, float(3 - i));
+        streamer.Update();
+        TextureStreamingStats stats = streamer.GetStats();
+        CHECK(stats.ResidentBytes <= stats.Budget);
+        CHECK(stats.WantedBytes > stats.Budget);
+    }
+    CHECK(backend.Loads == std::vector<UINT>({ 0, 1, 2 }));
+    CHECK(backend.LoadMips == std::vector<UINT>({ 0, 1, 2 }));
+    CHECK_EQ(streamer.GetResidentMip(0), 0u);
+    CHECK_EQ(streamer.GetResidentMip(1), 1u);
+    CHECK_EQ(streamer.GetResidentMip(2), 2u);
+    CHECK(backend.Evictions.empty());
+}
+
+TEST(TextureStreamer, LeastWantedMipsAreEvictedUnderPressure)
+{
+    FakeStreamingBackend backend;
+    const StreamedTextureDesc desc = TestDesc;
+    UINT64 fullBytes = 0;
+    UINT64 halfBytes = 0;
+    UINT64 tailBytes = 0;
+    {
+        TextureStreamer sizes(backend, 0);
+        UINT texture = sizes.AddTexture(desc);
+        fullBytes = sizes.GetChainSize(texture, 0);
+        halfBytes = sizes.GetChainSize(texture, 1);
+        tailBytes = sizes.GetChainSize(texture, sizes.GetTailMip(texture));
+    }
+    TextureStreamer streamer(backend, fullBytes + halfBytes + 2 * tailBytes);
+    UINT first = streamer.AddTexture(desc);
+    UINT second = streamer.AddTexture(desc);
+    UINT third = streamer.AddTexture(desc);
+
+    streamer.Request(first, 1.0f, 1.0f);
+    streamer.Request(second, 1.0f, 1.0f);
+    streamer.Update();
+    REQUIRE(backend.Loads.size() == 2);
+    backend.LoadsDone = true;
+
+    // The third one needs a full chain, evicting the unrequested second one is enough
+    streamer.Request(first, 2.0f, 4.0f);
+    streamer.Request(third, 0.0f, 1.0f);
+    streamer.Update();
+    CHECK(backend.Evictions == std::vector<UINT>({ second }));
+    CHECK_EQ(streamer.GetResidentMip(second), streamer.GetTailMip(second));
+    CHECK_EQ(streamer.GetResidentMip(first), 1u);
+    CHECK_EQ(backend.Loads.back(), third);
+    CHECK_EQ(backend.LoadMips.back(), 0u);
+    TextureStreamingStats stats = streamer.GetStats();
+    CHECK(stats.ResidentBytes <= stats.Budget);
+
+    // With the third one landed the budget is full, the first one gives up the mip it no longer wants
+    UINT fourth = streamer.AddTexture(desc);
+    streamer.Request(first, 2.0f, 4.0f);
+    streamer.Request(third, 0.0f, 1.0f);
+    streamer.Request(fourth, 1.0f, 1.0f);
+    streamer.Update();
+    CHECK(backend.Evictions == std::vector<UINT>({ second, first }));
+    CHECK_EQ(streamer.GetResidentMip(first), 2u);
+    CHECK_EQ(streamer.GetResidentMip(third), 0u);
+    stats = streamer.GetStats();
+    CHECK(stats.ResidentBytes <= stats.Budget);
+}
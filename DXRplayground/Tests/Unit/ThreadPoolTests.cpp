@@ -0,0 +1,55 @@
+#include "Test.h"
+
+#include <atomic>
+
+#include "Utils/ThreadPool.h"
+
+using namespace DirectxPlayground;
+
+TEST(ThreadPool, VisitsEveryIndexOnce)
+{
+    ThreadPool workers(4);
+    std::vector<std::atomic<int>> visits(10000);
+    workers.ParallelFor(visits.size(), [&visits](size_t i) { ++visits[i]; });
+    for (const auto& v : visits)
+        CHECK_EQ(v.load(), 1);
+}
+
+TEST(ThreadPool, NestedLoopsFinish)
+{
+    ThreadPool workers(2);
+    std::atomic<size_t> sum{ 0 };
+    workers.ParallelFor(64, [&](size_t i)
+    {
+        workers.ParallelFor(64, [&](size_t j) { sum += i * 64 + j; });
+    });
+    size_t count = 64 * 64;
+    CHECK_EQ(sum.load(), count * (count - 1) / 2);
+}
+
+TEST(ThreadPool, WithoutWorkersRunsInOrder)
+{
+    ThreadPool workers(0);
+    CHECK_EQ(workers.GetThreadsCount(), 1u);
+    std::vector<size_t> order;
+    workers.ParallelFor(16, [&order](size_t i) { order.push_back(i); });
+    REQUIRE(order.size() == 16);
+    for (size_t i = 0; i < order.size(); ++i)
+        CHECK_EQ(order[i], i);
+}
+
+TEST(ThreadPool, QueuedTasksFinishBeforeDestruction)
+{
+    std::atomic<int> done{ 0 };
+    {
+        ThreadPool workers(2);
+        for (int i = 0; i < 32; ++i)
+            workers.Run([&done]() { ++done; });
+    }
+    CHECK_EQ(done.load(), 32);
+
+    // Without workers the task is done on return
+    ThreadPool noWorkers(0);
+    noWorkers.Run([&done]() { ++done; });
+    CHECK_EQ(done.load(), 33);
+}
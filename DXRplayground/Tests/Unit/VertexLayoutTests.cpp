@@ -0,0 +1,101 @@
+#include "Test.h"
+#include "GltfGeometry.h"
+
+#include <random>
+
+#include "DXrenderer/Geometry/VertexLayout.h"
+
+using namespace DirectxPlayground;
+using namespace DirectxPlayground::Testing;
+
+namespace
+{
+std::vector<Vertex> GetRandomVertices(size_t count, UINT seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<Vertex> vertices(count);
+    for (auto& v : vertices)
+    {
+        float n[3] = { distribution(random), distribution(random), distribution(random) };
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        v.Pos = { distribution(random) * 5.0f, distribution(random) * 2.0f + 3.0f, distribution(random) };
+        v.Uv = { distribution(random) * 0.5f + 0.5f, distribution(random) * 4.0f };
+        v.Norm = { n[0] / length, n[1] / length, n[2] / length };
+        // Any vector orthogonal to the normal
+        float t[3] = { n[1], -n[0], 0.0f };
+        float tangentLength = std::sqrt(t[0] * t[0] + t[1] * t[1]);
+        v.Tangent = { t[0] / tangentLength, t[1] / tangentLength, 0.0f, distribution(random) < 0.0f ? -1.0f : 1.0f };
+    }
+    return vertices;
+}
+
+VertexEncodingError RoundTrip(const std::vector<Vertex>& vertices, const SourceQuantization& source, std::vector<Vertex>& decoded)
+{
+    std::vector<CompactVertex> encoded;
+    VertexDequantization dequantization;
+    EncodeCompactVertices(vertices, source, encoded, dequantization);
+    DecodeCompactVertices(encoded, dequantization, decoded);
+    return MeasureEncodingError(vertices, decoded);
+}
+}
+
+TEST(VertexLayout, StridesMatchStructs)
+{
+    CHECK_EQ(GetVertexStride(VertexLayout::Float), UINT(sizeof(Vertex)));
+    CHECK_EQ(GetVertexStride(VertexLayout::Compact), UINT(sizeof(CompactVertex)));
+    CHECK_EQ(sizeof(CompactVertex), size_t(16));
+}
+
+TEST(VertexLayout, CompactRoundTripErrorIsBounded)
+{
+    std::vector<Vertex> vertices = GetRandomVertices(10000, 1);
+    std::vector<Vertex> decoded;
+    VertexEncodingError error = RoundTrip(vertices, {}, decoded);
+    printf("  position %g, uv %g, normal %g deg, tangent %g deg\n", error.Position, error.Uv, error.NormalAngle * 57.2958f, error.TangentAngle * 57.2958f);
+
+    // Half a 16 bit step of the largest position extent (10 units) and of the uv extent (8), plus the float rounding of the decode
+    CHECK(error.Position <= 10.0f / 65534.0f * 0.55f);
+    CHECK(error.Uv <= 8.0f / 65535.0f * 0.55f);
+    // Octahedral snorm8 stays within a couple of degrees
+    CHECK(error.NormalAngle < 2.0f / 57.2958f);
+    CHECK(error.TangentAngle < 2.0f / 57.2958f);
+    for (size_t i = 0; i < vertices.size(); ++i)
+        CHECK_EQ(decoded[i].Tangent.w, vertices[i].Tangent.w);
+}
+
+TEST(VertexLayout, QuantizedSourceIsKeptExactly)
+{
+    std::vector<Vertex> vertices = GetRandomVertices(1000, 2);
+    SourceQuantization source;
+    for (int k = 0; k < 3; ++k)
+        source.PositionStep[k] = 1.0f / 1024.0f;
+    source.UvStep[0] = source.UvStep[1] = 1.0f / 4096.0f;
+    for (auto& v : vertices)
+    {
+        v.Pos = { std::round(v.Pos.x * 1024.0f) / 1024.0f, std::round(v.Pos.y * 1024.0f) / 1024.0f, std::round(v.Pos.z * 1024.0f) / 1024.0f };
+        v.Uv = { std::round(v.Uv.x * 4096.0f) / 4096.0f, std::round(v.Uv.y * 4096.0f) / 4096.0f };
+    }
+    std::vector<Vertex> decoded;
+    VertexEncodingError error = RoundTrip(vertices, source, decoded);
+    CHECK(error.Position <= 1e-6f);
+    CHECK(error.Uv <= 1e-6f);
+}
+
+TEST(VertexLayout, FlightHelmetRoundTrip)
+{
+    GltfGeometrySource source(ASSETS_DIR + std::string("Models//FlightHelmet//glTF//FlightHelmet.gltf"));
+    if (!source.IsValid())
+        SKIP("FlightHelmet.gltf isn't in Assets/Models/FlightHelmet/glTF");
+    for (size_t i = 0; i < source.GetPrimitivesCount(); ++i)
+    {
+        GltfPrimitiveGeometry geometry;
+        source.DecodePrimitive(i, geometry);
+        std::vector<Vertex> decoded;
+        VertexEncodingError error = RoundTrip(geometry.Vertices, {}, decoded);
+        printf("  primitive %zu: position %g, uv %g, normal %g deg\n", i, error.Position, error.Uv, error.NormalAngle * 57.2958f);
+        // The helmet is about half a unit across
+        CHECK(error.Position < 1e-5f);
+        CHECK(error.NormalAngle < 2.0f / 57.2958f);
+    }
+}
@@ -0,0 +1,236 @@
+#include "Test.h"
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "DXrenderer/Textures/VirtualTexture.h"
+
+using namespace DirectxPlayground;
+
+namespace
+{
+// 4x4, 2x2 and the pinned 1x1 pages
+constexpr UINT Size512 = 512;
+constexpr UINT Mips512 = 10;
+
+UINT Update(VirtualTextureCache& cache, std::vector<UINT> feedback, UINT maxUploads, std::vector<VirtualTileUpload>& uploads)
+{
+    cache.AddFeedback(feedback.data(), feedback.size());
+    cache.Update(maxUploads, uploads);
+    return static_cast<UINT>(uploads.size());
+}
+
+UINT GetEntry(const VirtualTextureCache& cache, const VirtualTileId& tile)
+{
+    return cache.GetIndirectionTable()[cache.GetIndirectionOffset(tile.Texture, tile.Mip) + tile.Y * cache.GetPagesX(tile.Texture, tile.Mip) + tile.X];
+}
+
+// Every page against the resident pages found by walking up from its first texel, and no physical tile mapped twice
+void CheckIndirection(const VirtualTextureCache& cache, UINT texturesCount)
+{
+    std::set<UINT> physicalTiles;
+    for (UINT texture = 0; texture < texturesCount; ++texture)
+    {
+        UINT mipsCount = cache.GetVirtualMipsCount(texture);
+        for (UINT mip = 0; mip < mipsCount; ++mip)
+        {
+            for (UINT y = 0; y < cache.GetPagesY(texture, mip); ++y)
+            {
+                for (UINT x = 0; x < cache.GetPagesX(texture, mip); ++x)
+                {
+                    VirtualTileId page = { texture, mip, x, y };
+                    UINT entry = GetEntry(cache, page);
+                    if (cache.IsResident(page))
+                    {
+                        CHECK_EQ(entry >> 24, mip);
+                        CHECK(physicalTiles.insert(entry & 0xffffff).second);
+                        continue;
+                    }
+                    UINT expected = InvalidIndirectionEntry;
+                    for (UINT ancestorMip = mip + 1; ancestorMip < mipsCount; ++ancestorMip)
+                    {
+                        UINT ancestorX = std::min((x << mip) >> ancestorMip, cache.GetPagesX(texture, ancestorMip) - 1);
+                        UINT ancestorY = std::min((y << mip) >> ancestorMip, cache.GetPagesY(texture, ancestorMip) - 1);
+                        VirtualTileId ancestor = { texture, ancestorMip, ancestorX, ancestorY };
+                        if (cache.IsResident(ancestor))
+                        {
+                            expected = GetEntry(cache, ancestor);
+                            break;
+                        }
+                    }
+                    CHECK_EQ(entry, expected);
+                }
+            }
+        }
+    }
+}
+
+std::vector<std::vector<UINT>> MakeRandomFeedback(const VirtualTextureCache& cache, UINT texturesCount, UINT framesCount, UINT seed)
+{
+    std::mt19937 random(seed);
+    std::vector<std::vector<UINT>> frames(framesCount);
+    for (auto& frame : frames)
+    {
+        UINT tilesCount = random() % 7;
+        for (UINT i = 0; i < tilesCount; ++i)
+        {
+            UINT texture = random() % texturesCount;
+            UINT mip = random() % cache.GetVirtualMipsCount(texture);
+            UINT x = random() % cache.GetPagesX(texture, mip);
+            UINT y = random() % cache.GetPagesY(texture, mip);
+            frame.push_back(PackVirtualTile({ texture, mip, x, y }));
+        }
+    }
+    return frames;
+}
+}
+
+TEST(VirtualTexture, LeastRecentlyUsedTileIsEvicted)
+{
+    VirtualTextureCache cache(2, 2);
+    UINT texture = cache.AddTexture(Size512, Size512, Mips512);
+    REQUIRE(cache.GetVirtualMipsCount(texture) == 3);
+    std::vector<VirtualTileUpload> uploads;
+    CHECK_EQ(Update(cache, {}, 64, uploads), 1u);
+
+    // The three slots next to the pinned one
+    const VirtualTileId a = { texture, 1, 0, 0 };
+    const VirtualTileId b = { texture, 1, 1, 0 };
+    const VirtualTileId c = { texture, 1, 0, 1 };
+    CHECK_EQ(Update(cache, { PackVirtualTile(a) }, 64, uploads), 1u);
+    CHECK_EQ(Update(cache, { PackVirtualTile(b) }, 64, uploads), 1u);
+    VirtualTileUpload bUpload = uploads[0];
+    CHECK_EQ(Update(cache, { PackVirtualTile(c) }, 64, uploads), 1u);
+    CHECK_EQ(Update(cache, { PackVirtualTile(a) }, 64, uploads), 0u);
+    CHECK_EQ(cache.GetStats().Evictions, 0ull);
+
+    // A was touched after B and C, B goes first and its tile is reused
+    const VirtualTileId d = { texture, 1, 1, 1 };
+    CHECK_EQ(Update(cache, { PackVirtualTile(d) }, 64, uploads), 1u);
+    CHECK_EQ(uploads[0].PhysicalX, bUpload.PhysicalX);
+    CHECK_EQ(uploads[0].PhysicalY, bUpload.PhysicalY);
+    CHECK(!cache.IsResident(b));
+    CHECK(cache.IsResident(a) && cache.IsResident(c) && cache.IsResident(d));
+
+    CHECK_EQ(Update(cache, { PackVirtualTile({ texture, 0, 0, 0 }) }, 64, uploads), 1u);
+    CHECK(!cache.IsResident(c));
+    CHECK(cache.IsResident(a) && cache.IsResident(d));
+    CHECK_EQ(cache.GetStats().Evictions, 2ull);
+
+    // Everything in the cache is wanted, the rest of the faults wait
+    std::vector<UINT> everything = { PackVirtualTile(a), PackVirtualTile(d), PackVirtualTile({ texture, 0, 0, 0 }), PackVirtualTile(b) };
+    CHECK_EQ(Update(cache, everything, 64, uploads), 0u);
+    CHECK(!cache.IsResident(b));
+    CheckIndirection(cache, 1);
+}
+
+TEST(VirtualTexture, PinnedTilesAreMappedWhenUploaded)
+{
+    VirtualTextureCache cache(2, 1);
+    UINT texture = cache.AddTexture(Size512, Size512, Mips512);
+    const VirtualTileId pinned = { texture, 2, 0, 0 };
+    CHECK(!cache.IsResident(pinned));
+    for (UINT entry : cache.GetIndirectionTable())
+        CHECK_EQ(entry, InvalidIndirectionEntry);
+
+    std::vector<VirtualTileUpload> uploads;
+    CHECK_EQ(Update(cache, {}, 0, uploads), 0u);
+    CHECK(!cache.IsResident(pinned));
+    CHECK_EQ(GetEntry(cache, pinned), InvalidIndirectionEntry);
+
+    // The pinned upload goes first and takes the whole budget, the fault waits
+    CHECK_EQ(Update(cache, { PackVirtualTile({ texture, 1, 0, 0 }) }, 1, uploads), 1u);
+    CHECK_EQ(uploads[0].Tile.Mip, 2u);
+    CHECK(cache.IsResident(pinned));
+    CHECK(!cache.IsResident({ texture, 1, 0, 0 }));
+    CHECK_EQ(cache.GetStats().Faults, 1ull);
+    CHECK_EQ(cache.GetStats().Uploads, 0ull);
+    UINT pinnedEntry = PackIndirectionEntry(uploads[0].PhysicalX, uploads[0].PhysicalY, 2);
+    for (UINT entry : cache.GetIndirectionTable())
+        CHECK_EQ(entry, pinnedEntry);
+
+    // One slot left for everything else, the pinned tile stays
+    for (UINT frame = 0; frame < 16; ++frame)
+    {
+        CHECK_EQ(Update(cache, { PackVirtualTile({ texture, 0, frame % 4, frame / 4 }) }, 64, uploads), 1u);
+        CHECK(cache.IsResident(pinned));
+        CHECK_EQ(GetEntry(cache, pinned), pinnedEntry);
+    }
+    CHECK_EQ(cache.GetStats().Evictions, 15ull);
+
+    // Mips past the virtual ones ask for the pinned tile
+    cache.AddMipFeedback(texture, 7);
+    cache.Update(64, uploads);
+    CHECK(uploads.empty());
+    CHECK_EQ(cache.GetStats().Hits, 1ull);
+}
+
+TEST(VirtualTexture, UnmappedPagesFallBackToTheirParent)
+{
+    VirtualTextureCache cache(2, 1);
+    UINT texture = cache.AddTexture(Size512, Size512, Mips512);
+    std::vector<VirtualTileUpload> uploads;
+    Update(cache, {}, 64, uploads);
+    UINT pinnedEntry = GetEntry(cache, { texture, 2, 0, 0 });
+
+    const VirtualTileId parent = { texture, 1, 1, 0 };
+    CHECK_EQ(Update(cache, { PackVirtualTile(parent) }, 64, uploads), 1u);
+    UINT parentEntry = PackIndirectionEntry(uploads[0].PhysicalX, uploads[0].PhysicalY, 1);
+    CHECK_EQ(GetEntry(cache, parent), parentEntry);
+    for (UINT y = 0; y < 4; ++y)
+    {
+        for (UINT x = 0; x < 4; ++x)
+            CHECK_EQ(GetEntry(cache, { texture, 0, x, y }), x >= 2 && y < 2 ? parentEntry : pinnedEntry);
+    }
+    CHECK_EQ(GetEntry(cache, { texture, 1, 0, 0 }), pinnedEntry);
+
+    // Evicting the parent sends its children back to the pinned tile
+    CHECK_EQ(Update(cache, { PackVirtualTile({ texture, 1, 0, 1 }) }, 64, uploads), 1u);
+    CHECK(!cache.IsResident(parent));
+    CHECK_EQ(GetEntry(cache, parent), pinnedEntry);
+    CHECK_EQ(GetEntry(cache, { texture, 0, 3, 1 }), pinnedEntry);
+    CHECK_EQ(GetEntry(cache, { texture, 0, 1, 3 }), GetEntry(cache, { texture, 1, 0, 1 }));
+    CheckIndirection(cache, 1);
+}
+
+TEST(VirtualTexture, RandomReplayKeepsTheFallbacks)
+{
+    // Odd page counts: 5x3, 3x2, 2x1 and a pinned 1x1
+    VirtualTextureCache cache(3, 3);
+    cache.AddTexture(640, 384, 10);
+    cache.AddTexture(Size512, Size512, Mips512);
+    REQUIRE(cache.GetVirtualMipsCount(0) == 4);
+    std::vector<std::vector<UINT>> frames = MakeRandomFeedback(cache, 2, 300, 7);
+    std::vector<VirtualTileUpload> uploads;
+    for (const auto& frame : frames)
+    {
+        cache.AddFeedback(frame.data(), frame.size());
+        cache.Update(3, uploads);
+        CheckIndirection(cache, 2);
+    }
+    CHECK(cache.GetStats().Evictions > 0);
+}
+
+TEST(VirtualTexture, ReplayIsDeterministic)
+{
+    VirtualTextureCache first(4, 2);
+    VirtualTextureCache second(4, 2);
+    for (VirtualTextureCache* cache : { &first, &second })
+    {
+        cache->AddTexture(640, 384, 10);
+        cache->AddTexture(Size512, Size512, Mips512);
+        cache->AddTexture(2048, 1024, 12);
+    }
+    std::vector<std::vector<UINT>> frames = MakeRandomFeedback(first, 3, 500, 11);
+    VirtualTextureStats a = ReplayVirtualTextureFeedback(first, frames, 4);
+    VirtualTextureStats b = ReplayVirtualTextureFeedback(second, frames, 4);
+    CHECK_EQ(a.Requests, b.Requests);
+    CHECK_EQ(a.Hits, b.Hits);
+    CHECK_EQ(a.Faults, b.Faults);
+    CHECK_EQ(a.Uploads, b.Uploads);
+    CHECK_EQ(a.Evictions, b.Evictions);
+    CHECK(first.GetIndirectionTable() == second.GetIndirectionTable());
+    CHECK_EQ(a.Requests, a.Hits + a.Faults);
+    CHECK(a.Hits > 0 && a.Evictions > 0);
+}